@@ -0,0 +1,26 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void bench_header(const char *name)
+{
+    printf("\n====== benchmark: %s ======\n", name);
+}
+
+void bench_report(const char *label, double seconds, double units, const char *unit)
+{
+    printf("  %-32s %12.0f %s/s  (%.3f s)\n", label, units / seconds, unit, seconds);
+}
+
+#endif // BENCH_H
@@ -0,0 +1,69 @@
+/**
+ * Measures CRC-32/MPEG-2 throughput (MB/s) of each kernel over PSI sized
+ * sections and larger private sections.
+ */
+
+#include "bench.h"
+#include "../test/stream.h"
+#include <tsdemux.h>
+#include <string.h>
+
+#define TOTAL_BYTES     (512 * 1024 * 1024)
+
+// the library's kernels, not part of the public API
+uint32_t crc32_slice8(uint32_t crc, const uint8_t *data, size_t size);
+#if defined(__x86_64__) || defined(__i386__)
+uint32_t crc32_pclmul(uint32_t crc, const uint8_t *data, size_t size);
+#endif
+
+typedef uint32_t (*crc_fn)(uint32_t crc, const uint8_t *data, size_t size);
+
+uint32_t bitwise(uint32_t crc, const uint8_t *data, size_t size)
+{
+    return stream_crc32(data, size);
+}
+
+void run(const char *name, crc_fn fn, const uint8_t *data, size_t size, size_t total)
+{
+    size_t rounds = total / size;
+    size_t i;
+    uint32_t sum = 0;
+    double start = bench_now();
+    for(i=0; i<rounds; ++i) {
+        sum ^= fn(0xFFFFFFFF, data, size);
+    }
+    double elapsed = bench_now() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s %zu bytes", name, size);
+    bench_report(label, elapsed, (double)rounds * size / (1024.0 * 1024.0), "MB");
+    if(sum == 0x12345678) {
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_header("CRC-32/MPEG-2");
+
+    uint8_t data[4096];
+    size_t i;
+    for(i=0; i<sizeof(data); ++i) {
+        data[i] = (uint8_t)(i * 131 + 7);
+    }
+    // fills in the tables used by the kernels
+    tsd_crc32(data, sizeof(data));
+
+    size_t sizes[] = { 188, 1024, 4096 };
+    for(i=0; i<sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        run("bitwise", bitwise, data, sizes[i], TOTAL_BYTES / 64);
+        run("slice-by-8", crc32_slice8, data, sizes[i], TOTAL_BYTES);
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) {
+            run("pclmul", crc32_pclmul, data, sizes[i], TOTAL_BYTES);
+        }
+#endif
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * Measures header only scanning (MB/s), parsing one packet at a time with
+ * tsd_parse_packet_header versus tsd_parse_packet_headers_batch.
+ */
+
+#include "bench.h"
+#include "../test/stream.h"
+#include <tsdemux.h>
+#include <string.h>
+
+#define PACKETS     (350000)
+#define BATCH       (1024)
+#define ROUNDS      (5)
+
+int main(int argc, char **argv)
+{
+    bench_header("packet header scanning");
+
+    uint8_t payload[184];
+    uint8_t cc = 0;
+    size_t i, r;
+
+    size_t len = PACKETS * 188;
+    uint8_t *stream = (uint8_t*) malloc(len);
+    memset(payload, 0xAB, sizeof(payload));
+    for(i=0; i<PACKETS; ++i) {
+        // a mix of full payloads and adaptation field stuffing
+        stream_packet(&stream[i * 188], (uint16_t)(0x100 + (i % 16)), i % 8 == 0,
+                      &cc, payload, (i % 3) ? 184 : 120, 0);
+    }
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+
+    // one packet at a time
+    size_t sum = 0;
+    double start = bench_now();
+    for(r=0; r<ROUNDS; ++r) {
+        TSDPacket hdr;
+        for(i=0; i<PACKETS; ++i) {
+            tsd_parse_packet_header(&ctx, &stream[i * 188], 188, &hdr);
+            sum += hdr.pid + hdr.continuity_counter;
+        }
+    }
+    double elapsed = bench_now() - start;
+    bench_report("tsd_parse_packet_header", elapsed,
+                 (double)len * ROUNDS / (1024.0 * 1024.0), "MB");
+
+    // in batches
+    uint16_t pid[BATCH];
+    uint8_t flags[BATCH], ccs[BATCH], afc[BATCH], offset[BATCH];
+    uint64_t pcr[BATCH];
+    TSDPacketHeaders headers = { pid, flags, ccs, afc, offset, pcr, BATCH };
+    size_t batch_sum = 0;
+    start = bench_now();
+    for(r=0; r<ROUNDS; ++r) {
+        size_t pos = 0;
+        while(pos < len) {
+            size_t count = 0;
+            tsd_parse_packet_headers_batch(&ctx, &stream[pos], len - pos, &headers, &count);
+            for(i=0; i<count; ++i) {
+                batch_sum += pid[i] + ccs[i];
+            }
+            pos += count * 188;
+        }
+    }
+    elapsed = bench_now() - start;
+    bench_report("tsd_parse_packet_headers_batch", elapsed,
+                 (double)len * ROUNDS / (1024.0 * 1024.0), "MB");
+
+    if(sum != batch_sum) {
+        printf("  mismatch %zu != %zu\n", sum, batch_sum);
+    }
+
+    tsd_context_destroy(&ctx);
+    free(stream);
+    return 0;
+}
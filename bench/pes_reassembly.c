@@ -0,0 +1,123 @@
+/**
+ * Measures PES reassembly cost (frames/s, MB/s and reallocations per frame)
+ * on a synthetic 4K HEVC stream: unbounded video PES packets with a 1.5 MB
+ * IDR frame every GOP and smaller frames in between.
+ */
+
+#include "bench.h"
+#include "../test/stream.h"
+#include <tsdemux.h>
+#include <string.h>
+
+#define VIDEO_PID       (0x100)
+#define GOP_LENGTH      (30)
+#define GOPS            (2)
+#define IDR_SIZE        (1536 * 1024)
+#define FRAME_SIZE      (160 * 1024)
+#define ROUNDS          (20)
+
+size_t frames = 0;
+size_t frame_bytes = 0;
+size_t allocations = 0;
+
+void *counting_malloc(size_t size)
+{
+    allocations++;
+    return malloc(size);
+}
+
+void *counting_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return realloc(ptr, size);
+}
+
+void event_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PES) {
+        TSDPESPacket *pes = (TSDPESPacket*)data;
+        frames++;
+        frame_bytes += pes->data_bytes_length;
+    }
+}
+
+// demuxes the stream ROUNDS times, either with a new context each time, so
+// every buffer has to grow from scratch, or with one context throughout.
+void run(const char *name, const uint8_t *stream, size_t len, int cold)
+{
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    double elapsed = 0;
+    size_t round;
+
+    frames = 0;
+    frame_bytes = 0;
+    allocations = 0;
+    for(round=0; round<ROUNDS; ++round) {
+        if(cold || round == 0) {
+            tsd_context_init(&ctx);
+            ctx.malloc = counting_malloc;
+            ctx.realloc = counting_realloc;
+            tsd_set_event_callback(&ctx, event_cb);
+            tsd_register_pid(&ctx, VIDEO_PID, TSD_REG_PES);
+        }
+        double start = bench_now();
+        tsd_demux(&ctx, (void*)stream, len, &parsed);
+        if(cold) {
+            tsd_demux_end(&ctx);
+        }
+        elapsed += bench_now() - start;
+        if(cold) {
+            tsd_context_destroy(&ctx);
+        }
+    }
+    if(!cold) {
+        tsd_context_destroy(&ctx);
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s frames", name);
+    bench_report(label, elapsed, (double)frames, "frames");
+    snprintf(label, sizeof(label), "%s payload", name);
+    bench_report(label, elapsed, (double)frame_bytes / (1024.0 * 1024.0), "MB");
+    snprintf(label, sizeof(label), "%s allocations", name);
+    printf("  %-32s %12.2f per frame\n", label,
+           frames ? (double)allocations / frames : 0.0);
+}
+
+// writes an unbounded PES carrying size bytes of payload, packetized.
+size_t write_frame(uint8_t *out, uint8_t *cc, uint8_t *pes, size_t size, uint64_t pts)
+{
+    uint8_t payload[1] = { 0 };
+    // build the PES header, then the payload straight after it
+    stream_pes(pes, 0xE0, pts, payload, 0, 0);
+    memset(&pes[14], (uint8_t)pts, size);
+    return stream_packetize_pes(out, VIDEO_PID, cc, pes, size + 14);
+}
+
+int main(int argc, char **argv)
+{
+    bench_header("PES reassembly, 4K HEVC");
+
+    size_t frame_count = GOP_LENGTH * GOPS;
+    size_t max_packets = (IDR_SIZE / 184 + 2) * GOPS +
+                         (FRAME_SIZE / 184 + 2) * frame_count;
+    uint8_t *stream = (uint8_t*) malloc(max_packets * 188);
+    uint8_t *pes = (uint8_t*) malloc(IDR_SIZE + 14);
+    uint8_t cc = 0;
+    size_t len = 0;
+    size_t i;
+
+    for(i=0; i<frame_count; ++i) {
+        size_t size = (i % GOP_LENGTH) == 0 ? IDR_SIZE :
+                      FRAME_SIZE - (i % 7) * 8192;
+        len += write_frame(&stream[len], &cc, pes, size, i * 3003);
+    }
+
+    run("cold", stream, len, 1);
+    run("warm", stream, len, 0);
+
+    free(pes);
+    free(stream);
+    return 0;
+}
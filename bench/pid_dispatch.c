@@ -0,0 +1,107 @@
+/**
+ * Measures tsd_demux throughput (packets/s) as the number of programs in a
+ * multi program transport stream grows.
+ */
+
+#include "bench.h"
+#include "../test/stream.h"
+#include <tsdemux.h>
+#include <string.h>
+
+// number of elementary streams we register for PES data
+#define REGISTERED_STREAMS  (16)
+// PES packets written in total, spread over all the programs
+#define PES_PACKETS         (200000)
+#define ROUNDS              (20)
+
+int registered = 0;
+size_t pes_events = 0;
+
+void event_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PMT && registered < REGISTERED_STREAMS) {
+        TSDPMTData *pmt = (TSDPMTData*)data;
+        if(pmt->program_elements_length > 0) {
+            if(tsd_register_pid(ctx, pmt->program_elements[0].elementary_pid,
+                                TSD_REG_PES) == TSD_OK) {
+                registered++;
+            }
+        }
+    } else if(id == TSD_EVENT_PES) {
+        pes_events++;
+    }
+}
+
+void run(size_t programs)
+{
+    uint8_t section[1024];
+    uint8_t payload[160];
+    uint8_t pes[256];
+    uint16_t prog_nums[256];
+    uint16_t pmt_pids[256];
+    uint8_t cc[256];
+    uint8_t cc_psi = 0;
+    size_t i, j;
+
+    // PSI followed by one single packet PES per program, repeated
+    size_t packets = 8 + programs + PES_PACKETS;
+    uint8_t *stream = (uint8_t*) malloc(packets * 188);
+    size_t len = 0;
+
+    memset(prog_nums, 0, sizeof(prog_nums));
+    memset(pmt_pids, 0, sizeof(pmt_pids));
+    memset(cc, 0, sizeof(cc));
+    memset(payload, 0xAB, sizeof(payload));
+    for(i=0; i<programs; ++i) {
+        prog_nums[i] = (uint16_t)(i + 1);
+        pmt_pids[i] = (uint16_t)(0x1000 + i);
+    }
+    size_t sec_len = stream_pat(section, 1, 0, programs, prog_nums, pmt_pids);
+    len += stream_packetize_section(&stream[len], 0, &cc_psi, section, sec_len);
+    for(i=0; i<programs; ++i) {
+        uint8_t type = TSD_PMT_STREAM_TYPE_VIDEO_AVC;
+        uint16_t es_pid = (uint16_t)(0x100 + i);
+        uint8_t pmt_cc = 0;
+        sec_len = stream_pmt(section, prog_nums[i], 0, es_pid, 1, &type, &es_pid);
+        len += stream_packetize_section(&stream[len], pmt_pids[i], &pmt_cc, section, sec_len);
+    }
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    for(j=0; j<PES_PACKETS / programs; ++j) {
+        for(i=0; i<programs; ++i) {
+            len += stream_packetize_pes(&stream[len], (uint16_t)(0x100 + i),
+                                        &cc[i], pes, pes_len);
+        }
+    }
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    registered = 0;
+    pes_events = 0;
+
+    size_t parsed = 0;
+    double start = bench_now();
+    for(i=0; i<ROUNDS; ++i) {
+        tsd_demux(&ctx, stream, len, &parsed);
+    }
+    double elapsed = bench_now() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%zu programs", programs);
+    bench_report(label, elapsed, (double)(len / 188) * ROUNDS, "packets");
+
+    tsd_context_destroy(&ctx);
+    free(stream);
+}
+
+int main(int argc, char **argv)
+{
+    bench_header("PID dispatch");
+
+    size_t programs[] = { 1, 10, 50, 100, 200 };
+    size_t i;
+    for(i=0; i<sizeof(programs) / sizeof(programs[0]); ++i) {
+        run(programs[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * Measures tsd_demux throughput (MB/s) on a noisy capture, where bursts of
+ * random bytes regularly break the packet sync.
+ */
+
+#include "bench.h"
+#include "../test/stream.h"
+#include <tsdemux.h>
+#include <string.h>
+
+#define PACKETS         (100000)
+// a burst of garbage follows every GARBAGE_INTERVAL packets
+#define GARBAGE_INTERVAL (10)
+#define GARBAGE_SIZE    (4096)
+#define ROUNDS          (5)
+
+size_t pes_events = 0;
+size_t sync_events = 0;
+
+void event_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PES) {
+        pes_events++;
+    } else if(id == TSD_EVENT_SYNC_ACQUIRED) {
+        sync_events++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_header("resync on noisy data");
+
+    uint8_t payload[160];
+    uint8_t pes[256];
+    uint8_t cc = 0;
+    size_t i;
+    uint32_t seed = 12345;
+
+    size_t bursts = PACKETS / GARBAGE_INTERVAL;
+    size_t capacity = PACKETS * 188 + bursts * GARBAGE_SIZE;
+    uint8_t *stream = (uint8_t*) malloc(capacity);
+    size_t len = 0;
+
+    memset(payload, 0xAB, sizeof(payload));
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    for(i=0; i<PACKETS; ++i) {
+        len += stream_packetize_pes(&stream[len], 0x100, &cc, pes, pes_len);
+        if((i + 1) % GARBAGE_INTERVAL == 0) {
+            size_t j;
+            for(j=0; j<GARBAGE_SIZE; ++j) {
+                seed = seed * 1103515245 + 12345;
+                stream[len++] = (uint8_t)(seed >> 16);
+            }
+        }
+    }
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    tsd_register_pid(&ctx, 0x100, TSD_REG_PES);
+
+    size_t parsed = 0;
+    double start = bench_now();
+    for(i=0; i<ROUNDS; ++i) {
+        tsd_demux(&ctx, stream, len, &parsed);
+    }
+    double elapsed = bench_now() - start;
+
+    bench_report("garbage every 10 packets", elapsed,
+                 (double)len * ROUNDS / (1024.0 * 1024.0), "MB");
+    printf("  PES events %zu of %zu\n", pes_events, (size_t)PACKETS * ROUNDS);
+
+    tsd_context_destroy(&ctx);
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * Measures Annex B start code scanning (MB/s) of a naive byte loop against
+ * each kernel, and the NAL splitter, over synthetic AVC elementary streams at
+ * 1080p and 4K bitrates.
+ */
+
+#include "bench.h"
+#include <tsdemux.h>
+#include <string.h>
+
+#define TOTAL_BYTES     (1024 * 1024 * 1024)
+#define FRAME_RATE      (50)
+
+// the library's kernels, not part of the public API
+typedef const uint8_t *(*find_start_code_fn)(const uint8_t *ptr, const uint8_t *end, uint8_t max);
+const uint8_t *find_start_code_scalar(const uint8_t *ptr, const uint8_t *end, uint8_t max);
+#if defined(__x86_64__) || defined(__i386__)
+const uint8_t *find_start_code_sse2(const uint8_t *ptr, const uint8_t *end, uint8_t max);
+const uint8_t *find_start_code_avx2(const uint8_t *ptr, const uint8_t *end, uint8_t max);
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+const uint8_t *find_start_code_neon(const uint8_t *ptr, const uint8_t *end, uint8_t max);
+#endif
+
+size_t naive(const uint8_t *data, size_t size)
+{
+    size_t count = 0;
+    size_t i;
+    for(i=0; i + 2 < size; ++i) {
+        if(data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t kernel_count(find_start_code_fn fn, const uint8_t *data, size_t size)
+{
+    const uint8_t *ptr = data;
+    const uint8_t *end = data + size;
+    size_t count = 0;
+    while((ptr = fn(ptr, end, 1)) != NULL) {
+        if(ptr[2] == 1) {
+            count++;
+            ptr += 3;
+        } else {
+            ptr++;
+        }
+    }
+    return count;
+}
+
+size_t library_count(const uint8_t *data, size_t size)
+{
+    size_t count = 0;
+    size_t offset;
+    while(tsd_find_start_code(data, size, &offset) == TSD_OK) {
+        count++;
+        data += offset + 3;
+        size -= offset + 3;
+    }
+    return count;
+}
+
+size_t splitter_count(const uint8_t *data, size_t size)
+{
+    TSDNALSplitter splitter;
+    TSDNALUnit unit;
+    size_t count = 0;
+    tsd_nal_splitter_init(&splitter, TSD_PMT_STREAM_TYPE_VIDEO_AVC);
+    tsd_nal_splitter_feed(&splitter, data, size);
+    while(tsd_nal_splitter_next(&splitter, &unit) == TSD_OK) {
+        count++;
+    }
+    if(tsd_nal_splitter_end(&splitter, &unit) == TSD_OK) {
+        count++;
+    }
+    return count;
+}
+
+void report(const char *name, const char *rate, double elapsed, size_t rounds,
+            size_t size, size_t count, size_t expected)
+{
+    char label[64];
+    snprintf(label, sizeof(label), "%s %s", name, rate);
+    bench_report(label, elapsed, (double)rounds * size / (1024.0 * 1024.0), "MB");
+    if(count != expected) {
+        printf("  %s found %zu start codes, expected %zu\n", label, count, expected);
+    }
+}
+
+void run_kernel(const char *name, find_start_code_fn fn, const char *rate,
+                const uint8_t *data, size_t size, size_t expected)
+{
+    size_t rounds = TOTAL_BYTES / size;
+    size_t count = 0;
+    size_t i;
+    double start = bench_now();
+    for(i=0; i<rounds; ++i) {
+        count = kernel_count(fn, data, size);
+    }
+    report(name, rate, bench_now() - start, rounds, size, count, expected);
+}
+
+// one second of video: an AUD and a few slices per frame, the slice data
+// random and escaped with emulation prevention bytes like a real stream.
+size_t write_stream(uint8_t *out, size_t bitrate, size_t slices)
+{
+    size_t frame_size = bitrate / 8 / FRAME_RATE;
+    size_t slice_size = frame_size / slices;
+    uint32_t seed = 0x12345678;
+    size_t len = 0;
+    size_t frame, slice, i;
+
+    for(frame=0; frame<FRAME_RATE; ++frame) {
+        const uint8_t aud[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0 };
+        memcpy(&out[len], aud, sizeof(aud));
+        len += sizeof(aud);
+        for(slice=0; slice<slices; ++slice) {
+            out[len++] = 0x00;
+            out[len++] = 0x00;
+            out[len++] = 0x01;
+            out[len++] = frame % 25 == 0 ? 0x65 : 0x41;
+            size_t zeros = 0;
+            for(i=0; i<slice_size; ++i) {
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                uint8_t byte = (uint8_t)seed;
+                if(zeros >= 2 && byte <= 3) {
+                    out[len++] = 0x03;
+                    zeros = 0;
+                }
+                out[len++] = byte;
+                zeros = byte == 0 ? zeros + 1 : 0;
+            }
+            // rbsp_stop_one_bit
+            out[len++] = 0x80;
+        }
+    }
+    return len;
+}
+
+void run(const char *rate, size_t bitrate, size_t slices)
+{
+    uint8_t *data = (uint8_t*) malloc(bitrate / 8 * 2);
+    size_t size = write_stream(data, bitrate, slices);
+    size_t expected = naive(data, size);
+    size_t rounds = TOTAL_BYTES / size;
+    size_t count = 0;
+    size_t i;
+
+    double start = bench_now();
+    for(i=0; i<rounds; ++i) {
+        count = naive(data, size);
+    }
+    report("naive", rate, bench_now() - start, rounds, size, count, expected);
+
+    run_kernel("scalar", find_start_code_scalar, rate, data, size, expected);
+#if defined(__x86_64__) || defined(__i386__)
+    run_kernel("sse2", find_start_code_sse2, rate, data, size, expected);
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        run_kernel("avx2", find_start_code_avx2, rate, data, size, expected);
+    }
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    run_kernel("neon", find_start_code_neon, rate, data, size, expected);
+#endif
+
+    start = bench_now();
+    for(i=0; i<rounds; ++i) {
+        count = library_count(data, size);
+    }
+    report("tsd_find_start_code", rate, bench_now() - start, rounds, size, count, expected);
+
+    start = bench_now();
+    for(i=0; i<rounds; ++i) {
+        count = splitter_count(data, size);
+    }
+    report("tsd_nal_splitter", rate, bench_now() - start, rounds, size, count, expected);
+
+    free(data);
+}
+
+int main(int argc, char **argv)
+{
+    bench_header("Annex B start codes");
+
+    run("1080p", 8 * 1000 * 1000, 4);
+    run("4K", 25 * 1000 * 1000, 8);
+    return 0;
+}
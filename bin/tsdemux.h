@@ -0,0 +1,2502 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Joel Freeman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TS_DEMUX_H
+#define TS_DEMUX_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// Software version, format MAJOR.MINOR.PATCH
+#define TSD_VERSION                             "0.1.1"
+
+#define TSD_SYNC_BYTE                           (0x47)
+#define TSD_MESSAGE_LEN                         (128)
+#define TSD_TSPACKET_SIZE                       (188)
+#define TSD_M2TS_PACKET_SIZE                    (192)
+#define TSD_RS_PACKET_SIZE                      (204)
+#define TSD_PACKET_SIZE_DETECT_BYTES            (4096)
+#define TSD_FILE_WINDOW_SIZE                    (64 * 1024 * 1024)
+#define TSD_MEM_PAGE_SIZE                       (1024)
+#define TSD_PID_REGS_INITIAL_CAPACITY           (16)
+#define TSD_PID_MAP_SIZE                        (8192)
+#define TSD_SYNC_CONFIRM_PACKETS                (3)
+#define TSD_SECTION_BUFFERS_MAX                 (16)
+#define TSD_TABLE_CACHE_INITIAL_CAPACITY        (16)
+#define TSD_SECTION_FILTERS_INITIAL_CAPACITY    (8)
+#define TSD_ARENA_ALIGNMENT                     (16)
+#define TSD_PES_HEADER_MAX_SIZE                 (6 + 3 + 255)
+#define TSD_PES_SLICES_INITIAL_CAPACITY         (16)
+
+// C++ support
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file
+ * @ingroup tsdemux
+ * Libtsdemux external API header
+ */
+
+// forward declarations
+typedef struct TSDemuxContext TSDemuxContext;
+typedef struct TSDTable TSDTable;
+typedef struct TSDTableSection TSDTableSection;
+
+/**
+ * Event Id.
+ * The Id of all events that may occur during demux. 
+ * (Moved here because forward declaration not allowed on enum!)
+ */
+typedef enum TSDEventId {
+    TSD_EVENT_PAT                            = 0x0001,
+    /// data is the TSDPMTData of the program directory, see tsd_get_program
+    TSD_EVENT_PMT                            = 0x0002,
+    TSD_EVENT_CAT                            = 0x0004,
+    TSD_EVENT_TSDT                           = 0x0008,
+    /// Table passing a section filter, data is a TSDTableData
+    TSD_EVENT_TABLE                          = 0x0010,
+    // User Registered PES data
+    TSD_EVENT_PES                            = 0x0020,
+    // User Registered Adaptionn Field Private Data
+    TSD_EVENT_ADAP_FIELD_PRV_DATA            = 0x0040,
+    /// Packet sync was lost, data is a TSDSyncEvent
+    TSD_EVENT_SYNC_LOSS                      = 0x0080,
+    /// Packet sync was (re)acquired, data is a TSDSyncEvent
+    TSD_EVENT_SYNC_ACQUIRED                  = 0x0100,
+    /// User Registered PCR, data is the TSDAdaptationField carrying it
+    TSD_EVENT_PCR                            = 0x0200,
+    /// User Registered PES as slices, data is a TSDPESSlices
+    TSD_EVENT_PES_SLICES                     = 0x0400,
+    /// Streamed PES header, data is a TSDPESPacket without data_bytes
+    TSD_EVENT_PES_START                      = 0x0800,
+    /// Streamed PES payload, data is a TSDPESChunk
+    TSD_EVENT_PES_DATA                       = 0x1000,
+    /// Streamed PES end, data is a TSDPESChunk
+    TSD_EVENT_PES_END                        = 0x2000,
+} TSDEventId;
+
+typedef enum TSDEventId TSDEventId;
+
+/**
+ * Memory Allocator.
+ * Allocate memory block.
+ * See malloc C90 (C++98) definition.
+ */
+typedef void * (*tsd_malloc) (size_t size);
+
+/**
+ * Memory Allocator.
+ * Allocate and zero initialize array.
+ * See calloc C90 (C++98) definition.
+ */
+typedef void * (*tsd_calloc) (size_t num, size_t size);
+
+/**
+ * Memory Allocator.
+ * Changes the size of the memory block pointed at by ptr.
+ * See realloc C90 (C++98) definition.
+ */
+typedef void * (*tsd_realloc) (void *ptr, size_t size);
+
+/**
+ * Memory deallocator.
+ */
+typedef void (*tsd_free) (void *mem);
+
+/**
+ * Allocator.
+ * A set of memory functions which are all passed user, so that each context
+ * can allocate from its own arena or pool without global state.
+ * @see tsd_set_allocator
+ */
+typedef struct TSDAllocator {
+    void * (*malloc) (void *user, size_t size);
+    void * (*calloc) (void *user, size_t num, size_t size);
+    void * (*realloc) (void *user, void *ptr, size_t size);
+    void (*free) (void *user, void *mem);
+    void *user;
+} TSDAllocator;
+
+/**
+ * Arena.
+ * A bump allocator handing out memory from a region supplied by the user.
+ * Memory is only given back when the arena is reset, apart from the most
+ * recent allocation which can be freed or grown in place.
+ * @see tsd_arena_init
+ */
+typedef struct TSDArena {
+    uint8_t *buffer;
+    size_t size;
+    size_t used;    /// bytes of buffer handed out so far
+    size_t last;    /// offset of the most recent allocation
+} TSDArena;
+
+/**
+ * Event Callback.
+ */
+typedef void (*tsd_on_event) (TSDemuxContext *ctx,
+                              uint16_t pid,
+                              TSDEventId id,
+                              void *data);
+
+/**
+ * Return codes.
+ */
+typedef enum TSDCode {
+    TSD_OK                                    = 0x0000,
+    TSD_INVALID_SYNC_BYTE                     = 0x0001,
+    TSD_INVALID_CONTEXT                       = 0x0002,
+    TSD_INVALID_DATA                          = 0x0003,
+    TSD_INVALID_DATA_SIZE                     = 0x0004,
+    TSD_INVALID_ARGUMENT                      = 0x0005,
+    TSD_INVALID_START_CODE_PREFIX             = 0x0006,
+    TSD_OUT_OF_MEMORY                         = 0x0007,
+    TSD_INCOMPLETE_TABLE                      = 0x0008,
+    TSD_NOT_A_TABLE_PACKET                    = 0x0009,
+    TSD_PARSE_ERROR                           = 0x000A,
+    TSD_PID_ALREADY_REGISTERED                = 0x000B,
+    TSD_TSD_MAX_PID_REGS_REACHED              = 0x000C,
+    TSD_PID_NOT_FOUND                         = 0x000D,
+    TSD_INVALID_POINTER_FIELD                 = 0x000E,
+    TSD_FILE_ERROR                            = 0x000F,
+    TSD_TABLE_UNCHANGED                       = 0x0010,
+    TSD_INVALID_CRC                           = 0x0011,
+    TSD_END_OF_DATA                           = 0x0012,
+    TSD_UNKNOWN_DESCRIPTOR                    = 0x0013,
+    TSD_PROGRAM_NOT_FOUND                     = 0x0014,
+} TSDCode;
+
+/**
+ * Transport Stream Packet Flags.
+ */
+typedef enum TSDPacketFlags {
+    TSD_PF_TRAN_ERR_INDICATOR                 = 0x04,
+    TSD_PF_PAYLOAD_UNIT_START_IND             = 0x02,
+    TSD_PF_TRAN_PRIORITY                      = 0x01,
+    /// PCR present, only set by tsd_parse_packet_headers_batch
+    TSD_PF_PCR                                = 0x08,
+} TSDPacketFlags;
+
+/**
+ * Adaptation Field Control.
+ */
+typedef enum TSDAdaptionFieldControl {
+    TSD_AFC_RESERVED                          = 0x00,
+    TSD_AFC_NO_FIELD_PRESENT                  = 0x01,
+    TSD_AFC_ADAP_FIELD_ONLY                   = 0x02,
+    TSD_AFC_ADAP_FIELD_AND_PAYLOAD            = 0x03,
+} TSDAdaptionFieldControl;
+
+/**
+ * Transport Scrambling Control.
+ */
+typedef enum TSDScramblingControl {
+    /** No scrambling of packet payload **/
+    TSD_SC_NO_SCRAMBLING                          = 0x00,
+    /** Reserved **/
+    TSD_SC_RESERVED                               = 0x01,
+    /** Transport Packet scrambled with Even key. **/
+    TSD_SC_EVEN_KEY                               = 0x02,
+    /** Transport Packet scrambled with Odd key. **/
+    TSD_SC_ODD_KEY                                = 0x03,
+} TSDScramblingControl;
+
+/**
+ * PID Value Allocations
+ */
+typedef enum TSDPIDValue {
+    /** Program Association TSDTable **/
+    TSD_PID_PAT                                   = 0x0000,
+    /** Conditional Access TSDTable **/
+    TSD_PID_CAT                                   = 0x0001,
+    /** Transport Stream Description TSDTable **/
+    TSD_PID_TSDT                                  = 0x0002,
+    /** MPEG-2 Systems Reserved **/
+    TSD_PID_RESERVED_MPEG2                        = 0x000F,
+    /** SDT Service Information (of DVB) **/
+    TSD_PID_SDT                                   = 0x0011,
+    /** DVB Service Information **/
+    TSD_PID_RESERVED_DVB_SI                       = 0x001F,
+    /** PIDs from this PID can be assigned to Program Map Tables, Elementary Streams
+      * or other data tables **/
+    TSD_PID_DATA_TABLES_START                     = 0x0020,
+    /** ARIB Service Information **/
+    TSD_PID_RESERVED_ARIB_SI                      = 0x002F,
+    /** Set aside for non ATSC Use **/
+    TSD_PID_RESERVED_NON_ATSC                     = 0x004F,
+    /** Available for general purpose **/
+    TSD_PID_GENERAL_PURPOSE                       = 0x1FEF,
+    /** Reserved for possible future use by ATSC and/or SCTE **/
+    TSD_PID_RESERVED_FUTURE                       = 0x1FFA,
+    /** ATSC PSIP tables **/
+    TSD_PID_ATSC_PSIP_SI                          = 0x1FFB,
+    /** Used by now-obsolete ATSC A/55 and A/56 standards **/
+    TSD_PID_RESERVED_ATSC                         = 0x1FFD,
+    /** OpenCable Data-Over-Cable Service Interface **/
+    TSD_PID_DOCSIS                                = 0x1FFE,
+    /** Identifies Null Packets **/
+    TSD_PID_NULL_PACKETS                          = 0x1FFF,
+} TSDPIDValue;
+
+/**
+ * Adaptation Field Flags.
+ */
+typedef enum TSDAdaptationFieldFlags {
+    TSD_AF_DISCON_IND                             = 0x80,
+    TSD_AF_RANDOM_ACCESS_IND                      = 0x40,
+    TSD_AF_ELEM_STREAM_PRIORIY_IND                = 0x20,
+    TSD_AF_PCR_FLAG                               = 0x10,
+    TSD_AF_OPCR_FLAG                              = 0x08,
+    TSD_AF_SPLICING_POINT_FLAG                    = 0x04,
+    TSD_AF_TRAN_PRIVATE_DATA_FLAG                 = 0x02,
+    TSD_AF_ADAP_FIELD_EXT_FLAG                    = 0x01,
+} TSDAdaptationFieldFlags;
+
+/**
+ * Adaptation Field Extensions Flags.
+ */
+typedef enum TSDAdaptationFieldExtensionFlags {
+    TSD_AFEF_LTW_FLAG                             = 0x04,
+    TSD_AFEF_PIECEWISE_RATE_FLAG                  = 0x02,
+    TSD_AFEF_SEAMLESS_SPLCE_FLAG                  = 0x01,
+} TSDAdaptationFieldExtensionFlags;
+
+/**
+ * PES Stream Id.
+ */
+typedef enum TSDPESStreamId {
+    TSD_PSID_PROGRAM_STREAM_MAP                   = 0xBC,
+    TSD_PSID_PRIV_STREAM_1                        = 0xBD,
+    TSD_PSID_PADDING_STREAM                       = 0xBE,
+    TSD_PSID_PRIV_STREAM_2                        = 0xBF,
+    TSD_PSID_AUDIO                                = 0xC0,
+    TSD_PSID_AUDIO_MASK                           = 0xE0,
+    TSD_PSID_VIDEO                                = 0xE0,
+    TSD_PSID_VIDEO_MASK                           = 0xF0,
+    TSD_PSID_ECM                                  = 0xF0,
+    TSD_PSID_EMM                                  = 0xF1,
+    TSD_PSID_DSMCC                                = 0xF2,
+    TSD_PSID_13522                                = 0xF3,
+    TSD_PSID_H2221_TYPE_A                         = 0xF4,
+    TSD_PSID_H2221_TYPE_B                         = 0xF5,
+    TSD_PSID_H2221_TYPE_C                         = 0xF6,
+    TSD_PSID_H2221_TYPE_D                         = 0xF7,
+    TSD_PSID_H2221_TYPE_E                         = 0xF8,
+    TSD_PSID_ANCILLARY                            = 0xF9,
+    TSD_PSID_SL_PACKETIZED                        = 0xFA,
+    TSD_PSID_FLEX_MUX                             = 0xFB,
+    TSD_PSID_RESERVED                             = 0xFC,
+    TSD_PSID_STREAM_DIRECTORY                     = 0xFF,
+} TSDPESStreamId;
+
+/**
+ * PES Scrambling Control.
+ */
+typedef enum TSDPESScramblingControl {
+    TSD_PSCNOT_SCRAMBLED                         = 0x00,
+    TSD_PSCUSER_DEFINED_1                        = 0x01,
+    TSD_PSCUSER_DEFINED_2                        = 0x02,
+    TSD_PSCUSER_DEFINED_3                        = 0x03,
+} TSDPESScramblingControl;
+
+/**
+ * PES Packaet Flags.
+ */
+typedef enum TSDPESPacketFlags {
+    TSD_PPF_PES_PRIORITY                          = 0x0800,
+    TSD_PPF_DATA_ALIGNMENT_INDICATOR              = 0x0400,
+    TSD_PPF_COPYRIGHT                             = 0x0200,
+    TSD_PPF_ORIGINAL_OR_COPY                      = 0x0100,
+    TSD_PPF_PTS_FLAG                              = 0x0080,
+    TSD_PPF_DTS_FLAG                              = 0x0040,
+    TSD_PPF_ESCR_FLAG                             = 0x0020,
+    TSD_PPF_ES_RATE_FLAG                          = 0x0010,
+    TSD_PPF_DSM_TRICK_MODE_FLAG                   = 0x0008,
+    TSD_PPF_ADDITIONAL_COPY_INFO_FLAG             = 0x0004,
+    TSD_PPF_PES_CRC_FLAG                          = 0x0002,
+    TSD_PPF_PES_EXTENSION_FLAG                    = 0x0001,
+} TSDPESPacketFlags;
+
+/**
+ * Trick Mode Control.
+ */
+typedef enum TSDTrickModeControl {
+    TSD_TMC_FAST_FORWARD                          = 0x00,
+    TSD_TMC_SLOW_MOTION                           = 0x01,
+    TSD_TMC_FREEZE_FRAME                          = 0x02,
+    TSD_TMC_FAST_REVERSE                          = 0x03,
+    TSD_TMC_SLOW_REVERSE                          = 0x04,
+} TSDTrickModeControl;
+
+/**
+ * PES Extension Flags.
+ */
+typedef enum TSDPESExtensionFlags {
+    TSD_PEF_PES_PRIVATE_DATA_FLAG                 = 0x80,
+    TSD_PEF_PACK_HEADER_FIELD_FLAG                = 0x40,
+    TSD_PEF_PROGRAM_PACKET_SEQUENCE_COUNTER_FLAG  = 0x20,
+    TSD_PEF_PSTD_BUFFER_FLAG                      = 0x10,
+    TSD_PEF_PES_EXTENSION_FLAG_2                  = 0x01,
+} TSDPESExtensionFlags;
+
+/**
+ * System Header Flags.
+ */
+typedef enum TSDSystemHeaderFlags {
+    TSD_SHF_FIXED_FLAG                            = 0x02000000,
+    TSD_SHF_CSPS_FLAG                             = 0x01000000,
+    TSD_SHF_SYSTEM_AUDIO_LOCK_FLAG                = 0x00800000,
+    TSD_SHF_SYSTEM_VIDEO_LOCK_FLAG                = 0x00400000,
+    TSD_SHF_PACKET_RATE_RESTICTION_FLAG           = 0x00008000,
+} TSDSystemHeaderFlags;
+
+/**
+ * TSDTable Flags.
+ */
+typedef enum TSDTableFlags {
+    TSD_TBL_PRIVATE_INDICATOR                     = 0x01,
+    TSD_TBL_SECTION_SYNTAX_INDICATOR              = 0x02,
+    TSD_TBL_CURRENT_NEXT_INDICATOR                = 0x04,
+} TSDTableFlags;
+
+/**
+ * PMT Program Element Stream Type
+ */
+typedef enum TSDPMTStreamType {
+    TSD_PMT_STREAM_TYPE_VIDEO                        = 0x01,
+    TSD_PMT_STREAM_TYPE_VIDEO_H262                   = 0x02,
+    TSD_PMT_STREAM_TYPE_AUDIO_11172                  = 0x03,
+    TSD_PMT_STREAM_TYPE_AUDIO_13818_3                = 0x04,
+    TSD_PMT_STREAM_TYPE_PRV_SECTIONS                 = 0x05,
+    TSD_PMT_STREAM_TYPE_PES_PRV                      = 0x06,
+    TSD_PMT_STREAM_TYPE_MHEG                         = 0x07,
+    TSD_PMT_STREAM_TYPE_H222_0_DSM_CC                = 0x08,
+    TSD_PMT_STREAM_TYPE_H222_1                       = 0x09,
+    TSD_PMT_STREAM_TYPE_A                            = 0x0A,
+    TSD_PMT_STREAM_TYPE_B                            = 0x0B,
+    TSD_PMT_STREAM_TYPE_C                            = 0x0C,
+    TSD_PMT_STREAM_TYPE_D                            = 0x0D,
+    TSD_PMT_STREAM_TYPE_H222_0_AUX                   = 0x0E,
+    TSD_PMT_STREAM_TYPE_AUDIO_AAC                    = 0x0F,
+    TSD_PMT_STREAM_TYPE_VISUAL                       = 0x10,
+    TSD_PMT_STREAM_TYPE_AUDIO_LATM                   = 0x11,
+    TSD_PMT_STREAM_TYPE_SL_PES                       = 0x12,
+    TSD_PMT_STREAM_TYPE_SL_SECTIONS                  = 0x13,
+    TSD_PMT_STREAM_TYPE_SYNC_DOWNLOAD                = 0x14,
+    TSD_PMT_STREAM_TYPE_PES_METADATA                 = 0x15,
+    TSD_PMT_STREAM_TYPE_METDATA_SECTIONS             = 0x16,
+    TSD_PMT_STREAM_TYPE_METADATA_DATA_CAROUSEL       = 0x17,
+    TSD_PMT_STREAM_TYPE_METADATA_OBJ_CAROUSEL        = 0x18,
+    cTSD_PMT_STREAM_TYPE_METADATA_SYNC_DOWNLOAD      = 0x19,
+    TSD_PMT_STREAM_TYPE_IPMP                         = 0x1A,
+    TSD_PMT_STREAM_TYPE_VIDEO_AVC                    = 0X1B,
+    TSD_PMT_STREAM_TYPE_VIDEO_H222_0                 = 0x1C,
+    TSD_PMT_STREAM_TYPE_VIDEO_HEVC                   = 0x24,
+    TSD_PMT_STREAM_TYPE_DCII_VIDEO                   = 0x80,
+    TSD_PMT_STREAM_TYPE_AUDIO_A53                    = 0x81,
+    TSD_PMT_STREAM_TYPE_SCTE_STD_SUBTITLE            = 0x82,
+    TSD_PMT_STREAM_TYPE_SCTE_ISOCH_DATA              = 0x83,
+    TSD_PMT_STREAM_TYPE_ATSC_PROG_ID                 = 0x85,
+    TSD_PMT_STREAM_TYPE_SCTE_25                      = 0x86,
+    TSD_PMT_STREAM_TYPE_AUDIO_EAC3                   = 0x87,
+    TSD_PMT_STREAM_TYPE_AUDIO_DTS_HD                 = 0x88,
+    TSD_PMT_STREAM_TYPE_DVB_MPE_FEC                  = 0x90,
+    TSD_PMT_STREAM_TYPE_ULE                          = 0x91,
+    TSD_PMT_STREAM_TYPE_VEI                          = 0x92,
+    TSD_PMT_STREAM_TYPE_ATSC_DATA_SERVICE_TABLE      = 0x95,
+    TSD_PMT_STREAM_TYPE_SCTE_IP_DATA                 = 0xA0,
+    TSD_PMT_STREAM_TYPE_DCII_TEXT                    = 0xC0,
+    TSD_PMT_STREAM_TYPE_ATSC_SYNC_DATA               = 0xC2,
+    TSD_PMT_STREAM_TYPE_SCTE_AYSNC_DATA              = 0xC3,
+    TSD_PMT_STREAM_TYPE_ATSC_USER_PRIV_PROG_ELEMENTS = 0xC4,
+    TSD_PMT_STREAM_TYPE_VC1                          = 0xEA,
+    TSD_PMT_STREAM_TYPE_ATSC_USER_PRIV               = 0xEB,
+} TSDPMTStreamType;
+
+
+/**
+ * Registration Type.
+ * Flags identifying what type of data the user wants to register.
+ * @see tsd_register_pid
+ */
+typedef enum TSDRegType {
+    TSD_REG_PES                     = 0x01,
+    TSD_REG_ADAPTATION_FIELD        = 0x02,
+    TSD_REG_PCR                     = 0x04,
+    /// PES packets delivered as TSD_EVENT_PES_SLICES instead of TSD_EVENT_PES
+    TSD_REG_PES_SLICES              = 0x08,
+    /// PES packets streamed as TSD_EVENT_PES_START, TSD_EVENT_PES_DATA and
+    /// TSD_EVENT_PES_END as they arrive, nothing but the header is buffered
+    TSD_REG_PES_STREAM              = 0x10,
+    /// unbounded AVC and HEVC PES packets are delivered as soon as an access
+    /// unit is known to be complete, rather than at the next PES
+    TSD_REG_PES_AU_END              = 0x20,
+} TSDRegType;
+
+/**
+ * PES Stream State.
+ * Progress of the PES being streamed on a PID registered with
+ * TSD_REG_PES_STREAM.
+ */
+typedef enum TSDPESStreamState {
+    TSD_PES_STREAM_IDLE             = 0x00,
+    TSD_PES_STREAM_HEADER           = 0x01,
+    TSD_PES_STREAM_PAYLOAD          = 0x02,
+} TSDPESStreamState;
+
+/**
+ * PID Route Flags.
+ * The role(s) a PID plays during demux, as stored in the Context's PID map.
+ * @see TSDPIDRoute
+ */
+typedef enum TSDPIDRouteFlags {
+    TSD_ROUTE_PAT                   = 0x01,
+    TSD_ROUTE_CAT                   = 0x02,
+    TSD_ROUTE_TSDT                  = 0x04,
+    TSD_ROUTE_PMT                   = 0x08,
+    TSD_ROUTE_REGISTERED            = 0x10,
+    TSD_ROUTE_SECTIONS              = 0x20,
+} TSDPIDRouteFlags;
+
+/**
+ * Video Stream Descriptor Flags.
+ */
+typedef enum TSDDescriptorFlagsVideoStream {
+    TSD_DFVS_MULTI_FRAME_RATE       = 0x80,
+    TSD_DFVS_MPEG_1_ONLY            = 0x04,
+    TSD_DFVS_CONSTRAINED_PARAM      = 0x02,
+    TSD_DFVS_STILL_PIC              = 0x01,
+    TSD_DFVS_FRAME_RATE_EXT         = 0x20,
+} TSDDescriptorFlagsVideoStream;
+
+/**
+ * AUdio Stream Descriptor Flags.
+ */
+typedef enum TSDDescriptorFlagsAudioStream {
+    TSD_DFAS_FREE_FORMAT            = 0x80,
+    TSD_DFAS_ID                     = 0x40,
+    TSD_DFAS_VAR_RATE_AUDIO_IND     = 0x08,
+} TSDDescriptorFlagsAudioStream;
+
+/**
+ * Data Context.
+ * Used to persist the session when streaming TS packets through the demux in
+ * multiple calls.
+ */
+typedef struct TSDDataContext {
+    uint8_t *buffer;
+    uint8_t *write;
+    uint8_t *end;
+    size_t size;
+    uint32_t id;
+} TSDDataContext;
+
+/**
+ * Section Assembler.
+ * Collects the sections of one table, identified by the PID it is carried on
+ * and the table_id, table_id_extension and version_number in data.id. The
+ * first complete bytes of data hold the sections received so far, in the
+ * order they arrived, followed by the section being assembled. received has
+ * a bit set for each section_number held, the table is complete once every
+ * section up to last_section_number has arrived. skip counts the bytes left
+ * of a section already held, which are passed over without being copied.
+ * The assemblers in use on a PID are chained through pid_next, starting from
+ * the one in slot found in the PID map.
+ */
+typedef struct TSDSectionAssembler {
+    TSDDataContext data;
+    uint16_t pid;
+    uint16_t slot;
+    uint8_t last_section_number;
+    uint32_t received[8];
+    size_t complete;
+    size_t skip;
+    struct TSDSectionAssembler *next;
+    struct TSDSectionAssembler *prev;
+    struct TSDSectionAssembler *pid_next;
+} TSDSectionAssembler;
+
+/**
+ * Table Cache Entry.
+ * The version of a PSI table last delivered on a PID. crc folds together the
+ * CRC_32 of every section in the table.
+ */
+typedef struct TSDTableCacheEntry {
+    uint16_t pid;
+    uint8_t table_id;
+    uint16_t table_id_extension;
+    uint8_t version_number;
+    uint32_t crc;
+} TSDTableCacheEntry;
+
+/**
+ * Adaptation Field Extension.
+ */
+typedef struct TSDAdaptationFieldExtension {
+    uint8_t length;
+    int flags;
+    // ltw_flag == '1'
+    int ltw_valid_flag;
+    uint16_t ltw_offset;
+    // piecewise_rate_flag == '1'
+    uint32_t piecewise_rate;
+    // seamless_splice_flag == '1'
+    uint8_t splice_type;
+    uint64_t dts_next_au;
+} TSDAdaptationFieldExtension;
+
+/**
+ * Adaptation Field.
+ */
+typedef struct TSDAdaptationField {
+    uint8_t adaptation_field_length;
+    int flags;
+    // PCR == '1'
+    uint64_t program_clock_ref_base;
+    uint16_t program_clock_ref_ext;
+    // OPCR == '1'
+    uint64_t orig_program_clock_ref_base;
+    uint16_t orig_program_clock_ref_ext;
+    // splicing_point_fag == '1'
+    uint8_t splice_countdown;
+    // transport private data flag == '1'
+    uint8_t transport_private_data_length;
+    const uint8_t *private_data_bytes;
+    // adaptation_field_extension_flag == '1'
+    TSDAdaptationFieldExtension adap_field_ext;
+} TSDAdaptationField;
+
+/**
+ * Transport Stream Packet Header.
+ */
+typedef struct TSDPacket {
+    uint8_t sync_byte;
+    int flags;
+    uint16_t pid;
+    TSDScramblingControl transport_scrambling_control;
+    TSDAdaptionFieldControl adaptation_field_control;
+    uint8_t continuity_counter;
+    TSDAdaptationField adaptation_field;
+    const uint8_t *data_bytes;
+    size_t data_bytes_length;
+    uint32_t arrival_time_stamp;    /// 30 bit M2TS arrival_time_stamp, 0 otherwise
+} TSDPacket;
+
+/**
+ * Packet Headers.
+ * Parallel arrays filled in by tsd_parse_packet_headers_batch, entry i of each
+ * array belongs to the i'th packet. The arrays are owned by the caller and
+ * must each have room for capacity entries.
+ */
+typedef struct TSDPacketHeaders {
+    uint16_t *pid;
+    uint8_t *flags;                     /// TSDPacketFlags
+    uint8_t *continuity_counter;
+    uint8_t *adaptation_field_control;  /// TSDAdaptionFieldControl
+    uint8_t *payload_offset;            /// from the sync byte, TSD_TSPACKET_SIZE when there is no payload
+    uint64_t *pcr;                      /// 27MHz PCR or 0 without TSD_PF_PCR, may be NULL
+    size_t capacity;
+} TSDPacketHeaders;
+
+/**
+ * DSM Trick Mode.
+ */
+typedef struct TSDDSMTrickMode {
+    TSDTrickModeControl control;
+    uint8_t field_id;
+    uint8_t intra_slice_refresh;
+    uint8_t frequency_truncation;
+    uint8_t rep_cntrl;
+} TSDDSMTrickMode;
+
+/**
+ * System Header Stream.
+ */
+typedef struct TSDSystemHeaderStream {
+    uint8_t stream_id;
+    uint8_t pstd_buffer_bound_scale;
+    uint16_t pstd_buffer_size_bound;
+} TSDSystemHeaderStream;
+
+/**
+ * Program Stream System Header.
+ */
+typedef struct TSDSystemHeader {
+    uint32_t start_code;
+    uint16_t length;
+    uint32_t rate_bound;
+    uint8_t audio_bound;
+    int flags;
+    uint8_t video_bound;
+    size_t stream_count;
+    TSDSystemHeaderStream *streams;
+} TSDSystemHeader;
+
+/**
+ * Program Stream Pack Header.
+ */
+typedef struct TSDPackHeader {
+    uint8_t length;
+    uint32_t start_code;
+    uint64_t system_clock_ref_base;
+    uint16_t system_clock_ref_ext;
+    uint32_t program_mux_rate;
+    uint8_t stuffing_length;
+    TSDSystemHeader system_header;
+} TSDPackHeader;
+
+/**
+ * PES Extension.
+ */
+typedef struct TSDPESExtension {
+    int flags;
+    uint8_t pes_private_data[16]; // 128 bits
+    TSDPackHeader pack_header;
+    uint8_t program_packet_sequence_counter;
+    int mpeg1_mpeg2_identifier;
+    uint8_t original_stuff_length;
+    int pstd_buffer_scale;
+    uint16_t pstd_buffer_size;
+    uint8_t pes_extension_field_length;
+} TSDPESExtension;
+
+/**
+ * PES Packet.
+ */
+typedef struct TSDPESPacket {
+    uint32_t start_code;
+    uint8_t stream_id;
+    uint16_t packet_length;
+    TSDPESScramblingControl scrambling_control;
+    int flags;
+    uint8_t header_data_length;
+    uint64_t pts;
+    uint64_t dts;
+    uint64_t escr;
+    uint16_t escr_extension;
+    uint32_t es_rate;
+    TSDDSMTrickMode trick_mode;
+    uint8_t additional_copy_info;
+    uint16_t previous_pes_packet_crc;
+    TSDPESExtension extension;
+    const uint8_t *data_bytes;
+    size_t data_bytes_length;
+} TSDPESPacket;
+
+// re-typing the PESPacket for user callback consistency.
+typedef TSDPESPacket TSDPESData;
+
+/**
+ * Slice.
+ * A contiguous run of PES payload, laid out like struct iovec so an array of
+ * slices can be handed to writev as is.
+ */
+typedef struct TSDSlice {
+    const uint8_t *data;
+    size_t length;
+} TSDSlice;
+
+/**
+ * PES Slices.
+ * Data of TSD_EVENT_PES_SLICES. The payload of the PES packet is not copied,
+ * the slices point into the data passed to tsd_demux and are only valid
+ * until the callback returns. Only the part of a PES packet received in
+ * earlier calls to tsd_demux is copied, the first slice then points into the
+ * PID's Data Context.
+ */
+typedef struct TSDPESSlices {
+    /// the parsed PES header, data_bytes is NULL and data_bytes_length is
+    /// the size of the payload held by the slices
+    TSDPESPacket pes;
+    const TSDSlice *slices;
+    size_t slices_length;
+} TSDPESSlices;
+
+/**
+ * PES Chunk.
+ * Data of TSD_EVENT_PES_DATA, a piece of the payload of the PES being
+ * streamed, valid until the callback returns. TSD_EVENT_PES_END passes a
+ * chunk without data whose offset is the size of the whole payload.
+ */
+typedef struct TSDPESChunk {
+    const uint8_t *data;
+    size_t length;
+    size_t offset;      /// offset of data into the PES payload
+} TSDPESChunk;
+
+/**
+ * TSDTable Section.
+ * Represents any short or long form table section, both PSI and private.
+ */
+typedef struct TSDTableSection {
+    uint8_t table_id;
+    int flags;
+    uint16_t section_length;
+    uint16_t table_id_extension;
+    uint8_t version_number;
+    uint8_t section_number;
+    uint8_t last_section_number;
+    uint32_t crc_32;
+    uint8_t *section_data;
+    size_t section_data_length;
+} TSDTableSection;
+
+/**
+ * TSDTable.
+ * Represents a table which is made up of multiple sections.
+ */
+typedef struct TSDTable {
+    TSDTableSection *sections;
+    size_t length;
+} TSDTable;
+
+/**
+ * PAT Data.
+ * PAT Data extracted from PAT TSDTable Sections.
+ */
+typedef struct TSDPATData {
+    uint16_t *program_number;
+    uint16_t *pid;
+    size_t length;
+} TSDPATData;
+
+/**
+ * PMT TSDDescriptor.
+ * Outter or Inner TSDDescriptor found within the PMT.
+ */
+typedef struct TSDDescriptor {
+    uint8_t tag;
+    uint8_t length;
+    const uint8_t *data;
+    size_t data_length;
+} TSDDescriptor;
+
+/**
+ * NAL Unit.
+ * A NAL unit found by a TSDNALSplitter. Offsets count the bytes passed to the
+ * splitter since it was initialised.
+ * @see tsd_nal_splitter_next
+ */
+typedef struct TSDNALUnit {
+    uint8_t type;                       /// nal_unit_type
+    size_t offset;                      /// offset of the NAL unit header
+    size_t length;                      /// length from the header on, without trailing zero bytes
+    size_t emulation_prevention_bytes;  /// emulation_prevention_three_bytes in the NAL unit
+} TSDNALUnit;
+
+/**
+ * NAL Splitter.
+ * Splits an Annex B byte stream of AVC or HEVC into NAL units. The stream may
+ * be passed in pieces of any size, such as the TSD_EVENT_PES_DATA chunks of a
+ * PID registered with TSD_REG_PES_STREAM, start codes split between two
+ * pieces are found as well.
+ * @see tsd_nal_splitter_init
+ */
+typedef struct TSDNALSplitter {
+    uint8_t stream_type;
+    const uint8_t *data;    /// the data being split
+    const uint8_t *ptr;     /// where the search carries on in data
+    size_t size;
+    size_t position;        /// offset of data into the stream
+    size_t zeros;           /// zero bytes the stream ended with before data
+    int boundary;           /// the start of data wasn't checked against the end of the previous data yet
+    int active;             /// a NAL unit is being received
+    int pending;            /// its header hasn't been received yet
+    TSDNALUnit unit;
+} TSDNALSplitter;
+
+/**
+ * Descriptor Iterator.
+ * Walks a descriptor loop in place, on the stack and without allocating.
+ * @see tsd_descriptor_iter_init
+ */
+typedef struct TSDDescriptorIter {
+    const uint8_t *ptr;
+    const uint8_t *end;
+} TSDDescriptorIter;
+
+/**
+ * Program Element.
+ * Description of a Program from the PMT.
+ */
+typedef struct TSDProgramElement {
+    uint8_t stream_type;
+    uint16_t elementary_pid;
+    uint16_t es_info_length;
+    TSDDescriptor *descriptors;
+    size_t descriptors_length;
+} TSDProgramElement;
+
+/**
+ * PMT Data.
+ * PMT Data extracted from PMT TSDTable Sections.
+ */
+typedef struct TSDPMTData {
+    uint16_t pcr_pid;
+    uint16_t program_info_length;
+    TSDDescriptor *descriptors;
+    size_t descriptors_length;
+    TSDProgramElement *program_elements;
+    size_t program_elements_length;
+    uint32_t crc_32;
+} TSDPMTData;
+
+/**
+ * Descritor Data.
+ * TSDDescriptor Data extracted from TSDTable Sections.
+ */
+typedef struct TSDDescriptorData {
+    TSDDescriptor *descriptors;
+    size_t descriptors_length;
+} TSDDescriptorData;
+
+/**
+ * Program.
+ * A program of the latest PAT, along with its latest PMT once one has been
+ * received. Kept by the context in its program directory.
+ */
+typedef struct TSDProgram {
+    uint16_t program_number;
+    uint16_t pmt_pid;
+    int has_pmt;            /// set once pmt holds the PMT of the program
+    TSDPMTData pmt;         /// descriptors point into data
+    uint8_t *data;          /// copy of the PMT table data
+    size_t data_length;
+} TSDProgram;
+
+/**
+ * Program Stream Reference.
+ * Entry of the program directory index of elementary streams, by PID.
+ */
+typedef struct TSDProgramStreamRef {
+    uint16_t pid;
+    uint16_t program;       /// index into the directory programs
+    uint16_t element;       /// index into the program elements of the PMT
+} TSDProgramStreamRef;
+
+typedef TSDDescriptorData TSDCATData;
+typedef TSDDescriptorData TSDTSDTData;
+
+/**
+ * TSDTable Data.
+ * Raw TSDTable Data extracted from a TSDTable which we don't support the parsing of.
+ */
+typedef struct TSDTableData {
+    TSDTable *table;   /// TSDTable section information
+    uint8_t *data;  /// Contiguous block of the table section data
+    size_t size;    /// The number of bytes in data
+} TSDTableData;
+
+/**
+ * Section Filter.
+ * Selects the sections on pid whose table_id equals table_id in every bit
+ * set in mask. When extension_mask isn't 0 the table_id_extension of long
+ * form sections must also equal table_id_extension in every bit set in it,
+ * short form sections never match.
+ * @see tsd_register_section_filter
+ * @see tsd_register_section_filter_ext
+ */
+typedef struct TSDSectionFilter {
+    uint16_t pid;
+    uint8_t table_id;
+    uint8_t mask;
+    uint16_t table_id_extension;
+    uint16_t extension_mask;
+} TSDSectionFilter;
+
+/**
+ * TS Demux Registration.
+ * Lists what data of data the user wants to listen out for.
+ */
+typedef struct TSDemuxRegistration {
+    uint16_t pid;
+    int data_types;
+    /// running max of the recent PES packet sizes, used to size the buffer
+    /// of unbounded PES packets before they arrive
+    size_t size_hint;
+    /// payload slices of the PES being received when registered with
+    /// TSD_REG_PES_SLICES. The first entry is kept for the copied prefix.
+    TSDSlice *slices;
+    size_t slices_length;
+    size_t slices_capacity;
+    size_t slices_bytes;
+    /// progress of the PES being streamed when registered with
+    /// TSD_REG_PES_STREAM, stream_length is 0 for unbounded PES packets
+    TSDPESStreamState stream_state;
+    size_t stream_offset;
+    size_t stream_length;
+    /// access unit tracking when registered with TSD_REG_PES_AU_END. The
+    /// stream_type comes from the PMT, au_scanned is the offset into the
+    /// buffer up to which start codes were searched.
+    uint8_t au_stream_type;
+    size_t au_scanned;
+    int au_vcl;             /// a VCL NAL unit of the current access unit was seen
+    int au_continued;       /// the buffer holds what followed a delivered access unit
+} TSDemuxRegistration;
+
+/**
+ * Sync Event.
+ * Data passed along with TSD_EVENT_SYNC_LOSS and TSD_EVENT_SYNC_ACQUIRED.
+ */
+typedef struct TSDSyncEvent {
+    size_t offset;          /// offset into the data passed to tsd_demux
+    size_t bytes_skipped;   /// bytes discarded before sync was acquired
+} TSDSyncEvent;
+
+/**
+ * PID Route.
+ * Entry in the PID map, describing how packets on a PID are dispatched.
+ * PIDs with no flags set are ignored.
+ */
+typedef struct TSDPIDRoute {
+    uint8_t flags;      /// TSDPIDRouteFlags
+    uint16_t index;     /// index into registered_pids when TSD_ROUTE_REGISTERED
+    uint16_t assembler; /// 1 + slot of the newest section assembler, 0 if none
+} TSDPIDRoute;
+
+/**
+ * TS Demux Context.
+ * The TSDEmuxContext is used to separate multiple demux tasks.
+ */
+typedef struct TSDemuxContext {
+    tsd_malloc malloc;
+    tsd_realloc realloc;
+    tsd_calloc calloc;
+    tsd_free free;
+
+    /**
+     * Allocator.
+     * When set with tsd_set_allocator every allocation made for the context
+     * goes through it, instead of the functions above.
+     */
+    TSDAllocator allocator;
+
+    /**
+     * Registerd PIDs.
+     * The PIDs registered for demuxing. Both arrays grow geometrically from
+     * TSD_PID_REGS_INITIAL_CAPACITY and are never shrunk, so PIDs can be
+     * added and removed repeatedly without further allocations.
+     */
+    TSDemuxRegistration *registered_pids;
+    TSDDataContext **registered_pids_data;
+    size_t registered_pids_length;
+    size_t registered_pids_capacity;
+
+    /**
+     * PID Map.
+     * TSD_PID_MAP_SIZE routing entries indexed by PID, kept up to date as the
+     * PAT changes and PIDs are (de)registered. Allocated on first use.
+     */
+    TSDPIDRoute *pid_map;
+
+    /**
+     * Sync State.
+     * Sync is only acquired when a sync byte is followed by confirm_packets
+     * more sync bytes at packet size intervals. Data still waiting to be
+     * confirmed is kept in the carry buffer across calls to tsd_demux, only
+     * tsd_demux_end accepts it on fewer. Defaults to TSD_SYNC_CONFIRM_PACKETS,
+     * at most as many as fit in TSD_PACKET_SIZE_DETECT_BYTES are used.
+     */
+    struct {
+        int locked;
+        size_t confirm_packets;
+        size_t bytes_skipped;
+        size_t packet_size;     /// detected packet size, 0 until detected
+    } sync;
+
+    /**
+     * Packet Size.
+     * TSD_TSPACKET_SIZE, TSD_M2TS_PACKET_SIZE or TSD_RS_PACKET_SIZE, or 0 to
+     * detect it from the start of the stream. Data is collected across calls
+     * to tsd_demux until a run of sync bytes long enough to confirm sync shows
+     * the packet size, or TSD_PACKET_SIZE_DETECT_BYTES have been collected.
+     * @see tsd_set_packet_size
+     */
+    size_t packet_size;
+
+    /**
+     * Carry.
+     * The end of the data passed to tsd_demux that didn't make a whole packet,
+     * completed with the start of the data in the next call. Holds the start
+     * of the stream while its packet size is being detected.
+     */
+    struct {
+        uint8_t data[TSD_PACKET_SIZE_DETECT_BYTES];
+        size_t length;
+    } carry;
+
+    /**
+     * Arrival Time Stamp.
+     * The M2TS arrival_time_stamp of the packet being demuxed, valid during
+     * event callbacks. Always 0 for other packet sizes.
+     */
+    uint32_t arrival_time_stamp;
+
+    /**
+     * On Event Callback.
+     * User specified event Callback.
+     */
+    tsd_on_event event_cb;
+
+    /**
+     * PAT Data.
+     */
+    struct {
+        TSDPATData value;
+        int valid;
+    } pat;
+
+    /**
+     * Program Directory.
+     * The programs of the latest PAT sorted by program number, each with its
+     * latest PMT, kept until a PAT drops the program. PMTs of programs the
+     * PAT doesn't list are dropped. streams indexes the elementary streams
+     * of every PMT, sorted by PID. generation goes up every time the PAT or
+     * a PMT changes, consumers can compare it with the value they last saw
+     * instead of comparing tables.
+     * @see tsd_get_program
+     */
+    struct {
+        TSDProgram *programs;
+        size_t length;
+        size_t capacity;
+        TSDProgramStreamRef *streams;
+        size_t streams_length;
+        size_t streams_capacity;
+        uint32_t generation;
+    } directory;
+
+    /**
+     * Data Context Buffers.
+     * Pool of section assemblers kept across tsd_demux calls. Each table
+     * being assembled has its own assembler on the used list, most recent
+     * first, so tables on different PIDs, or different tables on the same
+     * PID, can be interleaved. Assemblers return to the free list once their
+     * table is complete.
+     * length counts every buffer in the pool, at most max_length are kept.
+     * slots holds every buffer at the index it was given when created, the
+     * PID map refers to them by it.
+     * pool_allocations counts the heap allocations made by this pool alone,
+     * it stays flat once the tables being assembled reach a steady state.
+     * Allocations made elsewhere, such as for the parsed tables passed to
+     * the event callback, aren't counted. Set an allocator to count those.
+     * @see tsd_set_section_buffer_limit
+     * @see tsd_set_allocator
+     */
+    struct {
+        TSDSectionAssembler *used;
+        TSDSectionAssembler *free;
+        TSDSectionAssembler **slots;
+        size_t slots_capacity;
+        size_t length;
+        size_t max_length;
+        size_t pool_allocations;
+    } buffers;
+
+    /**
+     * Table Cache.
+     * PAT and PMT tables already delivered. A repeat of a table with the same
+     * version and CRCs is dropped before it is parsed and raises no event.
+     * @see tsd_set_table_cache
+     */
+    struct {
+        TSDTableCacheEntry *entries;
+        size_t length;
+        size_t capacity;
+        int enabled;
+    } table_cache;
+
+    /**
+     * Section Filters.
+     * The tables the user wants from PIDs other than the PAT, CAT, TSDT and
+     * PMTs, delivered with TSD_EVENT_TABLE. Every PID with a filter is routed
+     * with TSD_ROUTE_SECTIONS.
+     * @see tsd_register_section_filter
+     */
+    struct {
+        TSDSectionFilter *filters;
+        size_t length;
+        size_t capacity;
+    } section_filters;
+
+    /**
+     * Statistics.
+     * crc_errors counts the sections dropped because they failed their
+     * CRC_32 check. table_errors counts the packets of PSI that couldn't be
+     * parsed and were skipped by tsd_demux, last_table_error is the TSDCode
+     * of the latest one. section_evictions counts the partial tables dropped
+     * because every section buffer was in use.
+     */
+    struct {
+        size_t crc_errors;
+        size_t table_errors;
+        TSDCode last_table_error;
+        size_t section_evictions;
+    } stats;
+
+} TSDemuxContext;
+
+/**
+ * Video Stream Descriptor.
+ */
+typedef struct TSDDescriptorVideoStream {
+    uint8_t tag;
+    uint8_t length;
+    int flags;
+    uint8_t frame_rate_code;
+    // if MPEG_1_only_flag == '0'
+    uint8_t profile_and_level_indication;
+    uint8_t chroma_format;
+} TSDDescriptorVideoStream;
+
+/**
+ * Audio Stream Descriptor.
+ */
+typedef struct TSDDescriptorAudioStream {
+    uint8_t tag;
+    uint8_t length;
+    int flags;
+    uint8_t layer;
+} TSDDescriptorAudioStream;
+
+/**
+ * Hierarchy Descriptor.
+ */
+typedef struct TSDDescriptorHierarchy {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t type;
+    uint8_t layer_index;
+    uint8_t embedded_layer_index;
+    uint8_t channel;
+} TSDDescriptorHierarchy;
+
+/**
+ * Registration Descriptor.
+ */
+typedef struct TSDDescriptorRegistration {
+    uint8_t tag;
+    uint8_t length;
+    uint32_t format_identifier;
+    const uint8_t *additional_id_info;
+    size_t additional_id_info_length;
+} TSDDescriptorRegistration;
+
+/**
+ * Data Stream Descriptor.
+ */
+typedef struct TSDDescriptorDataStreamAlignment {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t type;
+} TSDDescriptorDataStreamAlignment;
+
+/**
+ * Target Background Grid Descriptor.
+ */
+typedef struct TSDDescriptorTargetBackgroundGrid {
+    uint8_t tag;
+    uint8_t length;
+    uint16_t horizontal_size;
+    uint16_t vertical_size;
+    uint8_t aspect_ratio_info;
+} TSDDescriptorTargetBackgroundGrid;
+
+/**
+ * Video Window Descriptor.
+ */
+typedef struct TSDDescriptorVideoWindow {
+    uint8_t tag;
+    uint8_t length;
+    uint16_t horizontal_offset;
+    uint16_t vertical_offset;
+    uint8_t window_priority;
+} TSDDescriptorVideoWindow;
+
+/**
+ * Conditional Access Descriptor.
+ */
+typedef struct TSDDescriptorConditionalAccess {
+    uint8_t tag;
+    uint8_t length;
+    uint16_t ca_system_id;
+    uint16_t ca_pid;
+    const uint8_t *private_data_bytes;
+    size_t private_data_bytes_length;
+} TSDDescriptorConditionalAccess;
+
+/**
+ * ISO 639 Language Descriptor.
+ */
+typedef struct TSDDescriptorISO639Language {
+    uint8_t tag;
+    uint8_t length;
+    // a single packet could hold up to 45 max,.
+    uint32_t iso_language_code[45];
+    uint8_t audio_type[45];
+    size_t language_length;
+} TSDDescriptorISO639Language;
+
+/**
+ *  System Clock Descriptor.
+ */
+typedef struct TSDDescriptorSystemClock {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t external_clock_reference_indicator;
+    uint8_t clock_accuracy_integer;
+    uint8_t clock_accuracy_exponent;
+} TSDDescriptorSystemClock;
+
+/**
+ *  Multiplex Buffer Utilization Descriptor.
+ */
+typedef struct TSDDescriptorMultiplexBufferUtilization {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t bound_valid_flag;
+    uint16_t ltw_offset_lower_bound;
+    uint16_t ltw_offset_upper_bound;
+} TSDDescriptorMultiplexBufferUtilization;
+
+/**
+ * Copyright Descriptor.
+ */
+typedef struct TSDDescriptorCopyright {
+    uint8_t tag;
+    uint8_t length;
+    uint32_t identifier;
+    const uint8_t *additional_copy_info;
+    size_t additional_copy_info_length;
+} TSDDescriptorCopyright;
+
+/**
+ * Maximum Bit-rate Descriptor.
+ */
+typedef struct TSDDescriptorMaxBitrate {
+    uint8_t tag;
+    uint8_t length;
+    uint32_t max_bitrate;
+} TSDDescriptorMaxBitrate;
+
+/**
+ * Private Data Indicator Descriptor.
+ */
+typedef struct TSDDescriptorPrivDataInd {
+    uint8_t tag;
+    uint8_t length;
+    uint32_t private_data_indicator;
+} TSDDescriptorPrivDataInd;
+
+/**
+ * Smoothing Buffer Descriptor.
+ */
+typedef struct TSDDescriptorSmoothingBuffer {
+    uint8_t tag;
+    uint8_t length;
+    uint32_t sb_leak_rate;
+    uint32_t sb_size;
+} TSDDescriptorSmoothingBuffer;
+
+/**
+ * System Target Decoder (STD) Descriptor.
+ */
+typedef struct TSDDescriptorSysTargetDecoder {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t leak_valid_flag;
+} TSDDescriptorSysTargetDecoder;
+
+/**
+ * IBP Descriptor.
+ */
+typedef struct TSDDescriptorIBP {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t closed_gop_flag;
+    uint8_t identical_gop_flag;
+    uint16_t max_gop_length;
+} TSDDescriptorIBP;
+
+/**
+ * MPEG-4 Video Descriptor.
+ */
+typedef struct TSDDescriptorMPEG4Video {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t visual_profile_and_level;
+} TSDDescriptorMPEG4Video;
+
+/**
+ * MPEG-4 Audio Descriptor.
+ */
+typedef struct TSDDescriptorMPEG4Audio {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t audio_profile_and_level;
+} TSDDescriptorMPEG4Audio;
+
+/**
+ * IOD Descriptor.
+ */
+typedef struct TSDDescriptorIOD {
+    uint8_t tag;
+    uint8_t length;
+    uint8_t scope_of_iod_label;
+    uint8_t iod_label;
+    const uint8_t *initial_object_descriptor;
+    size_t initial_object_descriptor_length;
+} TSDDescriptorIOD;
+
+/**
+ * SL Descriptor.
+ */
+typedef struct TSDDescriptorSL {
+    uint8_t tag;
+    uint8_t length;
+    uint16_t es_id;
+} TSDDescriptorSL;
+
+/**
+ * FMC Descriptor.
+ */
+typedef struct TSDDescriptorFMC {
+    uint8_t tag;
+    uint8_t length;
+    uint16_t es_id[32];
+    uint8_t flex_mux_channel[32];
+    size_t fmc_length;
+} TSDDescriptorFMC;
+
+/**
+ * External ES ID Descriptor.
+ */
+typedef struct TSDDescriptorExternalESID {
+    uint8_t tag;
+    uint8_t length;
+    uint16_t es_id;
+} TSDDescriptorExternalESID;
+
+/**
+ * MuxCode Descriptor.
+ */
+typedef struct TSDDescriptorMuxCode {
+    uint8_t tag;
+    uint8_t length;
+    const uint8_t *mux_code_table_entries;
+    size_t mux_code_table_entries_length;
+} TSDDescriptorMuxCode;
+
+/**
+ * FMX Buffer Size Descriptor.
+ */
+typedef struct TSDDescriptorFMXBufferSize {
+    uint8_t tag;
+    uint8_t length;
+    const uint8_t *default_flex_mux_buffer_descriptor;
+    size_t default_flex_mux_buffer_descriptor_length;
+    const uint8_t *flex_mux_buffer_descriptors;
+    size_t flex_mux_buffer_descriptors_length;
+} TSDDescriptorFMXBufferSize;
+
+/**
+ * Multiplex Buffer Descriptor.
+ */
+typedef struct TSDDescriptorMultiplexBuffer {
+    uint8_t tag;
+    uint8_t length;
+    uint32_t mb_buffer_size;
+    uint32_t tb_leak_rate;
+} TSDDescriptorMultiplexBuffer;
+
+/**
+ * Descriptor List.
+ * Every descriptor tsd_decode_descriptor knows about, as
+ * X(id, tag, name, type). name is both the member of TSDDecodedDescriptor
+ * and the suffix of the tsd_parse_descriptor_ function decoding it, so a new
+ * descriptor only needs its struct, its parse function and a line here.
+ */
+#define TSD_DESCRIPTOR_LIST(X) \
+    X(TSD_DESCRIPTOR_VIDEO_STREAM,                  0x02, video_stream,                  TSDDescriptorVideoStream) \
+    X(TSD_DESCRIPTOR_AUDIO_STREAM,                  0x03, audio_stream,                  TSDDescriptorAudioStream) \
+    X(TSD_DESCRIPTOR_HIERARCHY,                     0x04, hierarchy,                     TSDDescriptorHierarchy) \
+    X(TSD_DESCRIPTOR_REGISTRATION,                  0x05, registration,                  TSDDescriptorRegistration) \
+    X(TSD_DESCRIPTOR_DATA_STREAM_ALIGNMENT,         0x06, data_stream_alignment,         TSDDescriptorDataStreamAlignment) \
+    X(TSD_DESCRIPTOR_TARGET_BACKGROUND_GRID,        0x07, target_background_grid,        TSDDescriptorTargetBackgroundGrid) \
+    X(TSD_DESCRIPTOR_VIDEO_WINDOW,                  0x08, video_window,                  TSDDescriptorVideoWindow) \
+    X(TSD_DESCRIPTOR_CONDITIONAL_ACCESS,            0x09, conditional_access,            TSDDescriptorConditionalAccess) \
+    X(TSD_DESCRIPTOR_ISO639_LANGUAGE,               0x0A, iso639_language,               TSDDescriptorISO639Language) \
+    X(TSD_DESCRIPTOR_SYSTEM_CLOCK,                  0x0B, system_clock,                  TSDDescriptorSystemClock) \
+    X(TSD_DESCRIPTOR_MULTIPLEX_BUFFER_UTILIZATION,  0x0C, multiplex_buffer_utilization,  TSDDescriptorMultiplexBufferUtilization) \
+    X(TSD_DESCRIPTOR_COPYRIGHT,                     0x0D, copyright,                     TSDDescriptorCopyright) \
+    X(TSD_DESCRIPTOR_MAX_BITRATE,                   0x0E, max_bitrate,                   TSDDescriptorMaxBitrate) \
+    X(TSD_DESCRIPTOR_PRIV_DATA_IND,                 0x0F, priv_data_ind,                 TSDDescriptorPrivDataInd) \
+    X(TSD_DESCRIPTOR_SMOOTHING_BUFFER,              0x10, smoothing_buffer,              TSDDescriptorSmoothingBuffer) \
+    X(TSD_DESCRIPTOR_SYS_TARGET_DECODER,            0x11, sys_target_decoder,            TSDDescriptorSysTargetDecoder) \
+    X(TSD_DESCRIPTOR_IBP,                           0x12, ibp,                           TSDDescriptorIBP) \
+    X(TSD_DESCRIPTOR_MPEG4_VIDEO,                   0x1B, mpeg4_video,                   TSDDescriptorMPEG4Video) \
+    X(TSD_DESCRIPTOR_MPEG4_AUDIO,                   0x1C, mpeg4_audio,                   TSDDescriptorMPEG4Audio) \
+    X(TSD_DESCRIPTOR_IOD,                           0x1D, iod,                           TSDDescriptorIOD) \
+    X(TSD_DESCRIPTOR_SL,                            0x1E, sl,                            TSDDescriptorSL) \
+    X(TSD_DESCRIPTOR_FMC,                           0x1F, fmc,                           TSDDescriptorFMC) \
+    X(TSD_DESCRIPTOR_EXTERNAL_ES_ID,                0x20, external_es_id,                TSDDescriptorExternalESID) \
+    X(TSD_DESCRIPTOR_MUX_CODE,                      0x21, mux_code,                      TSDDescriptorMuxCode) \
+    X(TSD_DESCRIPTOR_FMX_BUFFER_SIZE,               0x22, fmx_buffer_size,               TSDDescriptorFMXBufferSize) \
+    X(TSD_DESCRIPTOR_MULTIPLEX_BUFFER,              0x23, multiplex_buffer,              TSDDescriptorMultiplexBuffer)
+
+/**
+ * Descriptor Tags.
+ */
+typedef enum TSDDescriptorTag {
+#define TSD_DESCRIPTOR_TAG(id, tag, name, type) id = tag,
+    TSD_DESCRIPTOR_LIST(TSD_DESCRIPTOR_TAG)
+#undef TSD_DESCRIPTOR_TAG
+} TSDDescriptorTag;
+
+/**
+ * Decoded Descriptor.
+ * Holds any descriptor decoded by tsd_decode_descriptor. Every member starts
+ * with the tag and length, which can always be read through header.
+ */
+typedef union TSDDecodedDescriptor {
+    struct {
+        uint8_t tag;
+        uint8_t length;
+    } header;
+#define TSD_DESCRIPTOR_MEMBER(id, tag, name, type) type name;
+    TSD_DESCRIPTOR_LIST(TSD_DESCRIPTOR_MEMBER)
+#undef TSD_DESCRIPTOR_MEMBER
+} TSDDecodedDescriptor;
+
+/**
+ * Get software version.
+ * Gets the verison of the softare as a string.
+ * The format of the version is MAJOR.MINOR.PATCH where each of the
+ * sections are an integer.
+ * @return The version of the software as a string.
+ */
+const char* tsd_get_version(void);
+
+/**
+ * Initializes a Demux Context.
+ * Sets default options and initializes a TSDemuxContext.
+ * TSDemuxContext must be a valid pointer to a TSDemuxContext object.
+ * @param ctx The TSDemuxContext to initialize.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_context_init(TSDemuxContext *ctx);
+
+/**
+ * Destroys a previously initialized Demux Context.
+ * @param ctx THe TSDemuxContext to destroy.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_context_destroy(TSDemuxContext *ctx);
+
+/**
+ * Set Demux Context's Event Callback.
+ * Sets the callback for all events that occur during demuxing.
+ * Setting callback to NULL will remove an existing callback.
+ * The callback may be set during the demux process.
+ * @param ctx The Context to set the callback for.
+ * @param callback The callback function that will be called when an
+ *                 event occurs during the demux process. Set this to
+ *                 NULL to remove the current callback.
+ * @return Returns TSD_OK on success.
+ */
+TSDCode tsd_set_event_callback(TSDemuxContext *ctx, tsd_on_event callback);
+
+/**
+ * Set the Packet Size.
+ * Packets may be plain 188 byte packets, 192 byte M2TS packets that start with
+ * a 4 byte arrival time stamp, or 204 byte packets that end with 16 bytes of
+ * Reed-Solomon parity. By default the packet size is detected, which holds
+ * back the first few packets of the stream until it is certain. Set it when
+ * it is known up front and the stream is fed a packet at a time.
+ * @param ctx The context being used to demux.
+ * @param packet_size TSD_TSPACKET_SIZE, TSD_M2TS_PACKET_SIZE,
+ *                    TSD_RS_PACKET_SIZE or 0 to detect the packet size.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT for any other size.
+ */
+TSDCode tsd_set_packet_size(TSDemuxContext *ctx, size_t packet_size);
+
+/**
+ * Set the Allocator.
+ * Makes every allocation of the context go through allocator, which is
+ * copied. Set the allocator straight after tsd_context_init, memory already
+ * allocated is released through the allocator that made it only if it is
+ * still set. Passing NULL goes back to the malloc, realloc, calloc and free
+ * members of the context.
+ * @param ctx The context being used to demux.
+ * @param allocator The allocator to use or NULL.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if one of the functions of
+ *         allocator is NULL.
+ */
+TSDCode tsd_set_allocator(TSDemuxContext *ctx, const TSDAllocator *allocator);
+
+/**
+ * Initialize an Arena.
+ * The arena hands out memory from buffer, aligned to TSD_ARENA_ALIGNMENT. It
+ * never allocates, once buffer is used up allocations fail until the arena
+ * is reset.
+ * @param arena The arena to initialize.
+ * @param buffer The region to allocate from, owned by the caller.
+ * @param size The number of bytes in buffer.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_arena_init(TSDArena *arena, void *buffer, size_t size);
+
+/**
+ * Reset an Arena.
+ * Makes the whole region available again, for example between streams.
+ * Nothing allocated from the arena may be used afterwards, destroy the
+ * contexts using it first.
+ * @param arena The arena to reset.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_arena_reset(TSDArena *arena);
+
+/**
+ * Arena Allocator.
+ * Fills allocator with functions allocating from arena, to be passed to
+ * tsd_set_allocator. The arena isn't thread safe, give each thread its own.
+ * @param arena The arena to allocate from.
+ * @param allocator The allocator to fill in.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_arena_allocator(TSDArena *arena, TSDAllocator *allocator);
+
+/**
+ * Set the Section Buffer Limit.
+ * Sets how many section assembly buffers the context keeps for reuse, by
+ * default TSD_SECTION_BUFFERS_MAX. When every buffer is in use the oldest
+ * partial table is dropped to make room for a new one, and counted in the
+ * context's stats.section_evictions. Raise the limit when that happens on
+ * streams carrying many tables at once.
+ * @param ctx The context being used to demux.
+ * @param max_length The maximum number of buffers, from 1 to 65535.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if max_length is out of
+ *         range.
+ */
+TSDCode tsd_set_section_buffer_limit(TSDemuxContext *ctx, size_t max_length);
+
+/**
+ * Enable or Disable the Table Cache.
+ * With the cache enabled, which is the default, TSD_EVENT_PAT and
+ * TSD_EVENT_PMT are only raised when a table changes. Repeats with the same
+ * version_number and CRC_32 are dropped without being parsed. Disable the
+ * cache to be notified of every repetition.
+ * @param ctx The context being used to demux.
+ * @param enabled 1 to enable the cache, 0 to disable it.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_set_table_cache(TSDemuxContext *ctx, int enabled);
+
+/**
+ * Demux a Transport Stream.
+ * Data may be passed in chunks of any size, it doesn't need to start or end
+ * on a packet boundary. A partial packet at the end of data is carried over
+ * internally and completed by the next call. Until packet sync is acquired,
+ * data is searched for a run of sync bytes at packet intervals. Packets of
+ * PSI that can't be parsed are skipped and counted in the context's stats.
+ * PES packets on PIDs registered with TSD_REG_PES_SLICES are delivered as
+ * slices pointing into data, which must not change until tsd_demux returns.
+ * @param ctx The contenxt being used to demux,
+ * @param data The data to demux.
+ * @param size The size of data.
+ * @param parsedSize The total number of bytes parsed will be populated in parsedSize. This is size on success and 0 if an error is returned.
+ * @return Returns TSD_OK on success.
+ */
+TSDCode tsd_demux(TSDemuxContext *ctx, void *data, size_t size, size_t *parsedSize);
+
+/**
+ * Demux a File.
+ * Demuxes a whole file, then ends the demux process with tsd_demux_end.
+ * Where mmap is available the file is mapped window_size bytes at a time, so
+ * PES packets that fit in a single TS packet point straight into the mapping
+ * and large files only take window_size bytes of address space. Otherwise the
+ * file is read into a window_size buffer.
+ * @param ctx The context being used to demux.
+ * @param path The path of the file to demux.
+ * @param window_size Bytes demuxed per tsd_demux call, 0 for
+ *                    TSD_FILE_WINDOW_SIZE.
+ * @return TSD_OK on success, TSD_FILE_ERROR if the file can't be read.
+ */
+TSDCode tsd_demux_file(TSDemuxContext *ctx, const char *path, size_t window_size);
+
+/**
+ * Ends the Demuxxing process.
+ * Flushing any pending PES packets in the buffers, and any packet carried over
+ * from the last call to tsd_demux.
+ * @param ctx The context being used to demux.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_demux_end(TSDemuxContext *ctx);
+
+/**
+ * Parse Packet Header.
+ * Parses a TS Packet from the supplied data.
+ * The parsed output is put into the hdr parameter supplied.
+ * The hdr pointer must be a pointer to a valid TSDPacket object.
+ * @param ctx The context being used to demux.
+ * @param data The TS data to parse.
+ * @param size The number of bytes to parse.
+ * @param hdr The ouput of the parsing will do into the object referenced by
+ *            this pointer.
+ * @return TSD_OK on success. See the TSDCode enum for error codes.
+ */
+TSDCode tsd_parse_packet_header(TSDemuxContext *ctx,
+                                const uint8_t *data,
+                                size_t size,
+                                TSDPacket *hdr);
+
+/**
+ * Parse Packet Headers in Bulk.
+ * Decodes the headers of consecutive packets into the parallel arrays of
+ * headers, without demuxing them. The packet size set on the context is used,
+ * TSD_TSPACKET_SIZE when there is none.
+ * @param ctx The context being used to demux.
+ * @param data The TS data to parse, starting at a packet boundary.
+ * @param size The number of bytes to parse.
+ * @param headers The arrays to fill in.
+ * @param count Populated with the number of packets parsed.
+ * @return TSD_OK on success, TSD_INVALID_SYNC_BYTE when parsing stopped at a
+ *         packet without a sync byte.
+ */
+TSDCode tsd_parse_packet_headers_batch(TSDemuxContext *ctx,
+                                       const uint8_t *data,
+                                       size_t size,
+                                       TSDPacketHeaders *headers,
+                                       size_t *count);
+
+/**
+ * Parse TS Packet Adaption Field.
+ * Parses the Adaption Field found inside a TSDPacket.
+ * This function is called internally when parsing TS Packets.
+ * @param ctx The context being used to demux.
+ * @param data The data to parse.
+ * @param size The size of the data to parse.
+ * @param adap The AdaptatioField object that will store the result.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_adaptation_field(TSDemuxContext *ctx,
+                                   const uint8_t *data,
+                                   size_t size,
+                                   TSDAdaptationField *adap);
+
+/**
+ * Parses TSDTable packets.
+ * Parses a series of packets to construct a generic table. A TSDTable
+ * can be contained within a single Packet or across multiple.
+ * The data contained within the table to produce a PAT, PMT or CAT
+ * needs to be parsed once the generic table has been parsed.
+ * This function supports both short and long form tables.
+ * A long form table is complete once every section from 0 to its
+ * last_section_number has arrived, in any order. The sections of the
+ * returned table are sorted by section_number. Sections arriving again
+ * before the table completes are skipped.
+ * Only the first table completed by pkt is returned.
+ * @param ctx The context being used to demux.
+ * @param pkt The packet to parse.
+ * @param table Where to store the table output.
+ * @return TSD_OK will be returned on successful parsing of a table
+ *                TSD_INCOMPLETE_TABLE will be returned when there is
+ *                not enough data to complete the table. tsd_parse_table
+ *                will then need to be called with the next packets
+ *                idenitfied with the sample table PID.
+ *                TSD_INVALID_CRC will be returned, and the section dropped,
+ *                when a long form section fails its CRC_32 check.
+ */
+
+TSDCode tsd_parse_table(TSDemuxContext *ctx,
+                        TSDPacket *pkt,
+                        TSDTable *table);
+
+/**
+ * Calculates a CRC-32/MPEG-2.
+ * The CRC used by PSI sections. A section including its CRC_32 field is
+ * intact when the result is 0.
+ * @param data The data to calculate the CRC of.
+ * @param size The number of bytes in data.
+ * @return The CRC of data.
+ */
+uint32_t tsd_crc32(const uint8_t *data, size_t size);
+
+/**
+ * Parses all the TSDTable Sections to form a TSDTable.
+ * Takes complete TSDTable data, which is all the TSDTable Sections that
+ * make up a table, and parses them into the supplied TSDTable object.
+ * This is called internally by tsd_parse_table.
+ * @param ctx The context being used to demux.
+ * @param data The raw TSDTable data to parse.
+ * @param size The number of bytes that make up the table.
+ * @param table The TSDTable where the TableSections will be stored.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_table_sections(TSDemuxContext *ctx,
+                                 uint8_t *data,
+                                 size_t size,
+                                 TSDTable *table);
+
+/**
+ * Parses PAT data from a TSDTable.
+ * The table data is the data supplied by a TSDTable object once a
+ * generic table has been processed using tsd_parse_table.
+ * @param ctx The context being used to demux.
+ * @param data The table data to parse into PAT values.
+ * @param size The size of the table data. Should be in multiple of 4
+ *             bytes
+ * @param pat The TSDPATData that will store the result.
+ * @return Returns TSD_OK on success.
+ */
+TSDCode tsd_parse_pat(TSDemuxContext *ctx,
+                      const uint8_t *data,
+                      size_t size,
+                      TSDPATData* pat);
+
+/**
+ * Parses TSDDescriptor data from a TSDTable.
+ * The table data is the data supplied by a TSDTable object once a
+ * generic table has been processed using tsd_parse_table.
+ * The descriptors array is allocated with ctx->calloc and points into data,
+ * use a TSDDescriptorIter instead to walk the descriptors without allocating.
+ * @param ctx The context being used to demux.
+ * @param data The table data to parse into CAT values.
+ * @param size The size of the table data.
+ * @param descriptorData The TSDDescriptorData that will store the result.
+ * @return Returns TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptors(TSDemuxContext *ctx,
+                              const uint8_t *data,
+                              size_t size,
+                              TSDDescriptorData *descriptorData);
+
+/**
+ * Parses PMT data from a TSDTable.
+ * The table data is the data supploed by a TSDTable object once a
+ * generic table has been processed using tsd_parse_table.
+ * The program elements and every descriptor are stored in a single block,
+ * allocated with ctx->calloc. It starts at program_elements, or at
+ * descriptors when there are no program elements, and is released with one
+ * call to ctx->free. The descriptors point into data.
+ * @param ctx The context being used to demux.
+ * @param data The table data to parse into a PMT.
+ * @param size The size of the table data.
+ * @param pmt The TSDPMTData that will store the result.
+ * @return Returns TSD_OK on success.
+ */
+TSDCode tsd_parse_pmt(TSDemuxContext *ctx,
+                      const uint8_t *data,
+                      size_t size,
+                      TSDPMTData *pmt);
+
+/**
+ * Parses PES packets.
+ * @param ctx The context being used to demux.
+ * @param data The raw data to parse.
+ * @param size The size of the data.
+ * @param pes The TSDPESPacket that the data will be parsed into.
+ * @return Returns TSD_OK on success.
+ */
+TSDCode tsd_parse_pes(TSDemuxContext *ctx,
+                      const uint8_t *data,
+                      size_t size,
+                      TSDPESPacket *pes);
+
+/**
+ * Parses and Extracts data from a TSDTable.
+ * Parses packets that make up a table and Extracts the data into a contiguous
+ * memory buffer.
+ * @param ctx The context being used to demux.
+ * @param hdr The next packet to parse
+ * @param table A pointer to a TSDTable Structure that will be populated with the
+ *              table section information.
+ * @param mem A pointer used to store the memry buffer location.
+ * @param size A pointer to an integer used to store the number of bytes written
+ *             to the memory buffer.
+ * @return TSD_OK once the table is parsed completely. TSD_INCOMPLETE_TABLE if
+ *         the table is incomplete and requires more packets to be parsed.
+ *         Any other response must be treated as an error.
+ */
+TSDCode tsd_table_data_extract(TSDemuxContext *ctx,
+                               TSDPacket *hdr,
+                               TSDTable *table,
+                               uint8_t **mem,
+                               size_t *size);
+
+/**
+ * Converts raw Decriptor data into a TSDDescriptor array.
+ * @param ctx The context being used to demux.
+ * @param data The raw Descriptor data.
+ * @param data_size The size of the Descriptor data.
+ * @param descriptors Pointer to assign the array of TSDDescriptor to.
+ * @param descriptors_length Where to write the number of Descriptors available in
+ *        descriptors.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_descriptor_extract(TSDemuxContext *ctx,
+                               const uint8_t *data,
+                               size_t data_size,
+                               TSDDescriptor **descriptors,
+                               size_t *descriptors_length);
+
+/**
+ * Get a Program.
+ * Looks up a program of the program directory. The program, and the PMT in
+ * it, stay valid until the next call to tsd_demux.
+ * @param ctx The context being used to demux.
+ * @param program_number The program number from the PAT.
+ * @param program Where to store the program.
+ * @return TSD_OK on success, TSD_PROGRAM_NOT_FOUND if the PAT has no such
+ *         program.
+ */
+TSDCode tsd_get_program(TSDemuxContext *ctx,
+                        uint16_t program_number,
+                        const TSDProgram **program);
+
+/**
+ * Get a Program by Elementary PID.
+ * Looks up the program carrying an elementary stream.
+ * @param ctx The context being used to demux.
+ * @param pid The elementary PID.
+ * @param program Where to store the program.
+ * @param element Where to store the program element of the stream, may be
+ *        NULL.
+ * @return TSD_OK on success, TSD_PID_NOT_FOUND if no PMT has the PID.
+ */
+TSDCode tsd_get_program_by_pid(TSDemuxContext *ctx,
+                               uint16_t pid,
+                               const TSDProgram **program,
+                               const TSDProgramElement **element);
+
+/**
+ * Find Streams by Stream Type.
+ * Walks the elementary streams of the program directory with the given stream
+ * type, in PID order. Set cursor to 0 to start, each call moves it on.
+ * @param ctx The context being used to demux.
+ * @param stream_type The stream type to look for, see TSDPMTStreamType.
+ * @param cursor Position of the search.
+ * @param program Where to store the program.
+ * @param element Where to store the program element of the stream.
+ * @return TSD_OK when a stream was found, TSD_END_OF_DATA when there are no
+ *         more.
+ */
+TSDCode tsd_find_stream_type(TSDemuxContext *ctx,
+                             uint8_t stream_type,
+                             size_t *cursor,
+                             const TSDProgram **program,
+                             const TSDProgramElement **element);
+
+/**
+ * Initialize a Descriptor Iterator.
+ * Prepares iter to walk the descriptor loop in data, such as the program info
+ * or ES info of a PMT or the body of a CAT. Nothing is copied, data must
+ * outlive the iterator.
+ * @param iter The iterator to initialize.
+ * @param data The raw Descriptor data, may be NULL when size is 0.
+ * @param size The size of the Descriptor data.
+ * @return TSD_OK on success, TSD_INVALID_DATA if data is NULL but size isn't
+ *         0, in which case iter is left empty.
+ */
+TSDCode tsd_descriptor_iter_init(TSDDescriptorIter *iter,
+                                 const uint8_t *data,
+                                 size_t size);
+
+/**
+ * Next Descriptor.
+ * Fills desc with the next descriptor of the loop. desc->data points at the
+ * descriptor tag inside the loop and desc->data_length includes the tag and
+ * length bytes, as in the descriptors of TSDPMTData.
+ * @param iter The iterator.
+ * @param desc Where to store the descriptor.
+ * @return TSD_OK when desc was filled, TSD_END_OF_DATA once the loop is done
+ *         or TSD_INVALID_DATA_SIZE if the next descriptor runs past the end of
+ *         the loop, after which the iterator is done.
+ */
+TSDCode tsd_descriptor_iter_next(TSDDescriptorIter *iter, TSDDescriptor *desc);
+
+/**
+ * Find a Descriptor.
+ * Moves iter on to the next descriptor with the given tag, so that calling it
+ * again finds the following one.
+ * @param iter The iterator.
+ * @param tag The descriptor tag to look for.
+ * @param desc Where to store the descriptor.
+ * @return TSD_OK when found, TSD_END_OF_DATA if there are no more descriptors
+ *         with that tag or TSD_INVALID_DATA_SIZE if the loop is truncated.
+ */
+TSDCode tsd_descriptor_iter_find(TSDDescriptorIter *iter,
+                                 uint8_t tag,
+                                 TSDDescriptor *desc);
+
+/**
+ * Destroys Table Data.
+ * Detroys data used in a Table.
+ * @param ctx The context being used to demux.
+ * @param table The table to destroy.
+ * @returns TSD_OK on success.
+ */
+TSDCode tsd_table_data_destroy(TSDemuxContext *ctx, TSDTable *table);
+
+/**
+ * Data Content Initializtion.
+ * Initializes a Data Context. Do not call multiple times on the same Context
+ * unless the context has been destroyed.
+ * A TSDDataContext must be initialized before being used anywhere in the API.
+ * @param ctx The context being used to demux.
+ * @param dataCtx The TSDDataContext to initialize.
+ * @return TSD_OK on succes.
+ */
+TSDCode tsd_data_context_init(TSDemuxContext *ctx, TSDDataContext *dataCtx);
+
+/**
+ * Destroys a TSDDataContext.
+ * Destroys a TSDDataContext that has been previously initialized.
+ * Calling tsd_data_context_destroy multiple times after initializing a TSDDataContext
+ * will not cause any problems.
+ * Do not call tsd_data_context_destroy on an unitialized TSDDataContext, unexecpted
+ * behavior will occur.
+ * It is possible to reinitialize a TSDDataContext once it has been destroyed.
+ * @param ctx The context being used to demux.
+ * @param dataCtx The TSDDataContext to destroy.
+ * @return TSD_OK on success and if the TSDDataContext has already been destroyed.
+ */
+TSDCode tsd_data_context_destroy(TSDemuxContext *ctx, TSDDataContext *dataCtx);
+
+/**
+ * Writes data to TSDDataContext.
+ * The TSDDataContext will dynamically allocate more memory if there is not enough
+ * space in the TSDDataContext buffer, at least doubling its size.
+ * Supplying NULL data or a size of zero will cause tsd_data_context_write to return
+ * an error.
+ * @param ctx The context being used to demux.
+ * @param dataCtx The TSDDataContext to write the data to.
+ * @param data The data to write.
+ * @param size The number of bytes to write.
+ * @returns TSD_OK on success.
+ */
+TSDCode tsd_data_context_write(TSDemuxContext *ctx, TSDDataContext *dataCtx, const uint8_t *data, size_t size);
+
+/**
+ * Reset Data Context.
+ * Resets the write buffer effecively clearing the buffer and starting over.
+ * Re-uses the existing buffer even if it has previously been dynamically
+ * allocated during a write process.
+ * @param ctx The context being used to demux.
+ * @param dataCtx The TSDDataContext to reset.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_data_context_reset(TSDemuxContext *ctx, TSDDataContext *dataCtx);
+
+/**
+ * Data Context Reserve.
+ * Makes sure the Data Context can hold at least size bytes without growing,
+ * keeping the data already written. The buffer never shrinks.
+ * @param ctx The context being used to demux.
+ * @param dataCtx The Data Context to grow.
+ * @param size The number of bytes the Data Context should be able to hold.
+ * @return TSD_OK on success, TSD_OUT_OF_MEMORY if the memory couldn't be
+ *         allocated.
+ */
+TSDCode tsd_data_context_reserve(TSDemuxContext *ctx,
+                                 TSDDataContext *dataCtx,
+                                 size_t size);
+
+/**
+ * Register a PID for demuxing.
+ * When a PID is registered, the user supplied callback will be called with the
+ * data associated with that PID as packets are being parsed.
+ * @param ctx The context being used to demux.
+ * @param pid The PID being registered.
+ * @param reg_data_type What type of data to register.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if the PID is out of range.
+ * @see TSDRegType
+ */
+TSDCode tsd_register_pid(TSDemuxContext *ctx, uint16_t pid, int reg_data_type);
+
+/**
+ * Deregisters a PID for demuxing.
+ * Removes a PID from the PID demuxing register and frees any data buffered
+ * for it. Unflushed PES data is discarded.
+ * @param ctx The context being used to demux.
+ * @param pid The PID being deregistered.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_deregister_pid(TSDemuxContext *ctx, uint16_t pid);
+
+/**
+ * Register a Section Filter.
+ * Tables carried on pid whose table_id matches table_id, in the bits set in
+ * mask, are assembled and passed to the user callback with TSD_EVENT_TABLE
+ * and a TSDTableData. Sections that don't match are skipped before they are
+ * copied. Several filters can be registered on the same PID, for example to
+ * receive SCTE-35 (0xFC) or all EIT tables (0x40 with mask 0xC0).
+ * Filters on the PAT, CAT, TSDT or PMT PIDs are ignored, those tables are
+ * parsed by the demux itself.
+ * The TSDTableData is only valid for the duration of the callback.
+ * @param ctx The context being used to demux.
+ * @param pid The PID carrying the tables.
+ * @param table_id The table_id to look for.
+ * @param mask The bits of table_id to compare, 0xFF for an exact match.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if the PID is out of range
+ *         and TSD_PID_ALREADY_REGISTERED if the filter already exists.
+ */
+TSDCode tsd_register_section_filter(TSDemuxContext *ctx,
+                                    uint16_t pid,
+                                    uint8_t table_id,
+                                    uint8_t mask);
+
+/**
+ * Deregisters a Section Filter.
+ * Removes a filter added with tsd_register_section_filter.
+ * @param ctx The context being used to demux.
+ * @param pid The PID of the filter.
+ * @param table_id The table_id of the filter.
+ * @param mask The mask of the filter.
+ * @return TSD_OK on success, TSD_PID_NOT_FOUND if there is no such filter.
+ */
+TSDCode tsd_deregister_section_filter(TSDemuxContext *ctx,
+                                      uint16_t pid,
+                                      uint8_t table_id,
+                                      uint8_t mask);
+
+/**
+ * Register a Section Filter on the table_id_extension.
+ * Like tsd_register_section_filter, but only the long form sections whose
+ * table_id_extension also matches table_id_extension, in the bits set in
+ * extension_mask, are assembled. For example the EIT of a single service
+ * (0x4E with the service_id) or the SDT of one transport stream. Sections
+ * that don't match are skipped before anything is allocated for them.
+ * @param ctx The context being used to demux.
+ * @param pid The PID carrying the tables.
+ * @param table_id The table_id to look for.
+ * @param mask The bits of table_id to compare, 0xFF for an exact match.
+ * @param table_id_extension The table_id_extension to look for.
+ * @param extension_mask The bits of table_id_extension to compare, 0 to
+ *                       accept any.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if the PID is out of range
+ *         and TSD_PID_ALREADY_REGISTERED if the filter already exists.
+ */
+TSDCode tsd_register_section_filter_ext(TSDemuxContext *ctx,
+                                        uint16_t pid,
+                                        uint8_t table_id,
+                                        uint8_t mask,
+                                        uint16_t table_id_extension,
+                                        uint16_t extension_mask);
+
+/**
+ * Deregisters a Section Filter on the table_id_extension.
+ * Removes a filter added with tsd_register_section_filter_ext.
+ * @param ctx The context being used to demux.
+ * @param pid The PID of the filter.
+ * @param table_id The table_id of the filter.
+ * @param mask The mask of the filter.
+ * @param table_id_extension The table_id_extension of the filter.
+ * @param extension_mask The extension mask of the filter.
+ * @return TSD_OK on success, TSD_PID_NOT_FOUND if there is no such filter.
+ */
+TSDCode tsd_deregister_section_filter_ext(TSDemuxContext *ctx,
+                                          uint16_t pid,
+                                          uint8_t table_id,
+                                          uint8_t mask,
+                                          uint16_t table_id_extension,
+                                          uint16_t extension_mask);
+
+/**
+ * Parses a Video Stream Descriptor.
+ * @param data The data to parse.
+ * @param size, The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_video_stream(const uint8_t *data,
+        size_t size,
+        TSDDescriptorVideoStream *desc);
+
+/**
+ * Parses an Audio Stream Descriptor.
+ * @param data The data to parse.
+ * @param size, The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_audio_stream(const uint8_t *data,
+        size_t size,
+        TSDDescriptorAudioStream *desc);
+
+/**
+ * Parses a Hierarchy Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_hierarchy(const uint8_t *data,
+                                       size_t size,
+                                       TSDDescriptorHierarchy *desc);
+/**
+ * Parses a Registration Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_registration(const uint8_t *data,
+        size_t size,
+        TSDDescriptorRegistration *desc);
+
+/**
+ * Parses a Registration Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_registration(const uint8_t *data,
+        size_t size,
+        TSDDescriptorRegistration *desc);
+
+/**
+ * Parses a Data Stream Alignment Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_data_stream_alignment(const uint8_t *data,
+        size_t size,
+        TSDDescriptorDataStreamAlignment *desc);
+
+/**
+ * Parses a Target Background Grid Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_target_background_grid(const uint8_t *data,
+        size_t size,
+        TSDDescriptorTargetBackgroundGrid *desc);
+
+/**
+ * Parses a Video Window Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_video_window(const uint8_t *data,
+        size_t size,
+        TSDDescriptorVideoWindow *desc);
+
+/**
+ * Parses a Conditional Access Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_conditional_access(const uint8_t *data,
+        size_t size,
+        TSDDescriptorConditionalAccess *desc);
+
+/**
+ * Parses a ISO 639 Language Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_iso639_language(const uint8_t *data,
+        size_t size,
+        TSDDescriptorISO639Language *desc);
+
+/**
+ * Parses a System Clock Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_system_clock(const uint8_t *data,
+        size_t size,
+        TSDDescriptorSystemClock *desc);
+
+/**
+ * Parses a Multiplex Buffer Utilization Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_multiplex_buffer_utilization(const uint8_t *data,
+        size_t size,
+        TSDDescriptorMultiplexBufferUtilization *desc);
+
+/**
+ * Parses a Copyright Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_copyright(const uint8_t *data,
+                                       size_t size,
+                                       TSDDescriptorCopyright *desc);
+
+/**
+ * Parses a Maximum Bit-rate Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_max_bitrate(const uint8_t *data,
+        size_t size,
+        TSDDescriptorMaxBitrate *desc);
+
+/**
+ * Parses a Private Data Indicator Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_priv_data_ind(const uint8_t *data,
+        size_t size,
+        TSDDescriptorPrivDataInd *desc);
+
+/**
+ * Parses a Smoothing Buffer Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_smoothing_buffer(const uint8_t *data,
+        size_t size,
+        TSDDescriptorSmoothingBuffer *desc);
+
+/**
+ * Parses a System Target Decoder Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_sys_target_decoder(const uint8_t *data,
+        size_t size,
+        TSDDescriptorSysTargetDecoder *desc);
+
+/**
+ * Parses a IBP Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_ibp(const uint8_t *data,
+                                 size_t size,
+                                 TSDDescriptorIBP *desc);
+
+/**
+ * Parses a MPEG-4 Video Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_mpeg4_video(const uint8_t *data,
+        size_t size,
+        TSDDescriptorMPEG4Video *desc);
+
+/**
+ * Parses a MPEG-4 Audio Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_mpeg4_audio(const uint8_t *data,
+        size_t size,
+        TSDDescriptorMPEG4Audio *desc);
+
+/**
+ * Parses a IOD Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_iod(const uint8_t *data,
+                                 size_t size,
+                                 TSDDescriptorIOD *desc);
+
+/**
+ * Parses a SL Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_sl(const uint8_t *data,
+                                size_t size,
+                                TSDDescriptorSL *desc);
+
+/**
+ * Parses a FMC Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_fmc(const uint8_t *data,
+                                 size_t size,
+                                 TSDDescriptorFMC *desc);
+
+/**
+ * Parses a External ES ID Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_external_es_id(const uint8_t *data,
+        size_t size,
+        TSDDescriptorExternalESID *desc);
+
+/**
+ * Parses a MuxCode Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_mux_code(const uint8_t *data,
+                                      size_t size,
+                                      TSDDescriptorMuxCode *desc);
+
+/**
+ * Parses a FMX Buffer Size Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_fmx_buffer_size(const uint8_t *data,
+        size_t size,
+        TSDDescriptorFMXBufferSize *desc);
+
+/**
+ * Parses a Multiplex Buffer Descriptor.
+ * @param data The data to parse.
+ * @param size The size of the data in bytes.
+ * @param desc The descriptor to write the parsed information into.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_parse_descriptor_multiplex_buffer(const uint8_t *data,
+        size_t size,
+        TSDDescriptorMultiplexBuffer *desc);
+
+/**
+ * Decodes a Descriptor.
+ * Picks the decoder for the tag of desc from a table, instead of a switch
+ * over every tsd_parse_descriptor_ function, and decodes into the matching
+ * member of out, e.g. out->iso639_language for TSD_DESCRIPTOR_ISO639_LANGUAGE.
+ * @param desc The descriptor, as given by a TSDDescriptorIter or in
+ *        TSDPMTData.
+ * @param out The decoded descriptor.
+ * @return TSD_OK on success, TSD_UNKNOWN_DESCRIPTOR if the tag has no decoder
+ *         or the code returned by the decoder.
+ */
+TSDCode tsd_decode_descriptor(const TSDDescriptor *desc,
+                              TSDDecodedDescriptor *out);
+
+/**
+ * Find a Start Code.
+ * Searches data for the next Annex B start code (0x000001), using the widest
+ * SIMD instructions the CPU supports.
+ * @param data The data to search.
+ * @param size The size of data.
+ * @param offset Where to store the offset of the start code into data, or
+ *        size when there is none.
+ * @return TSD_OK when a start code was found, TSD_END_OF_DATA otherwise.
+ */
+TSDCode tsd_find_start_code(const uint8_t *data, size_t size, size_t *offset);
+
+/**
+ * Initialize a NAL Splitter.
+ * @param splitter The splitter to initialize.
+ * @param stream_type TSD_PMT_STREAM_TYPE_VIDEO_AVC or
+ *        TSD_PMT_STREAM_TYPE_VIDEO_HEVC, picks how nal_unit_type is read.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT for other stream types.
+ */
+TSDCode tsd_nal_splitter_init(TSDNALSplitter *splitter, uint8_t stream_type);
+
+/**
+ * Feed a NAL Splitter.
+ * Passes the next piece of the stream to the splitter. Nothing is copied,
+ * data must stay valid until tsd_nal_splitter_next returned TSD_END_OF_DATA.
+ * @param splitter The splitter.
+ * @param data The next piece of the stream.
+ * @param size The size of data.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_nal_splitter_feed(TSDNALSplitter *splitter,
+                              const uint8_t *data,
+                              size_t size);
+
+/**
+ * Next NAL Unit.
+ * Finds the next NAL unit that ends in the data fed last. A NAL unit ends
+ * where the following start code begins, so the last one is only returned
+ * by tsd_nal_splitter_end.
+ * @param splitter The splitter.
+ * @param unit Where to store the NAL unit.
+ * @return TSD_OK when unit was filled, TSD_END_OF_DATA once the data needs to
+ *         be followed by more.
+ */
+TSDCode tsd_nal_splitter_next(TSDNALSplitter *splitter, TSDNALUnit *unit);
+
+/**
+ * End a NAL Splitter.
+ * Ends the stream, e.g. at the end of a PES packet when NAL units don't span
+ * PES packets, returning the NAL unit that was still being received.
+ * The splitter can carry on being fed afterwards.
+ * @param splitter The splitter.
+ * @param unit Where to store the NAL unit.
+ * @return TSD_OK when unit was filled, TSD_END_OF_DATA if there was none.
+ */
+TSDCode tsd_nal_splitter_end(TSDNALSplitter *splitter, TSDNALUnit *unit);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif // TS_DEMUX_H
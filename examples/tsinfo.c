@@ -54,33 +54,21 @@ int main(int argc, char **charv) {
     tsd_set_event_callback(&ctx, event_cb);
 
     // create a buffer on the stack which we'll use to read the file data into.
-    // we'll set the buffer size to exactly 10 TS packets but it could be any
-    // size.
-    char buffer[1880];
+    // the buffer can be any size, tsd_demux keeps hold of any partial packet
+    // at the end of the data and completes it on the next call.
+    char buffer[2000];
 
-    int count = 0; // number of bytes read from the file.
+    size_t count = 0; // number of bytes read from the file.
     size_t parsed = 0; // number of bytes parsed by the demuxer.
 
     // read the file until we reach the end.
     do {
-        // at the end of the do loop, we write back any remainder bytes into
-        // the buffer, this is why we write into the buffer at the location
-        // &buffer[count - parsed].
-        count = fread(&buffer[count - parsed], 1, 1880 - (count - parsed), file_input);
-
+        count = fread(buffer, 1, sizeof(buffer), file_input);
         if(count > 0) {
+            // during 'demux' our callback may be called, so we can safely
+            // reuse our buffer afterwards.
             // with res, we could report any errors found during demuxing
             TSDCode res = tsd_demux(&ctx, buffer, count, &parsed);
-        }else{
-            parsed = 0;
-        }
-        // during 'demux' our callback may be called, so we can safely discard
-        // our buffer.
-        // we'll copy any unused bytes back into the start of the buffer.
-        // this may happen if we read partial packets from file, or there was
-        // some corruption in the TS stream.
-        if(parsed < count) {
-            memmove(buffer, buffer, count - parsed);
         }
     } while(count > 0);
 
@@ -453,32 +441,25 @@ const char* descriptor_tag_to_str(uint8_t tag) {
 void print_descriptor_info(TSDDescriptor *desc)
 {
     // print out some interesting descriptor data
-    switch(desc->tag) {
-        case 0x05: // Registration descriptor
-        {
-            TSDDescriptorRegistration res;
-            if(TSD_OK == tsd_parse_descriptor_registration(desc->data, desc->data_length, &res)) {
-                printf("\n  format identififer: 0x%08X\n\n", res.format_identifier);
-            }
-        } break;
-        case 0x0A: // ISO 639 Language descriptor
-        {
-            TSDDescriptorISO639Language res;
-            if(TSD_OK == tsd_parse_descriptor_iso639_language(desc->data, desc->data_length, &res)) {
-                printf("\n");
-                int i=0;
-                for(; i < res.language_length; ++i) {
-                    printf(" ISO Language Code: 0x%08X, audio type: 0x%02x\n", res.iso_language_code[i], res.audio_type[i]);
-                }
-                printf("\n");
-            }
-        } break;
-        case 0x0E: // Maximum bitrate descriptor
+    TSDDecodedDescriptor res;
+    if(TSD_OK != tsd_decode_descriptor(desc, &res)) {
+        return;
+    }
+    switch(res.header.tag) {
+        case TSD_DESCRIPTOR_REGISTRATION:
+            printf("\n  format identififer: 0x%08X\n\n", res.registration.format_identifier);
+            break;
+        case TSD_DESCRIPTOR_ISO639_LANGUAGE:
         {
-            TSDDescriptorMaxBitrate res;
-            if(TSD_OK == tsd_parse_descriptor_max_bitrate(desc->data, desc->data_length, &res)) {
-                printf("\n Maximum Bitrate: %d x 50 bytes/second\n\n", res.max_bitrate);
+            printf("\n");
+            int i=0;
+            for(; i < res.iso639_language.language_length; ++i) {
+                printf(" ISO Language Code: 0x%08X, audio type: 0x%02x\n", res.iso639_language.iso_language_code[i], res.iso639_language.audio_type[i]);
             }
+            printf("\n");
         } break;
+        case TSD_DESCRIPTOR_MAX_BITRATE:
+            printf("\n Maximum Bitrate: %d x 50 bytes/second\n\n", res.max_bitrate.max_bitrate);
+            break;
     }
 }
@@ -26,6 +26,66 @@
 #include "string.h"
 #include <stdio.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define TSD_FILE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// the kernels are selected once, whichever thread gets there first.
+#if defined(__unix__) || defined(__APPLE__)
+#define TSD_ONCE_PTHREAD
+#include <pthread.h>
+#elif defined(_WIN32)
+#define TSD_ONCE_WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+// SIMD kernels. SSE2 is part of the x86-64 baseline, AVX2 is built with a
+// target attribute and only used when the CPU supports it.
+#if defined(__x86_64__) || defined(_M_X64) || \
+    (defined(__i386__) && defined(__SSE2__)) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TSD_SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define TSD_SIMD_AVX2
+#define TSD_SIMD_PCLMUL
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TSD_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// PMULL is only used when the build targets the ARMv8 crypto extension.
+#if defined(__aarch64__) && defined(TSD_SIMD_NEON) && \
+    (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#define TSD_SIMD_PMULL
+#endif
+
+#if defined(__GNUC__)
+#define TSD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define TSD_TARGET(isa)
+#endif
+
+typedef enum TSDCpuFeature {
+    TSD_CPU_SSE2    = 0x01,
+    TSD_CPU_AVX2    = 0x02,
+    TSD_CPU_NEON    = 0x04,
+    TSD_CPU_PCLMUL  = 0x08,
+    TSD_CPU_PMULL   = 0x10,
+} TSDCpuFeature;
+
 uint16_t parse_u16(const uint8_t *bytes)
 {
     uint16_t val = *((uint16_t*)bytes);
@@ -66,6 +126,516 @@ uint64_t parse_u64(const uint8_t *bytes)
 #endif
 }
 
+int cpu_features(void)
+{
+    int features = 0;
+#if defined(TSD_SIMD_SSE2)
+    features |= TSD_CPU_SSE2;
+#endif
+#if defined(TSD_SIMD_AVX2) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        features |= TSD_CPU_AVX2;
+    }
+    if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) {
+        features |= TSD_CPU_PCLMUL;
+    }
+#elif defined(TSD_SIMD_AVX2) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    // PCLMULQDQ and SSSE3
+    if((info[2] & 0x202) == 0x202) {
+        features |= TSD_CPU_PCLMUL;
+    }
+    // OSXSAVE and AVX, with the OS saving the YMM registers
+    if(max_leaf >= 7 &&
+       (info[2] & 0x18000000) == 0x18000000 && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        if(info[1] & 0x20) {
+            features |= TSD_CPU_AVX2;
+        }
+    }
+#endif
+#if defined(TSD_SIMD_NEON)
+    features |= TSD_CPU_NEON;
+#endif
+#if defined(TSD_SIMD_PMULL)
+    features |= TSD_CPU_PMULL;
+#endif
+    return features;
+}
+
+typedef const uint8_t *(*find_sync_pair_fn)(const uint8_t *ptr, const uint8_t *end, size_t stride);
+typedef const uint8_t *(*find_start_code_fn)(const uint8_t *ptr, const uint8_t *end, uint8_t max);
+typedef size_t (*parse_headers_fn)(const uint8_t *data,
+                                   size_t stride,
+                                   size_t i,
+                                   size_t n,
+                                   TSDPacketHeaders *headers);
+typedef uint32_t (*crc32_fn)(uint32_t crc, const uint8_t *data, size_t size);
+
+// the kernels used on this CPU, see kernels().
+typedef struct TSDKernels {
+    find_sync_pair_fn find_sync_pair;
+    find_start_code_fn find_start_code;
+    parse_headers_fn parse_headers;
+    crc32_fn crc32;
+} TSDKernels;
+
+const TSDKernels *kernels(void);
+
+int count_trailing_zeros(uint32_t val)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(val);
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, val);
+    return (int)idx;
+#else
+    int n = 0;
+    while(!(val & 1)) {
+        val >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// The find_sync_pair kernels return the first position in [ptr, end) that
+// holds a sync byte and is followed by another one stride bytes later, or
+// NULL. ptr + stride is always read, so end must have at least stride bytes
+// after it.
+const uint8_t *find_sync_pair_scalar(const uint8_t *ptr, const uint8_t *end, size_t stride)
+{
+    for(; ptr < end; ++ptr) {
+        if(ptr[0] == TSD_SYNC_BYTE && ptr[stride] == TSD_SYNC_BYTE) {
+            return ptr;
+        }
+    }
+    return NULL;
+}
+
+#if defined(TSD_SIMD_SSE2)
+const uint8_t *find_sync_pair_sse2(const uint8_t *ptr, const uint8_t *end, size_t stride)
+{
+    const __m128i sync = _mm_set1_epi8((char)TSD_SYNC_BYTE);
+    for(; ptr + 16 <= end; ptr += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)ptr);
+        __m128i b = _mm_loadu_si128((const __m128i*)(ptr + stride));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(a, sync), _mm_cmpeq_epi8(b, sync));
+        int mask = _mm_movemask_epi8(eq);
+        if(mask) {
+            return ptr + count_trailing_zeros((uint32_t)mask);
+        }
+    }
+    return find_sync_pair_scalar(ptr, end, stride);
+}
+#endif
+
+#if defined(TSD_SIMD_AVX2)
+TSD_TARGET("avx2")
+const uint8_t *find_sync_pair_avx2(const uint8_t *ptr, const uint8_t *end, size_t stride)
+{
+    const __m256i sync = _mm256_set1_epi8((char)TSD_SYNC_BYTE);
+    for(; ptr + 32 <= end; ptr += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)ptr);
+        __m256i b = _mm256_loadu_si256((const __m256i*)(ptr + stride));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(a, sync),
+                                      _mm256_cmpeq_epi8(b, sync));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+        if(mask) {
+            return ptr + count_trailing_zeros(mask);
+        }
+    }
+    return find_sync_pair_scalar(ptr, end, stride);
+}
+#endif
+
+#if defined(TSD_SIMD_NEON)
+const uint8_t *find_sync_pair_neon(const uint8_t *ptr, const uint8_t *end, size_t stride)
+{
+    const uint8x16_t sync = vdupq_n_u8(TSD_SYNC_BYTE);
+    for(; ptr + 16 <= end; ptr += 16) {
+        uint8x16_t a = vld1q_u8(ptr);
+        uint8x16_t b = vld1q_u8(ptr + stride);
+        uint8x16_t eq = vandq_u8(vceqq_u8(a, sync), vceqq_u8(b, sync));
+        uint8x8_t any = vorr_u8(vget_low_u8(eq), vget_high_u8(eq));
+        if(vget_lane_u64(vreinterpret_u64_u8(any), 0)) {
+            return find_sync_pair_scalar(ptr, ptr + 16, stride);
+        }
+    }
+    return find_sync_pair_scalar(ptr, end, stride);
+}
+#endif
+
+const uint8_t *find_sync_pair(const uint8_t *ptr, const uint8_t *end, size_t stride)
+{
+    return kernels()->find_sync_pair(ptr, end, stride);
+}
+
+// The find_start_code kernels return the first position in [ptr, end - 2)
+// that holds two zero bytes followed by a byte no larger than max, or NULL.
+// A max of 1 finds start codes, 3 emulation prevention bytes as well.
+const uint8_t *find_start_code_scalar(const uint8_t *ptr, const uint8_t *end, uint8_t max)
+{
+    for(; ptr + 2 < end; ++ptr) {
+        if(ptr[2] > max) {
+            // nothing can start at ptr, ptr + 1 or ptr + 2
+            ptr += 2;
+        } else if(ptr[0] == 0 && ptr[1] == 0) {
+            return ptr;
+        }
+    }
+    return NULL;
+}
+
+#if defined(TSD_SIMD_SSE2)
+const uint8_t *find_start_code_sse2(const uint8_t *ptr, const uint8_t *end, uint8_t max)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi8((char)max);
+    for(; ptr + 18 <= end; ptr += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)ptr);
+        __m128i b = _mm_loadu_si128((const __m128i*)(ptr + 1));
+        __m128i c = _mm_loadu_si128((const __m128i*)(ptr + 2));
+        __m128i zeros = _mm_cmpeq_epi8(_mm_or_si128(a, b), zero);
+        __m128i small = _mm_cmpeq_epi8(_mm_max_epu8(c, limit), limit);
+        int mask = _mm_movemask_epi8(_mm_and_si128(zeros, small));
+        if(mask) {
+            return ptr + count_trailing_zeros((uint32_t)mask);
+        }
+    }
+    return find_start_code_scalar(ptr, end, max);
+}
+#endif
+
+#if defined(TSD_SIMD_AVX2)
+TSD_TARGET("avx2")
+const uint8_t *find_start_code_avx2(const uint8_t *ptr, const uint8_t *end, uint8_t max)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i limit = _mm256_set1_epi8((char)max);
+    for(; ptr + 34 <= end; ptr += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)ptr);
+        __m256i b = _mm256_loadu_si256((const __m256i*)(ptr + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(ptr + 2));
+        __m256i zeros = _mm256_cmpeq_epi8(_mm256_or_si256(a, b), zero);
+        __m256i small = _mm256_cmpeq_epi8(_mm256_max_epu8(c, limit), limit);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(zeros, small));
+        if(mask) {
+            return ptr + count_trailing_zeros(mask);
+        }
+    }
+    return find_start_code_scalar(ptr, end, max);
+}
+#endif
+
+#if defined(TSD_SIMD_NEON)
+const uint8_t *find_start_code_neon(const uint8_t *ptr, const uint8_t *end, uint8_t max)
+{
+    const uint8x16_t limit = vdupq_n_u8(max);
+    for(; ptr + 18 <= end; ptr += 16) {
+        uint8x16_t a = vld1q_u8(ptr);
+        uint8x16_t b = vld1q_u8(ptr + 1);
+        uint8x16_t c = vld1q_u8(ptr + 2);
+        uint8x16_t zeros = vceqq_u8(vorrq_u8(a, b), vdupq_n_u8(0));
+        uint8x16_t hit = vandq_u8(zeros, vcleq_u8(c, limit));
+        uint8x8_t any = vorr_u8(vget_low_u8(hit), vget_high_u8(hit));
+        if(vget_lane_u64(vreinterpret_u64_u8(any), 0)) {
+            return find_start_code_scalar(ptr, ptr + 18, max);
+        }
+    }
+    return find_start_code_scalar(ptr, end, max);
+}
+#endif
+
+const uint8_t *find_start_code(const uint8_t *ptr, const uint8_t *end, uint8_t max)
+{
+    return kernels()->find_start_code(ptr, end, max);
+}
+
+size_t packet_sync_offset(size_t packet_size)
+{
+    // M2TS packets start with a 4 byte TP_extra_header
+    return packet_size == TSD_M2TS_PACKET_SIZE ? 4 : 0;
+}
+
+// returns the packet size with the longest run of sync bytes in data, 0 when
+// there is no run of two. run is set to the length of it.
+size_t detect_packet_size(const uint8_t *data, size_t size, size_t *run_length)
+{
+    static const size_t sizes[] = {
+        TSD_TSPACKET_SIZE, TSD_M2TS_PACKET_SIZE, TSD_RS_PACKET_SIZE
+    };
+    const uint8_t *end = data + (size < TSD_PACKET_SIZE_DETECT_BYTES ?
+                                 size : TSD_PACKET_SIZE_DETECT_BYTES);
+    size_t best_size = 0;
+    size_t best_run = 1;
+    size_t i;
+
+    // the longest run of sync bytes at a packet stride wins, on a tie the
+    // smaller packet size is preferred.
+    for(i=0; i<sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        size_t stride = sizes[i];
+        const uint8_t *first = data + packet_sync_offset(stride);
+        const uint8_t *ptr;
+        for(ptr = first; ptr < first + stride && ptr < end; ++ptr) {
+            size_t run = 0;
+            const uint8_t *next = ptr;
+            while(next < end && *next == TSD_SYNC_BYTE) {
+                run++;
+                next += stride;
+            }
+            if(run > best_run) {
+                best_run = run;
+                best_size = stride;
+            }
+        }
+    }
+    *run_length = best_run;
+    return best_size;
+}
+
+// looks at the start of the stream for its packet size. It is only settled
+// once a run of sync bytes would confirm sync, TSD_PACKET_SIZE_DETECT_BYTES
+// have been seen, or the stream ends. A shorter run can't be trusted, the RS
+// parity bytes or M2TS header of a packet can hold sync bytes of their own.
+// Falls back to TSD_TSPACKET_SIZE when no packet size stands out.
+int packet_size_settle(TSDemuxContext *ctx, const uint8_t *data, size_t size, int end)
+{
+    size_t confirm = ctx->sync.confirm_packets > 0 ? ctx->sync.confirm_packets : 1;
+    size_t run;
+    size_t detected = detect_packet_size(data, size, &run);
+    if(run <= confirm && size < TSD_PACKET_SIZE_DETECT_BYTES && !end) {
+        return 0;
+    }
+    ctx->sync.packet_size = detected ? detected : TSD_TSPACKET_SIZE;
+    return 1;
+}
+
+// the number of sync bytes that must follow a candidate for sync to be
+// acquired. Kept low enough for the candidate and its confirmation to fit in
+// the carry buffer.
+size_t sync_confirm_packets(TSDemuxContext *ctx, size_t stride)
+{
+    size_t confirm = ctx->sync.confirm_packets > 0 ? ctx->sync.confirm_packets : 1;
+    size_t max = TSD_PACKET_SIZE_DETECT_BYTES / stride - 2;
+    return confirm < max ? confirm : max;
+}
+
+// looks for a sync byte followed by confirm_packets more at packet intervals.
+// Returns 1 with pos on the packet once found. Otherwise returns 0 with pos on
+// the first candidate whose confirmation runs past the end of the data, which
+// must be kept until more data arrives. With flush set that is the end of the
+// stream, and a candidate is accepted on what confirmation there is.
+int sync_acquire(TSDemuxContext *ctx,
+                 const uint8_t *end,
+                 size_t stride,
+                 const uint8_t **pos,
+                 int flush)
+{
+    size_t offset = packet_sync_offset(stride);
+    const uint8_t *ptr = *pos;
+    // the last complete packet in the data
+    const uint8_t *last = end - stride;
+    size_t confirm = sync_confirm_packets(ctx, stride);
+
+    // sync bytes are searched for where the following packet's sync byte is
+    // still inside the data.
+    const uint8_t *sync = ptr + offset;
+    while(sync < last) {
+        const uint8_t *candidate = find_sync_pair(sync, last, stride);
+        if(candidate == NULL) {
+            break;
+        }
+        // the pair confirmed one packet, check the rest that are available.
+        const uint8_t *next = candidate + 2 * stride;
+        size_t k = 1;
+        while(k < confirm && next < end && *next == TSD_SYNC_BYTE) {
+            next += stride;
+            k++;
+        }
+        if(k == confirm || (next >= end && flush)) {
+            *pos = candidate - offset;
+            return 1;
+        }
+        if(next >= end) {
+            *pos = candidate - offset;
+            return 0;
+        }
+        sync = candidate + 1;
+    }
+
+    // a packet on its own can't be confirmed, it is only accepted at the end
+    // of the stream.
+    if(flush && last >= ptr && last[offset] == TSD_SYNC_BYTE) {
+        *pos = last;
+        return 1;
+    }
+    if((size_t)(last - ptr) > offset) {
+        ptr = last - offset;
+    }
+    while(ptr <= last && ptr[offset] != TSD_SYNC_BYTE) {
+        ptr++;
+    }
+    *pos = ptr;
+    return 0;
+}
+
+// memory of the context goes through the allocator when one is set, otherwise
+// through the plain function pointers.
+void *mem_malloc(TSDemuxContext *ctx, size_t size)
+{
+    if(ctx->allocator.malloc) {
+        return ctx->allocator.malloc(ctx->allocator.user, size);
+    }
+    return ctx->malloc(size);
+}
+
+void *mem_calloc(TSDemuxContext *ctx, size_t num, size_t size)
+{
+    if(ctx->allocator.calloc) {
+        return ctx->allocator.calloc(ctx->allocator.user, num, size);
+    }
+    return ctx->calloc(num, size);
+}
+
+void *mem_realloc(TSDemuxContext *ctx, void *ptr, size_t size)
+{
+    if(ctx->allocator.realloc) {
+        return ctx->allocator.realloc(ctx->allocator.user, ptr, size);
+    }
+    return ctx->realloc(ptr, size);
+}
+
+void mem_free(TSDemuxContext *ctx, void *mem)
+{
+    if(ctx->allocator.free) {
+        ctx->allocator.free(ctx->allocator.user, mem);
+    } else {
+        ctx->free(mem);
+    }
+}
+
+TSDCode tsd_set_allocator(TSDemuxContext *ctx, const TSDAllocator *allocator)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(allocator == NULL) {
+        memset(&ctx->allocator, 0, sizeof(TSDAllocator));
+        return TSD_OK;
+    }
+    if(!allocator->malloc || !allocator->calloc ||
+       !allocator->realloc || !allocator->free) {
+        return TSD_INVALID_ARGUMENT;
+    }
+    ctx->allocator = *allocator;
+    return TSD_OK;
+}
+
+// every arena block is preceded by its size, padded so that the data stays
+// aligned.
+#define TSD_ARENA_HEADER_SIZE \
+    ((sizeof(size_t) + TSD_ARENA_ALIGNMENT - 1) & ~(size_t)(TSD_ARENA_ALIGNMENT - 1))
+
+TSDCode tsd_arena_init(TSDArena *arena, void *buffer, size_t size)
+{
+    if(arena == NULL)                   return TSD_INVALID_ARGUMENT;
+    if(buffer == NULL && size > 0)      return TSD_INVALID_ARGUMENT;
+
+    arena->buffer = (uint8_t*)buffer;
+    arena->size = size;
+    // skip ahead to the first aligned address of the region
+    size_t misalign = (size_t)((uintptr_t)buffer & (TSD_ARENA_ALIGNMENT - 1));
+    size_t skip = misalign ? TSD_ARENA_ALIGNMENT - misalign : 0;
+    if(skip > size) skip = size;
+    arena->buffer += skip;
+    arena->size -= skip;
+    return tsd_arena_reset(arena);
+}
+
+TSDCode tsd_arena_reset(TSDArena *arena)
+{
+    if(arena == NULL)   return TSD_INVALID_ARGUMENT;
+    arena->used = 0;
+    arena->last = (size_t)-1;
+    return TSD_OK;
+}
+
+void *arena_malloc(void *user, size_t size)
+{
+    TSDArena *arena = (TSDArena*)user;
+    size_t padded = (size + TSD_ARENA_ALIGNMENT - 1) &
+                    ~(size_t)(TSD_ARENA_ALIGNMENT - 1);
+    if(padded < size ||
+       arena->size - arena->used < TSD_ARENA_HEADER_SIZE ||
+       arena->size - arena->used - TSD_ARENA_HEADER_SIZE < padded) {
+        return NULL;
+    }
+    uint8_t *block = arena->buffer + arena->used;
+    memcpy(block, &size, sizeof(size_t));
+    arena->last = arena->used;
+    arena->used += TSD_ARENA_HEADER_SIZE + padded;
+    return block + TSD_ARENA_HEADER_SIZE;
+}
+
+void *arena_calloc(void *user, size_t num, size_t size)
+{
+    if(size != 0 && num > ((size_t)-1) / size) return NULL;
+    void *mem = arena_malloc(user, num * size);
+    if(mem) memset(mem, 0, num * size);
+    return mem;
+}
+
+void arena_free(void *user, void *mem)
+{
+    TSDArena *arena = (TSDArena*)user;
+    if(mem == NULL) return;
+    // only the most recent block can be given back
+    if((uint8_t*)mem == arena->buffer + arena->last + TSD_ARENA_HEADER_SIZE) {
+        arena->used = arena->last;
+        arena->last = (size_t)-1;
+    }
+}
+
+void *arena_realloc(void *user, void *ptr, size_t size)
+{
+    TSDArena *arena = (TSDArena*)user;
+    if(ptr == NULL) return arena_malloc(user, size);
+
+    uint8_t *header = (uint8_t*)ptr - TSD_ARENA_HEADER_SIZE;
+    size_t old_size;
+    memcpy(&old_size, header, sizeof(size_t));
+
+    // the most recent block grows or shrinks in place
+    if(header == arena->buffer + arena->last) {
+        size_t used = arena->used;
+        arena->used = arena->last;
+        void *mem = arena_malloc(user, size);
+        if(!mem) arena->used = used;
+        return mem;
+    }
+    if(size <= old_size) {
+        return ptr;
+    }
+    void *mem = arena_malloc(user, size);
+    if(mem) memcpy(mem, ptr, old_size);
+    return mem;
+}
+
+TSDCode tsd_arena_allocator(TSDArena *arena, TSDAllocator *allocator)
+{
+    if(arena == NULL || allocator == NULL)  return TSD_INVALID_ARGUMENT;
+    allocator->malloc = arena_malloc;
+    allocator->calloc = arena_calloc;
+    allocator->realloc = arena_realloc;
+    allocator->free = arena_free;
+    allocator->user = arena;
+    return TSD_OK;
+}
+
 const char* tsd_get_version(void)
 {
     return TSD_VERSION;
@@ -82,12 +652,29 @@ TSDCode tsd_context_init(TSDemuxContext *ctx)
     ctx->calloc = calloc;
     ctx->free = free;
 
+    ctx->sync.confirm_packets = TSD_SYNC_CONFIRM_PACKETS;
+    ctx->buffers.max_length = TSD_SECTION_BUFFERS_MAX;
+    ctx->table_cache.enabled = 1;
+
     // initialize the user defined event callback
     ctx->event_cb = (tsd_on_event) NULL;
 
     return TSD_OK;
 }
 
+void assembler_list_destroy(TSDemuxContext *ctx, TSDSectionAssembler *assembler)
+{
+    while(assembler) {
+        TSDSectionAssembler *next = assembler->next;
+        ctx->buffers.slots[assembler->slot] = NULL;
+        tsd_data_context_destroy(ctx, &assembler->data);
+        mem_free(ctx, assembler);
+        assembler = next;
+    }
+}
+
+void directory_destroy(TSDemuxContext *ctx);
+
 TSDCode tsd_context_destroy(TSDemuxContext *ctx)
 {
     if(ctx == NULL) return TSD_INVALID_CONTEXT;
@@ -97,22 +684,44 @@ TSDCode tsd_context_destroy(TSDemuxContext *ctx)
     // destroyregistered pid list
     for(i=0; i<size; ++i) {
         tsd_data_context_destroy(ctx, ctx->registered_pids_data[i]);
-        ctx->free(ctx->registered_pids_data[i]);
+        mem_free(ctx, ctx->registered_pids_data[i]);
+        if(ctx->registered_pids[i].slices) {
+            mem_free(ctx, ctx->registered_pids[i].slices);
+        }
+    }
+    if(ctx->registered_pids) {
+        mem_free(ctx, ctx->registered_pids);
+    }
+    if(ctx->registered_pids_data) {
+        mem_free(ctx, ctx->registered_pids_data);
     }
 
     // destroy data context buffer pool
-    size = ctx->buffers.length;
-    for(i=0; i<size; ++i) {
-        tsd_data_context_destroy(ctx, &ctx->buffers.pool[i]);
+    assembler_list_destroy(ctx, ctx->buffers.used);
+    assembler_list_destroy(ctx, ctx->buffers.free);
+    if(ctx->buffers.slots) {
+        mem_free(ctx, ctx->buffers.slots);
+    }
+
+    if(ctx->table_cache.entries) {
+        mem_free(ctx, ctx->table_cache.entries);
     }
-    if(size) {
-        ctx->free(ctx->buffers.pool);
+
+    if(ctx->section_filters.filters) {
+        mem_free(ctx, ctx->section_filters.filters);
     }
 
     // destroy PAT data
     if(ctx->pat.valid && ctx->pat.value.length > 0) {
-        ctx->free(ctx->pat.value.pid);
-        ctx->free(ctx->pat.value.program_number);
+        mem_free(ctx, ctx->pat.value.pid);
+        mem_free(ctx, ctx->pat.value.program_number);
+    }
+
+    directory_destroy(ctx);
+
+    // destroy the PID map
+    if(ctx->pid_map) {
+        mem_free(ctx, ctx->pid_map);
     }
 
     // clear everything
@@ -121,6 +730,52 @@ TSDCode tsd_context_destroy(TSDemuxContext *ctx)
     return TSD_OK;
 }
 
+TSDCode pid_map_create(TSDemuxContext *ctx)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(ctx->pid_map)    return TSD_OK;
+
+    ctx->pid_map = (TSDPIDRoute*) mem_calloc(ctx, TSD_PID_MAP_SIZE,
+                   sizeof(TSDPIDRoute));
+    if(!ctx->pid_map) return TSD_OUT_OF_MEMORY;
+
+    // the PSI PIDs are always routed
+    ctx->pid_map[TSD_PID_PAT].flags = TSD_ROUTE_PAT;
+    ctx->pid_map[TSD_PID_CAT].flags = TSD_ROUTE_CAT;
+    ctx->pid_map[TSD_PID_TSDT].flags = TSD_ROUTE_TSDT;
+
+    // routes for PIDs registered before the map existed
+    size_t i;
+    for(i=0; i<ctx->registered_pids_length; ++i) {
+        TSDPIDRoute *route = &ctx->pid_map[ctx->registered_pids[i].pid];
+        route->flags |= TSD_ROUTE_REGISTERED;
+        route->index = (uint16_t)i;
+    }
+
+    return TSD_OK;
+}
+
+void pid_map_set_pmts(TSDemuxContext *ctx, const TSDPATData *pat, int set)
+{
+    if(!ctx->pid_map) return;
+
+    size_t i;
+    for(i=0; i<pat->length; ++i) {
+        uint16_t pid = pat->pid[i];
+        // program number 0 is the network PID, not a PMT
+        if(pat->program_number[i] == 0 ||
+           pid < TSD_PID_DATA_TABLES_START ||
+           pid > TSD_PID_RESERVED_FUTURE) {
+            continue;
+        }
+        if(set) {
+            ctx->pid_map[pid].flags |= TSD_ROUTE_PMT;
+        } else {
+            ctx->pid_map[pid].flags &= ~TSD_ROUTE_PMT;
+        }
+    }
+}
+
 TSDCode tsd_set_event_callback(TSDemuxContext *ctx, tsd_on_event callback)
 {
     if(ctx == NULL)     return TSD_INVALID_CONTEXT;
@@ -129,10 +784,69 @@ TSDCode tsd_set_event_callback(TSDemuxContext *ctx, tsd_on_event callback)
     return TSD_OK;
 }
 
+TSDCode parse_packet_header(TSDemuxContext *ctx,
+                            const uint8_t *data,
+                            size_t size,
+                            TSDPacket *hdr,
+                            int parse_af);
+
+TSDCode tsd_set_packet_size(TSDemuxContext *ctx, size_t packet_size)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(packet_size != 0 &&
+       packet_size != TSD_TSPACKET_SIZE &&
+       packet_size != TSD_M2TS_PACKET_SIZE &&
+       packet_size != TSD_RS_PACKET_SIZE) {
+        return TSD_INVALID_ARGUMENT;
+    }
+    ctx->packet_size = packet_size;
+    // look for sync again with the new packet size
+    ctx->sync.packet_size = 0;
+    ctx->sync.locked = 0;
+    ctx->carry.length = 0;
+    return TSD_OK;
+}
+
+TSDCode tsd_set_section_buffer_limit(TSDemuxContext *ctx, size_t max_length)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    // the PID map holds the slot of an assembler in 16 bits
+    if(max_length == 0 || max_length > UINT16_MAX) return TSD_INVALID_ARGUMENT;
+
+    ctx->buffers.max_length = max_length;
+    // free buffers we no longer keep, used ones go once they are released
+    while(ctx->buffers.length > max_length && ctx->buffers.free) {
+        TSDSectionAssembler *assembler = ctx->buffers.free;
+        ctx->buffers.free = assembler->next;
+        assembler->next = NULL;
+        assembler_list_destroy(ctx, assembler);
+        ctx->buffers.length--;
+    }
+    return TSD_OK;
+}
+
+TSDCode tsd_set_table_cache(TSDemuxContext *ctx, int enabled)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    ctx->table_cache.enabled = enabled ? 1 : 0;
+    return TSD_OK;
+}
+
 TSDCode tsd_parse_packet_header(TSDemuxContext *ctx,
                                 const uint8_t *data,
                                 size_t size,
                                 TSDPacket *hdr)
+{
+    return parse_packet_header(ctx, data, size, hdr, 1);
+}
+
+// when parse_af is 0 only the length and flags of the adaptation field are
+// read, the rest of hdr->adaptation_field is left as it was.
+TSDCode parse_packet_header(TSDemuxContext *ctx,
+                            const uint8_t *data,
+                            size_t size,
+                            TSDPacket *hdr,
+                            int parse_af)
 {
     if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
     if(data == NULL)                return TSD_INVALID_DATA;
@@ -162,17 +876,29 @@ TSDCode tsd_parse_packet_header(TSDemuxContext *ctx,
     if(hdr->adaptation_field_control == TSD_AFC_ADAP_FIELD_AND_PAYLOAD ||
        hdr->adaptation_field_control == TSD_AFC_ADAP_FIELD_ONLY) {
 
-        TSDCode res = tsd_parse_adaptation_field(ctx, ptr, size-4,
-                      &hdr->adaptation_field);
-
-        if(res != TSD_OK) return res;
+        if(parse_af) {
+            TSDCode res = tsd_parse_adaptation_field(ctx, ptr, size-4,
+                          &hdr->adaptation_field);
+            if(res != TSD_OK) return res;
+        } else {
+            hdr->adaptation_field.adaptation_field_length = *ptr;
+            if(*ptr > TSD_TSPACKET_SIZE - 5) {
+                return TSD_PARSE_ERROR;
+            }
+            hdr->adaptation_field.flags = *ptr > 0 ? ptr[1] : 0;
+        }
 
         if(end < &ptr[hdr->adaptation_field.adaptation_field_length]) {
             return TSD_INVALID_DATA_SIZE;
         };
         ptr = &ptr[hdr->adaptation_field.adaptation_field_length + 1];
     } else {
-        memset(&hdr->adaptation_field, 0, sizeof(TSDAdaptationField));
+        if(parse_af) {
+            memset(&hdr->adaptation_field, 0, sizeof(TSDAdaptationField));
+        } else {
+            hdr->adaptation_field.adaptation_field_length = 0;
+            hdr->adaptation_field.flags = 0;
+        }
     }
 
     // is there a payload in this packet?
@@ -196,18 +922,199 @@ TSDCode tsd_parse_packet_header(TSDemuxContext *ctx,
     return TSD_OK;
 }
 
-TSDCode tsd_parse_adaptation_field(TSDemuxContext *ctx,
-                                   const uint8_t *data,
-                                   size_t size,
-                                   TSDAdaptationField *adap)
+uint64_t parse_pcr(const uint8_t *bytes)
 {
-    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
-    if(data == NULL)                return TSD_INVALID_DATA;
-    if(size == 0)                   return TSD_INVALID_DATA_SIZE;
-    if(adap == NULL)                return TSD_INVALID_ARGUMENT;
+    uint64_t val = parse_u64(bytes);
+    uint64_t base = (val >> 31) & 0x1FFFFFFFFL;
+    uint64_t ext = (val >> 16) & 0x1FFL;
+    return base * 300 + ext;
+}
 
-    const uint8_t *ptr = data;
-    const uint8_t *end = &ptr[size];
+// The parse_headers kernels decode the headers of packets [i, n) and return
+// the index of the first packet without a sync byte, or n.
+size_t parse_headers_scalar(const uint8_t *data,
+                            size_t stride,
+                            size_t i,
+                            size_t n,
+                            TSDPacketHeaders *headers)
+{
+    for(; i<n; ++i) {
+        const uint8_t *ptr = &data[i * stride];
+        if(ptr[0] != TSD_SYNC_BYTE) {
+            break;
+        }
+        uint8_t flags = ptr[1] >> 5;
+        uint8_t afc = (ptr[3] >> 4) & 0x03;
+        uint8_t af_len = ptr[4];
+        size_t offset = TSD_TSPACKET_SIZE;
+        uint64_t pcr = 0;
+
+        // bit 0 of the adaptation_field_control signals a payload, bit 1 an
+        // adaptation field.
+        if(afc & 0x01) {
+            offset = (afc & 0x02) ? 5 + af_len : 4;
+            if(offset > TSD_TSPACKET_SIZE) {
+                offset = TSD_TSPACKET_SIZE;
+            }
+        }
+        if((afc & 0x02) && af_len >= 7 &&
+           (ptr[5] & TSD_AF_PCR_FLAG)) {
+            flags |= TSD_PF_PCR;
+            pcr = parse_pcr(&ptr[6]);
+        }
+
+        headers->pid[i] = parse_u16(&ptr[1]) & 0x1FFF;
+        headers->flags[i] = flags;
+        headers->continuity_counter[i] = ptr[3] & 0x0F;
+        headers->adaptation_field_control[i] = afc;
+        headers->payload_offset[i] = (uint8_t)offset;
+        if(headers->pcr) {
+            headers->pcr[i] = pcr;
+        }
+    }
+    return i;
+}
+
+#if defined(TSD_SIMD_AVX2)
+TSD_TARGET("avx2")
+void store_u16x8(uint16_t *dst, __m256i val)
+{
+    __m256i packed = _mm256_packus_epi32(val, val);
+    packed = _mm256_permute4x64_epi64(packed, 0x08);
+    _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(packed));
+}
+
+TSD_TARGET("avx2")
+void store_u8x8(uint8_t *dst, __m256i val)
+{
+    __m256i packed = _mm256_packus_epi32(val, val);
+    packed = _mm256_packus_epi16(packed, packed);
+    packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+    _mm_storel_epi64((__m128i*)dst, _mm256_castsi256_si128(packed));
+}
+
+// gathers the first 8 bytes of 8 packets at a time.
+TSD_TARGET("avx2")
+size_t parse_headers_avx2(const uint8_t *data,
+                          size_t stride,
+                          size_t i,
+                          size_t n,
+                          TSDPacketHeaders *headers)
+{
+    const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                          _mm256_set1_epi32((int)stride));
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+    const __m256i sync = _mm256_set1_epi32(TSD_SYNC_BYTE);
+    const __m256i packet_size = _mm256_set1_epi32(TSD_TSPACKET_SIZE);
+
+    for(; i + 8 <= n; i += 8) {
+        const uint8_t *base = &data[i * stride];
+        __m256i hdr = _mm256_i32gather_epi32((const int*)base, index, 1);
+        __m256i adap = _mm256_i32gather_epi32((const int*)(base + 4), index, 1);
+
+        __m256i sync_byte = _mm256_and_si256(hdr, byte_mask);
+        if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(sync_byte, sync)) != -1) {
+            break;
+        }
+
+        // the bytes are in little endian order within each lane
+        __m256i b1 = _mm256_and_si256(_mm256_srli_epi32(hdr, 8), byte_mask);
+        __m256i b2 = _mm256_and_si256(_mm256_srli_epi32(hdr, 16), byte_mask);
+        __m256i b3 = _mm256_srli_epi32(hdr, 24);
+        __m256i af_len = _mm256_and_si256(adap, byte_mask);
+        __m256i af_flags = _mm256_and_si256(_mm256_srli_epi32(adap, 8), byte_mask);
+
+        __m256i pid = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(b1,
+                                      _mm256_set1_epi32(0x1F)), 8), b2);
+        __m256i flags = _mm256_srli_epi32(b1, 5);
+        __m256i cc = _mm256_and_si256(b3, _mm256_set1_epi32(0x0F));
+        __m256i afc = _mm256_and_si256(_mm256_srli_epi32(b3, 4), _mm256_set1_epi32(0x03));
+
+        __m256i zero = _mm256_setzero_si256();
+        __m256i has_af = _mm256_cmpgt_epi32(_mm256_and_si256(afc,
+                                            _mm256_set1_epi32(0x02)), zero);
+        __m256i has_payload = _mm256_cmpgt_epi32(_mm256_and_si256(afc,
+                              _mm256_set1_epi32(0x01)), zero);
+
+        __m256i offset = _mm256_blendv_epi8(_mm256_set1_epi32(4),
+                                            _mm256_add_epi32(af_len, _mm256_set1_epi32(5)), has_af);
+        offset = _mm256_min_epi32(offset, packet_size);
+        offset = _mm256_blendv_epi8(packet_size, offset, has_payload);
+
+        __m256i has_pcr = _mm256_and_si256(has_af,
+                                           _mm256_cmpgt_epi32(af_len, _mm256_set1_epi32(6)));
+        has_pcr = _mm256_and_si256(has_pcr, _mm256_cmpgt_epi32(_mm256_and_si256(af_flags,
+                                   _mm256_set1_epi32(TSD_AF_PCR_FLAG)), zero));
+        flags = _mm256_or_si256(flags, _mm256_and_si256(has_pcr, _mm256_set1_epi32(TSD_PF_PCR)));
+
+        store_u16x8(&headers->pid[i], pid);
+        store_u8x8(&headers->flags[i], flags);
+        store_u8x8(&headers->continuity_counter[i], cc);
+        store_u8x8(&headers->adaptation_field_control[i], afc);
+        store_u8x8(&headers->payload_offset[i], offset);
+
+        if(headers->pcr) {
+            int pcr_mask = _mm256_movemask_ps(_mm256_castsi256_ps(has_pcr));
+            int k;
+            for(k=0; k<8; ++k) {
+                headers->pcr[i + k] = (pcr_mask & (1 << k)) ?
+                                      parse_pcr(&base[k * stride + 6]) : 0;
+            }
+        }
+    }
+    return parse_headers_scalar(data, stride, i, n, headers);
+}
+#endif
+
+TSDCode tsd_parse_packet_headers_batch(TSDemuxContext *ctx,
+                                       const uint8_t *data,
+                                       size_t size,
+                                       TSDPacketHeaders *headers,
+                                       size_t *count)
+{
+    if(count != NULL) *count = 0;
+
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(data == NULL)        return TSD_INVALID_DATA;
+    if(headers == NULL || count == NULL ||
+       headers->pid == NULL || headers->flags == NULL ||
+       headers->continuity_counter == NULL ||
+       headers->adaptation_field_control == NULL ||
+       headers->payload_offset == NULL) {
+        return TSD_INVALID_ARGUMENT;
+    }
+
+    size_t stride = ctx->packet_size ? ctx->packet_size : ctx->sync.packet_size;
+    if(stride == 0) {
+        stride = TSD_TSPACKET_SIZE;
+    }
+    size_t offset = packet_sync_offset(stride);
+    if(size < offset + TSD_TSPACKET_SIZE) {
+        return TSD_INVALID_DATA_SIZE;
+    }
+
+    // the last packet only needs its TS packet, not any trailing parity
+    size_t n = (size - offset - TSD_TSPACKET_SIZE) / stride + 1;
+    if(n > headers->capacity) {
+        n = headers->capacity;
+    }
+
+    *count = kernels()->parse_headers(data + offset, stride, 0, n, headers);
+    return *count == n ? TSD_OK : TSD_INVALID_SYNC_BYTE;
+}
+
+TSDCode tsd_parse_adaptation_field(TSDemuxContext *ctx,
+                                   const uint8_t *data,
+                                   size_t size,
+                                   TSDAdaptationField *adap)
+{
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(data == NULL)                return TSD_INVALID_DATA;
+    if(size == 0)                   return TSD_INVALID_DATA_SIZE;
+    if(adap == NULL)                return TSD_INVALID_ARGUMENT;
+
+    const uint8_t *ptr = data;
+    const uint8_t *end = &ptr[size];
 
     if(ptr+1 > end) return TSD_INVALID_DATA_SIZE;
 
@@ -296,1141 +1203,3224 @@ TSDCode tsd_parse_adaptation_field(TSDemuxContext *ctx,
     return TSD_OK;
 }
 
-TSDCode get_data_context(TSDemuxContext *ctx,
-                         uint8_t table_id,
-                         uint16_t table_ext,
-                         uint8_t version,
-                         TSDDataContext **context)
+// id of an assembler holding the start of a section whose header hasn't
+// arrived in full. Never a real table, version_number is at most 0x1F.
+#define TSD_SECTION_ID_UNKNOWN      (0xFFFFFFFF)
+
+// creates a 32-bit Id for the table a section belongs to. Short form sections
+// have no table_id_extension or version_number, 0x80 keeps their Ids apart
+// from the long form ones.
+uint32_t section_id(const uint8_t *section)
 {
-    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
-    if(context == NULL)     return TSD_INVALID_ARGUMENT;
+    if(!(section[1] & 0x80)) {
+        return (((uint32_t)section[0]) << 24) | 0x80;
+    }
+    return (((uint32_t)section[0]) << 24) |
+           (((uint32_t)parse_u16(&section[3])) << 8) |
+           ((uint32_t)((section[5] >> 1) & 0x1F));
+}
 
-    // create a 32-bit Id for this table
-    uint32_t id = (((uint32_t)table_id) << 24) |
-                  (((uint32_t)table_ext) << 8) |
-                  ((uint32_t)version);
+// the newest assembler in use on pid, the others follow through pid_next.
+TSDSectionAssembler *pid_assemblers(TSDemuxContext *ctx, uint16_t pid)
+{
+    if(!ctx->pid_map || ctx->pid_map[pid].assembler == 0) {
+        return NULL;
+    }
+    return ctx->buffers.slots[ctx->pid_map[pid].assembler - 1];
+}
 
-    // go through the DataContexts already Available and see if we have a match
-    size_t i=0;
-    for(; i<ctx->buffers.length; ++i) {
-        if(ctx->buffers.pool[i].id == id) {
-            // found a matching TSDDataContext
-            *context = &ctx->buffers.pool[i];
-            return TSD_OK;
+// the assembler collecting the table id on pid, or NULL.
+TSDSectionAssembler *find_assembler(TSDemuxContext *ctx, uint16_t pid, uint32_t id)
+{
+    TSDSectionAssembler *assembler = pid_assemblers(ctx, pid);
+    for(; assembler; assembler = assembler->pid_next) {
+        if(assembler->data.id == id) {
+            return assembler;
         }
     }
+    return NULL;
+}
 
-    // we'll need to find the active buffer if one is set
-    int active_idx = -1;
-    if(ctx->buffers.active) {
-        for(i=0; i<ctx->buffers.length; ++i) {
-            if(ctx->buffers.pool[i].id == ctx->buffers.active->id) {
-                active_idx = (int)i;
-                break;
-            }
+// number of bytes of the section being assembled received so far.
+size_t assembler_pending(const TSDSectionAssembler *assembler)
+{
+    return (size_t)(assembler->data.write - assembler->data.buffer) -
+           assembler->complete;
+}
+
+// the assembler on pid part way through a section, or NULL.
+TSDSectionAssembler *assembler_in_progress(TSDemuxContext *ctx, uint16_t pid)
+{
+    TSDSectionAssembler *assembler = pid_assemblers(ctx, pid);
+    for(; assembler; assembler = assembler->pid_next) {
+        if(assembler->skip > 0 || assembler_pending(assembler) > 0) {
+            return assembler;
         }
     }
+    return NULL;
+}
+
+void assembler_reset(TSDemuxContext *ctx, TSDSectionAssembler *assembler)
+{
+    tsd_data_context_reset(ctx, &assembler->data);
+    assembler->last_section_number = 0;
+    memset(assembler->received, 0, sizeof(assembler->received));
+    assembler->complete = 0;
+    assembler->skip = 0;
+}
 
-    // we didn't find a TSDDataContext, create a new one and add it to the Pool
-    TSDDataContext *dataCtx = NULL;
-    size_t len = ctx->buffers.length + 1;
-    if(len == 1) {
-        dataCtx = (TSDDataContext*) ctx->malloc(sizeof(TSDDataContext));
+// takes an assembler off the used list and its PID's chain. Returns 0 when it
+// wasn't in use.
+int assembler_unlink(TSDemuxContext *ctx, TSDSectionAssembler *assembler)
+{
+    TSDPIDRoute *route = &ctx->pid_map[assembler->pid];
+    TSDSectionAssembler *head = pid_assemblers(ctx, assembler->pid);
+    if(head == assembler) {
+        route->assembler = assembler->pid_next ? assembler->pid_next->slot + 1 : 0;
     } else {
-        size_t size = sizeof(TSDDataContext) * len;
-        dataCtx = (TSDDataContext*) ctx->realloc(ctx->buffers.pool, size);
+        while(head && head->pid_next != assembler) {
+            head = head->pid_next;
+        }
+        if(head == NULL) {
+            return 0;
+        }
+        head->pid_next = assembler->pid_next;
     }
+    assembler->pid_next = NULL;
 
-    if(!dataCtx) {
-        return TSD_OUT_OF_MEMORY;
+    if(assembler->prev) {
+        assembler->prev->next = assembler->next;
+    } else {
+        ctx->buffers.used = assembler->next;
     }
-    ctx->buffers.pool = dataCtx;
-    ctx->buffers.length = len;
-    // reassign the active buffer if it was previously set
-    if(active_idx >= 0) {
-        ctx->buffers.active = &ctx->buffers.pool[active_idx];
+    if(assembler->next) {
+        assembler->next->prev = assembler->prev;
     }
-
-    // initialize the TSDDataContext
-    TSDCode res = tsd_data_context_init(ctx, &(dataCtx[len-1]));
-    *context = dataCtx;
-    return res;
+    assembler->prev = NULL;
+    assembler->next = NULL;
+    return 1;
 }
 
-TSDCode tsd_parse_table(TSDemuxContext *ctx,
-                        TSDPacket *pkt,
-                        TSDTable *table)
+// returns an assembler to the free list once its table is complete.
+void release_assembler(TSDemuxContext *ctx, TSDSectionAssembler *assembler)
 {
-    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
-    if(pkt == NULL)                 return TSD_INVALID_ARGUMENT;
-    if(table == NULL)               return TSD_INVALID_ARGUMENT;
+    if(!assembler_unlink(ctx, assembler)) {
+        return;
+    }
 
-    TSDCode res;
+    // the data stays in place until the assembler is reused, a parsed table
+    // may still point into it.
+    assembler_reset(ctx, assembler);
+    assembler->next = ctx->buffers.free;
+    ctx->buffers.free = assembler;
+}
 
-    // payload data error handling.
-    if(pkt->data_bytes == NULL || pkt->data_bytes_length == 0) {
-        return TSD_INCOMPLETE_TABLE;
+// drops the section an assembler was part way through, and the assembler
+// itself when that was all it held.
+void assembler_drop_section(TSDemuxContext *ctx, TSDSectionAssembler *assembler)
+{
+    assembler->data.write = &assembler->data.buffer[assembler->complete];
+    assembler->skip = 0;
+    if(assembler->complete == 0) {
+        release_assembler(ctx, assembler);
     }
+}
 
-    // keep hold of the data location.
-    const uint8_t *ptr = pkt->data_bytes;
-    size_t ptr_len = pkt->data_bytes_length;
-
-    if(pkt->flags & TSD_PF_PAYLOAD_UNIT_START_IND) {
-        // there is a new table section somewhere in this packet.
-        // parse the pointer_field.
-        size_t pointer_field = *ptr;
-        if(pointer_field >= pkt->data_bytes_length - 6) {
-            return TSD_INVALID_POINTER_FIELD;
-        }
-        ptr = &ptr[pointer_field + 1];
-        ptr_len -= (pointer_field + 1);
-        // parse some of the table info so that we can find the TSDDataContext
-        // assoicated with this table.
-        uint8_t table_id = *ptr;
-        uint16_t table_ext = 0;
-        uint8_t version = 0;
-        if(ptr[1] & 0x80) {
-            table_ext = parse_u16(&ptr[3]);
-            version = (ptr[5] & 0x3E) >> 1;
-        }
-
-        // set the TSDDataContext for this table as active.
-        res = get_data_context(ctx,
-                               table_id,
-                               table_ext,
-                               version,
-                               &(ctx->buffers.active));
-        if(res != TSD_OK) {
-            return res;
+// a new version of a table replaces whatever was collected of the old one.
+void release_other_versions(TSDemuxContext *ctx, uint16_t pid, uint32_t id)
+{
+    TSDSectionAssembler *next = pid_assemblers(ctx, pid);
+    while(next) {
+        TSDSectionAssembler *assembler = next;
+        next = next->pid_next;
+        if(assembler->data.id != id &&
+           (assembler->data.id & 0xFFFFFF00) == (id & 0xFFFFFF00)) {
+            release_assembler(ctx, assembler);
         }
+    }
+}
 
-    } else {
-        // if we don't already have an active buffer this must be old table data
-        // that we aren't prepared to parse
-        if(ctx->buffers.active == NULL) {
-            return TSD_INCOMPLETE_TABLE;
+// gives a new assembler the first free slot.
+TSDCode assembler_slot(TSDemuxContext *ctx, TSDSectionAssembler *assembler)
+{
+    size_t slot = 0;
+    while(slot < ctx->buffers.slots_capacity && ctx->buffers.slots[slot]) {
+        slot++;
+    }
+    if(slot == ctx->buffers.slots_capacity) {
+        size_t capacity = slot > 0 ? slot * 2 : TSD_SECTION_BUFFERS_MAX;
+        if(capacity > UINT16_MAX) {
+            capacity = UINT16_MAX;
+        }
+        TSDSectionAssembler **slots = (TSDSectionAssembler**) mem_realloc(ctx,
+            ctx->buffers.slots, capacity * sizeof(TSDSectionAssembler*));
+        if(!slots) {
+            return TSD_OUT_OF_MEMORY;
         }
+        memset(&slots[slot], 0, (capacity - slot) * sizeof(TSDSectionAssembler*));
+        ctx->buffers.slots = slots;
+        ctx->buffers.slots_capacity = capacity;
+        ctx->buffers.pool_allocations++;
     }
+    ctx->buffers.slots[slot] = assembler;
+    assembler->slot = (uint16_t)slot;
+    return TSD_OK;
+}
+
+// finds or sets up the assembler of the table id on pid.
+TSDCode get_assembler(TSDemuxContext *ctx,
+                      uint16_t pid,
+                      uint32_t id,
+                      TSDSectionAssembler **out)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(out == NULL)         return TSD_INVALID_ARGUMENT;
 
-    TSDDataContext *dataCtx = ctx->buffers.active;
-    // write the data into our buffer
-    res = tsd_data_context_write(ctx, dataCtx, ptr, ptr_len);
+    // assemblers are found through the PID map, tsd_parse_table may be used
+    // without ever calling tsd_demux.
+    TSDCode res = pid_map_create(ctx);
     if(res != TSD_OK) {
         return res;
     }
 
-    // has the table completed yet? We'll need enough data to see the section
-    // length to figure that out.
-    ptr = dataCtx->buffer;
-    int section_count = 0;
-
-    while(ptr < dataCtx->write) {
-        uint16_t section_len = parse_u16(ptr+1);
-        section_len &= 0x0FFF;
-        ptr += section_len + 3;
-        section_count++;
-
-        if((ptr <= dataCtx->write) && ((*(ptr+1) == 0xFF) || (0x00 == *(ptr+1)))) {
-            // create and parse the sections.
-            table->length = section_count;
-            table->sections = (TSDTableSection*) ctx->calloc(section_count,
-                              sizeof(TSDTableSection));
+    TSDSectionAssembler *assembler = find_assembler(ctx, pid, id);
+    if(assembler) {
+        *out = assembler;
+        return TSD_OK;
+    }
 
-            if(!table->sections) return TSD_OUT_OF_MEMORY;
+    if(id != TSD_SECTION_ID_UNKNOWN) {
+        release_other_versions(ctx, pid, id);
+    }
 
-            // parse the table sections
-            res = tsd_parse_table_sections(ctx,
-                                           dataCtx->buffer,
-                                           dataCtx->write - dataCtx->buffer,
-                                           table);
+    // free assemblers beyond the limit once nothing refers to them
+    while(ctx->buffers.length > ctx->buffers.max_length && ctx->buffers.free) {
+        assembler = ctx->buffers.free;
+        ctx->buffers.free = assembler->next;
+        assembler->next = NULL;
+        assembler_list_destroy(ctx, assembler);
+        ctx->buffers.length--;
+    }
 
+    if(ctx->buffers.free) {
+        // reuse a free assembler
+        assembler = ctx->buffers.free;
+        ctx->buffers.free = assembler->next;
+    } else if(ctx->buffers.length < ctx->buffers.max_length ||
+              ctx->buffers.used == NULL) {
+        // grow the pool
+        assembler = (TSDSectionAssembler*) mem_malloc(ctx, sizeof(TSDSectionAssembler));
+        if(!assembler) {
+            return TSD_OUT_OF_MEMORY;
+        }
+        res = tsd_data_context_init(ctx, &assembler->data);
+        if(res == TSD_OK) {
+            res = assembler_slot(ctx, assembler);
             if(res != TSD_OK) {
-                tsd_table_data_destroy(ctx, table);
-                if(res == TSD_INVALID_DATA_SIZE) {
-                    res = TSD_INCOMPLETE_TABLE;
-                }
-            } else {
-                // we found the end of the table,
-                // clear the active buffer seeing as we've finished with the table
-                ctx->buffers.active = NULL;
+                tsd_data_context_destroy(ctx, &assembler->data);
             }
+        }
+        if(res != TSD_OK) {
+            mem_free(ctx, assembler);
             return res;
         }
+        ctx->buffers.length++;
+        ctx->buffers.pool_allocations += 2;
+    } else {
+        // the pool is full, drop the oldest partial table
+        assembler = ctx->buffers.used;
+        while(assembler->next) {
+            assembler = assembler->next;
+        }
+        assembler_unlink(ctx, assembler);
+        ctx->stats.section_evictions++;
     }
 
-    return TSD_INCOMPLETE_TABLE;
+    assembler_reset(ctx, assembler);
+    assembler->pid = pid;
+    assembler->data.id = id;
+    assembler->prev = NULL;
+    assembler->next = ctx->buffers.used;
+    if(ctx->buffers.used) {
+        ctx->buffers.used->prev = assembler;
+    }
+    ctx->buffers.used = assembler;
+    TSDSectionAssembler *head = pid_assemblers(ctx, pid);
+    assembler->pid_next = head;
+    ctx->pid_map[pid].assembler = (uint16_t)(assembler->slot + 1);
+    *out = assembler;
+    return TSD_OK;
 }
 
-TSDCode tsd_parse_table_sections(TSDemuxContext *ctx,
-                                 uint8_t *data,
-                                 size_t size,
-                                 TSDTable *table)
+TSDCode assembler_write(TSDemuxContext *ctx,
+                        TSDSectionAssembler *assembler,
+                        const uint8_t *data,
+                        size_t size)
 {
-    if(ctx == NULL)             return TSD_INVALID_CONTEXT;
-    if(data == NULL)            return TSD_INVALID_DATA;
-    if(size == 0)               return TSD_INVALID_DATA_SIZE;
-    if(table == NULL)            return TSD_INVALID_ARGUMENT;
-
-    uint8_t *ptr = data;
-    uint8_t *end = &data[size];
-    size_t i;
-
-    for(i=0; i < table->length; ++i) {
-        // make sure we have enough data to parse the table info
-        if((size_t)(end - ptr) < 3) {
-            return TSD_INVALID_DATA_SIZE;
-        }
-        TSDTableSection *section = &(table->sections[i]);
-        section->table_id = *ptr;
-        ptr++;
-        // section syntax indicator and private indicator
-        section->flags = (int)(((*ptr) >> 6) & 0x03);
-        section->section_length = parse_u16(ptr) & 0x0FFF;
-        ptr+=2;
-        if(&ptr[section->section_length] > end) {
-            return TSD_INVALID_DATA_SIZE;
-        }
-        // are we dealing with a long form or short form table?
-        if(section->flags & TSD_TBL_SECTION_SYNTAX_INDICATOR) {
-            // long form table properties
-            // Note that the table_id_extension could be PAT, CAT or PMT data.
-            // make sure we have enough data, and that the section length is
-            // long enought to parse the table info.
-            if((size_t)(end - ptr) < 9 || section->section_length < 9) {
-                return TSD_INVALID_DATA_SIZE;
-            }
-            section->table_id_extension = parse_u16(ptr);
-            section->version_number = ((*(ptr+2)) >> 1) & 0x1F;
-            // current next indicator
-            section->flags |= ((*(ptr+2)) & 0x01) << 2;
-            section->section_number = *(ptr+3);
-            section->last_section_number = *(ptr+4);
-            section->section_data = ptr+5;
-            section->crc_32 = parse_u32(&ptr[section->section_length - 4]);
-            // the crc32 is not counted in the data
-            section->section_data_length = section->section_length - 9;
-        } else {
-            // set everything to zero for short form
-            section->table_id_extension = 0;
-            section->version_number = 0;
-            section->section_number = 0;
-            section->last_section_number = 0;
-            section->crc_32 = 0;
-            section->section_data = ptr;
-            section->section_data_length = section->section_length;
-        }
-
-        ptr += section->section_length;
+    size_t buffer_size = assembler->data.size;
+    TSDCode res = tsd_data_context_write(ctx, &assembler->data, data, size);
+    if(res == TSD_OK && assembler->data.size != buffer_size) {
+        ctx->buffers.pool_allocations++;
     }
-
-    return TSD_OK;
+    return res;
 }
 
-TSDCode tsd_parse_pat(TSDemuxContext *ctx,
-                      const uint8_t *data,
-                      size_t size,
-                      TSDPATData *pat)
+int assembler_has_section(const TSDSectionAssembler *assembler, uint8_t number)
 {
-    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
-    if(data == NULL)                return TSD_INVALID_DATA;
-    if(size < 4)                    return TSD_INVALID_DATA_SIZE;
-    if(pat == NULL)                 return TSD_INVALID_ARGUMENT;
-
-    size_t count = size / 4;
-    size_t new_length = pat->length + count;
-    uint16_t *pid_data = NULL;
-    uint16_t *prog_data = NULL;
-
-    if(pat->length) {
-        pid_data = (uint16_t*)ctx->realloc(pat->pid,
-                                           new_length * sizeof(uint16_t));
-        prog_data = (uint16_t*)ctx->realloc(pat->program_number,
-                                            new_length * sizeof(uint16_t));
-    } else {
-        pid_data = (uint16_t*)ctx->malloc(new_length * sizeof(uint16_t));
-        prog_data = (uint16_t*)ctx->malloc(new_length *sizeof(uint16_t));
-    }
+    return (assembler->received[number >> 5] >> (number & 0x1F)) & 0x01;
+}
 
-    if(!pid_data || !prog_data) {
-        if(prog_data) ctx->free(prog_data);
-        if(pid_data) ctx->free(pid_data);
-        return TSD_OUT_OF_MEMORY;
+// checks every section from 0 to last_section_number has been received.
+int assembler_complete(const TSDSectionAssembler *assembler)
+{
+    // a short form section is a table on its own
+    if(assembler->data.id & 0x80) {
+        return 1;
     }
-
+    size_t last = assembler->last_section_number;
     size_t i;
-    for(i=pat->length; i < new_length; ++i) {
-        prog_data[i] = parse_u16(data);
-        data += 2;
-        pid_data[i] = parse_u16(data) & 0x1FFF;
-        data += 2;
+    for(i=0; i < (last >> 5); ++i) {
+        if(assembler->received[i] != 0xFFFFFFFF) {
+            return 0;
+        }
     }
+    uint32_t mask = 0xFFFFFFFF >> (31 - (last & 0x1F));
+    return (assembler->received[last >> 5] & mask) == mask;
+}
 
-    pat->pid = pid_data;
-    pat->program_number = prog_data;
-    pat->length = new_length;
+// CRC-32/MPEG-2, polynomial 0x04C11DB7 processed MSB first with no final XOR.
+// The crc32 kernels continue a running crc over size bytes. Running one over a
+// whole section, CRC_32 included, gives 0 when the section is intact.
+#define TSD_CRC32_POLY      (0x04C11DB7)
 
-    return TSD_OK;
-}
+// filled in once by kernels_select(), before any kernel can read them.
+uint32_t crc32_tables[8][256];
+// x^n mod P pairs {x^n, x^(n+64)} used to fold 128 bit blocks n bits forward.
+uint64_t crc32_fold_128[2];
+uint64_t crc32_fold_512[2];
 
-TSDCode destroy_pat_data(TSDemuxContext *ctx, TSDPATData *pat)
+uint32_t crc32_xpow(size_t n)
 {
-    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
-    if(pat == NULL)     return TSD_INVALID_ARGUMENT;
-
-    if(pat->length > 0) {
-        ctx->free(pat->program_number);
-        ctx->free(pat->pid);
+    uint32_t r = 1;
+    while(n--) {
+        r = (r << 1) ^ ((r & 0x80000000) ? TSD_CRC32_POLY : 0);
     }
-    pat->length = 0;
-    pat->program_number = pat->pid = NULL;
-    return TSD_OK;
+    return r;
 }
 
-size_t descriptor_count(const uint8_t *ptr, size_t length)
+void crc32_init(void)
 {
-    // count the number of descriptors
-    const uint8_t *end = &ptr[length];
-    size_t count = 0;
-
-    while((ptr+2) <= end) {
-        ++count;
-        uint8_t desc_len = ptr[1];
-        if(desc_len > 0 && &ptr[2+desc_len] <= end) {
-            ptr = &ptr[2 + desc_len];
-        } else {
-            break;
+    uint32_t i;
+    int k;
+    for(i=0; i<256; ++i) {
+        uint32_t crc = i << 24;
+        for(k=0; k<8; ++k) {
+            crc = (crc << 1) ^ ((crc & 0x80000000) ? TSD_CRC32_POLY : 0);
         }
+        crc32_tables[0][i] = crc;
     }
-
-    return count;
+    // table k holds the byte k places before the end of an 8 byte block
+    for(k=1; k<8; ++k) {
+        for(i=0; i<256; ++i) {
+            uint32_t prev = crc32_tables[k-1][i];
+            crc32_tables[k][i] = (prev << 8) ^ crc32_tables[0][prev >> 24];
+        }
+    }
+    crc32_fold_128[0] = crc32_xpow(128);
+    crc32_fold_128[1] = crc32_xpow(192);
+    crc32_fold_512[0] = crc32_xpow(512);
+    crc32_fold_512[1] = crc32_xpow(576);
 }
 
-size_t parse_descriptor(const uint8_t* data,
-                        size_t size,
-                        TSDDescriptor *descriptors,
-                        size_t length)
+uint32_t crc32_slice8(uint32_t crc, const uint8_t *data, size_t size)
 {
-    TSDDescriptor *desc;
-    const uint8_t *ptr = data;
-    const uint8_t *end = &data[size];
-
-    size_t i=0;
-    for(; i < length && (ptr+2) < end; ++i) {
-        desc = &descriptors[i];
-        desc->tag = ptr[0];
-        desc->length = ptr[1];
-        // make sure we have enough data to correctly parse the descriptors
-        if(desc->length > 0 && &ptr[desc->length + 2] <= end) {
-            desc->data = ptr;
-            desc->data_length = desc->length + 2;
-            ptr = &ptr[desc->length + 2];
-        } else {
-            desc->data = NULL;
-            desc->data_length = 0;
-            desc->length = 0;
-            ptr = end;
-        }
+    const uint32_t (*t)[256] = crc32_tables;
+    while(size >= 8) {
+        uint32_t hi = crc ^ (((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+                             ((uint32_t)data[2] << 8) | (uint32_t)data[3]);
+        crc = t[7][hi >> 24] ^ t[6][(hi >> 16) & 0xFF] ^
+              t[5][(hi >> 8) & 0xFF] ^ t[4][hi & 0xFF] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        size -= 8;
     }
+    while(size--) {
+        crc = (crc << 8) ^ t[0][(crc >> 24) ^ *data++];
+    }
+    return crc;
+}
 
-    return (size_t)(ptr - data);
+// The carry-less kernels treat 16 bytes as a 128 bit polynomial, first byte
+// most significant, and fold blocks forward with the x^n mod P constants until
+// one block is left. That block and the tail are finished by the table kernel.
+#if defined(TSD_SIMD_PCLMUL)
+TSD_TARGET("pclmul,ssse3")
+__m128i crc32_fold_pclmul(__m128i a, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x11),
+                         _mm_clmulepi64_si128(a, k, 0x00));
 }
 
-TSDCode destroy_pmt_data(TSDemuxContext *ctx, TSDPMTData *pmt)
+TSD_TARGET("pclmul,ssse3")
+uint32_t crc32_pclmul(uint32_t crc, const uint8_t *data, size_t size)
 {
-    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
-    if(pmt == NULL)     return TSD_INVALID_ARGUMENT;
+    if(size < 64) {
+        return crc32_slice8(crc, data, size);
+    }
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+                                          7, 6, 5, 4, 3, 2, 1, 0);
+    const __m128i k128 = _mm_set_epi64x((long long)crc32_fold_128[1],
+                                        (long long)crc32_fold_128[0]);
+    const __m128i k512 = _mm_set_epi64x((long long)crc32_fold_512[1],
+                                        (long long)crc32_fold_512[0]);
+#define TSD_CRC_LOAD(p) _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p)), reverse)
+    __m128i x0 = TSD_CRC_LOAD(data);
+    __m128i x1 = TSD_CRC_LOAD(data + 16);
+    __m128i x2 = TSD_CRC_LOAD(data + 32);
+    __m128i x3 = TSD_CRC_LOAD(data + 48);
+    // the running crc applies to the first 4 bytes
+    x0 = _mm_xor_si128(x0, _mm_set_epi32((int)crc, 0, 0, 0));
+    data += 64;
+    size -= 64;
+
+    for(; size >= 64; data += 64, size -= 64) {
+        x0 = _mm_xor_si128(crc32_fold_pclmul(x0, k512), TSD_CRC_LOAD(data));
+        x1 = _mm_xor_si128(crc32_fold_pclmul(x1, k512), TSD_CRC_LOAD(data + 16));
+        x2 = _mm_xor_si128(crc32_fold_pclmul(x2, k512), TSD_CRC_LOAD(data + 32));
+        x3 = _mm_xor_si128(crc32_fold_pclmul(x3, k512), TSD_CRC_LOAD(data + 48));
+    }
+    x0 = _mm_xor_si128(crc32_fold_pclmul(x0, k128), x1);
+    x0 = _mm_xor_si128(crc32_fold_pclmul(x0, k128), x2);
+    x0 = _mm_xor_si128(crc32_fold_pclmul(x0, k128), x3);
+    for(; size >= 16; data += 16, size -= 16) {
+        x0 = _mm_xor_si128(crc32_fold_pclmul(x0, k128), TSD_CRC_LOAD(data));
+    }
+#undef TSD_CRC_LOAD
+
+    uint8_t block[16];
+    _mm_storeu_si128((__m128i*)block, _mm_shuffle_epi8(x0, reverse));
+    crc = crc32_slice8(0, block, sizeof(block));
+    return crc32_slice8(crc, data, size);
+}
+#endif
+
+#if defined(TSD_SIMD_PMULL)
+uint64x2_t crc32_load_pmull(const uint8_t *data)
+{
+    uint8x16_t v = vrev64q_u8(vld1q_u8(data));
+    return vreinterpretq_u64_u8(vextq_u8(v, v, 8));
+}
+
+uint64x2_t crc32_fold_pmull(uint64x2_t a, const uint64_t *k)
+{
+    poly128_t hi = vmull_p64((poly64_t)vgetq_lane_u64(a, 1), (poly64_t)k[1]);
+    poly128_t lo = vmull_p64((poly64_t)vgetq_lane_u64(a, 0), (poly64_t)k[0]);
+    return veorq_u64(vreinterpretq_u64_p128(hi), vreinterpretq_u64_p128(lo));
+}
+
+uint32_t crc32_pmull(uint32_t crc, const uint8_t *data, size_t size)
+{
+    if(size < 64) {
+        return crc32_slice8(crc, data, size);
+    }
+    uint64x2_t x0 = crc32_load_pmull(data);
+    uint64x2_t x1 = crc32_load_pmull(data + 16);
+    uint64x2_t x2 = crc32_load_pmull(data + 32);
+    uint64x2_t x3 = crc32_load_pmull(data + 48);
+    // the running crc applies to the first 4 bytes
+    x0 = veorq_u64(x0, vcombine_u64(vcreate_u64(0), vcreate_u64((uint64_t)crc << 32)));
+    data += 64;
+    size -= 64;
+
+    for(; size >= 64; data += 64, size -= 64) {
+        x0 = veorq_u64(crc32_fold_pmull(x0, crc32_fold_512), crc32_load_pmull(data));
+        x1 = veorq_u64(crc32_fold_pmull(x1, crc32_fold_512), crc32_load_pmull(data + 16));
+        x2 = veorq_u64(crc32_fold_pmull(x2, crc32_fold_512), crc32_load_pmull(data + 32));
+        x3 = veorq_u64(crc32_fold_pmull(x3, crc32_fold_512), crc32_load_pmull(data + 48));
+    }
+    x0 = veorq_u64(crc32_fold_pmull(x0, crc32_fold_128), x1);
+    x0 = veorq_u64(crc32_fold_pmull(x0, crc32_fold_128), x2);
+    x0 = veorq_u64(crc32_fold_pmull(x0, crc32_fold_128), x3);
+    for(; size >= 16; data += 16, size -= 16) {
+        x0 = veorq_u64(crc32_fold_pmull(x0, crc32_fold_128), crc32_load_pmull(data));
+    }
+
+    uint8_t block[16];
+    uint8x16_t v = vrev64q_u8(vreinterpretq_u8_u64(x0));
+    vst1q_u8(block, vextq_u8(v, v, 8));
+    crc = crc32_slice8(0, block, sizeof(block));
+    return crc32_slice8(crc, data, size);
+}
+#endif
+
+uint32_t crc32_mpeg2(uint32_t crc, const uint8_t *data, size_t size)
+{
+    return kernels()->crc32(crc, data, size);
+}
+
+TSDKernels kernels_selected;
+
+void kernels_select(void)
+{
+    int features = cpu_features();
+    TSDKernels *k = &kernels_selected;
+
+    k->find_sync_pair = find_sync_pair_scalar;
+#if defined(TSD_SIMD_SSE2)
+    if(features & TSD_CPU_SSE2) k->find_sync_pair = find_sync_pair_sse2;
+#endif
+#if defined(TSD_SIMD_AVX2)
+    if(features & TSD_CPU_AVX2) k->find_sync_pair = find_sync_pair_avx2;
+#endif
+#if defined(TSD_SIMD_NEON)
+    if(features & TSD_CPU_NEON) k->find_sync_pair = find_sync_pair_neon;
+#endif
+
+    k->find_start_code = find_start_code_scalar;
+#if defined(TSD_SIMD_SSE2)
+    if(features & TSD_CPU_SSE2) k->find_start_code = find_start_code_sse2;
+#endif
+#if defined(TSD_SIMD_AVX2)
+    if(features & TSD_CPU_AVX2) k->find_start_code = find_start_code_avx2;
+#endif
+#if defined(TSD_SIMD_NEON)
+    if(features & TSD_CPU_NEON) k->find_start_code = find_start_code_neon;
+#endif
+
+    k->parse_headers = parse_headers_scalar;
+#if defined(TSD_SIMD_AVX2)
+    if(features & TSD_CPU_AVX2) k->parse_headers = parse_headers_avx2;
+#endif
+
+    // the tables are filled in here so that no thread reads them early.
+    crc32_init();
+    k->crc32 = crc32_slice8;
+#if defined(TSD_SIMD_PCLMUL)
+    if(features & TSD_CPU_PCLMUL) k->crc32 = crc32_pclmul;
+#endif
+#if defined(TSD_SIMD_PMULL)
+    if(features & TSD_CPU_PMULL) k->crc32 = crc32_pmull;
+#endif
+    (void)features;
+}
+
+#if defined(TSD_ONCE_WIN32)
+BOOL CALLBACK kernels_select_once(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    (void)once;
+    (void)param;
+    (void)context;
+    kernels_select();
+    return TRUE;
+}
+#endif
+
+// selects the kernels for this CPU on first use. Every thread returns only
+// once the selection is complete and sees all of it.
+const TSDKernels *kernels(void)
+{
+#if defined(TSD_ONCE_PTHREAD)
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, kernels_select);
+#elif defined(TSD_ONCE_WIN32)
+    static INIT_ONCE once = INIT_ONCE_STATIC_INIT;
+    InitOnceExecuteOnce(&once, kernels_select_once, NULL, NULL);
+#else
+    // no threads to synchronize with
+    static int selected = 0;
+    if(!selected) {
+        kernels_select();
+        selected = 1;
+    }
+#endif
+    return &kernels_selected;
+}
+
+uint32_t tsd_crc32(const uint8_t *data, size_t size)
+{
+    if(data == NULL) return 0xFFFFFFFF;
+    return crc32_mpeg2(0xFFFFFFFF, data, size);
+}
+
+// sections can arrive in any order, each CRC_32 is rotated by its
+// section_number so the result doesn't depend on it.
+uint32_t table_cache_fold(uint32_t crc, uint32_t section_crc, uint8_t section_number)
+{
+    unsigned int n = section_number & 0x1F;
+    return crc ^ (n ? ((section_crc << n) | (section_crc >> (32 - n))) : section_crc);
+}
+
+TSDTableCacheEntry *table_cache_find(TSDemuxContext *ctx,
+                                     const TSDTableCacheEntry *key)
+{
+    size_t i;
+    for(i=0; i<ctx->table_cache.length; ++i) {
+        TSDTableCacheEntry *entry = &ctx->table_cache.entries[i];
+        if(entry->pid == key->pid &&
+           entry->table_id == key->table_id &&
+           entry->table_id_extension == key->table_id_extension) {
+            return entry;
+        }
+    }
+    return NULL;
+}
 
-    if(pmt->descriptors_length > 0) {
-        ctx->free(pmt->descriptors);
+// works out the cache entry of the raw sections of a complete table. Returns 0
+// for tables that can't be cached, short form sections carry no CRC.
+int table_cache_entry(uint16_t pid,
+                      const uint8_t *data,
+                      const uint8_t *end,
+                      int section_count,
+                      TSDTableCacheEntry *entry)
+{
+    memset(entry, 0, sizeof(TSDTableCacheEntry));
+    entry->pid = pid;
+    int i;
+    for(i=0; i<section_count; ++i) {
+        if(end - data < 8 || !(data[1] & 0x80)) {
+            return 0;
+        }
+        size_t len = (parse_u16(&data[1]) & 0x0FFF) + 3;
+        if(len < 12 || len > (size_t)(end - data)) {
+            return 0;
+        }
+        if(i == 0) {
+            entry->table_id = data[0];
+            entry->table_id_extension = parse_u16(&data[3]);
+            entry->version_number = (data[5] >> 1) & 0x1F;
+        }
+        entry->crc = table_cache_fold(entry->crc, parse_u32(&data[len - 4]), data[6]);
+        data += len;
+    }
+    return section_count > 0;
+}
+
+// remembers a table that has been delivered.
+TSDCode table_cache_store(TSDemuxContext *ctx, uint16_t pid, const TSDTable *table)
+{
+    TSDTableCacheEntry key;
+    memset(&key, 0, sizeof(key));
+    key.pid = pid;
+    size_t i;
+    for(i=0; i<table->length; ++i) {
+        const TSDTableSection *section = &table->sections[i];
+        if(!(section->flags & TSD_TBL_SECTION_SYNTAX_INDICATOR)) {
+            return TSD_OK;
+        }
+        key.crc = table_cache_fold(key.crc, section->crc_32, section->section_number);
     }
-    if(pmt->program_elements_length > 0) {
-        int size = pmt->program_elements_length;
-        int i = 0;
-        for(; i<size; ++i) {
-            TSDProgramElement *prog = &pmt->program_elements[i];
-            if(prog != NULL && prog->descriptors_length > 0) {
-                free(prog->descriptors);
+    if(table->length == 0) {
+        return TSD_OK;
+    }
+    key.table_id = table->sections[0].table_id;
+    key.table_id_extension = table->sections[0].table_id_extension;
+    key.version_number = table->sections[0].version_number;
+
+    TSDTableCacheEntry *entry = table_cache_find(ctx, &key);
+    if(entry == NULL) {
+        if(ctx->table_cache.length == ctx->table_cache.capacity) {
+            size_t capacity = ctx->table_cache.capacity * 2;
+            if(capacity == 0) {
+                capacity = TSD_TABLE_CACHE_INITIAL_CAPACITY;
             }
+            TSDTableCacheEntry *entries = (TSDTableCacheEntry*) mem_realloc(ctx, 
+                                              ctx->table_cache.entries,
+                                              capacity * sizeof(TSDTableCacheEntry));
+            if(entries == NULL) return TSD_OUT_OF_MEMORY;
+            ctx->table_cache.entries = entries;
+            ctx->table_cache.capacity = capacity;
+        }
+        entry = &ctx->table_cache.entries[ctx->table_cache.length++];
+    }
+    *entry = key;
+    return TSD_OK;
+}
+
+// forgets every table other than the ones carried on pid.
+void table_cache_keep_pid(TSDemuxContext *ctx, uint16_t pid)
+{
+    size_t i;
+    size_t kept = 0;
+    for(i=0; i<ctx->table_cache.length; ++i) {
+        if(ctx->table_cache.entries[i].pid == pid) {
+            ctx->table_cache.entries[kept++] = ctx->table_cache.entries[i];
         }
-        ctx->free(pmt->program_elements);
     }
+    ctx->table_cache.length = kept;
+}
 
-    memset(pmt, 0, sizeof(TSDPMTData));
+// the payload of a PSI packet still to be assembled. The first tail bytes
+// continue the section the PID was part way through, new sections can only
+// start after them in a packet with the payload_unit_start_indicator set.
+typedef struct TSDSectionCursor {
+    uint16_t pid;
+    const uint8_t *ptr;
+    size_t size;
+    size_t tail;
+    int unit_start;
+    // when view is set a single section table is returned in section, with
+    // its data left in the assembly buffer. Only valid until the next table.
+    int view;
+    TSDTableSection section;
+} TSDSectionCursor;
+
+TSDCode section_cursor_init(TSDPacket *pkt, TSDSectionCursor *cursor)
+{
+    cursor->pid = pkt->pid;
+    cursor->ptr = pkt->data_bytes;
+    cursor->size = pkt->data_bytes ? pkt->data_bytes_length : 0;
+    cursor->tail = cursor->size;
+    cursor->unit_start = 0;
+    cursor->view = 0;
+
+    if(cursor->size > 0 && (pkt->flags & TSD_PF_PAYLOAD_UNIT_START_IND)) {
+        // there is a new table section somewhere in this packet.
+        // parse the pointer_field. The section may start in the last bytes
+        // of the payload, the rest of its header follows in the next packet.
+        size_t pointer_field = *cursor->ptr;
+        if(pointer_field >= cursor->size) {
+            return TSD_INVALID_POINTER_FIELD;
+        }
+        cursor->ptr++;
+        cursor->size--;
+        cursor->tail = pointer_field;
+        cursor->unit_start = 1;
+    }
     return TSD_OK;
 }
 
-TSDCode tsd_parse_pmt(TSDemuxContext *ctx,
+// finds the assembler for a section starting at data. A section already held
+// is skipped. When the header isn't all there the section is collected by an
+// assembler with an unknown Id until it is complete.
+TSDCode section_start(TSDemuxContext *ctx,
+                      uint16_t pid,
                       const uint8_t *data,
                       size_t size,
-                      TSDPMTData *pmt)
+                      TSDSectionAssembler **out)
 {
-    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
-    if(data == NULL)                return TSD_INVALID_DATA;
-    if(size < 4)                    return TSD_INVALID_DATA_SIZE;
-    if(pmt == NULL)                 return TSD_INVALID_ARGUMENT;
-
-    const uint8_t *ptr = data;
-    const uint8_t *end = &ptr[size];
-
-    pmt->pcr_pid = parse_u16(ptr) & 0x1FFF;
-    ptr += 2;
-    pmt->program_info_length = parse_u16(ptr) & 0x0FFF;
-    ptr += 2;
+    if(size < 3 || (size < 8 && (data[1] & 0x80))) {
+        return get_assembler(ctx, pid, TSD_SECTION_ID_UNKNOWN, out);
+    }
 
-    size_t desc_size = (size_t)pmt->program_info_length;
-    // make sure we have enough data to parse the desciptors
-    if(&ptr[desc_size] > end) {
-        return TSD_INVALID_DATA_SIZE;
+    TSDCode res = get_assembler(ctx, pid, section_id(data), out);
+    if(res != TSD_OK) {
+        return res;
+    }
+    if((data[1] & 0x80) && assembler_has_section(*out, data[6])) {
+        (*out)->skip = (parse_u16(&data[1]) & 0x0FFF) + 3;
     }
+    return TSD_OK;
+}
 
-    // parse the outter descriptor into a one-dimensional array
-    size_t count = 0;
-    if(desc_size > 0) {
-        TSDCode res = tsd_descriptor_extract(ctx,
-                                             ptr,
-                                             desc_size,
-                                             &(pmt->descriptors),
-                                             &(pmt->descriptors_length));
+// adds up to size bytes to the section being assembled, stopping at its end.
+// used is set to the number of bytes taken and done once the section is
+// complete.
+TSDCode section_feed(TSDemuxContext *ctx,
+                     TSDSectionAssembler *assembler,
+                     const uint8_t *data,
+                     size_t size,
+                     size_t *used,
+                     int *done)
+{
+    *used = 0;
+    *done = 0;
+
+    if(assembler->skip > 0) {
+        size_t len = size < assembler->skip ? size : assembler->skip;
+        assembler->skip -= len;
+        *used = len;
+        *done = assembler->skip == 0;
+        return TSD_OK;
+    }
 
-        if(res != TSD_OK) return res;
-        ptr = &ptr[desc_size];
+    // we'll need enough data to see the section length
+    size_t pending = assembler_pending(assembler);
+    if(pending < 3) {
+        size_t len = 3 - pending;
+        if(len > size) {
+            len = size;
+        }
+        TSDCode res = assembler_write(ctx, assembler, data, len);
+        if(res != TSD_OK) {
+            return res;
+        }
+        *used = len;
+        pending += len;
+        if(pending < 3 || *used == size) {
+            return TSD_OK;
+        }
     }
 
-    // parse the program elements.
-    // As above, determine how many program elements we will have
-    const uint8_t *pe_ptr = ptr;
-    const uint8_t *pe_end = &data[size];
-    count = 0; // reset the counter
+    const uint8_t *section = &assembler->data.buffer[assembler->complete];
+    size_t section_size = (parse_u16(&section[1]) & 0x0FFF) + 3;
+    size_t len = section_size - pending;
+    if(len > size - *used) {
+        len = size - *used;
+    }
+    TSDCode res = assembler_write(ctx, assembler, &data[*used], len);
+    if(res != TSD_OK) {
+        return res;
+    }
+    *used += len;
+    *done = pending + len == section_size;
+    return TSD_OK;
+}
 
-    while(pe_ptr+5 <= pe_end) {
-        ++count;
-        pe_ptr += 3;
-        uint16_t len = parse_u16(pe_ptr) & 0x0FFF; // ES Info length
-        pe_ptr = &pe_ptr[2+len];
+// destroys a table unless its section belongs to the cursor.
+void table_destroy(TSDemuxContext *ctx, TSDSectionCursor *cursor, TSDTable *table)
+{
+    if(table->sections == &cursor->section) {
+        table->sections = NULL;
+        table->length = 0;
+    } else {
+        tsd_table_data_destroy(ctx, table);
     }
+}
 
-    // there might not be any Program Elements
-    if(count == 0) {
-        pmt->crc_32 = parse_u32(ptr);
-        ctx->free(pmt->descriptors);
-        pmt->descriptors = NULL;
-        pmt->descriptors_length = 0;
-        return TSD_OK;
+void sort_table_sections(TSDTable *table)
+{
+    size_t i;
+    for(i=1; i<table->length; ++i) {
+        TSDTableSection section = table->sections[i];
+        size_t j = i;
+        while(j > 0 && table->sections[j-1].section_number > section.section_number) {
+            table->sections[j] = table->sections[j-1];
+            j--;
+        }
+        table->sections[j] = section;
     }
+}
 
-    pmt->program_elements = (TSDProgramElement*) ctx->calloc(count,
-                            sizeof(TSDProgramElement));
+int section_filter_match(TSDemuxContext *ctx, uint16_t pid, const uint8_t *data, size_t size);
 
-    if(!pmt->program_elements) {
-        ctx->free(pmt->descriptors);
-        pmt->descriptors = NULL;
-        pmt->descriptors_length = 0;
-        return TSD_OUT_OF_MEMORY;
+// adds a complete section to its table. Returns TSD_OK with the table once
+// every section of it has been received.
+TSDCode section_complete(TSDemuxContext *ctx,
+                         TSDSectionCursor *cursor,
+                         TSDSectionAssembler *assembler,
+                         TSDTable *table,
+                         int use_cache)
+{
+    TSDCode res;
+    const uint8_t *section = &assembler->data.buffer[assembler->complete];
+    size_t section_size = assembler_pending(assembler);
+
+    // a skipped repeat
+    if(section_size == 0) {
+        return TSD_INCOMPLETE_TABLE;
     }
 
-    // parse the Program Elements
-    pmt->program_elements_length = count;
-    size_t i;
-    TSDCode res = TSD_OK;
-    for(i=0; i<count; ++i) {
-        TSDProgramElement *prog = &pmt->program_elements[i];
-        prog->stream_type = *ptr;
-        ptr++;
-        prog->elementary_pid = parse_u16(ptr) & 0x1FFF;
-        ptr += 2;
-        prog->es_info_length = parse_u16(ptr) & 0x0FFF;
-        ptr += 2;
-        // parse the inner descriptors for each program as above,
-        // find out how many there are, then allocate a single array
-        desc_size = (size_t) prog->es_info_length;
-        if(desc_size == 0) {
-            prog->descriptors = NULL;
-            prog->descriptors_length = 0;
-            continue;
+    if(section[1] & 0x80) {
+        if(section_size < 12) {
+            assembler_drop_section(ctx, assembler);
+            return TSD_INVALID_DATA_SIZE;
         }
+        // drop corrupt sections, a repeat may be intact
+        if(crc32_mpeg2(0xFFFFFFFF, section, section_size) != 0) {
+            ctx->stats.crc_errors++;
+            assembler_drop_section(ctx, assembler);
+            return TSD_INVALID_CRC;
+        }
+    }
 
-        // make sure we make enough data to parse the descriptors
-        if(&ptr[desc_size] > end) {
-            res = TSD_INVALID_DATA_SIZE;
-            break;
+    if(assembler->data.id == TSD_SECTION_ID_UNKNOWN) {
+        // the header is known now, the filters may not want it after all
+        if(!section_filter_match(ctx, assembler->pid, section, section_size)) {
+            release_assembler(ctx, assembler);
+            return TSD_INCOMPLETE_TABLE;
+        }
+        // hand the section to its table
+        uint32_t id = section_id(section);
+        TSDSectionAssembler *table_assembler = find_assembler(ctx, assembler->pid, id);
+        if(table_assembler == NULL) {
+            release_other_versions(ctx, assembler->pid, id);
+            assembler->data.id = id;
+        } else {
+            if(!(section[1] & 0x80) ||
+               !assembler_has_section(table_assembler, section[6])) {
+                res = assembler_write(ctx, table_assembler, section, section_size);
+                if(res != TSD_OK) {
+                    release_assembler(ctx, assembler);
+                    return res;
+                }
+            }
+            release_assembler(ctx, assembler);
+            assembler = table_assembler;
+            section = &assembler->data.buffer[assembler->complete];
+            section_size = assembler_pending(assembler);
+            if(section_size == 0) {
+                return TSD_INCOMPLETE_TABLE;
+            }
         }
+    }
+
+    if(section[1] & 0x80) {
+        uint8_t number = section[6];
+        assembler->received[number >> 5] |= ((uint32_t)1) << (number & 0x1F);
+        assembler->last_section_number = section[7];
+    }
+    assembler->complete += section_size;
 
-        size_t inner_count = 0;
-        TSDCode res_des = tsd_descriptor_extract(ctx,
-                          ptr,
-                          desc_size,
-                          &(prog->descriptors),
-                          &inner_count);
+    if(!assembler_complete(assembler)) {
+        return TSD_INCOMPLETE_TABLE;
+    }
 
-        if(res_des != TSD_OK) return res_des;
+    const uint8_t *data = assembler->data.buffer;
+    const uint8_t *end = &data[assembler->complete];
+    int section_count = 0;
+    for(section = data; section < end;
+        section += (parse_u16(&section[1]) & 0x0FFF) + 3) {
+        section_count++;
+    }
 
-        prog->descriptors_length = inner_count;
-        ptr = &ptr[desc_size];
-        if(inner_count == 0) {
-            continue;
+    // drop repeats of a table we've already delivered
+    TSDTableCacheEntry key;
+    if(use_cache && ctx->table_cache.enabled &&
+       table_cache_entry(assembler->pid, data, end, section_count, &key)) {
+        TSDTableCacheEntry *entry = table_cache_find(ctx, &key);
+        if(entry && entry->version_number == key.version_number &&
+           entry->crc == key.crc) {
+            release_assembler(ctx, assembler);
+            return TSD_TABLE_UNCHANGED;
         }
     }
 
-    if(res != TSD_OK)  {
-        destroy_pmt_data(ctx, pmt);
-        return res;
+    // create and parse the sections.
+    table->length = section_count;
+    if(section_count == 1 && cursor->view) {
+        memset(&cursor->section, 0, sizeof(TSDTableSection));
+        table->sections = &cursor->section;
+    } else {
+        table->sections = (TSDTableSection*) mem_calloc(ctx, section_count,
+                          sizeof(TSDTableSection));
     }
 
-    pmt->crc_32 = parse_u32(ptr);
+    if(!table->sections) return TSD_OUT_OF_MEMORY;
 
+    // parse the table sections
+    res = tsd_parse_table_sections(ctx,
+                                   assembler->data.buffer,
+                                   assembler->complete,
+                                   table);
+    // the table is done with either way, the PID can start another
+    release_assembler(ctx, assembler);
+    if(res != TSD_OK) {
+        table_destroy(ctx, cursor, table);
+        return res;
+    }
+    sort_table_sections(table);
     return TSD_OK;
 }
 
-TSDCode tsd_parse_pes(TSDemuxContext *ctx,
-                      const uint8_t *data,
-                      size_t size,
-                      TSDPESPacket *pes)
+// checks the section starting at data against the filters on pid. When the
+// table_id_extension is beyond size the section is let through, its filters
+// are checked again once it is complete.
+int section_filter_match(TSDemuxContext *ctx, uint16_t pid, const uint8_t *data, size_t size)
 {
-    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
-    if(data == NULL)                return TSD_INVALID_DATA;
-    if(size < 6)                    return TSD_INVALID_DATA_SIZE;
-    if(pes == NULL)                 return TSD_INVALID_ARGUMENT;
+    if(!ctx->pid_map) return 1;
+    uint8_t flags = ctx->pid_map[pid].flags;
+    if(!(flags & TSD_ROUTE_SECTIONS) ||
+       (flags & (TSD_ROUTE_PAT | TSD_ROUTE_CAT | TSD_ROUTE_TSDT | TSD_ROUTE_PMT))) {
+        return 1;
+    }
 
-    memset(pes, 0, sizeof(TSDPESPacket));
+    size_t i;
+    for(i=0; i<ctx->section_filters.length; ++i) {
+        const TSDSectionFilter *filter = &ctx->section_filters.filters[i];
+        if(filter->pid != pid ||
+           ((filter->table_id ^ data[0]) & filter->mask) != 0) {
+            continue;
+        }
+        if(filter->extension_mask == 0 || size < 5) {
+            return 1;
+        }
+        if((data[1] & 0x80) &&
+           ((filter->table_id_extension ^ parse_u16(&data[3])) & filter->extension_mask) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    const uint8_t *ptr = data;
-    const uint8_t *end = &ptr[size];
+// assembles the sections in cursor until a table completes. The cursor is
+// left after the last byte used, call again while its size isn't 0 to find
+// any further tables. When use_cache is set a complete table matching the
+// table cache isn't parsed and TSD_TABLE_UNCHANGED is returned.
+TSDCode next_table(TSDemuxContext *ctx,
+                   TSDSectionCursor *cursor,
+                   TSDTable *table,
+                   int use_cache)
+{
+    TSDSectionAssembler *assembler;
+    TSDCode res;
+    size_t used;
+    int done;
+
+    if(cursor->tail > 0) {
+        // finish the section the PID was part way through. Whatever follows
+        // the end of it is stuffing.
+        size_t tail = cursor->tail;
+        res = TSD_INCOMPLETE_TABLE;
+        assembler = assembler_in_progress(ctx, cursor->pid);
+        if(assembler) {
+            res = section_feed(ctx, assembler, cursor->ptr, tail, &used, &done);
+            if(res == TSD_OK) {
+                res = done ? section_complete(ctx, cursor, assembler, table, use_cache) :
+                             TSD_INCOMPLETE_TABLE;
+            }
+        }
+        cursor->ptr += tail;
+        cursor->size -= tail;
+        cursor->tail = 0;
+        if(res != TSD_INCOMPLETE_TABLE) {
+            return res;
+        }
+    }
 
-    uint32_t value = parse_u32(ptr);
-    pes->start_code = (value >> 8);
-    if(pes->start_code != 0x01) return TSD_INVALID_START_CODE_PREFIX;
+    // sections follow one another until the payload ends or stuffing starts.
+    while(cursor->unit_start && cursor->size > 0 && *cursor->ptr != 0xFF) {
+        // a section that never completed is dropped
+        assembler = assembler_in_progress(ctx, cursor->pid);
+        if(assembler) {
+            assembler_drop_section(ctx, assembler);
+        }
 
-    pes->stream_id = (uint8_t)(value & 0x000000FF);
-    ptr = &ptr[4];
-    pes->packet_length = parse_u16(ptr);
-    ptr = &ptr[2];
+        // pass over sections nobody asked for, any part of them in the next
+        // packets is dropped as there is no section in progress.
+        if(!section_filter_match(ctx, cursor->pid, cursor->ptr, cursor->size)) {
+            size_t section_size = cursor->size;
+            if(cursor->size >= 3) {
+                section_size = (parse_u16(&cursor->ptr[1]) & 0x0FFF) + 3;
+                if(section_size > cursor->size) {
+                    section_size = cursor->size;
+                }
+            }
+            cursor->ptr += section_size;
+            cursor->size -= section_size;
+            continue;
+        }
 
-    if(pes->stream_id == TSD_PSID_PADDING_STREAM) {
-        // Padding, we don't need to do anything
-    } else if(pes->stream_id == TSD_PSID_PROGRAM_STREAM_MAP ||
-              pes->stream_id == TSD_PSID_PRIV_STREAM_2 ||
-              pes->stream_id == TSD_PSID_ECM ||
-              pes->stream_id == TSD_PSID_EMM ||
-              pes->stream_id == TSD_PSID_STREAM_DIRECTORY ||
-              pes->stream_id == TSD_PSID_DSMCC ||
-              pes->stream_id == TSD_PSID_H2221_TYPE_E) {
-        pes->data_bytes = ptr;
-    } else {
-        uint8_t value = *ptr;
-        ptr++;
-        pes->scrambling_control = (TSDPESScramblingControl)((value & 0x30) >> 6);
-        pes->flags = ((value & 0x0F) << 8) | *ptr;
-        ptr++;
-        pes->header_data_length = *ptr;
-        ptr++;
-        const uint8_t *header_end = &ptr[pes->header_data_length];
-        if(pes->flags & TSD_PPF_PTS_FLAG) {
-            uint64_t pts1 = (uint64_t) (((*ptr) >> 1) & 0x07);
-            uint64_t pts2 = (uint64_t) ((parse_u16(ptr+1) >> 1) & 0x7FFF);
-            uint64_t pts3 = (uint64_t) ((parse_u16(ptr+3) >> 1) & 0x7FFF);
-            pes->pts = (pts1 << 30) | (pts2 << 15) | pts3;
-            ptr = &ptr[5];
+        res = section_start(ctx, cursor->pid, cursor->ptr, cursor->size, &assembler);
+        if(res == TSD_OK) {
+            res = section_feed(ctx, assembler, cursor->ptr, cursor->size, &used, &done);
         }
-        if(pes->flags & TSD_PPF_DTS_FLAG) {
-            uint64_t dts1 = (uint64_t) (((*ptr) >> 1) & 0x07);
-            uint64_t dts2 = (uint64_t) ((parse_u16(ptr+1) >> 1) & 0x7FFF);
-            uint64_t dts3 = (uint64_t) ((parse_u16(ptr+3) >> 1) & 0x7FFF);
-            pes->dts = (dts1 << 30) | (dts2 << 15) | dts3;
-            ptr = &ptr[5];
+        if(res != TSD_OK) {
+            cursor->size = 0;
+            return res;
         }
-        if(pes->flags & TSD_PPF_ESCR_FLAG) {
-            uint64_t value = parse_u64(ptr);
-            pes->escr = ((value >> 27) & 0x7FFFLL) |
+        cursor->ptr += used;
+        cursor->size -= used;
+        if(done) {
+            res = section_complete(ctx, cursor, assembler, table, use_cache);
+            if(res != TSD_INCOMPLETE_TABLE) {
+                return res;
+            }
+        }
+    }
+
+    cursor->size = 0;
+    return TSD_INCOMPLETE_TABLE;
+}
+
+TSDCode tsd_parse_table(TSDemuxContext *ctx,
+                        TSDPacket *pkt,
+                        TSDTable *table)
+{
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(pkt == NULL)                 return TSD_INVALID_ARGUMENT;
+    if(table == NULL)               return TSD_INVALID_ARGUMENT;
+
+    TSDSectionCursor cursor;
+    TSDCode res = section_cursor_init(pkt, &cursor);
+    if(res != TSD_OK) {
+        return res;
+    }
+    return next_table(ctx, &cursor, table, 0);
+}
+
+TSDCode tsd_parse_table_sections(TSDemuxContext *ctx,
+                                 uint8_t *data,
+                                 size_t size,
+                                 TSDTable *table)
+{
+    if(ctx == NULL)             return TSD_INVALID_CONTEXT;
+    if(data == NULL)            return TSD_INVALID_DATA;
+    if(size == 0)               return TSD_INVALID_DATA_SIZE;
+    if(table == NULL)            return TSD_INVALID_ARGUMENT;
+
+    uint8_t *ptr = data;
+    uint8_t *end = &data[size];
+    size_t i;
+
+    for(i=0; i < table->length; ++i) {
+        // make sure we have enough data to parse the table info
+        if((size_t)(end - ptr) < 3) {
+            return TSD_INVALID_DATA_SIZE;
+        }
+        TSDTableSection *section = &(table->sections[i]);
+        section->table_id = *ptr;
+        ptr++;
+        // section syntax indicator and private indicator
+        section->flags = (int)(((*ptr) >> 6) & 0x03);
+        section->section_length = parse_u16(ptr) & 0x0FFF;
+        ptr+=2;
+        if(&ptr[section->section_length] > end) {
+            return TSD_INVALID_DATA_SIZE;
+        }
+        // are we dealing with a long form or short form table?
+        if(section->flags & TSD_TBL_SECTION_SYNTAX_INDICATOR) {
+            // long form table properties
+            // Note that the table_id_extension could be PAT, CAT or PMT data.
+            // make sure we have enough data, and that the section length is
+            // long enought to parse the table info.
+            if((size_t)(end - ptr) < 9 || section->section_length < 9) {
+                return TSD_INVALID_DATA_SIZE;
+            }
+            section->table_id_extension = parse_u16(ptr);
+            section->version_number = ((*(ptr+2)) >> 1) & 0x1F;
+            // current next indicator
+            section->flags |= ((*(ptr+2)) & 0x01) << 2;
+            section->section_number = *(ptr+3);
+            section->last_section_number = *(ptr+4);
+            section->section_data = ptr+5;
+            section->crc_32 = parse_u32(&ptr[section->section_length - 4]);
+            // the crc32 is not counted in the data
+            section->section_data_length = section->section_length - 9;
+        } else {
+            // set everything to zero for short form
+            section->table_id_extension = 0;
+            section->version_number = 0;
+            section->section_number = 0;
+            section->last_section_number = 0;
+            section->crc_32 = 0;
+            section->section_data = ptr;
+            section->section_data_length = section->section_length;
+        }
+
+        ptr += section->section_length;
+    }
+
+    return TSD_OK;
+}
+
+TSDCode tsd_parse_pat(TSDemuxContext *ctx,
+                      const uint8_t *data,
+                      size_t size,
+                      TSDPATData *pat)
+{
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(data == NULL)                return TSD_INVALID_DATA;
+    if(size < 4)                    return TSD_INVALID_DATA_SIZE;
+    if(pat == NULL)                 return TSD_INVALID_ARGUMENT;
+
+    size_t count = size / 4;
+    size_t new_length = pat->length + count;
+    uint16_t *pid_data = NULL;
+    uint16_t *prog_data = NULL;
+
+    if(pat->length) {
+        pid_data = (uint16_t*)mem_realloc(ctx, pat->pid,
+                                           new_length * sizeof(uint16_t));
+        prog_data = (uint16_t*)mem_realloc(ctx, pat->program_number,
+                                            new_length * sizeof(uint16_t));
+    } else {
+        pid_data = (uint16_t*)mem_malloc(ctx, new_length * sizeof(uint16_t));
+        prog_data = (uint16_t*)mem_malloc(ctx, new_length *sizeof(uint16_t));
+    }
+
+    if(!pid_data || !prog_data) {
+        if(prog_data) mem_free(ctx, prog_data);
+        if(pid_data) mem_free(ctx, pid_data);
+        return TSD_OUT_OF_MEMORY;
+    }
+
+    size_t i;
+    for(i=pat->length; i < new_length; ++i) {
+        prog_data[i] = parse_u16(data);
+        data += 2;
+        pid_data[i] = parse_u16(data) & 0x1FFF;
+        data += 2;
+    }
+
+    pat->pid = pid_data;
+    pat->program_number = prog_data;
+    pat->length = new_length;
+
+    return TSD_OK;
+}
+
+TSDCode destroy_pat_data(TSDemuxContext *ctx, TSDPATData *pat)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(pat == NULL)     return TSD_INVALID_ARGUMENT;
+
+    if(pat->length > 0) {
+        mem_free(ctx, pat->program_number);
+        mem_free(ctx, pat->pid);
+    }
+    pat->length = 0;
+    pat->program_number = pat->pid = NULL;
+    return TSD_OK;
+}
+
+TSDCode tsd_descriptor_iter_init(TSDDescriptorIter *iter,
+                                 const uint8_t *data,
+                                 size_t size)
+{
+    if(iter == NULL)                return TSD_INVALID_ARGUMENT;
+
+    // a rejected loop is left empty
+    iter->ptr = NULL;
+    iter->end = NULL;
+    if(data == NULL && size > 0)    return TSD_INVALID_DATA;
+
+    iter->ptr = data;
+    iter->end = data ? &data[size] : data;
+    return TSD_OK;
+}
+
+TSDCode tsd_descriptor_iter_next(TSDDescriptorIter *iter, TSDDescriptor *desc)
+{
+    if(iter == NULL || desc == NULL)    return TSD_INVALID_ARGUMENT;
+
+    size_t left = (size_t)(iter->end - iter->ptr);
+    if(left == 0) {
+        return TSD_END_OF_DATA;
+    }
+    // the tag, length and payload must all be within the loop
+    if(left < 2 || left < (size_t)iter->ptr[1] + 2) {
+        iter->ptr = iter->end;
+        return TSD_INVALID_DATA_SIZE;
+    }
+
+    desc->tag = iter->ptr[0];
+    desc->length = iter->ptr[1];
+    desc->data = iter->ptr;
+    desc->data_length = (size_t)desc->length + 2;
+    iter->ptr += desc->data_length;
+    return TSD_OK;
+}
+
+TSDCode tsd_descriptor_iter_find(TSDDescriptorIter *iter,
+                                 uint8_t tag,
+                                 TSDDescriptor *desc)
+{
+    TSDCode res;
+    while((res = tsd_descriptor_iter_next(iter, desc)) == TSD_OK) {
+        if(desc->tag == tag) {
+            return TSD_OK;
+        }
+    }
+    return res;
+}
+
+size_t descriptor_count(const uint8_t *ptr, size_t length)
+{
+    // count the descriptors which are whole, a truncated one ends the loop
+    TSDDescriptorIter iter;
+    TSDDescriptor desc;
+    size_t count = 0;
+
+    if(tsd_descriptor_iter_init(&iter, ptr, length) != TSD_OK) {
+        return 0;
+    }
+    while(tsd_descriptor_iter_next(&iter, &desc) == TSD_OK) {
+        ++count;
+    }
+
+    return count;
+}
+
+size_t parse_descriptor(const uint8_t* data,
+                        size_t size,
+                        TSDDescriptor *descriptors,
+                        size_t length)
+{
+    TSDDescriptorIter iter;
+
+    size_t i=0;
+    if(tsd_descriptor_iter_init(&iter, data, size) != TSD_OK) {
+        return 0;
+    }
+    while(i < length &&
+          tsd_descriptor_iter_next(&iter, &descriptors[i]) == TSD_OK) {
+        ++i;
+    }
+
+    return i;
+}
+
+TSDCode destroy_pmt_data(TSDemuxContext *ctx, TSDPMTData *pmt)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(pmt == NULL)     return TSD_INVALID_ARGUMENT;
+
+    // the program elements and every descriptor share one block, starting
+    // with the program elements when there are any.
+    void *arena = pmt->program_elements_length > 0 ?
+                  (void*)pmt->program_elements : (void*)pmt->descriptors;
+    if(arena) {
+        mem_free(ctx, arena);
+    }
+
+    memset(pmt, 0, sizeof(TSDPMTData));
+    return TSD_OK;
+}
+
+TSDCode tsd_parse_pmt(TSDemuxContext *ctx,
+                      const uint8_t *data,
+                      size_t size,
+                      TSDPMTData *pmt)
+{
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(data == NULL)                return TSD_INVALID_DATA;
+    if(size < 4)                    return TSD_INVALID_DATA_SIZE;
+    if(pmt == NULL)                 return TSD_INVALID_ARGUMENT;
+
+    const uint8_t *ptr = data;
+    const uint8_t *end = &ptr[size];
+
+    pmt->pcr_pid = parse_u16(ptr) & 0x1FFF;
+    ptr += 2;
+    pmt->program_info_length = parse_u16(ptr) & 0x0FFF;
+    ptr += 2;
+    pmt->descriptors = NULL;
+    pmt->descriptors_length = 0;
+    pmt->program_elements = NULL;
+    pmt->program_elements_length = 0;
+
+    size_t desc_size = (size_t)pmt->program_info_length;
+    // make sure we have enough data to parse the desciptors
+    if(&ptr[desc_size] > end) {
+        return TSD_INVALID_DATA_SIZE;
+    }
+
+    // measure the table first, so that the program elements and all the
+    // descriptors fit in a single allocation
+    size_t outer_count = descriptor_count(ptr, desc_size);
+    size_t desc_count = outer_count;
+    size_t count = 0;
+    const uint8_t *pe_ptr = &ptr[desc_size];
+    while(pe_ptr+5 <= end) {
+        size_t len = parse_u16(&pe_ptr[3]) & 0x0FFF; // ES Info length
+        // make sure we make enough data to parse the descriptors
+        if(&pe_ptr[5+len] > end) {
+            return TSD_INVALID_DATA_SIZE;
+        }
+        desc_count += descriptor_count(&pe_ptr[5], len);
+        ++count;
+        pe_ptr = &pe_ptr[5+len];
+    }
+
+    uint8_t *arena = NULL;
+    TSDDescriptor *descriptors = NULL;
+    if(count > 0 || desc_count > 0) {
+        arena = (uint8_t*) mem_calloc(ctx, 1, count * sizeof(TSDProgramElement) +
+                                          desc_count * sizeof(TSDDescriptor));
+        if(!arena) return TSD_OUT_OF_MEMORY;
+        descriptors = (TSDDescriptor*) &arena[count * sizeof(TSDProgramElement)];
+    }
+
+    // parse the outter descriptor into a one-dimensional array
+    if(outer_count > 0) {
+        parse_descriptor(ptr, desc_size, descriptors, outer_count);
+        pmt->descriptors = descriptors;
+        pmt->descriptors_length = outer_count;
+        descriptors += outer_count;
+    }
+    ptr = &ptr[desc_size];
+
+    // parse the Program Elements
+    size_t i;
+    for(i=0; i<count; ++i) {
+        TSDProgramElement *prog = &((TSDProgramElement*)arena)[i];
+        prog->stream_type = *ptr;
+        ptr++;
+        prog->elementary_pid = parse_u16(ptr) & 0x1FFF;
+        ptr += 2;
+        prog->es_info_length = parse_u16(ptr) & 0x0FFF;
+        ptr += 2;
+        // the inner descriptors of each program follow one another
+        desc_size = (size_t) prog->es_info_length;
+        size_t inner_count = parse_descriptor(ptr, desc_size, descriptors,
+                                              desc_count - outer_count);
+        if(inner_count > 0) {
+            prog->descriptors = descriptors;
+            prog->descriptors_length = inner_count;
+            descriptors += inner_count;
+            desc_count -= inner_count;
+        }
+        ptr = &ptr[desc_size];
+    }
+    if(count > 0) {
+        pmt->program_elements = (TSDProgramElement*)arena;
+        pmt->program_elements_length = count;
+    }
+
+    // the CRC_32 is only there when given the whole section
+    if(end - ptr >= 4) {
+        pmt->crc_32 = parse_u32(ptr);
+    }
+
+    return TSD_OK;
+}
+
+// whether a PES with this stream_id has the optional header fields following
+// PES_packet_length.
+int pes_has_header_fields(uint8_t stream_id)
+{
+    return stream_id != TSD_PSID_PADDING_STREAM &&
+           stream_id != TSD_PSID_PROGRAM_STREAM_MAP &&
+           stream_id != TSD_PSID_PRIV_STREAM_2 &&
+           stream_id != TSD_PSID_ECM &&
+           stream_id != TSD_PSID_EMM &&
+           stream_id != TSD_PSID_STREAM_DIRECTORY &&
+           stream_id != TSD_PSID_DSMCC &&
+           stream_id != TSD_PSID_H2221_TYPE_E;
+}
+
+// the size of the PES header at the start of data, 0 while there isn't
+// enough data to tell.
+size_t pes_header_size(const uint8_t *data, size_t size)
+{
+    if(size < 6) return 0;
+    if(!pes_has_header_fields(data[3])) return 6;
+    if(size < 9) return 0;
+    return 9 + data[8];
+}
+
+TSDCode tsd_parse_pes(TSDemuxContext *ctx,
+                      const uint8_t *data,
+                      size_t size,
+                      TSDPESPacket *pes)
+{
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(data == NULL)                return TSD_INVALID_DATA;
+    if(size < 6)                    return TSD_INVALID_DATA_SIZE;
+    if(pes == NULL)                 return TSD_INVALID_ARGUMENT;
+
+    memset(pes, 0, sizeof(TSDPESPacket));
+
+    const uint8_t *ptr = data;
+    const uint8_t *end = &ptr[size];
+
+    uint32_t value = parse_u32(ptr);
+    pes->start_code = (value >> 8);
+    if(pes->start_code != 0x01) return TSD_INVALID_START_CODE_PREFIX;
+
+    pes->stream_id = (uint8_t)(value & 0x000000FF);
+    ptr = &ptr[4];
+    pes->packet_length = parse_u16(ptr);
+    ptr = &ptr[2];
+
+    if(pes->stream_id == TSD_PSID_PADDING_STREAM) {
+        // Padding, we don't need to do anything
+    } else if(!pes_has_header_fields(pes->stream_id)) {
+        pes->data_bytes = ptr;
+    } else {
+        uint8_t value = *ptr;
+        ptr++;
+        pes->scrambling_control = (TSDPESScramblingControl)((value & 0x30) >> 6);
+        pes->flags = ((value & 0x0F) << 8) | *ptr;
+        ptr++;
+        pes->header_data_length = *ptr;
+        ptr++;
+        const uint8_t *header_end = &ptr[pes->header_data_length];
+        if(pes->flags & TSD_PPF_PTS_FLAG) {
+            uint64_t pts1 = (uint64_t) (((*ptr) >> 1) & 0x07);
+            uint64_t pts2 = (uint64_t) ((parse_u16(ptr+1) >> 1) & 0x7FFF);
+            uint64_t pts3 = (uint64_t) ((parse_u16(ptr+3) >> 1) & 0x7FFF);
+            pes->pts = (pts1 << 30) | (pts2 << 15) | pts3;
+            ptr = &ptr[5];
+        }
+        if(pes->flags & TSD_PPF_DTS_FLAG) {
+            uint64_t dts1 = (uint64_t) (((*ptr) >> 1) & 0x07);
+            uint64_t dts2 = (uint64_t) ((parse_u16(ptr+1) >> 1) & 0x7FFF);
+            uint64_t dts3 = (uint64_t) ((parse_u16(ptr+3) >> 1) & 0x7FFF);
+            pes->dts = (dts1 << 30) | (dts2 << 15) | dts3;
+            ptr = &ptr[5];
+        }
+        if(pes->flags & TSD_PPF_ESCR_FLAG) {
+            uint64_t value = parse_u64(ptr);
+            pes->escr = ((value >> 27) & 0x7FFFLL) |
                         (((value >> 43) & 0x7FFFLL) << 15) |
                         (((value >> 59) & 0x0007LL) << 30);
             pes->escr_extension = (uint16_t)((value >> 17) & 0x01FFLL);
             ptr = &ptr[6];
         }
-        if(pes->flags & TSD_PPF_ES_RATE_FLAG) {
-            uint32_t value = parse_u32(ptr);
-            pes->es_rate = (value >> 9) & 0x003FFFFF;
-            ptr = &ptr[3];
+        if(pes->flags & TSD_PPF_ES_RATE_FLAG) {
+            uint32_t value = parse_u32(ptr);
+            pes->es_rate = (value >> 9) & 0x003FFFFF;
+            ptr = &ptr[3];
+        }
+        if(pes->flags & TSD_PPF_DSM_TRICK_MODE_FLAG) {
+            pes->trick_mode.control = (TSDTrickModeControl)(((*ptr) >> 5) & 0x07);
+            if(pes->trick_mode.control == TSD_TMC_FAST_FORWARD ||
+               pes->trick_mode.control == TSD_TMC_FAST_REVERSE) {
+                pes->trick_mode.field_id = ((*ptr) >> 3) & 0x03;
+                pes->trick_mode.intra_slice_refresh = ((*ptr) >> 2) & 0x01;
+                pes->trick_mode.frequency_truncation = (*ptr) & 0x03;
+            } else if(pes->trick_mode.control == TSD_TMC_SLOW_MOTION ||
+                      pes->trick_mode.control == TSD_TMC_SLOW_REVERSE) {
+                pes->trick_mode.rep_cntrl = (*ptr) & 0x1F;
+            } else if(pes->trick_mode.control == TSD_TMC_FREEZE_FRAME) {
+                pes->trick_mode.field_id = ((*ptr) >> 3) & 0x03;
+            }
+            ptr++;
+        }
+        if(pes->flags & TSD_PPF_ADDITIONAL_COPY_INFO_FLAG) {
+            pes->additional_copy_info = (*ptr) & 0x7F;
+            ptr++;
+        }
+        if(pes->flags & TSD_PPF_PES_CRC_FLAG) {
+            pes->previous_pes_packet_crc = parse_u16(ptr);
+            ptr = &ptr[2];
+        }
+        if(pes->flags & TSD_PPF_PES_EXTENSION_FLAG) {
+            pes->extension.flags = *ptr;
+            ptr++;
+            if(pes->extension.flags & TSD_PEF_PES_PRIVATE_DATA_FLAG) {
+                int i=0;
+                for(i=0; i<16; ++i) {
+                    pes->extension.pes_private_data[i] = ptr[i];
+                }
+                ptr = &ptr[16]; // 128 bits
+            }
+            if(pes->extension.flags & TSD_PEF_PACK_HEADER_FIELD_FLAG) {
+                TSDPackHeader *pheader = &pes->extension.pack_header;
+                pheader->length = *ptr;
+                ptr++;
+                pheader->start_code = parse_u32(ptr);
+                ptr = &ptr[4];
+                uint64_t value = parse_u64(ptr);
+                pheader->system_clock_ref_base =
+                    ((value >> 27) & 0x7FFFLL) |
+                    (((value >> 43) & 0x7FFFLL) << 15) |
+                    (((value >> 59) & 0x0007LL) << 30);
+                pheader->system_clock_ref_ext =
+                    (uint16_t)((value >> 17) & 0x01FFLL);
+                ptr = &ptr[6];
+                pheader->program_mux_rate = parse_u32(ptr) >> 10;
+                ptr = &ptr[3];
+                pheader->stuffing_length = (*ptr) & 0x07;
+                // get past stuffing
+                ptr = &ptr[1 + pheader->stuffing_length];
+                // System Header
+                TSDSystemHeader *sysh = &pheader->system_header;
+                sysh->start_code = parse_u32(ptr);
+                ptr = &ptr[4];
+                sysh->length = parse_u16(ptr);
+                ptr = &ptr[2];
+                sysh->rate_bound = (parse_u32(ptr) >> 9) & 0x003FFFFF;
+                ptr = &ptr[3];
+                sysh->audio_bound = (*ptr) >> 2;
+                sysh->flags = parse_u32(ptr) & 0x03C08000;
+                ptr++;
+                sysh->video_bound = (*ptr) & 0x1F;
+                ptr = &ptr[2];
+                sysh->stream_count = (sysh->length - 6) / 3;
+                if(sysh->stream_count > 0) {
+                    sysh->streams = (TSDSystemHeaderStream*) mem_calloc(ctx, sysh->stream_count, sizeof(TSDSystemHeaderStream));
+                    if(!sysh->streams) return TSD_OUT_OF_MEMORY;
+                    size_t i;
+                    size_t used = 0;
+                    for(i=0; i<sysh->stream_count; ++i) {
+                        // make sure the first bit is set in the stream id
+                        if((*ptr) & 0x80) {
+                            used++;
+                            TSDSystemHeaderStream *stream = &sysh->streams[i];
+                            stream->stream_id = *ptr;
+                            ptr++;
+                            stream->pstd_buffer_bound_scale = ((*ptr) >> 5) & 0x01;
+                            stream->pstd_buffer_size_bound = parse_u16(ptr) & 0x1FFF;
+                            ptr = &ptr[2];
+                        }
+                    }
+                    sysh->stream_count = used;
+                }
+            }
+            if(pes->extension.flags & TSD_PEF_PROGRAM_PACKET_SEQUENCE_COUNTER_FLAG) {
+                pes->extension.program_packet_sequence_counter = (*ptr) & 0x7F;
+                ptr++;
+                pes->extension.mpeg1_mpeg2_identifier = ((*ptr) >> 6) & 0x01;
+                pes->extension.original_stuff_length = (*ptr) & 0x3F;
+                ptr++;
+            }
+            if(pes->extension.flags & TSD_PEF_PSTD_BUFFER_FLAG) {
+                pes->extension.pstd_buffer_scale = ((*ptr) >> 5) & 0x01;
+                pes->extension.pstd_buffer_size = parse_u16(ptr) & 0x1FFF;
+                ptr = &ptr[2];
+            }
+            if(pes->extension.flags & TSD_PEF_PES_EXTENSION_FLAG_2) {
+                pes->extension.pes_extension_field_length = (*ptr) & 0x7F;
+                ptr = &ptr[1 + pes->extension.pes_extension_field_length];
+            }
+        }
+        // get past any stuffing
+        while(ptr < header_end && *ptr == 0xFF) {
+            ptr++;
+        }
+        pes->data_bytes = ptr;
+        pes->data_bytes_length = end - ptr;
+    }
+
+    return TSD_OK;
+}
+
+TSDCode tsd_parse_descriptors(TSDemuxContext *ctx,
+                              const uint8_t *data,
+                              size_t size,
+                              TSDDescriptorData *descriptorData)
+{
+
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(data == NULL)                return TSD_INVALID_DATA;
+    if(size < 2)                    return TSD_INVALID_DATA_SIZE;
+    if(descriptorData == NULL)      return TSD_INVALID_ARGUMENT;
+
+    size_t count = descriptor_count(data, size);
+    if(count == 0) {
+        descriptorData->descriptors = NULL;
+        descriptorData->descriptors_length = 0;
+    } else {
+        descriptorData->descriptors = (TSDDescriptor*) mem_calloc(ctx, count,
+                                      sizeof(TSDDescriptor));
+        if(!descriptorData->descriptors) return TSD_OUT_OF_MEMORY;
+        descriptorData->descriptors_length =
+            parse_descriptor(data, size, descriptorData->descriptors, count);
+    }
+
+    return TSD_OK;
+}
+
+TSDCode tsd_data_context_init(TSDemuxContext *ctx, TSDDataContext *dataCtx)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
+
+    dataCtx->buffer = (uint8_t*)mem_malloc(ctx, TSD_MEM_PAGE_SIZE);
+    dataCtx->end = dataCtx->buffer + TSD_MEM_PAGE_SIZE;
+    dataCtx->write = dataCtx->buffer;
+    dataCtx->size = TSD_MEM_PAGE_SIZE;
+
+    return TSD_OK;
+}
+
+TSDCode tsd_data_context_destroy(TSDemuxContext *ctx, TSDDataContext *dataCtx)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
+
+    if(dataCtx->buffer != NULL) {
+        mem_free(ctx, dataCtx->buffer);
+        memset(dataCtx, 0, sizeof(TSDDataContext));
+    }
+
+    return TSD_OK;
+}
+
+TSDCode tsd_data_context_write(TSDemuxContext *ctx,
+                               TSDDataContext *dataCtx,
+                               const uint8_t *data,
+                               size_t size)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
+    if(data == NULL)        return TSD_INVALID_DATA;
+    if(size == 0)           return TSD_INVALID_DATA_SIZE;
+
+    // if we don't have enough space we'll need to reallocate the  data.
+    size_t space = (size_t)(dataCtx->end - dataCtx->write);
+    if(space < size) {
+        // grow geometrically, so that a large PES only takes a handful of
+        // reallocations instead of one per page.
+        size_t used = dataCtx->size - space;
+        size_t new_size = dataCtx->size * 2;
+        if(new_size < used + size) {
+            new_size = used + size;
+        }
+        TSDCode res = tsd_data_context_reserve(ctx, dataCtx, new_size);
+        if(res != TSD_OK) {
+            return res;
+        }
+    }
+
+    // write the data into the buffer
+    memcpy(dataCtx->write, data, size);
+    dataCtx->write += size;
+    return TSD_OK;
+}
+
+TSDCode tsd_data_context_reserve(TSDemuxContext *ctx,
+                                 TSDDataContext *dataCtx,
+                                 size_t size)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
+
+    if(size <= dataCtx->size && dataCtx->buffer) {
+        return TSD_OK;
+    }
+
+    // allocate enough memory aligning it to the default size
+    size_t align = TSD_MEM_PAGE_SIZE;
+    size_t new_size = ((size + align - 1) / align) * align;
+    size_t used = (size_t)(dataCtx->write - dataCtx->buffer);
+
+    void *mem;
+    if(used == 0) {
+        // nothing to keep, so skip the copy realloc would make
+        mem = mem_malloc(ctx, new_size);
+        if(!mem) {
+            return TSD_OUT_OF_MEMORY;
+        }
+        if(dataCtx->buffer) {
+            mem_free(ctx, dataCtx->buffer);
+        }
+    } else {
+        mem = mem_realloc(ctx, dataCtx->buffer, new_size);
+        if(!mem) {
+            return TSD_OUT_OF_MEMORY;
+        }
+    }
+
+    dataCtx->buffer = (uint8_t*)mem;
+    dataCtx->end = dataCtx->buffer + new_size;
+    dataCtx->write = dataCtx->buffer + used;
+    dataCtx->size = new_size;
+    return TSD_OK;
+}
+
+TSDCode tsd_data_context_reset(TSDemuxContext *ctx, TSDDataContext *dataCtx)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
+
+    dataCtx->write = dataCtx->buffer;
+    return TSD_OK;
+}
+
+TSDCode tsd_descriptor_extract(TSDemuxContext *ctx,
+                               const uint8_t *data,
+                               size_t data_size,
+                               TSDDescriptor **descriptors,
+                               size_t *descriptors_length)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+
+    size_t count = descriptor_count(data, data_size);
+
+    if(count == 0) {
+        *descriptors = NULL;
+        *descriptors_length = 0;
+        return TSD_OK;
+    }
+
+    // create and parse the descriptors
+    TSDDescriptor *descriptors_tmp = (TSDDescriptor*) mem_calloc(ctx, count,
+                                     sizeof(TSDDescriptor));
+
+    if(!descriptors_tmp) return TSD_OUT_OF_MEMORY;
+
+    // parse the individual descriptors
+    parse_descriptor(data, data_size, descriptors_tmp, count);
+    *descriptors_length = count;
+    *descriptors = descriptors_tmp;
+
+    return TSD_OK;
+}
+
+TSDCode table_data_extract(TSDemuxContext *ctx,
+                           TSDSectionCursor *cursor,
+                           TSDTable *table,
+                           uint8_t **mem,
+                           size_t *size,
+                           int use_cache);
+
+TSDCode tsd_table_data_extract(TSDemuxContext *ctx,
+                               TSDPacket *hdr,
+                               TSDTable *table,
+                               uint8_t **mem,
+                               size_t *size)
+{
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(hdr == NULL || table == NULL) return TSD_INVALID_ARGUMENT;
+
+    TSDSectionCursor cursor;
+    TSDCode res = section_cursor_init(hdr, &cursor);
+    if(res != TSD_OK) {
+        return res;
+    }
+    return table_data_extract(ctx, &cursor, table, mem, size, 0);
+}
+
+// the table data is copied into a new block unless the cursor has view set
+// and there is a single section. The data of that section is then handed
+// out where it is, in the assembly buffer.
+TSDCode table_data_extract(TSDemuxContext *ctx,
+                           TSDSectionCursor *cursor,
+                           TSDTable *table,
+                           uint8_t **mem,
+                           size_t *size,
+                           int use_cache)
+{
+    memset(table, 0, sizeof(TSDTable));
+    TSDCode res = next_table(ctx, cursor, table, use_cache);
+
+    // there may not be any sections available yet.
+    if(res != TSD_OK || !table->sections) {
+        return res;
+    }
+
+    if(cursor->view && table->length == 1) {
+        if(table->sections[0].section_data_length == 0) {
+            table_destroy(ctx, cursor, table);
+            return TSD_INVALID_DATA_SIZE;
+        }
+        *size = table->sections[0].section_data_length;
+        *mem = table->sections[0].section_data;
+        return TSD_OK;
+    }
+
+    // we have a complete table.
+    // create a contiguous memory buffer for parsing the table
+    size_t block_size = 0;
+    size_t i=0;
+    for(; i<table->length; ++i) {
+        block_size += table->sections[i].section_data_length;
+    }
+    if(block_size == 0) {
+        tsd_table_data_destroy(ctx, table);
+        return TSD_INVALID_DATA_SIZE;
+    }
+
+    void *block = mem_malloc(ctx, block_size);
+    if(!block) {
+        tsd_table_data_destroy(ctx, table);
+        return TSD_OUT_OF_MEMORY;
+    }
+
+    uint8_t *ptr = (uint8_t*) block;
+    uint8_t *end = &ptr[block_size];
+    size_t written = 0;
+
+    // go through all the sections and copy them into our buffer
+    for(i=0; i<table->length; ++i) {
+        TSDTableSection *sec = &table->sections[i];
+        if(!sec->section_data || sec->section_data_length == 0) {
+            continue;
+        }
+        size_t len = sec->section_data_length;
+        // make sure we have enough room to accomodate the copy
+        if(&ptr[len] > end) {
+            mem_free(ctx, block);
+            return TSD_INVALID_DATA_SIZE;
         }
-        if(pes->flags & TSD_PPF_DSM_TRICK_MODE_FLAG) {
-            pes->trick_mode.control = (TSDTrickModeControl)(((*ptr) >> 5) & 0x07);
-            if(pes->trick_mode.control == TSD_TMC_FAST_FORWARD ||
-               pes->trick_mode.control == TSD_TMC_FAST_REVERSE) {
-                pes->trick_mode.field_id = ((*ptr) >> 3) & 0x03;
-                pes->trick_mode.intra_slice_refresh = ((*ptr) >> 2) & 0x01;
-                pes->trick_mode.frequency_truncation = (*ptr) & 0x03;
-            } else if(pes->trick_mode.control == TSD_TMC_SLOW_MOTION ||
-                      pes->trick_mode.control == TSD_TMC_SLOW_REVERSE) {
-                pes->trick_mode.rep_cntrl = (*ptr) & 0x1F;
-            } else if(pes->trick_mode.control == TSD_TMC_FREEZE_FRAME) {
-                pes->trick_mode.field_id = ((*ptr) >> 3) & 0x03;
+        memcpy(ptr, sec->section_data, len);
+        written += len;
+        ptr = &ptr[len];
+    }
+
+    *size = written;
+    *mem = (uint8_t *)block;
+
+    return TSD_OK;
+}
+
+TSDCode tsd_table_data_destroy(TSDemuxContext *ctx, TSDTable *table)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(table == NULL)   return TSD_INVALID_ARGUMENT;
+
+    if(table->length) {
+        mem_free(ctx, table->sections);
+    }
+
+    table->length = 0;
+    table->sections = NULL;
+
+    return TSD_OK;
+}
+
+typedef TSDCode (*table_handler)(TSDemuxContext *ctx,
+                                 uint16_t pid,
+                                 TSDTable *table,
+                                 uint8_t *block,
+                                 size_t size);
+
+// hands every table completed by the packet to handler. The table and its
+// data are only valid during the call.
+TSDCode demux_tables(TSDemuxContext *ctx,
+                     TSDPacket *hdr,
+                     int use_cache,
+                     table_handler handler)
+{
+    TSDSectionCursor cursor;
+    TSDCode res = section_cursor_init(hdr, &cursor);
+    if(res != TSD_OK) {
+        return res;
+    }
+
+    cursor.view = 1;
+    TSDCode result = TSD_INCOMPLETE_TABLE;
+    while(cursor.size > 0) {
+        uint8_t *block = NULL;
+        size_t written = 0;
+        TSDTable table;
+        res = table_data_extract(ctx,
+                                 &cursor,
+                                 &table,
+                                 &block,
+                                 &written,
+                                 use_cache);
+        if(res == TSD_INCOMPLETE_TABLE) {
+            break;
+        }
+        if(res == TSD_TABLE_UNCHANGED) {
+            result = TSD_OK;
+            continue;
+        }
+        if(res == TSD_OK) {
+            res = handler(ctx, hdr->pid, &table, block, written);
+            // cleanup, only tables of several sections were copied
+            if(table.length > 1) {
+                mem_free(ctx, block);
             }
-            ptr++;
+            table_destroy(ctx, &cursor, &table);
         }
-        if(pes->flags & TSD_PPF_ADDITIONAL_COPY_INFO_FLAG) {
-            pes->additional_copy_info = (*ptr) & 0x7F;
-            ptr++;
+        if(res != TSD_OK && res != TSD_INVALID_CRC) {
+            return res;
         }
-        if(pes->flags & TSD_PPF_PES_CRC_FLAG) {
-            pes->previous_pes_packet_crc = parse_u16(ptr);
-            ptr = &ptr[2];
+        result = res;
+    }
+    return result;
+}
+
+// binary search of the directory, returns the index of the program or the
+// index it would be inserted at.
+size_t directory_search(TSDemuxContext *ctx, uint16_t program_number)
+{
+    size_t lo = 0;
+    size_t hi = ctx->directory.length;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(ctx->directory.programs[mid].program_number < program_number) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
-        if(pes->flags & TSD_PPF_PES_EXTENSION_FLAG) {
-            pes->extension.flags = *ptr;
-            ptr++;
-            if(pes->extension.flags & TSD_PEF_PES_PRIVATE_DATA_FLAG) {
-                int i=0;
-                for(i=0; i<16; ++i) {
-                    pes->extension.pes_private_data[i] = ptr[i];
-                }
-                ptr = &ptr[16]; // 128 bits
-            }
-            if(pes->extension.flags & TSD_PEF_PACK_HEADER_FIELD_FLAG) {
-                TSDPackHeader *pheader = &pes->extension.pack_header;
-                pheader->length = *ptr;
-                ptr++;
-                pheader->start_code = parse_u32(ptr);
-                ptr = &ptr[4];
-                uint64_t value = parse_u64(ptr);
-                pheader->system_clock_ref_base =
-                    ((value >> 27) & 0x7FFFLL) |
-                    (((value >> 43) & 0x7FFFLL) << 15) |
-                    (((value >> 59) & 0x0007LL) << 30);
-                pheader->system_clock_ref_ext =
-                    (uint16_t)((value >> 17) & 0x01FFLL);
-                ptr = &ptr[6];
-                pheader->program_mux_rate = parse_u32(ptr) >> 10;
-                ptr = &ptr[3];
-                pheader->stuffing_length = (*ptr) & 0x07;
-                // get past stuffing
-                ptr = &ptr[1 + pheader->stuffing_length];
-                // System Header
-                TSDSystemHeader *sysh = &pheader->system_header;
-                sysh->start_code = parse_u32(ptr);
-                ptr = &ptr[4];
-                sysh->length = parse_u16(ptr);
-                ptr = &ptr[2];
-                sysh->rate_bound = (parse_u32(ptr) >> 9) & 0x003FFFFF;
-                ptr = &ptr[3];
-                sysh->audio_bound = (*ptr) >> 2;
-                sysh->flags = parse_u32(ptr) & 0x03C08000;
-                ptr++;
-                sysh->video_bound = (*ptr) & 0x1F;
-                ptr = &ptr[2];
-                sysh->stream_count = (sysh->length - 6) / 3;
-                if(sysh->stream_count > 0) {
-                    sysh->streams = (TSDSystemHeaderStream*) ctx->calloc(sysh->stream_count, sizeof(TSDSystemHeaderStream));
-                    if(!sysh->streams) return TSD_OUT_OF_MEMORY;
-                    size_t i;
-                    size_t used = 0;
-                    for(i=0; i<sysh->stream_count; ++i) {
-                        // make sure the first bit is set in the stream id
-                        if((*ptr) & 0x80) {
-                            used++;
-                            TSDSystemHeaderStream *stream = &sysh->streams[i];
-                            stream->stream_id = *ptr;
-                            ptr++;
-                            stream->pstd_buffer_bound_scale = ((*ptr) >> 5) & 0x01;
-                            stream->pstd_buffer_size_bound = parse_u16(ptr) & 0x1FFF;
-                            ptr = &ptr[2];
-                        }
-                    }
-                    sysh->stream_count = used;
-                }
-            }
-            if(pes->extension.flags & TSD_PEF_PROGRAM_PACKET_SEQUENCE_COUNTER_FLAG) {
-                pes->extension.program_packet_sequence_counter = (*ptr) & 0x7F;
-                ptr++;
-                pes->extension.mpeg1_mpeg2_identifier = ((*ptr) >> 6) & 0x01;
-                pes->extension.original_stuff_length = (*ptr) & 0x3F;
-                ptr++;
-            }
-            if(pes->extension.flags & TSD_PEF_PSTD_BUFFER_FLAG) {
-                pes->extension.pstd_buffer_scale = ((*ptr) >> 5) & 0x01;
-                pes->extension.pstd_buffer_size = parse_u16(ptr) & 0x1FFF;
-                ptr = &ptr[2];
+    }
+    return lo;
+}
+
+void directory_clear_pmt(TSDemuxContext *ctx, TSDProgram *program)
+{
+    if(program->has_pmt) {
+        destroy_pmt_data(ctx, &program->pmt);
+    }
+    if(program->data) {
+        mem_free(ctx, program->data);
+    }
+    program->has_pmt = 0;
+    program->data = NULL;
+    program->data_length = 0;
+}
+
+void directory_destroy(TSDemuxContext *ctx)
+{
+    size_t i;
+    for(i=0; i<ctx->directory.length; ++i) {
+        directory_clear_pmt(ctx, &ctx->directory.programs[i]);
+    }
+    if(ctx->directory.programs) {
+        mem_free(ctx, ctx->directory.programs);
+    }
+    if(ctx->directory.streams) {
+        mem_free(ctx, ctx->directory.streams);
+    }
+    memset(&ctx->directory, 0, sizeof(ctx->directory));
+}
+
+// adds a program at its sorted position, returns NULL when out of memory.
+TSDProgram *directory_insert(TSDemuxContext *ctx,
+                             size_t idx,
+                             uint16_t program_number,
+                             uint16_t pmt_pid)
+{
+    if(ctx->directory.length == ctx->directory.capacity) {
+        size_t capacity = ctx->directory.capacity ?
+                          ctx->directory.capacity * 2 : 8;
+        TSDProgram *programs = (TSDProgram*) mem_realloc(ctx,
+                               ctx->directory.programs,
+                               capacity * sizeof(TSDProgram));
+        if(!programs) return NULL;
+        ctx->directory.programs = programs;
+        ctx->directory.capacity = capacity;
+    }
+    TSDProgram *program = &ctx->directory.programs[idx];
+    memmove(program + 1, program,
+            (ctx->directory.length - idx) * sizeof(TSDProgram));
+    ctx->directory.length++;
+    memset(program, 0, sizeof(TSDProgram));
+    program->program_number = program_number;
+    program->pmt_pid = pmt_pid;
+    return program;
+}
+
+// rebuilds the index of elementary streams by PID.
+TSDCode directory_index_streams(TSDemuxContext *ctx)
+{
+    size_t count = 0;
+    size_t i, j;
+    for(i=0; i<ctx->directory.length; ++i) {
+        count += ctx->directory.programs[i].pmt.program_elements_length;
+    }
+    if(count > ctx->directory.streams_capacity) {
+        TSDProgramStreamRef *streams = (TSDProgramStreamRef*) mem_realloc(ctx,
+                                       ctx->directory.streams,
+                                       count * sizeof(TSDProgramStreamRef));
+        if(!streams) {
+            ctx->directory.streams_length = 0;
+            return TSD_OUT_OF_MEMORY;
+        }
+        ctx->directory.streams = streams;
+        ctx->directory.streams_capacity = count;
+    }
+
+    // insertion sort, the streams of a PMT usually come in PID order
+    TSDProgramStreamRef *streams = ctx->directory.streams;
+    size_t length = 0;
+    for(i=0; i<ctx->directory.length; ++i) {
+        const TSDPMTData *pmt = &ctx->directory.programs[i].pmt;
+        for(j=0; j<pmt->program_elements_length; ++j) {
+            TSDProgramStreamRef ref;
+            ref.pid = pmt->program_elements[j].elementary_pid;
+            ref.program = (uint16_t)i;
+            ref.element = (uint16_t)j;
+            size_t k = length++;
+            while(k > 0 && streams[k-1].pid > ref.pid) {
+                streams[k] = streams[k-1];
+                --k;
             }
-            if(pes->extension.flags & TSD_PEF_PES_EXTENSION_FLAG_2) {
-                pes->extension.pes_extension_field_length = (*ptr) & 0x7F;
-                ptr = &ptr[1 + pes->extension.pes_extension_field_length];
+            streams[k] = ref;
+        }
+    }
+    ctx->directory.streams_length = length;
+    return TSD_OK;
+}
+
+int pat_has_program(const TSDPATData *pat, uint16_t program_number)
+{
+    size_t i;
+    for(i=0; i<pat->length; ++i) {
+        if(pat->program_number[i] == program_number) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// brings the directory in line with a new PAT, keeping the PMTs of the
+// programs still in it.
+TSDCode directory_set_pat(TSDemuxContext *ctx, const TSDPATData *pat)
+{
+    size_t i;
+    size_t kept = 0;
+    int changed = 0;
+    for(i=0; i<ctx->directory.length; ++i) {
+        TSDProgram *program = &ctx->directory.programs[i];
+        if(pat_has_program(pat, program->program_number)) {
+            ctx->directory.programs[kept++] = *program;
+        } else {
+            directory_clear_pmt(ctx, program);
+            changed = 1;
+        }
+    }
+    ctx->directory.length = kept;
+
+    for(i=0; i<pat->length; ++i) {
+        // program number 0 is the network PID, not a program
+        if(pat->program_number[i] == 0) continue;
+        size_t idx = directory_search(ctx, pat->program_number[i]);
+        if(idx < ctx->directory.length &&
+           ctx->directory.programs[idx].program_number == pat->program_number[i]) {
+            if(ctx->directory.programs[idx].pmt_pid != pat->pid[i]) {
+                ctx->directory.programs[idx].pmt_pid = pat->pid[i];
+                changed = 1;
             }
+        } else if(directory_insert(ctx, idx, pat->program_number[i], pat->pid[i])) {
+            changed = 1;
+        } else {
+            return TSD_OUT_OF_MEMORY;
+        }
+    }
+
+    if(!changed) {
+        return TSD_OK;
+    }
+    ctx->directory.generation++;
+    return directory_index_streams(ctx);
+}
+
+// stores the PMT of a program. The table data is copied so that the PMT
+// outlives the section buffers. Only programs of the PAT are in the directory,
+// so TSDProgram pointers stay valid until the next PAT change.
+TSDCode directory_set_pmt(TSDemuxContext *ctx,
+                          uint16_t program_number,
+                          const uint8_t *block,
+                          size_t written,
+                          TSDProgram **out)
+{
+    size_t idx = directory_search(ctx, program_number);
+    if(idx >= ctx->directory.length ||
+       ctx->directory.programs[idx].program_number != program_number) {
+        return TSD_PROGRAM_NOT_FOUND;
+    }
+    TSDProgram *program = &ctx->directory.programs[idx];
+
+    // a repeat of the same PMT isn't a change
+    if(program->has_pmt && program->data_length == written &&
+       memcmp(program->data, block, written) == 0) {
+        *out = program;
+        return TSD_OK;
+    }
+
+    uint8_t *data = (uint8_t*) mem_malloc(ctx, written);
+    if(!data) return TSD_OUT_OF_MEMORY;
+    memcpy(data, block, written);
+
+    TSDPMTData pmt;
+    memset(&pmt, 0, sizeof(pmt));
+    TSDCode res = tsd_parse_pmt(ctx, data, written, &pmt);
+    if(res != TSD_OK) {
+        mem_free(ctx, data);
+        return res;
+    }
+
+    directory_clear_pmt(ctx, program);
+    program->pmt = pmt;
+    program->data = data;
+    program->data_length = written;
+    program->has_pmt = 1;
+    *out = program;
+
+    ctx->directory.generation++;
+    return directory_index_streams(ctx);
+}
+
+TSDCode tsd_get_program(TSDemuxContext *ctx,
+                        uint16_t program_number,
+                        const TSDProgram **program)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(program == NULL)     return TSD_INVALID_ARGUMENT;
+
+    size_t idx = directory_search(ctx, program_number);
+    if(idx >= ctx->directory.length ||
+       ctx->directory.programs[idx].program_number != program_number) {
+        return TSD_PROGRAM_NOT_FOUND;
+    }
+    *program = &ctx->directory.programs[idx];
+    return TSD_OK;
+}
+
+TSDCode tsd_get_program_by_pid(TSDemuxContext *ctx,
+                               uint16_t pid,
+                               const TSDProgram **program,
+                               const TSDProgramElement **element)
+{
+    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
+    if(program == NULL)     return TSD_INVALID_ARGUMENT;
+
+    size_t lo = 0;
+    size_t hi = ctx->directory.streams_length;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(ctx->directory.streams[mid].pid < pid) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if(lo >= ctx->directory.streams_length ||
+       ctx->directory.streams[lo].pid != pid) {
+        return TSD_PID_NOT_FOUND;
+    }
+
+    const TSDProgramStreamRef *ref = &ctx->directory.streams[lo];
+    *program = &ctx->directory.programs[ref->program];
+    if(element) {
+        *element = &(*program)->pmt.program_elements[ref->element];
+    }
+    return TSD_OK;
+}
+
+TSDCode tsd_find_stream_type(TSDemuxContext *ctx,
+                             uint8_t stream_type,
+                             size_t *cursor,
+                             const TSDProgram **program,
+                             const TSDProgramElement **element)
+{
+    if(ctx == NULL)                                 return TSD_INVALID_CONTEXT;
+    if(cursor == NULL || program == NULL ||
+       element == NULL)                             return TSD_INVALID_ARGUMENT;
+
+    size_t i;
+    for(i=*cursor; i<ctx->directory.streams_length; ++i) {
+        const TSDProgramStreamRef *ref = &ctx->directory.streams[i];
+        const TSDProgram *prog = &ctx->directory.programs[ref->program];
+        const TSDProgramElement *elem = &prog->pmt.program_elements[ref->element];
+        if(elem->stream_type == stream_type) {
+            *program = prog;
+            *element = elem;
+            *cursor = i + 1;
+            return TSD_OK;
+        }
+    }
+    *cursor = ctx->directory.streams_length;
+    return TSD_END_OF_DATA;
+}
+
+TSDCode demux_pat_table(TSDemuxContext *ctx,
+                        uint16_t pid,
+                        TSDTable *table,
+                        uint8_t *block,
+                        size_t written)
+{
+    // parse the PAT.
+    // cleanup the old PAT data and the PMT routes it set.
+    if(ctx->pat.valid == 1) {
+        ctx->pat.valid = 0;
+        pid_map_set_pmts(ctx, &ctx->pat.value, 0);
+        destroy_pat_data(ctx, &ctx->pat.value);
+    }
+    // parse the new PAT data.
+    TSDPATData *pat = &ctx->pat.value;
+    memset(pat, 0, sizeof(TSDPATData));
+    TSDCode res = tsd_parse_pat(ctx, block, written, pat);
+
+    if(TSD_OK == res) {
+        ctx->pat.valid = 1;
+        pid_map_set_pmts(ctx, pat, 1);
+        res = directory_set_pat(ctx, pat);
+        if(res != TSD_OK) {
+            return res;
         }
-        // get past any stuffing
-        while(ptr < header_end && *ptr == 0xFF) {
-            ptr++;
+        // the programs may have changed, deliver every PMT again
+        table_cache_keep_pid(ctx, pid);
+        table_cache_store(ctx, pid, table);
+        // call the user callback
+        if(ctx->event_cb) {
+            ctx->event_cb(ctx, pid, TSD_EVENT_PAT, (void*)pat);
         }
-        pes->data_bytes = ptr;
-        pes->data_bytes_length = end - ptr;
+    } else {
+        // we're not sure what went wrong... something royal
+        ctx->pat.valid = 0;
+        return TSD_PARSE_ERROR;
     }
 
     return TSD_OK;
 }
 
-TSDCode tsd_parse_descriptors(TSDemuxContext *ctx,
-                              const uint8_t *data,
-                              size_t size,
-                              TSDDescriptorData *descriptorData)
+TSDCode demux_pat(TSDemuxContext *ctx, TSDPacket *hdr)
 {
+    return demux_tables(ctx, hdr, 1, demux_pat_table);
+}
 
-    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
-    if(data == NULL)                return TSD_INVALID_DATA;
-    if(size < 2)                    return TSD_INVALID_DATA_SIZE;
-    if(descriptorData == NULL)      return TSD_INVALID_ARGUMENT;
+TSDCode demux_pmt_table(TSDemuxContext *ctx,
+                        uint16_t pid,
+                        TSDTable *table,
+                        uint8_t *block,
+                        size_t written)
+{
+    // other tables can share the PMT PID, only a TS_program_map_section is
+    // a PMT.
+    if(table->sections[0].table_id != 0x02) {
+        return TSD_OK;
+    }
 
-    size_t count = descriptor_count(data, size);
-    if(count == 0) {
-        descriptorData->descriptors = NULL;
-        descriptorData->descriptors_length = 0;
-    } else {
-        descriptorData->descriptors = (TSDDescriptor*) ctx->calloc(count,
-                                      sizeof(TSDDescriptor));
-        if(!descriptorData->descriptors) return TSD_OUT_OF_MEMORY;
-        descriptorData->descriptors_length = count;
+    // parse the PMT TSDTable into the program directory, where it stays
+    TSDProgram *program = NULL;
+    TSDCode res = directory_set_pmt(ctx, table->sections[0].table_id_extension,
+                                    block, written, &program);
+
+    if(TSD_OK == res) {
+        program->pmt.crc_32 = table->sections[table->length - 1].crc_32;
+        table_cache_store(ctx, pid, table);
+        if(ctx->event_cb) {
+            ctx->event_cb(ctx, pid, TSD_EVENT_PMT, (void*)&program->pmt);
+        }
     }
 
-    return TSD_OK;
+    return res;
 }
 
-TSDCode tsd_data_context_init(TSDemuxContext *ctx, TSDDataContext *dataCtx)
+TSDCode demux_pmt(TSDemuxContext *ctx, TSDPacket *hdr)
 {
-    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
-    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
+    return demux_tables(ctx, hdr, 1, demux_pmt_table);
+}
 
-    dataCtx->buffer = (uint8_t*)ctx->malloc(TSD_MEM_PAGE_SIZE);
-    dataCtx->end = dataCtx->buffer + TSD_MEM_PAGE_SIZE;
-    dataCtx->write = dataCtx->buffer;
-    dataCtx->size = TSD_MEM_PAGE_SIZE;
+TSDCode demux_descriptors_table(TSDemuxContext *ctx,
+                                uint16_t pid,
+                                TSDTable *table,
+                                uint8_t *block,
+                                size_t written)
+{
+    // the descriptors are all there is, the table itself isn't reported
+    (void)table;
+
+    // parse all the outter descriptors
+    TSDDescriptorData descriptorData;
+    TSDCode res = tsd_parse_descriptors(ctx, block, written, &descriptorData);
+
+    // call the callback with the descriptors and TSDTable data
+    if(TSD_OK == res) {
+        if(ctx->event_cb) {
+            TSDEventId event;
+            switch(pid) {
+            case TSD_PID_CAT:
+                event = TSD_EVENT_CAT;
+                break;
+            case TSD_PID_TSDT:
+                event = TSD_EVENT_TSDT;
+                break;
+            default:
+                event = TSD_EVENT_TSDT;
+                break;
+            }
+            ctx->event_cb(ctx, pid, event, (void*)&descriptorData);
+        }
+        if(descriptorData.descriptors) {
+            mem_free(ctx, descriptorData.descriptors);
+        }
+    }
 
     return TSD_OK;
 }
 
-TSDCode tsd_data_context_destroy(TSDemuxContext *ctx, TSDDataContext *dataCtx)
+TSDCode demux_descriptors(TSDemuxContext *ctx, TSDPacket *hdr)
 {
-    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
-    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
+    return demux_tables(ctx, hdr, 0, demux_descriptors_table);
+}
 
-    if(dataCtx->buffer != NULL) {
-        ctx->free(dataCtx->buffer);
-        memset(dataCtx, 0, sizeof(TSDDataContext));
+TSDCode demux_sections_table(TSDemuxContext *ctx,
+                             uint16_t pid,
+                             TSDTable *table,
+                             uint8_t *block,
+                             size_t written)
+{
+    if(ctx->event_cb) {
+        TSDTableData data;
+        data.table = table;
+        data.data = block;
+        data.size = written;
+        ctx->event_cb(ctx, pid, TSD_EVENT_TABLE, (void*)&data);
     }
 
     return TSD_OK;
 }
 
-TSDCode tsd_data_context_write(TSDemuxContext *ctx,
-                               TSDDataContext *dataCtx,
-                               const uint8_t *data,
-                               size_t size)
+TSDCode demux_sections(TSDemuxContext *ctx, TSDPacket *hdr)
 {
-    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
-    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
-    if(data == NULL)        return TSD_INVALID_DATA;
-    if(size == 0)           return TSD_INVALID_DATA_SIZE;
+    return demux_tables(ctx, hdr, 0, demux_sections_table);
+}
 
-    // if we don't have enough space we'll need to reallocate the  data.
-    size_t space = (size_t)(dataCtx->end - dataCtx->write);
-    if(space < size) {
-        // reallocate enough memory aligning it to the default size
-        size_t align = TSD_MEM_PAGE_SIZE;
-        size_t new_size = dataCtx->size + ((((size-space)/align) + 1) * align);
-        size_t used = dataCtx->size - space;
+TSDDataContext *registered_data(TSDemuxContext *ctx, uint16_t pid)
+{
+    TSDPIDRoute route = ctx->pid_map[pid];
+    if(!(route.flags & TSD_ROUTE_REGISTERED)) return NULL;
+    return ctx->registered_pids_data[route.index];
+}
 
-        void *mem = ctx->realloc(dataCtx->buffer, new_size);
-        if(!mem) {
-            return TSD_OUT_OF_MEMORY;
+// learns the size of the PES packets on a PID. The hint follows the largest
+// recent packet and slowly decays, so a single oversized frame is forgotten.
+void pes_size_hint_update(TSDemuxRegistration *reg, size_t size)
+{
+    if(size >= reg->size_hint) {
+        reg->size_hint = size;
+    } else {
+        reg->size_hint -= (reg->size_hint - size) / 16;
+    }
+}
+
+// starts tracking the access units of a new PES on a PID registered with
+// TSD_REG_PES_AU_END. Only AVC and HEVC streams are tracked.
+void pes_au_start(TSDemuxContext *ctx, TSDemuxRegistration *reg)
+{
+    reg->au_stream_type = 0;
+    reg->au_scanned = 0;
+    reg->au_vcl = 0;
+    reg->au_continued = 0;
+    if(!(reg->data_types & TSD_REG_PES_AU_END)) {
+        return;
+    }
+    const TSDProgram *program;
+    const TSDProgramElement *element;
+    if(tsd_get_program_by_pid(ctx, reg->pid, &program, &element) == TSD_OK &&
+       (element->stream_type == TSD_PMT_STREAM_TYPE_VIDEO_AVC ||
+        element->stream_type == TSD_PMT_STREAM_TYPE_VIDEO_HEVC)) {
+        reg->au_stream_type = element->stream_type;
+    }
+}
+
+// whether every access unit of the PES in the buffer was delivered already,
+// leaving just its header.
+int pes_au_drained(TSDemuxRegistration *reg, TSDDataContext *dataCtx)
+{
+    size_t size = dataCtx->write - dataCtx->buffer;
+    return reg->au_continued && size <= pes_header_size(dataCtx->buffer, size);
+}
+
+// whether the NAL unit with this first header byte ends the access unit
+// being received. Returns 1 when the access unit ends before the NAL unit,
+// 2 when it ends with it and 0 otherwise.
+int pes_au_boundary(TSDemuxRegistration *reg, uint8_t nal_header)
+{
+    if(reg->au_stream_type == TSD_PMT_STREAM_TYPE_VIDEO_AVC) {
+        // H.264 7.4.1.2.3
+        uint8_t type = nal_header & 0x1F;
+        if(type >= 1 && type <= 5) {
+            reg->au_vcl = 1;
+        } else if(reg->au_vcl) {
+            if(type == 10 || type == 11) return 2;
+            if((type >= 6 && type <= 9) || (type >= 14 && type <= 18)) return 1;
+        }
+    } else {
+        // H.265 7.4.2.4.4
+        uint8_t type = (nal_header >> 1) & 0x3F;
+        if(type <= 31) {
+            reg->au_vcl = 1;
+        } else if(reg->au_vcl) {
+            if(type == 36 || type == 37) return 2;
+            if((type >= 32 && type <= 35) || type == 39 ||
+               (type >= 41 && type <= 44) || (type >= 48 && type <= 55)) return 1;
         }
+    }
+    return 0;
+}
 
-        dataCtx->buffer = (uint8_t*)mem;
-        dataCtx->end = dataCtx->buffer + new_size;
-        dataCtx->write = dataCtx->buffer + used;
-        dataCtx->size = new_size;
+// looks through the data added to an unbounded video PES for the end of an
+// access unit. Everything up to it is delivered as a PES of its own, the rest
+// stays in the buffer behind the same header, minus PTS, DTS and the other
+// optional fields as those belong to the first access unit of the PES.
+TSDCode pes_au_end(TSDemuxContext *ctx, uint16_t pid)
+{
+    TSDemuxRegistration *reg = &ctx->registered_pids[ctx->pid_map[pid].index];
+    if(reg->au_stream_type == 0) {
+        return TSD_OK;
     }
+    TSDDataContext *dataCtx = ctx->registered_pids_data[ctx->pid_map[pid].index];
+    uint8_t *buffer = dataCtx->buffer;
+    size_t size = dataCtx->write - buffer;
+    size_t header = pes_header_size(buffer, size);
+    if(header == 0 || header > size) {
+        return TSD_OK;
+    }
+    size_t nal_header_size = reg->au_stream_type == TSD_PMT_STREAM_TYPE_VIDEO_AVC ? 1 : 2;
 
-    // write the data into the buffer
-    memcpy(dataCtx->write, data, size);
-    dataCtx->write += size;
+    size_t i = reg->au_scanned > header ? reg->au_scanned : header;
+    while(i + 3 < size) {
+        if(buffer[i + 2] > 1) {
+            i += 3;
+            continue;
+        }
+        if(buffer[i] != 0 || buffer[i + 1] != 0 || buffer[i + 2] != 1) {
+            i++;
+            continue;
+        }
+        size_t cut;
+        int boundary = pes_au_boundary(reg, buffer[i + 3]);
+        if(boundary == 0) {
+            i += 3;
+            continue;
+        } else if(boundary == 1) {
+            // a zero_byte in front of the start code belongs to the next NAL
+            cut = (i > header && buffer[i - 1] == 0) ? i - 1 : i;
+        } else {
+            cut = i + 3 + nal_header_size;
+            if(cut > size) {
+                break;
+            }
+        }
+
+        TSDPESPacket pes;
+        if(tsd_parse_pes(ctx, buffer, cut, &pes) != TSD_OK) {
+            return TSD_PARSE_ERROR;
+        }
+        ctx->event_cb(ctx, pid, TSD_EVENT_PES, (void *)&pes);
+        // the callback may have deregistered the PID
+        if(!(ctx->pid_map[pid].flags & TSD_ROUTE_REGISTERED)) {
+            return TSD_OK;
+        }
+        reg = &ctx->registered_pids[ctx->pid_map[pid].index];
+
+        // keep the rest behind the header, its optional fields turned into
+        // stuffing
+        memmove(&buffer[header], &buffer[cut], size - cut);
+        size = header + size - cut;
+        dataCtx->write = &buffer[size];
+        if(header > 9) {
+            buffer[7] = 0x00;
+            memset(&buffer[9], 0xFF, header - 9);
+        }
+        reg->au_vcl = 0;
+        reg->au_continued = 1;
+        i = header;
+    }
+    reg->au_scanned = i;
     return TSD_OK;
 }
 
-TSDCode tsd_data_context_reset(TSDemuxContext *ctx, TSDDataContext *dataCtx)
+TSDCode pes_slices_deliver(TSDemuxContext *ctx, int reg_idx);
+TSDCode pes_stream_end(TSDemuxContext *ctx, int reg_idx);
+
+TSDCode demux_pes_flush(TSDemuxContext *ctx, int reg_idx)
 {
-    if(ctx == NULL)         return TSD_INVALID_CONTEXT;
-    if(dataCtx == NULL)     return TSD_INVALID_ARGUMENT;
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(reg_idx < 0)     return TSD_INVALID_ARGUMENT;
 
-    dataCtx->write = dataCtx->buffer;
+    if(ctx->registered_pids[reg_idx].data_types & TSD_REG_PES_STREAM) {
+        return pes_stream_end(ctx, reg_idx);
+    }
+    if(ctx->registered_pids[reg_idx].data_types & TSD_REG_PES_SLICES) {
+        return pes_slices_deliver(ctx, reg_idx);
+    }
+
+    TSDDataContext *dataCtx = ctx->registered_pids_data[reg_idx];
+    if(pes_au_drained(&ctx->registered_pids[reg_idx], dataCtx)) {
+        tsd_data_context_reset(ctx, dataCtx);
+    }
+
+    // if the buffer already has same data in it, we will parse it.
+    size_t data_len = dataCtx->write - dataCtx->buffer;
+    if(data_len > 0) {
+        pes_size_hint_update(&ctx->registered_pids[reg_idx], data_len);
+        TSDPESPacket pes;
+        TSDCode res = tsd_parse_pes(ctx, dataCtx->buffer, data_len, &pes);
+        if(res != TSD_OK) {
+            return res;
+        } else {
+            // call the user callback with the data.
+            uint16_t pid = ctx->registered_pids[reg_idx].pid;
+            ctx->event_cb(ctx, pid, TSD_EVENT_PES, (void *)&pes);
+            // the callback may have deregistered the PID
+            dataCtx = registered_data(ctx, pid);
+            if(dataCtx == NULL) return TSD_OK;
+        }
+        // clear the DataContext.
+        tsd_data_context_reset(ctx, dataCtx);
+    }
     return TSD_OK;
 }
 
-TSDCode tsd_descriptor_extract(TSDemuxContext *ctx,
-                               const uint8_t *data,
-                               size_t data_size,
-                               TSDDescriptor **descriptors,
-                               size_t *descriptors_length)
+TSDCode demux_pes(TSDemuxContext *ctx, TSDPacket *hdr, int reg_idx)
 {
     if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(hdr == NULL)     return TSD_INVALID_ARGUMENT;
 
-    size_t count = descriptor_count(data, data_size);
-
-    if(count == 0) {
-        *descriptors = NULL;
-        *descriptors_length = 0;
+    // make sure we have some data to parse.
+    if(hdr->data_bytes_length == 0 || !hdr->data_bytes) {
         return TSD_OK;
     }
 
-    // create and parse the descriptors
-    TSDDescriptor *descriptors_tmp = (TSDDescriptor*) ctx->calloc(count,
-                                     sizeof(TSDDescriptor));
+    const uint8_t *ptr = hdr->data_bytes;
+    TSDDataContext *dataCtx = ctx->registered_pids_data[reg_idx];
+    TSDCode initial_parse_res = TSD_OK;
 
-    if(!descriptors_tmp) return TSD_OUT_OF_MEMORY;
+    size_t ptr_len = hdr->data_bytes_length;
+    // is this the start of a new PES packet?
+    if((hdr->flags & TSD_PF_PAYLOAD_UNIT_START_IND)) {
+        if(pes_au_drained(&ctx->registered_pids[reg_idx], dataCtx)) {
+            tsd_data_context_reset(ctx, dataCtx);
+        }
+        // if the buffer already has same data in it, we will parse it.
+        size_t data_len = dataCtx->write - dataCtx->buffer;
+        if(data_len > 0) {
+            pes_size_hint_update(&ctx->registered_pids[reg_idx], data_len);
+            TSDPESPacket pes;
+            initial_parse_res = tsd_parse_pes(ctx, dataCtx->buffer, data_len, &pes);
+            if(initial_parse_res == TSD_OK) {
+                // call the user callback with the data.
+                ctx->event_cb(ctx, hdr->pid, TSD_EVENT_PES, (void *)&pes);
+                // the callback may have deregistered the PID
+                dataCtx = registered_data(ctx, hdr->pid);
+                if(dataCtx == NULL) return TSD_OK;
+            } else {
+                initial_parse_res = TSD_PARSE_ERROR;
+            }
+            // clear the DataContext for the new packet data.
+            tsd_data_context_reset(ctx, dataCtx);
+        }
+
+        // a PES that fits in this packet is delivered straight from the
+        // packet data without being copied.
+        size_t expected = ctx->registered_pids[ctx->pid_map[hdr->pid].index].size_hint;
+        if(ptr_len > 5) {
+            size_t pes_len = parse_u16(&ptr[4]);
+            if(pes_len > 0 && pes_len + 6 <= ptr_len) {
+                TSDPESPacket pes;
+                if(tsd_parse_pes(ctx, ptr, pes_len + 6, &pes) != TSD_OK) {
+                    return TSD_PARSE_ERROR;
+                }
+                ctx->event_cb(ctx, hdr->pid, TSD_EVENT_PES, (void *)&pes);
+                return initial_parse_res;
+            }
+            if(pes_len > 0) {
+                expected = pes_len + 6;
+            }
+        }
+
+        pes_au_start(ctx, &ctx->registered_pids[ctx->pid_map[hdr->pid].index]);
+
+        // size the buffer for the whole PES before any of it is copied, from
+        // PES_packet_length or else from the recent packets on the PID.
+        TSDCode res = tsd_data_context_reserve(ctx, dataCtx, expected);
+        if(res != TSD_OK) {
+            return res;
+        }
+    }
+
+    // write the data into the DataContext.
+    TSDCode res = tsd_data_context_write(ctx, dataCtx, ptr, ptr_len);
+    if(res != TSD_OK) {
+        return res;
+    }
+
+    // get the PES length to see if we have the complete packet.
+    size_t data_len = dataCtx->write - dataCtx->buffer;
+    // make sure we have enough data to parse the PES
+    // the PES header starts with 6 bytes:
+    //    packet_start_code_prefix(24), stream_id(8) and PES_packet_length(16)
+    if(data_len > 5) {
+        // get the PES length
+        uint16_t pes_len = parse_u16(&dataCtx->buffer[4]);
+        // if the amount of data in the DataContext matches the PES length
+        // we have enough data to parse the PES packet.
+        // PES_packet_length doesn't include the first 6 bytes PES header
+        if(pes_len > 0 && data_len >= pes_len + 6) {
+            pes_size_hint_update(&ctx->registered_pids[ctx->pid_map[hdr->pid].index],
+                                 data_len);
+            TSDPESPacket pes;
+            res = tsd_parse_pes(ctx, dataCtx->buffer, data_len, &pes);
+            if(res != TSD_OK) {
+                return TSD_PARSE_ERROR;
+            } else {
+                // call the user callback with the data.
+                ctx->event_cb(ctx, hdr->pid, TSD_EVENT_PES, (void *)&pes);
+                dataCtx = registered_data(ctx, hdr->pid);
+                if(dataCtx == NULL) return initial_parse_res;
+            }
+            tsd_data_context_reset(ctx, dataCtx);
+        } else if(pes_len == 0) {
+            res = pes_au_end(ctx, hdr->pid);
+            if(res != TSD_OK) {
+                return res;
+            }
+        }
+    }
+    return initial_parse_res;
+}
 
-    // parse the individual descriptors
-    parse_descriptor(data, data_size, descriptors_tmp, count);
-    *descriptors_length = count;
-    *descriptors = descriptors_tmp;
+// copies the first size bytes of the PES being received on a sliced PID, from
+// the copied prefix and then the slices. Returns the number of bytes copied.
+size_t pes_slices_gather(TSDDataContext *dataCtx,
+                         TSDemuxRegistration *reg,
+                         uint8_t *out,
+                         size_t size)
+{
+    size_t copied = dataCtx->write - dataCtx->buffer;
+    if(copied > size) {
+        copied = size;
+    }
+    if(copied > 0) {
+        memcpy(out, dataCtx->buffer, copied);
+    }
+    size_t i;
+    for(i=1; i<reg->slices_length && copied < size; ++i) {
+        size_t take = reg->slices[i].length;
+        if(take > size - copied) {
+            take = size - copied;
+        }
+        memcpy(&out[copied], reg->slices[i].data, take);
+        copied += take;
+    }
+    return copied;
+}
 
+TSDCode pes_slices_append(TSDemuxContext *ctx,
+                          TSDemuxRegistration *reg,
+                          const uint8_t *data,
+                          size_t length)
+{
+    // slot 0 is kept for the copied prefix
+    size_t next = reg->slices_length > 0 ? reg->slices_length : 1;
+    if(next >= reg->slices_capacity) {
+        size_t capacity = reg->slices_capacity > 0 ? reg->slices_capacity * 2 :
+                          TSD_PES_SLICES_INITIAL_CAPACITY;
+        TSDSlice *slices = (TSDSlice*) mem_realloc(ctx, reg->slices,
+                                                   capacity * sizeof(TSDSlice));
+        if(slices == NULL) {
+            return TSD_OUT_OF_MEMORY;
+        }
+        reg->slices = slices;
+        reg->slices_capacity = capacity;
+    }
+    reg->slices[next].data = data;
+    reg->slices[next].length = length;
+    reg->slices_length = next + 1;
+    reg->slices_bytes += length;
     return TSD_OK;
 }
 
-TSDCode tsd_table_data_extract(TSDemuxContext *ctx,
-                               TSDPacket *hdr,
-                               TSDTable *table,
-                               uint8_t **mem,
-                               size_t *size)
+// delivers the PES received so far on a sliced PID, if there is one.
+TSDCode pes_slices_deliver(TSDemuxContext *ctx, int reg_idx)
 {
-    memset(table, 0, sizeof(TSDTable));
-    TSDCode res = tsd_parse_table(ctx, hdr, table);
-
-    if(res != TSD_OK && res != TSD_INCOMPLETE_TABLE) {
-        // clear the active buffer if it is set
-        tsd_data_context_reset(ctx, ctx->buffers.active);
-        ctx->buffers.active = NULL;
-        return res;
+    TSDemuxRegistration *reg = &ctx->registered_pids[reg_idx];
+    TSDDataContext *dataCtx = ctx->registered_pids_data[reg_idx];
+    size_t prefix = dataCtx->write - dataCtx->buffer;
+    size_t total = prefix + reg->slices_bytes;
+    if(total == 0) {
+        return TSD_OK;
     }
-
-    // there may not be any sections available yet.
-    if(!table->sections) {
-        return res;
+    pes_size_hint_update(reg, total);
+
+    // the header is parsed from a copy as it may span several slices
+    uint8_t header[TSD_PES_HEADER_MAX_SIZE];
+    memset(header, 0, sizeof(header));
+    size_t header_len = pes_slices_gather(dataCtx, reg, header, sizeof(header));
+
+    uint16_t pid = reg->pid;
+    TSDPESSlices out;
+    TSDCode res = tsd_parse_pes(ctx, header, header_len, &out.pes);
+    if(res == TSD_OK) {
+        size_t skip = out.pes.data_bytes ? (size_t)(out.pes.data_bytes - header) : 6;
+        if(skip > total) {
+            skip = total;
+        }
+        TSDSlice *slices = reg->slices;
+        size_t first = prefix > 0 ? 0 : 1;
+        size_t count = reg->slices_length > 0 ? reg->slices_length : 1;
+        slices[0].data = dataCtx->buffer;
+        slices[0].length = prefix;
+        out.pes.data_bytes = NULL;
+        out.pes.data_bytes_length = total - skip;
+        // leave the header out of the slices
+        while(skip > 0 && first < count) {
+            if(slices[first].length <= skip) {
+                skip -= slices[first].length;
+                first++;
+            } else {
+                slices[first].data += skip;
+                slices[first].length -= skip;
+                skip = 0;
+            }
+        }
+        out.slices = &slices[first];
+        out.slices_length = count - first;
+        ctx->event_cb(ctx, pid, TSD_EVENT_PES_SLICES, (void*)&out);
+        // the callback may have deregistered the PID
+        if(!(ctx->pid_map[pid].flags & TSD_ROUTE_REGISTERED)) {
+            return TSD_OK;
+        }
+        reg = &ctx->registered_pids[ctx->pid_map[pid].index];
+        dataCtx = ctx->registered_pids_data[ctx->pid_map[pid].index];
+    } else {
+        res = TSD_PARSE_ERROR;
     }
+    reg->slices_length = 0;
+    reg->slices_bytes = 0;
+    tsd_data_context_reset(ctx, dataCtx);
+    return res;
+}
 
-    // get the data context for the table in question using the first section
-    // as a reference.
-    TSDTableSection *section = &table->sections[0];
-    TSDDataContext *data = NULL;
-    res = get_data_context(ctx,
-                           section->table_id,
-                           section->table_id_extension,
-                           section->version_number,
-                           &data);
+// demuxes the PES on a PID registered with TSD_REG_PES_SLICES. The payload of
+// each packet is kept as a slice pointing into the packet itself.
+TSDCode demux_pes_slices(TSDemuxContext *ctx, TSDPacket *hdr, int reg_idx)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(hdr == NULL)     return TSD_INVALID_ARGUMENT;
 
-    // the table could be incomplete at this point, so continue parsing
-    if(res == TSD_INCOMPLETE_TABLE || (data && data->size == 0)) {
-        return TSD_INCOMPLETE_TABLE;
+    if(hdr->data_bytes_length == 0 || !hdr->data_bytes) {
+        return TSD_OK;
     }
 
-    // we have a complete table.
-    // create a contiguous memory buffer for parsing the table
-    if(res != TSD_OK) {
-        return res;
+    TSDCode res = TSD_OK;
+    if(hdr->flags & TSD_PF_PAYLOAD_UNIT_START_IND) {
+        res = pes_slices_deliver(ctx, reg_idx);
+        if(!(ctx->pid_map[hdr->pid].flags & TSD_ROUTE_REGISTERED)) {
+            return res;
+        }
+        reg_idx = ctx->pid_map[hdr->pid].index;
+    } else if(ctx->registered_pids[reg_idx].slices_bytes == 0 &&
+              ctx->registered_pids_data[reg_idx]->write ==
+              ctx->registered_pids_data[reg_idx]->buffer) {
+        // the start of this PES was missed
+        return TSD_OK;
     }
 
-    size_t block_size = data->write - data->buffer;
-    if(block_size == 0) {
-        return TSD_INVALID_DATA_SIZE;
+    TSDemuxRegistration *reg = &ctx->registered_pids[reg_idx];
+    TSDDataContext *dataCtx = ctx->registered_pids_data[reg_idx];
+    TSDCode append = pes_slices_append(ctx, reg, hdr->data_bytes, hdr->data_bytes_length);
+    if(append != TSD_OK) {
+        return append;
     }
 
-    void *block = ctx->malloc(block_size);
-    if(!block) {
-        tsd_data_context_reset(ctx, data);
-        ctx->buffers.active = NULL;
-        return TSD_OUT_OF_MEMORY;
+    // a bounded PES is delivered as soon as it's complete
+    uint8_t start[6];
+    if(pes_slices_gather(dataCtx, reg, start, sizeof(start)) == sizeof(start)) {
+        size_t pes_len = parse_u16(&start[4]);
+        size_t total = (dataCtx->write - dataCtx->buffer) + reg->slices_bytes;
+        if(pes_len > 0 && total >= pes_len + 6) {
+            TSDCode deliver = pes_slices_deliver(ctx, reg_idx);
+            if(deliver != TSD_OK) {
+                res = deliver;
+            }
+        }
     }
+    return res;
+}
 
-    uint8_t *ptr = (uint8_t*) block;
-    uint8_t *end = &ptr[block_size];
-    size_t i=0;
-    size_t written = 0;
-
-    // go through all the sections and copy them into our buffer
-    for(; i<table->length; ++i) {
-        TSDTableSection *sec = &table->sections[i];
-        if(!sec->section_data || sec->section_data_length == 0) {
+// slices only live as long as the data passed to tsd_demux, so the part of a
+// PES still being received is copied into the PID's Data Context before
+// tsd_demux returns.
+TSDCode pes_slices_keep(TSDemuxContext *ctx)
+{
+    size_t i;
+    for(i=0; i<ctx->registered_pids_length; ++i) {
+        TSDemuxRegistration *reg = &ctx->registered_pids[i];
+        if(reg->slices_bytes == 0) {
             continue;
         }
-        size_t len = sec->section_data_length;
-        // make sure we have enough room to accomodate the copy
-        if(&ptr[len] > end) {
-            ctx->free(block);
-            return TSD_INVALID_DATA_SIZE;
+        TSDDataContext *dataCtx = ctx->registered_pids_data[i];
+        size_t size = (dataCtx->write - dataCtx->buffer) + reg->slices_bytes;
+        TSDCode res = tsd_data_context_reserve(ctx, dataCtx, size);
+        if(res != TSD_OK) {
+            return res;
         }
-        memcpy(ptr, sec->section_data, len);
-        written += len;
-        ptr = &ptr[len];
+        size_t j;
+        for(j=1; j<reg->slices_length; ++j) {
+            res = tsd_data_context_write(ctx, dataCtx, reg->slices[j].data,
+                                         reg->slices[j].length);
+            if(res != TSD_OK) {
+                return res;
+            }
+        }
+        reg->slices_length = 0;
+        reg->slices_bytes = 0;
     }
+    return TSD_OK;
+}
 
-    *size = written;
-    *mem = (uint8_t *)block;
-
-    // reset the block of data
-    tsd_data_context_reset(ctx, data);
-
+// ends the PES being streamed on a PID. TSD_EVENT_PES_END is only sent when
+// TSD_EVENT_PES_START was.
+TSDCode pes_stream_end(TSDemuxContext *ctx, int reg_idx)
+{
+    TSDemuxRegistration *reg = &ctx->registered_pids[reg_idx];
+    TSDPESStreamState state = reg->stream_state;
+    reg->stream_state = TSD_PES_STREAM_IDLE;
+    tsd_data_context_reset(ctx, ctx->registered_pids_data[reg_idx]);
+    if(state == TSD_PES_STREAM_PAYLOAD) {
+        TSDPESChunk chunk;
+        chunk.data = NULL;
+        chunk.length = 0;
+        chunk.offset = reg->stream_offset;
+        ctx->event_cb(ctx, reg->pid, TSD_EVENT_PES_END, (void*)&chunk);
+    }
     return TSD_OK;
 }
 
-TSDCode tsd_table_data_destroy(TSDemuxContext *ctx, TSDTable *table)
+// passes a piece of payload on, a bounded PES ends once all of it is in.
+void pes_stream_data(TSDemuxContext *ctx,
+                     uint16_t pid,
+                     const uint8_t *data,
+                     size_t length)
+{
+    TSDemuxRegistration *reg = &ctx->registered_pids[ctx->pid_map[pid].index];
+    int bounded = reg->stream_length > 0;
+    if(bounded && length > reg->stream_length - reg->stream_offset) {
+        length = reg->stream_length - reg->stream_offset;
+    }
+    if(length > 0) {
+        TSDPESChunk chunk;
+        chunk.data = data;
+        chunk.length = length;
+        chunk.offset = reg->stream_offset;
+        reg->stream_offset += length;
+        ctx->event_cb(ctx, pid, TSD_EVENT_PES_DATA, (void*)&chunk);
+        // the callback may have deregistered the PID
+        if(!(ctx->pid_map[pid].flags & TSD_ROUTE_REGISTERED)) return;
+        reg = &ctx->registered_pids[ctx->pid_map[pid].index];
+    }
+    if(bounded && reg->stream_state == TSD_PES_STREAM_PAYLOAD &&
+       reg->stream_offset >= reg->stream_length) {
+        pes_stream_end(ctx, ctx->pid_map[pid].index);
+    }
+}
+
+// demuxes the PES on a PID registered with TSD_REG_PES_STREAM. Only the PES
+// header is buffered, the payload is passed on straight from the packets.
+TSDCode demux_pes_stream(TSDemuxContext *ctx, TSDPacket *hdr, int reg_idx)
 {
     if(ctx == NULL)     return TSD_INVALID_CONTEXT;
-    if(table == NULL)   return TSD_INVALID_ARGUMENT;
+    if(hdr == NULL)     return TSD_INVALID_ARGUMENT;
 
-    if(table->length) {
-        ctx->free(table->sections);
+    if(hdr->data_bytes_length == 0 || !hdr->data_bytes) {
+        return TSD_OK;
     }
 
-    table->length = 0;
-    table->sections = NULL;
+    uint16_t pid = hdr->pid;
+    if(hdr->flags & TSD_PF_PAYLOAD_UNIT_START_IND) {
+        pes_stream_end(ctx, reg_idx);
+        if(!(ctx->pid_map[pid].flags & TSD_ROUTE_REGISTERED)) return TSD_OK;
+        reg_idx = ctx->pid_map[pid].index;
+        ctx->registered_pids[reg_idx].stream_state = TSD_PES_STREAM_HEADER;
+        ctx->registered_pids[reg_idx].stream_offset = 0;
+        ctx->registered_pids[reg_idx].stream_length = 0;
+    }
 
-    return TSD_OK;
-}
+    TSDemuxRegistration *reg = &ctx->registered_pids[reg_idx];
+    if(reg->stream_state == TSD_PES_STREAM_PAYLOAD) {
+        pes_stream_data(ctx, pid, hdr->data_bytes, hdr->data_bytes_length);
+        return TSD_OK;
+    } else if(reg->stream_state != TSD_PES_STREAM_HEADER) {
+        // the start of this PES was missed
+        return TSD_OK;
+    }
 
-TSDCode demux_pat(TSDemuxContext *ctx, TSDPacket *hdr)
-{
-    uint8_t *block = NULL;
-    size_t written = 0;
-    TSDTable table;
-    TSDCode res = tsd_table_data_extract(ctx,
-                                         hdr,
-                                         &table,
-                                         &block,
-                                         &written);
+    // collect the header, it may span several packets
+    TSDDataContext *dataCtx = ctx->registered_pids_data[reg_idx];
+    TSDCode res = tsd_data_context_write(ctx, dataCtx, hdr->data_bytes,
+                                         hdr->data_bytes_length);
     if(res != TSD_OK) {
         return res;
     }
-
-    // parse the PAT.
-    // cleanup the old PAT data.
-    if(ctx->pat.valid == 1) {
-        ctx->pat.valid = 0;
-        destroy_pat_data(ctx, &ctx->pat.value);
+    size_t data_len = dataCtx->write - dataCtx->buffer;
+    size_t header_size = pes_header_size(dataCtx->buffer, data_len);
+    if(header_size == 0 || header_size > data_len) {
+        return TSD_OK;
     }
-    // parse the new PAT data.
-    TSDPATData *pat = &ctx->pat.value;
-    memset(pat, 0, sizeof(TSDPATData));
-    res = tsd_parse_pat(ctx, block, written, pat);
 
-    if(TSD_OK == res) {
-        ctx->pat.valid = 1;
-        // call the user callback
-        if(ctx->event_cb) {
-            ctx->event_cb(ctx, hdr->pid, TSD_EVENT_PAT, (void*)pat);
-        }
-    } else {
-        // we're not sure what went wrong... something royal
-        ctx->pat.valid = 0;
-        tsd_table_data_destroy(ctx, &table);
+    // parsed from a copy, tsd_parse_pes may read past the end of the header
+    uint8_t header[TSD_PES_HEADER_MAX_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, dataCtx->buffer, header_size);
+    TSDPESPacket pes;
+    if(tsd_parse_pes(ctx, header, header_size, &pes) != TSD_OK) {
+        reg->stream_state = TSD_PES_STREAM_IDLE;
+        tsd_data_context_reset(ctx, dataCtx);
         return TSD_PARSE_ERROR;
     }
+    int bounded = pes.packet_length > 0;
+    size_t pes_size = (size_t)pes.packet_length + 6;
+    pes.data_bytes = NULL;
+    pes.data_bytes_length = 0;
+    if(bounded && pes_size > header_size) {
+        pes.data_bytes_length = pes_size - header_size;
+    }
+    // what's left of the packet after the header is payload
+    size_t rest = data_len - header_size;
+    tsd_data_context_reset(ctx, dataCtx);
+
+    reg->stream_state = TSD_PES_STREAM_PAYLOAD;
+    reg->stream_length = pes.data_bytes_length;
+    ctx->event_cb(ctx, pid, TSD_EVENT_PES_START, (void*)&pes);
+    if(!(ctx->pid_map[pid].flags & TSD_ROUTE_REGISTERED)) return TSD_OK;
+    reg = &ctx->registered_pids[ctx->pid_map[pid].index];
+    if(reg->stream_state != TSD_PES_STREAM_PAYLOAD) {
+        return TSD_OK;
+    }
+    if(bounded && reg->stream_length == 0) {
+        return pes_stream_end(ctx, ctx->pid_map[pid].index);
+    }
+    pes_stream_data(ctx, pid, &hdr->data_bytes[hdr->data_bytes_length - rest], rest);
+    return TSD_OK;
+}
+
+TSDCode demux_adaptation_field_prv_data(TSDemuxContext *ctx, TSDPacket *hdr, int reg_idx)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(hdr == NULL)     return TSD_INVALID_ARGUMENT;
+
+    // make sure we have an adaptation field
+    if(hdr->adaptation_field_control == TSD_AFC_NO_FIELD_PRESENT) {
+        return TSD_OK;
+    }
+    // make sure we have private data
+    if(!(hdr->adaptation_field.flags & TSD_AF_TRAN_PRIVATE_DATA_FLAG) ||
+       hdr->adaptation_field.transport_private_data_length == 0 ||
+       !hdr->adaptation_field.private_data_bytes) {
+        return TSD_OK;
+    }
 
-    // cleanup
-    ctx->free(block);
-    tsd_table_data_destroy(ctx, &table);
+    // call the user callback with the private data
+    ctx->event_cb(ctx,
+                  hdr->pid,
+                  TSD_EVENT_ADAP_FIELD_PRV_DATA,
+                  &hdr->adaptation_field);
 
     return TSD_OK;
 }
 
-TSDCode demux_pmt(TSDemuxContext *ctx, TSDPacket *hdr, size_t pmt_idx)
+// the data types registered for pid, 0 once it isn't registered. Callbacks
+// can (de)register PIDs and move the registrations around, so it is looked up
+// again after each of them.
+int registered_data_types(TSDemuxContext *ctx, uint16_t pid, uint16_t *index)
 {
-    uint8_t *block = NULL;
-    size_t written = 0;
-    TSDTable table;
-    TSDCode res = tsd_table_data_extract(ctx,
-                                         hdr,
-                                         &table,
-                                         &block,
-                                         &written);
-    if(res != TSD_OK) {
-        return res;
+    TSDPIDRoute route = ctx->pid_map[pid];
+    if(!(route.flags & TSD_ROUTE_REGISTERED)) {
+        return 0;
     }
-    // parse the PMT TSDTable
-    TSDPMTData pmt;
-    memset(&pmt, 0, sizeof(pmt));
-    res = tsd_parse_pmt(ctx, block, written, &pmt);
+    *index = route.index;
+    return ctx->registered_pids[route.index].data_types;
+}
 
-    if(TSD_OK == res) {
-        if(ctx->event_cb) {
-            ctx->event_cb(ctx, hdr->pid, TSD_EVENT_PMT, (void*)&pmt);
-        }
-        // cleanup
-        destroy_pmt_data(ctx, &pmt);
+// a table that can't be parsed only costs the packet it is in, like a bad
+// PES does. The error is counted instead of stopping the demux.
+void table_error(TSDemuxContext *ctx, TSDCode res)
+{
+    if(res != TSD_OK && res != TSD_INCOMPLETE_TABLE && res != TSD_INVALID_CRC) {
+        ctx->stats.table_errors++;
+        ctx->stats.last_table_error = res;
     }
-
-    // cleanup
-    ctx->free(block);
-    tsd_table_data_destroy(ctx, &table);
-
-    return res;
 }
 
-TSDCode demux_descriptors(TSDemuxContext *ctx, TSDPacket *hdr)
+TSDCode demux_packet(TSDemuxContext *ctx, const uint8_t *unit, size_t sync_offset)
 {
-    uint8_t *block = NULL;
-    size_t written = 0;
-    TSDTable table;
-    TSDCode res = tsd_table_data_extract(ctx,
-                                         hdr,
-                                         &table,
-                                         &block,
-                                         &written);
+    TSDPacket hdr;
+    TSDCode res;
+
+    // the adaptation field is only decoded further down if it's needed
+    const uint8_t *packet = unit + sync_offset;
+    res = parse_packet_header(ctx, packet, TSD_TSPACKET_SIZE, &hdr, 0);
+    hdr.arrival_time_stamp = sync_offset ? (uint32_t)(parse_u32(unit) & 0x3FFFFFFF) : 0;
+    ctx->arrival_time_stamp = hdr.arrival_time_stamp;
+
+    // if we run into an error skip the packet.
     if(res != TSD_OK) {
-        return res;
+        return TSD_OK;
     }
 
-    // parse all the outter descriptors
-    TSDDescriptorData descriptorData;
-    res = tsd_parse_descriptors(ctx, block, written, &descriptorData);
+    // skip packets with errors and null packets
+    if((hdr.flags & TSD_PF_TRAN_ERR_INDICATOR) ||
+       (hdr.pid == TSD_PID_NULL_PACKETS) ||
+       (hdr.adaptation_field_control == TSD_AFC_RESERVED)) {
+        return TSD_OK;
+    }
 
-    // call the callback with the descriptors and TSDTable data
-    if(TSD_OK == res) {
-        if(ctx->event_cb) {
-            TSDEventId event;
-            switch(hdr->pid) {
-            case TSD_PID_CAT:
-                event = TSD_EVENT_CAT;
-                break;
-            case TSD_PID_TSDT:
-                event = TSD_EVENT_TSDT;
-                break;
-            default:
-                event = TSD_EVENT_TSDT;
-                break;
+    // a single lookup tells us what to do with this PID
+    TSDPIDRoute route = ctx->pid_map[hdr.pid];
+
+    if(route.flags & TSD_ROUTE_PAT) {
+        table_error(ctx, demux_pat(ctx, &hdr));
+    } else if(route.flags & (TSD_ROUTE_CAT | TSD_ROUTE_TSDT)) {
+        table_error(ctx, demux_descriptors(ctx, &hdr));
+    } else if(route.flags & TSD_ROUTE_PMT) {
+        table_error(ctx, demux_pmt(ctx, &hdr));
+    } else if(route.flags & TSD_ROUTE_SECTIONS) {
+        table_error(ctx, demux_sections(ctx, &hdr));
+    } else if(route.flags & TSD_ROUTE_REGISTERED) {
+        uint16_t index = route.index;
+        int data_types = registered_data_types(ctx, hdr.pid, &index);
+        // if the user registered PES data demux the PES.
+        if(data_types & TSD_REG_PES_STREAM) {
+            demux_pes_stream(ctx, &hdr, index);
+        } else if(data_types & TSD_REG_PES_SLICES) {
+            demux_pes_slices(ctx, &hdr, index);
+        } else if(data_types & TSD_REG_PES) {
+            demux_pes(ctx, &hdr, index);
+        }
+        // decode the adaptation field for the users that want it.
+        data_types = registered_data_types(ctx, hdr.pid, &index);
+        if((data_types & (TSD_REG_ADAPTATION_FIELD | TSD_REG_PCR)) &&
+           hdr.adaptation_field.adaptation_field_length > 0 &&
+           tsd_parse_adaptation_field(ctx, &packet[4], TSD_TSPACKET_SIZE - 4,
+                                      &hdr.adaptation_field) == TSD_OK) {
+            if(data_types & TSD_REG_ADAPTATION_FIELD) {
+                demux_adaptation_field_prv_data(ctx, &hdr, index);
+                data_types = registered_data_types(ctx, hdr.pid, &index);
+            }
+            if((data_types & TSD_REG_PCR) &&
+               (hdr.adaptation_field.flags & TSD_AF_PCR_FLAG) && ctx->event_cb) {
+                ctx->event_cb(ctx, hdr.pid, TSD_EVENT_PCR, &hdr.adaptation_field);
             }
-            ctx->event_cb(ctx, hdr->pid, event, (void*)&descriptorData);
         }
     }
-
-    // cleanup
-    tsd_table_data_destroy(ctx, &table);
-
     return TSD_OK;
 }
 
-TSDCode demux_pes_flush(TSDemuxContext *ctx, int reg_idx)
+void sync_lost(TSDemuxContext *ctx, size_t offset)
 {
-    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
-    if(reg_idx < 0)     return TSD_INVALID_ARGUMENT;
+    ctx->sync.locked = 0;
+    ctx->sync.bytes_skipped = 0;
+    TSDSyncEvent sync_event;
+    sync_event.offset = offset;
+    sync_event.bytes_skipped = 0;
+    if(ctx->event_cb) {
+        ctx->event_cb(ctx, 0, TSD_EVENT_SYNC_LOSS, (void*)&sync_event);
+    }
+}
 
-    TSDDataContext *dataCtx = ctx->registered_pids_data[reg_idx];
+void sync_acquired(TSDemuxContext *ctx, size_t offset)
+{
+    ctx->sync.locked = 1;
+    TSDSyncEvent sync_event;
+    sync_event.offset = offset;
+    sync_event.bytes_skipped = ctx->sync.bytes_skipped;
+    ctx->sync.bytes_skipped = 0;
+    if(ctx->event_cb) {
+        ctx->event_cb(ctx, 0, TSD_EVENT_SYNC_ACQUIRED, (void*)&sync_event);
+    }
+}
 
-    // if the buffer already has same data in it, we will parse it.
-    size_t data_len = dataCtx->write - dataCtx->buffer;
-    if(data_len > 0) {
-        TSDPESPacket pes;
-        TSDCode res = tsd_parse_pes(ctx, dataCtx->buffer, data_len, &pes);
-        if(res != TSD_OK) {
-            return res;
-        } else {
-            // call the user callback with the data.
-            uint16_t pid = ctx->registered_pids[reg_idx].pid;
-            ctx->event_cb(ctx, pid, TSD_EVENT_PES, (void *)&pes);
+// Completes the packet carried over from the previous call with the start of
+// data and demuxes it, only used while in sync. *ptr and *remaining are moved
+// past the bytes used.
+TSDCode demux_carry(TSDemuxContext *ctx,
+                    const uint8_t **ptr,
+                    size_t *remaining,
+                    size_t stride)
+{
+    size_t sync_offset = packet_sync_offset(stride);
+    uint8_t *carry = ctx->carry.data;
+    size_t length = ctx->carry.length;
+    const uint8_t *data = *ptr;
+    size_t size = *remaining;
+
+    if(length < stride) {
+        size_t take = stride - length;
+        if(take > *remaining) {
+            take = *remaining;
+        }
+        memcpy(&carry[length], *ptr, take);
+        length += take;
+        *ptr += take;
+        *remaining -= take;
+        if(length < stride) {
+            ctx->carry.length = length;
+            return TSD_OK;
         }
-        // clear the DataContext.
-        tsd_data_context_reset(ctx, dataCtx);
     }
-    return TSD_OK;
+    size_t carried = ctx->carry.length;
+    ctx->carry.length = 0;
+
+    // when the carried packet isn't usable only the carried bytes are
+    // dropped, data is searched for sync from its start.
+    if(carry[sync_offset] != TSD_SYNC_BYTE) {
+        sync_lost(ctx, 0);
+        ctx->sync.bytes_skipped += carried;
+        *ptr = data;
+        *remaining = size;
+        return TSD_OK;
+    }
+
+    return demux_packet(ctx, carry, sync_offset);
 }
 
-TSDCode demux_pes(TSDemuxContext *ctx, TSDPacket *hdr, int reg_idx)
+// demuxes data once the packet size is known. The end of it that doesn't make
+// a whole packet, or that is still waiting for sync to be confirmed, is kept in
+// the carry buffer for the next call. flush is set at the end of the stream.
+TSDCode demux_data(TSDemuxContext *ctx,
+                   const uint8_t *data,
+                   size_t size,
+                   size_t stride,
+                   int flush)
 {
-    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
-    if(hdr == NULL)     return TSD_INVALID_ARGUMENT;
+    TSDCode res;
+    const uint8_t *ptr = data;
+    const uint8_t *end = ptr + size;
+    size_t remaining = size;
+    size_t sync_offset = packet_sync_offset(stride);
 
-    // make sure we have some data to parse.
-    if(hdr->data_bytes_length == 0 || !hdr->data_bytes) {
+    while(ctx->carry.length > 0 && remaining > 0) {
+        if(ctx->sync.locked) {
+            res = demux_carry(ctx, &ptr, &remaining, stride);
+            if(res != TSD_OK) {
+                pes_slices_keep(ctx);
+                return res;
+            }
+            break;
+        }
+
+        // out of sync the carry holds a candidate waiting to be confirmed,
+        // the start of data is added to it and it is searched again.
+        size_t take = TSD_PACKET_SIZE_DETECT_BYTES - ctx->carry.length;
+        if(take > remaining) {
+            take = remaining;
+        }
+        memcpy(&ctx->carry.data[ctx->carry.length], ptr, take);
+        size_t collected = ctx->carry.length + take;
+        ptr += take;
+        remaining -= take;
+        ctx->carry.length = 0;
+        res = demux_data(ctx, ctx->carry.data, collected, stride, 0);
+        if(res != TSD_OK) {
+            return res;
+        }
+    }
+    if(ctx->carry.length > 0) {
+        // still not a whole packet, or sync still not confirmed
         return TSD_OK;
     }
+    while(remaining >= stride) {
+        if(!ctx->sync.locked || ptr[sync_offset] != TSD_SYNC_BYTE) {
+            if(ctx->sync.locked) {
+                sync_lost(ctx, (size_t)(ptr - data));
+            }
 
-    const uint8_t *ptr = hdr->data_bytes;
-    TSDDataContext *dataCtx = ctx->registered_pids_data[reg_idx];
-    TSDCode initial_parse_res = TSD_OK;
-
-    size_t ptr_len = hdr->data_bytes_length;
-    // is this the start of a new PES packet?
-    if((hdr->flags & TSD_PF_PAYLOAD_UNIT_START_IND)) {
-        // if the buffer already has same data in it, we will parse it.
-        size_t data_len = dataCtx->write - dataCtx->buffer;
-        if(data_len > 0) {
-            TSDPESPacket pes;
-            initial_parse_res = tsd_parse_pes(ctx, dataCtx->buffer, data_len, &pes);
-            if(initial_parse_res == TSD_OK) {
-                // call the user callback with the data.
-                ctx->event_cb(ctx, hdr->pid, TSD_EVENT_PES, (void *)&pes);
-            } else {
-                initial_parse_res = TSD_PARSE_ERROR;
+            const uint8_t *pos = ptr;
+            int locked = sync_acquire(ctx, end, stride, &pos, flush);
+            ctx->sync.bytes_skipped += (size_t)(pos - ptr);
+            remaining -= (size_t)(pos - ptr);
+            ptr = pos;
+            if(!locked) {
+                break;
             }
-            // clear the DataContext for the new packet data.
-            tsd_data_context_reset(ctx, dataCtx);
+            sync_acquired(ctx, (size_t)(ptr - data));
+        }
+
+        res = demux_packet(ctx, ptr, sync_offset);
+        if(res != TSD_OK) {
+            pes_slices_keep(ctx);
+            return res;
         }
+        remaining -= stride;
+        ptr += stride;
     }
 
-    // write the data into the DataContext.
-    TSDCode res = tsd_data_context_write(ctx, dataCtx, ptr, ptr_len);
+    // the carried packet is overwritten below, and data may be gone next time
+    res = pes_slices_keep(ctx);
     if(res != TSD_OK) {
         return res;
     }
 
-    // get the PES length to see if we have the complete packet.
-    size_t data_len = dataCtx->write - dataCtx->buffer;
-    // make sure we have enough data to parse the PES
-    // the PES header starts with 6 bytes:
-    //    packet_start_code_prefix(24), stream_id(8) and PES_packet_length(16)
-    if(data_len > 5) {
-        // get the PES length
-        uint16_t pes_len = parse_u16(&dataCtx->buffer[4]);
-        // if the amount of data in the DataContext matches the PES length
-        // we have enough data to parse the PES packet.
-        // PES_packet_length doesn't include the first 6 bytes PES header
-        if(pes_len > 0 && data_len >= pes_len + 6) {
-            TSDPESPacket pes;
-            res = tsd_parse_pes(ctx, dataCtx->buffer, data_len, &pes);
-            if(res != TSD_OK) {
-                return TSD_PARSE_ERROR;
-            } else {
-                // call the user callback with the data.
-                ctx->event_cb(ctx, hdr->pid, TSD_EVENT_PES, (void *)&pes);
-            }
-            tsd_data_context_reset(ctx, dataCtx);
-        }
+    // carry whatever is left over into the next call. That is less than a
+    // packet in sync, and out of sync the candidate and its confirmation so
+    // far, which sync_confirm_packets keeps within the carry buffer. data may
+    // be the carry buffer itself.
+    if(remaining > TSD_PACKET_SIZE_DETECT_BYTES) {
+        ctx->sync.bytes_skipped += remaining - TSD_PACKET_SIZE_DETECT_BYTES;
+        ptr += remaining - TSD_PACKET_SIZE_DETECT_BYTES;
+        remaining = TSD_PACKET_SIZE_DETECT_BYTES;
     }
-    return initial_parse_res;
+    if(remaining > 0) {
+        memmove(ctx->carry.data, ptr, remaining);
+    }
+    ctx->carry.length = remaining;
+    return TSD_OK;
 }
 
-TSDCode demux_adaptation_field_prv_data(TSDemuxContext *ctx, TSDPacket *hdr, int reg_idx)
+// demuxes the start of the stream collected while detecting the packet size.
+TSDCode demux_collected(TSDemuxContext *ctx)
 {
-    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
-    if(hdr == NULL)     return TSD_INVALID_ARGUMENT;
-
-    // make sure we have an adaptation field
-    if(hdr->adaptation_field_control == TSD_AFC_NO_FIELD_PRESENT) {
-        return TSD_OK;
-    }
-    // make sure we have private data
-    if(!(hdr->adaptation_field.flags & TSD_AF_TRAN_PRIVATE_DATA_FLAG) ||
-       hdr->adaptation_field.transport_private_data_length == 0 ||
-       !hdr->adaptation_field.private_data_bytes) {
-        return TSD_OK;
-    }
-
-    // call the user callback with the private data
-    ctx->event_cb(ctx,
-                  hdr->pid,
-                  TSD_EVENT_ADAP_FIELD_PRV_DATA,
-                  &hdr->adaptation_field);
-
-    return TSD_OK;
+    size_t collected = ctx->carry.length;
+    ctx->carry.length = 0;
+    return demux_data(ctx, ctx->carry.data, collected, ctx->sync.packet_size, 0);
 }
 
 TSDCode tsd_demux(TSDemuxContext *ctx,
-                 void *data,
-                 size_t size,
-                 size_t *parsedSize)
+                  void *data,
+                  size_t size,
+                  size_t *parsedSize)
 {
     // initially set parsedSize to 0
     if(parsedSize != NULL) *parsedSize = 0;
@@ -1439,158 +4429,228 @@ TSDCode tsd_demux(TSDemuxContext *ctx,
     if(data == NULL)        return TSD_INVALID_DATA;
     if(size == 0)           return TSD_INVALID_DATA_SIZE;
 
-    uint8_t *ptr = (uint8_t*)data;
+    TSDCode res = pid_map_create(ctx);
+    if(res != TSD_OK)       return res;
+
+    const uint8_t *ptr = (const uint8_t*)data;
     size_t remaining = size;
 
-    TSDPacket hdr;
-    TSDCode res;
+    // work out the packet size before looking for sync. When the data is too
+    // short to tell, it is collected in the carry buffer until it isn't.
+    if(ctx->packet_size == 0 && ctx->sync.packet_size == 0 &&
+       (ctx->carry.length > 0 || !packet_size_settle(ctx, ptr, size, 0))) {
+        size_t take = TSD_PACKET_SIZE_DETECT_BYTES - ctx->carry.length;
+        if(take > remaining) {
+            take = remaining;
+        }
+        memcpy(&ctx->carry.data[ctx->carry.length], ptr, take);
+        ctx->carry.length += take;
+        ptr += take;
+        remaining -= take;
+        if(!packet_size_settle(ctx, ctx->carry.data, ctx->carry.length, 0)) {
+            if(parsedSize != NULL) *parsedSize = size;
+            return TSD_OK;
+        }
+        res = demux_collected(ctx);
+        if(res != TSD_OK) {
+            return res;
+        }
+    }
+    size_t stride = ctx->packet_size ? ctx->packet_size : ctx->sync.packet_size;
 
-    while(remaining >= TSD_TSPACKET_SIZE) {
-        res = tsd_parse_packet_header(ctx, ptr, size, &hdr);
-        // if we run into an error try parsing the next packet.
+    if(remaining > 0) {
+        res = demux_data(ctx, ptr, remaining, stride, 0);
         if(res != TSD_OK) {
-            // if the error is due to an invalid sync byte, see if we can
-            // lock onto a valid one.
-            if(res == TSD_INVALID_SYNC_BYTE) {
-                while(remaining >= TSD_TSPACKET_SIZE) {
-                    remaining--;
-                    ptr++;
-                    // if we find a value for a sync byte try and use that.
-                    if(*ptr == TSD_SYNC_BYTE) {
-                        break;
-                    }
-                }
-                continue;
-            } else {
-                // skip this packet
-                remaining -= TSD_TSPACKET_SIZE;
-                ptr += TSD_TSPACKET_SIZE;
-                continue;
-            }
+            return res;
         }
+    }
 
-        remaining -= TSD_TSPACKET_SIZE;
-        ptr += TSD_TSPACKET_SIZE;
+    if (parsedSize != NULL) *parsedSize = size;
+    return TSD_OK;
+}
 
-        // skip packets with errors and null packets
-        if((hdr.flags & TSD_PF_TRAN_ERR_INDICATOR) ||
-           (hdr.pid == TSD_PID_NULL_PACKETS) ||
-           (hdr.adaptation_field_control == TSD_AFC_RESERVED)) {
-            continue;
-        }
+TSDCode tsd_demux_end(TSDemuxContext *ctx)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
 
-        if(hdr.pid == TSD_PID_PAT) {
-            res = demux_pat(ctx, &hdr);
-            if(res != TSD_OK && res != TSD_INCOMPLETE_TABLE) {
-                return res;
-            }
-        } else if(hdr.pid == TSD_PID_CAT || hdr.pid == TSD_PID_TSDT) {
-            res = demux_descriptors(ctx, &hdr);
-            if(res != TSD_OK && res != TSD_INCOMPLETE_TABLE) {
-                return res;
-            }
-        } else if (hdr.pid >= TSD_PID_DATA_TABLES_START &&
-                   hdr.pid <= TSD_PID_RESERVED_FUTURE) {
-            // check to see if this PID is a PMT
-            int parsed = 0;
-            if(ctx->pat.valid) {
-                size_t len = ctx->pat.value.length;
-                uint16_t *pids = ctx->pat.value.pid;
-                size_t i;
-
-                for(i=0; i<len; ++i) {
-                    if(pids[i] == hdr.pid) {
-                        if(parsed != 1) parsed = 1;
-                        res = demux_pmt(ctx, &hdr, i);
-                        if(res == TSD_INCOMPLETE_TABLE) {
-                            continue;
-                        } else if(res != TSD_OK) {
-                            return res;
-                        }
-                    }
-                }
-            }
+    // the stream ended before its packet size could be told for certain
+    if(ctx->packet_size == 0 && ctx->sync.packet_size == 0 &&
+       ctx->carry.length > 0 && ctx->pid_map) {
+        packet_size_settle(ctx, ctx->carry.data, ctx->carry.length, 1);
+        demux_collected(ctx);
+    }
 
-            // if this isn't a PMT PID, check to see if the user has registered it
-            if(parsed == 0) {
-                size_t i;
-                for(i=0; i < ctx->registered_pids_length; ++i) {
-                    if(ctx->registered_pids[i].pid != hdr.pid) {
-                        continue;
-                    }
-                    // if the user registered PES data demux the PES.
-                    if(ctx->registered_pids[i].data_types & TSD_REG_PES) {
-                        // demux the PES data
-                        demux_pes(ctx, &hdr, i);
-                    }
-                    // if the user registered the Adaptation field data, demux that.
-                    if(ctx->registered_pids[i].data_types & TSD_REG_ADAPTATION_FIELD) {
-                        demux_adaptation_field_prv_data(ctx, &hdr, i);
-                    }
-                }
-            }
+    // the packets still waiting to be confirmed are accepted on what
+    // confirmation there is.
+    size_t stride = ctx->packet_size ? ctx->packet_size : ctx->sync.packet_size;
+    if(!ctx->sync.locked && stride != 0 && ctx->carry.length > 0 && ctx->pid_map) {
+        size_t collected = ctx->carry.length;
+        ctx->carry.length = 0;
+        demux_data(ctx, ctx->carry.data, collected, stride, 1);
+    }
+    ctx->carry.length = 0;
+
+    // walk backwards, a callback deregistering its PID only moves entries
+    // we have already flushed.
+    size_t i = ctx->registered_pids_length;
+    while(i > 0) {
+        --i;
+        if(i < ctx->registered_pids_length) {
+            demux_pes_flush(ctx, (int)i);
         }
     }
+    return TSD_OK;
+}
 
-    // cleaup all the buffers if there isn't an active one
-    if(ctx->buffers.active == NULL && ctx->buffers.length > 0) {
-        size_t len = ctx->buffers.length;
-        size_t i;
-        for(i=0; i<len; ++i) {
-            tsd_data_context_destroy(ctx, &ctx->buffers.pool[i]);
+#if defined(TSD_FILE_MMAP)
+TSDCode demux_file_mmap(TSDemuxContext *ctx, int fd, size_t window_size)
+{
+    struct stat st;
+    if(fstat(fd, &st) != 0) return TSD_FILE_ERROR;
+
+    // windows start on a page boundary
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    window_size = ((window_size + page - 1) / page) * page;
+
+    size_t file_size = (size_t)st.st_size;
+    size_t offset = 0;
+    while(offset < file_size) {
+        size_t len = file_size - offset;
+        if(len > window_size) {
+            len = window_size;
         }
-        ctx->free(ctx->buffers.pool);
-        ctx->buffers.pool = NULL;
-        ctx->buffers.length = 0;
+        void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, (off_t)offset);
+        if(map == MAP_FAILED) return TSD_FILE_ERROR;
+#if defined(MADV_SEQUENTIAL)
+        madvise(map, len, MADV_SEQUENTIAL);
+#endif
+#if defined(MADV_HUGEPAGE)
+        madvise(map, len, MADV_HUGEPAGE);
+#endif
+        size_t parsed = 0;
+        TSDCode res = tsd_demux(ctx, map, len, &parsed);
+        munmap(map, len);
+        if(res != TSD_OK) return res;
+        offset += len;
     }
-
-    if (parsedSize != NULL) *parsedSize = size - remaining;
     return TSD_OK;
 }
+#endif
 
-TSDCode tsd_demux_end(TSDemuxContext *ctx)
+TSDCode demux_file_read(TSDemuxContext *ctx, FILE *file, size_t window_size)
+{
+    uint8_t *buffer = (uint8_t*) mem_malloc(ctx, window_size);
+    if(buffer == NULL) return TSD_OUT_OF_MEMORY;
+
+    TSDCode res = TSD_OK;
+    size_t count;
+    while((count = fread(buffer, 1, window_size, file)) > 0) {
+        size_t parsed = 0;
+        res = tsd_demux(ctx, buffer, count, &parsed);
+        if(res != TSD_OK) break;
+    }
+    if(res == TSD_OK && ferror(file)) {
+        res = TSD_FILE_ERROR;
+    }
+    mem_free(ctx, buffer);
+    return res;
+}
+
+TSDCode tsd_demux_file(TSDemuxContext *ctx, const char *path, size_t window_size)
 {
     if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(path == NULL)    return TSD_INVALID_ARGUMENT;
 
-    int i=0;
-    for(; i<ctx->registered_pids_length; ++i) {
-        demux_pes_flush(ctx, i);
+    if(window_size == 0) {
+        window_size = TSD_FILE_WINDOW_SIZE;
+    }
+
+    TSDCode res;
+#if defined(TSD_FILE_MMAP)
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return TSD_FILE_ERROR;
+    res = demux_file_mmap(ctx, fd, window_size);
+    close(fd);
+#else
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) return TSD_FILE_ERROR;
+    res = demux_file_read(ctx, file, window_size);
+    fclose(file);
+#endif
+    if(res != TSD_OK) return res;
+
+    return tsd_demux_end(ctx);
+}
+
+TSDCode registrations_grow(TSDemuxContext *ctx)
+{
+    size_t capacity = ctx->registered_pids_capacity * 2;
+    if(capacity == 0) {
+        capacity = TSD_PID_REGS_INITIAL_CAPACITY;
     }
+
+    TSDemuxRegistration *regs = (TSDemuxRegistration*) mem_realloc(ctx, 
+                                    ctx->registered_pids, capacity * sizeof(TSDemuxRegistration));
+    if(regs == NULL) return TSD_OUT_OF_MEMORY;
+    ctx->registered_pids = regs;
+
+    TSDDataContext **data = (TSDDataContext**) mem_realloc(ctx, 
+                                ctx->registered_pids_data, capacity * sizeof(TSDDataContext*));
+    if(data == NULL) return TSD_OUT_OF_MEMORY;
+    ctx->registered_pids_data = data;
+
+    ctx->registered_pids_capacity = capacity;
     return TSD_OK;
 }
 
 TSDCode tsd_register_pid(TSDemuxContext *ctx, uint16_t pid, int reg_data_type)
 {
-    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(pid >= TSD_PID_MAP_SIZE)     return TSD_INVALID_ARGUMENT;
+
+    TSDCode res = pid_map_create(ctx);
+    if(res != TSD_OK)   return res;
 
     // make sure the pid isn't already registered
-    size_t i;
-    for(i=0; i<ctx->registered_pids_length; ++i) {
-        if(ctx->registered_pids[i].pid == pid) {
-            return TSD_PID_ALREADY_REGISTERED;
-        }
+    if(ctx->pid_map[pid].flags & TSD_ROUTE_REGISTERED) {
+        return TSD_PID_ALREADY_REGISTERED;
     }
 
     // make sure we have room to register a new pid
-    if(ctx->registered_pids_length == TSD_MAX_PID_REGS) {
-        return TSD_TSD_MAX_PID_REGS_REACHED;
+    if(ctx->registered_pids_length == ctx->registered_pids_capacity) {
+        res = registrations_grow(ctx);
+        if(res != TSD_OK) return res;
     }
 
-    // register the new pid
-    TSDemuxRegistration *reg = &ctx->registered_pids[ctx->registered_pids_length];
-    reg->pid = pid;
-    reg->data_types = reg_data_type;
-    TSDDataContext *dataContext = (TSDDataContext*) ctx->malloc(sizeof(TSDDataContext));
+    TSDDataContext *dataContext = (TSDDataContext*) mem_malloc(ctx, sizeof(TSDDataContext));
     if(dataContext == NULL) {
         return TSD_OUT_OF_MEMORY;
     }
-
-    TSDCode res = tsd_data_context_init(ctx, dataContext);
+    res = tsd_data_context_init(ctx, dataContext);
     if(res != TSD_OK) {
-        ctx->free(dataContext);
+        mem_free(ctx, dataContext);
         return res;
     }
-    ctx->registered_pids_data[ctx->registered_pids_length] = dataContext;
+
+    // register the new pid
+    size_t idx = ctx->registered_pids_length;
+    ctx->registered_pids[idx].pid = pid;
+    ctx->registered_pids[idx].data_types = reg_data_type;
+    ctx->registered_pids[idx].size_hint = 0;
+    ctx->registered_pids[idx].slices = NULL;
+    ctx->registered_pids[idx].slices_length = 0;
+    ctx->registered_pids[idx].slices_capacity = 0;
+    ctx->registered_pids[idx].slices_bytes = 0;
+    ctx->registered_pids[idx].stream_state = TSD_PES_STREAM_IDLE;
+    ctx->registered_pids[idx].stream_offset = 0;
+    ctx->registered_pids[idx].stream_length = 0;
+    ctx->registered_pids[idx].au_stream_type = 0;
+    ctx->registered_pids[idx].au_scanned = 0;
+    ctx->registered_pids[idx].au_vcl = 0;
+    ctx->registered_pids[idx].au_continued = 0;
+    ctx->registered_pids_data[idx] = dataContext;
+    ctx->pid_map[pid].flags |= TSD_ROUTE_REGISTERED;
+    ctx->pid_map[pid].index = (uint16_t)idx;
     ctx->registered_pids_length++;
 
     return TSD_OK;
@@ -1600,20 +4660,137 @@ TSDCode tsd_deregister_pid(TSDemuxContext *ctx, uint16_t pid)
 {
     if(ctx == NULL)     return TSD_INVALID_CONTEXT;
 
-    // find the pid in the registration list
+    if(pid >= TSD_PID_MAP_SIZE || !ctx->pid_map ||
+       !(ctx->pid_map[pid].flags & TSD_ROUTE_REGISTERED)) {
+        return TSD_PID_NOT_FOUND;
+    }
+
+    size_t idx = ctx->pid_map[pid].index;
+    tsd_data_context_destroy(ctx, ctx->registered_pids_data[idx]);
+    mem_free(ctx, ctx->registered_pids_data[idx]);
+    if(ctx->registered_pids[idx].slices) {
+        mem_free(ctx, ctx->registered_pids[idx].slices);
+    }
+
+    // move the last registration into the free slot
+    size_t last = ctx->registered_pids_length - 1;
+    if(idx != last) {
+        ctx->registered_pids[idx] = ctx->registered_pids[last];
+        ctx->registered_pids_data[idx] = ctx->registered_pids_data[last];
+        ctx->pid_map[ctx->registered_pids[idx].pid].index = (uint16_t)idx;
+    }
+    ctx->registered_pids_length--;
+
+    ctx->pid_map[pid].flags &= ~TSD_ROUTE_REGISTERED;
+    ctx->pid_map[pid].index = 0;
+    return TSD_OK;
+}
+
+TSDSectionFilter *find_section_filter(TSDemuxContext *ctx,
+                                      uint16_t pid,
+                                      uint8_t table_id,
+                                      uint8_t mask,
+                                      uint16_t table_id_extension,
+                                      uint16_t extension_mask)
+{
     size_t i;
-    for(i=0; i<ctx->registered_pids_length; ++i) {
-        if(ctx->registered_pids[i].pid == pid) {
-            // remove this pid by shifting the pids in front of it down
-            size_t j;
-            for(j=i+1; j<ctx->registered_pids_length; ++j) {
-                ctx->registered_pids[j-1] = ctx->registered_pids[j];
-            }
-            ctx->registered_pids_length--;
+    for(i=0; i<ctx->section_filters.length; ++i) {
+        TSDSectionFilter *filter = &ctx->section_filters.filters[i];
+        if(filter->pid == pid && filter->mask == mask &&
+           ((filter->table_id ^ table_id) & mask) == 0 &&
+           filter->extension_mask == extension_mask &&
+           ((filter->table_id_extension ^ table_id_extension) & extension_mask) == 0) {
+            return filter;
+        }
+    }
+    return NULL;
+}
+
+TSDCode tsd_register_section_filter(TSDemuxContext *ctx,
+                                    uint16_t pid,
+                                    uint8_t table_id,
+                                    uint8_t mask)
+{
+    return tsd_register_section_filter_ext(ctx, pid, table_id, mask, 0, 0);
+}
+
+TSDCode tsd_register_section_filter_ext(TSDemuxContext *ctx,
+                                        uint16_t pid,
+                                        uint8_t table_id,
+                                        uint8_t mask,
+                                        uint16_t table_id_extension,
+                                        uint16_t extension_mask)
+{
+    if(ctx == NULL)                 return TSD_INVALID_CONTEXT;
+    if(pid >= TSD_PID_MAP_SIZE)     return TSD_INVALID_ARGUMENT;
+
+    TSDCode res = pid_map_create(ctx);
+    if(res != TSD_OK)   return res;
+
+    if(find_section_filter(ctx, pid, table_id, mask,
+                           table_id_extension, extension_mask)) {
+        return TSD_PID_ALREADY_REGISTERED;
+    }
+
+    if(ctx->section_filters.length == ctx->section_filters.capacity) {
+        size_t capacity = ctx->section_filters.capacity * 2;
+        if(capacity == 0) {
+            capacity = TSD_SECTION_FILTERS_INITIAL_CAPACITY;
+        }
+        TSDSectionFilter *filters = (TSDSectionFilter*) mem_realloc(ctx, 
+                                        ctx->section_filters.filters,
+                                        capacity * sizeof(TSDSectionFilter));
+        if(filters == NULL) return TSD_OUT_OF_MEMORY;
+        ctx->section_filters.filters = filters;
+        ctx->section_filters.capacity = capacity;
+    }
+
+    TSDSectionFilter *filter = &ctx->section_filters.filters[ctx->section_filters.length++];
+    filter->pid = pid;
+    filter->table_id = table_id & mask;
+    filter->mask = mask;
+    filter->table_id_extension = table_id_extension & extension_mask;
+    filter->extension_mask = extension_mask;
+    ctx->pid_map[pid].flags |= TSD_ROUTE_SECTIONS;
+    return TSD_OK;
+}
+
+TSDCode tsd_deregister_section_filter(TSDemuxContext *ctx,
+                                      uint16_t pid,
+                                      uint8_t table_id,
+                                      uint8_t mask)
+{
+    return tsd_deregister_section_filter_ext(ctx, pid, table_id, mask, 0, 0);
+}
+
+TSDCode tsd_deregister_section_filter_ext(TSDemuxContext *ctx,
+                                          uint16_t pid,
+                                          uint8_t table_id,
+                                          uint8_t mask,
+                                          uint16_t table_id_extension,
+                                          uint16_t extension_mask)
+{
+    if(ctx == NULL)     return TSD_INVALID_CONTEXT;
+    if(pid >= TSD_PID_MAP_SIZE || !ctx->pid_map) {
+        return TSD_PID_NOT_FOUND;
+    }
+
+    TSDSectionFilter *filter = find_section_filter(ctx, pid, table_id, mask,
+                                                   table_id_extension, extension_mask);
+    if(filter == NULL) {
+        return TSD_PID_NOT_FOUND;
+    }
+    *filter = ctx->section_filters.filters[--ctx->section_filters.length];
+
+    // the PID is only routed while it has a filter
+    size_t i;
+    for(i=0; i<ctx->section_filters.length; ++i) {
+        if(ctx->section_filters.filters[i].pid == pid) {
             return TSD_OK;
         }
     }
-    return TSD_PID_NOT_FOUND;
+    ctx->pid_map[pid].flags &= ~TSD_ROUTE_SECTIONS;
+    return TSD_OK;
 }
 
 TSDCode tsd_parse_descriptor_video_stream(const uint8_t *data,
@@ -2091,3 +5268,201 @@ TSDCode tsd_parse_descriptor_multiplex_buffer(const uint8_t *data,
 
     return TSD_OK;
 }
+
+// every decoder has the same signature, so they can share one table indexed
+// by the descriptor tag.
+typedef TSDCode (*descriptor_decoder)(const uint8_t *data,
+                                      size_t size,
+                                      TSDDecodedDescriptor *out);
+
+#define TSD_DESCRIPTOR_DECODER(id, tag, name, type) \
+TSDCode decode_descriptor_##name(const uint8_t *data, \
+                                 size_t size, \
+                                 TSDDecodedDescriptor *out) \
+{ \
+    return tsd_parse_descriptor_##name(data, size, &out->name); \
+}
+TSD_DESCRIPTOR_LIST(TSD_DESCRIPTOR_DECODER)
+#undef TSD_DESCRIPTOR_DECODER
+
+const descriptor_decoder descriptor_decoders[256] = {
+#define TSD_DESCRIPTOR_ENTRY(id, tag, name, type) [tag] = decode_descriptor_##name,
+    TSD_DESCRIPTOR_LIST(TSD_DESCRIPTOR_ENTRY)
+#undef TSD_DESCRIPTOR_ENTRY
+};
+
+TSDCode tsd_decode_descriptor(const TSDDescriptor *desc,
+                              TSDDecodedDescriptor *out)
+{
+    if(desc == NULL || out == NULL)     return TSD_INVALID_ARGUMENT;
+    if(desc->data == NULL)              return TSD_INVALID_DATA;
+
+    descriptor_decoder decode = descriptor_decoders[desc->tag];
+    if(!decode) {
+        return TSD_UNKNOWN_DESCRIPTOR;
+    }
+    return decode(desc->data, desc->data_length, out);
+}
+
+TSDCode tsd_find_start_code(const uint8_t *data, size_t size, size_t *offset)
+{
+    if(data == NULL && size > 0)    return TSD_INVALID_DATA;
+    if(offset == NULL)              return TSD_INVALID_ARGUMENT;
+
+    const uint8_t *ptr = data;
+    const uint8_t *end = data + size;
+    while(size > 0 && (ptr = find_start_code(ptr, end, 1)) != NULL) {
+        if(ptr[2] == 1) {
+            *offset = (size_t)(ptr - data);
+            return TSD_OK;
+        }
+        // 00 00 00, the start code may follow
+        ptr++;
+    }
+    *offset = size;
+    return TSD_END_OF_DATA;
+}
+
+TSDCode tsd_nal_splitter_init(TSDNALSplitter *splitter, uint8_t stream_type)
+{
+    if(splitter == NULL)                                return TSD_INVALID_ARGUMENT;
+    if(stream_type != TSD_PMT_STREAM_TYPE_VIDEO_AVC &&
+       stream_type != TSD_PMT_STREAM_TYPE_VIDEO_HEVC)   return TSD_INVALID_ARGUMENT;
+
+    memset(splitter, 0, sizeof(TSDNALSplitter));
+    splitter->stream_type = stream_type;
+    return TSD_OK;
+}
+
+// the number of zero bytes the data passed to the splitter ends with.
+size_t nal_splitter_trailing_zeros(const TSDNALSplitter *splitter)
+{
+    const uint8_t *ptr = splitter->data + splitter->size;
+    while(ptr > splitter->data && ptr[-1] == 0) {
+        ptr--;
+    }
+    size_t zeros = (size_t)(splitter->data + splitter->size - ptr);
+    return ptr == splitter->data ? splitter->zeros + zeros : zeros;
+}
+
+TSDCode tsd_nal_splitter_feed(TSDNALSplitter *splitter,
+                              const uint8_t *data,
+                              size_t size)
+{
+    if(splitter == NULL)            return TSD_INVALID_ARGUMENT;
+    if(data == NULL && size > 0)    return TSD_INVALID_DATA;
+
+    splitter->zeros = nal_splitter_trailing_zeros(splitter);
+    splitter->position += splitter->size;
+    splitter->data = data;
+    splitter->ptr = data;
+    splitter->size = size;
+    splitter->boundary = size > 0;
+    return TSD_OK;
+}
+
+// handles the 00 00 0x pattern at offset, preceded by zeros zero bytes.
+// Returns 1 when it ended a NAL unit, which is stored in unit.
+int nal_splitter_pattern(TSDNALSplitter *splitter,
+                         size_t offset,
+                         size_t zeros,
+                         uint8_t value,
+                         TSDNALUnit *unit)
+{
+    if(value == 3) {
+        if(splitter->active) {
+            splitter->unit.emulation_prevention_bytes++;
+        }
+        return 0;
+    }
+    if(value != 1) {
+        return 0;
+    }
+    int ended = 0;
+    if(splitter->active && !splitter->pending) {
+        size_t nal_end = offset - zeros;
+        *unit = splitter->unit;
+        unit->length = nal_end > unit->offset ? nal_end - unit->offset : 0;
+        ended = 1;
+    }
+    splitter->active = 1;
+    splitter->pending = 1;
+    splitter->unit.offset = offset + 3;
+    splitter->unit.length = 0;
+    splitter->unit.emulation_prevention_bytes = 0;
+    return ended;
+}
+
+TSDCode tsd_nal_splitter_next(TSDNALSplitter *splitter, TSDNALUnit *unit)
+{
+    if(splitter == NULL || unit == NULL)    return TSD_INVALID_ARGUMENT;
+
+    const uint8_t *data = splitter->data;
+    const uint8_t *end = data + splitter->size;
+    int ended = 0;
+
+    // a pattern split between the previous data and this one
+    if(splitter->boundary) {
+        splitter->boundary = 0;
+        size_t zeros = splitter->zeros;
+        if(zeros >= 2 && (data[0] == 1 || data[0] == 3)) {
+            ended = nal_splitter_pattern(splitter, splitter->position - 2,
+                                         zeros - 2, data[0], unit);
+            splitter->ptr = data + 1;
+        } else if(zeros >= 1 && splitter->size >= 2 && data[0] == 0 &&
+                  (data[1] == 1 || data[1] == 3)) {
+            ended = nal_splitter_pattern(splitter, splitter->position - 1,
+                                         zeros - 1, data[1], unit);
+            splitter->ptr = data + 2;
+        }
+    }
+
+    while(!ended) {
+        const uint8_t *ptr = splitter->ptr;
+        if(splitter->pending && ptr < end) {
+            uint8_t header = *ptr;
+            splitter->unit.type = splitter->stream_type == TSD_PMT_STREAM_TYPE_VIDEO_AVC ?
+                                  header & 0x1F : (header >> 1) & 0x3F;
+            splitter->pending = 0;
+        }
+        const uint8_t *hit = find_start_code(ptr, end, 3);
+        if(hit == NULL) {
+            splitter->ptr = end;
+            return TSD_END_OF_DATA;
+        }
+        if(hit[2] == 0 || hit[2] == 2) {
+            splitter->ptr = hit + 1;
+            continue;
+        }
+        // zero bytes in front of a start code aren't part of the NAL unit
+        const uint8_t *zero = hit;
+        while(zero > data && zero[-1] == 0) {
+            zero--;
+        }
+        size_t zeros = (size_t)(hit - zero);
+        if(zero == data) {
+            zeros += splitter->zeros;
+        }
+        ended = nal_splitter_pattern(splitter, splitter->position + (size_t)(hit - data),
+                                     zeros, hit[2], unit);
+        splitter->ptr = hit + 3;
+    }
+    return TSD_OK;
+}
+
+TSDCode tsd_nal_splitter_end(TSDNALSplitter *splitter, TSDNALUnit *unit)
+{
+    if(splitter == NULL || unit == NULL)    return TSD_INVALID_ARGUMENT;
+
+    int active = splitter->active && !splitter->pending;
+    splitter->active = 0;
+    splitter->pending = 0;
+    if(!active) {
+        return TSD_END_OF_DATA;
+    }
+    size_t nal_end = splitter->position + splitter->size -
+                     nal_splitter_trailing_zeros(splitter);
+    *unit = splitter->unit;
+    unit->length = nal_end > unit->offset ? nal_end - unit->offset : 0;
+    return TSD_OK;
+}
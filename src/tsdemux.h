@@ -34,8 +34,20 @@
 #define TSD_SYNC_BYTE                           (0x47)
 #define TSD_MESSAGE_LEN                         (128)
 #define TSD_TSPACKET_SIZE                       (188)
+#define TSD_M2TS_PACKET_SIZE                    (192)
+#define TSD_RS_PACKET_SIZE                      (204)
+#define TSD_PACKET_SIZE_DETECT_BYTES            (4096)
+#define TSD_FILE_WINDOW_SIZE                    (64 * 1024 * 1024)
 #define TSD_MEM_PAGE_SIZE                       (1024)
-#define TSD_MAX_PID_REGS                        (16)
+#define TSD_PID_REGS_INITIAL_CAPACITY           (16)
+#define TSD_PID_MAP_SIZE                        (8192)
+#define TSD_SYNC_CONFIRM_PACKETS                (3)
+#define TSD_SECTION_BUFFERS_MAX                 (16)
+#define TSD_TABLE_CACHE_INITIAL_CAPACITY        (16)
+#define TSD_SECTION_FILTERS_INITIAL_CAPACITY    (8)
+#define TSD_ARENA_ALIGNMENT                     (16)
+#define TSD_PES_HEADER_MAX_SIZE                 (6 + 3 + 255)
+#define TSD_PES_SLICES_INITIAL_CAPACITY         (16)
 
 // C++ support
 #ifdef __cplusplus
@@ -61,15 +73,30 @@ typedef struct TSDTableSection TSDTableSection;
  */
 typedef enum TSDEventId {
     TSD_EVENT_PAT                            = 0x0001,
+    /// data is the TSDPMTData of the program directory, see tsd_get_program
     TSD_EVENT_PMT                            = 0x0002,
     TSD_EVENT_CAT                            = 0x0004,
     TSD_EVENT_TSDT                           = 0x0008,
-    /// Unsupported TSDTable
+    /// Table passing a section filter, data is a TSDTableData
     TSD_EVENT_TABLE                          = 0x0010,
     // User Registered PES data
     TSD_EVENT_PES                            = 0x0020,
     // User Registered Adaptionn Field Private Data
     TSD_EVENT_ADAP_FIELD_PRV_DATA            = 0x0040,
+    /// Packet sync was lost, data is a TSDSyncEvent
+    TSD_EVENT_SYNC_LOSS                      = 0x0080,
+    /// Packet sync was (re)acquired, data is a TSDSyncEvent
+    TSD_EVENT_SYNC_ACQUIRED                  = 0x0100,
+    /// User Registered PCR, data is the TSDAdaptationField carrying it
+    TSD_EVENT_PCR                            = 0x0200,
+    /// User Registered PES as slices, data is a TSDPESSlices
+    TSD_EVENT_PES_SLICES                     = 0x0400,
+    /// Streamed PES header, data is a TSDPESPacket without data_bytes
+    TSD_EVENT_PES_START                      = 0x0800,
+    /// Streamed PES payload, data is a TSDPESChunk
+    TSD_EVENT_PES_DATA                       = 0x1000,
+    /// Streamed PES end, data is a TSDPESChunk
+    TSD_EVENT_PES_END                        = 0x2000,
 } TSDEventId;
 
 typedef enum TSDEventId TSDEventId;
@@ -100,6 +127,34 @@ typedef void * (*tsd_realloc) (void *ptr, size_t size);
  */
 typedef void (*tsd_free) (void *mem);
 
+/**
+ * Allocator.
+ * A set of memory functions which are all passed user, so that each context
+ * can allocate from its own arena or pool without global state.
+ * @see tsd_set_allocator
+ */
+typedef struct TSDAllocator {
+    void * (*malloc) (void *user, size_t size);
+    void * (*calloc) (void *user, size_t num, size_t size);
+    void * (*realloc) (void *user, void *ptr, size_t size);
+    void (*free) (void *user, void *mem);
+    void *user;
+} TSDAllocator;
+
+/**
+ * Arena.
+ * A bump allocator handing out memory from a region supplied by the user.
+ * Memory is only given back when the arena is reset, apart from the most
+ * recent allocation which can be freed or grown in place.
+ * @see tsd_arena_init
+ */
+typedef struct TSDArena {
+    uint8_t *buffer;
+    size_t size;
+    size_t used;    /// bytes of buffer handed out so far
+    size_t last;    /// offset of the most recent allocation
+} TSDArena;
+
 /**
  * Event Callback.
  */
@@ -127,6 +182,12 @@ typedef enum TSDCode {
     TSD_TSD_MAX_PID_REGS_REACHED              = 0x000C,
     TSD_PID_NOT_FOUND                         = 0x000D,
     TSD_INVALID_POINTER_FIELD                 = 0x000E,
+    TSD_FILE_ERROR                            = 0x000F,
+    TSD_TABLE_UNCHANGED                       = 0x0010,
+    TSD_INVALID_CRC                           = 0x0011,
+    TSD_END_OF_DATA                           = 0x0012,
+    TSD_UNKNOWN_DESCRIPTOR                    = 0x0013,
+    TSD_PROGRAM_NOT_FOUND                     = 0x0014,
 } TSDCode;
 
 /**
@@ -136,6 +197,8 @@ typedef enum TSDPacketFlags {
     TSD_PF_TRAN_ERR_INDICATOR                 = 0x04,
     TSD_PF_PAYLOAD_UNIT_START_IND             = 0x02,
     TSD_PF_TRAN_PRIORITY                      = 0x01,
+    /// PCR present, only set by tsd_parse_packet_headers_batch
+    TSD_PF_PCR                                = 0x08,
 } TSDPacketFlags;
 
 /**
@@ -352,6 +415,7 @@ typedef enum TSDPMTStreamType {
     TSD_PMT_STREAM_TYPE_IPMP                         = 0x1A,
     TSD_PMT_STREAM_TYPE_VIDEO_AVC                    = 0X1B,
     TSD_PMT_STREAM_TYPE_VIDEO_H222_0                 = 0x1C,
+    TSD_PMT_STREAM_TYPE_VIDEO_HEVC                   = 0x24,
     TSD_PMT_STREAM_TYPE_DCII_VIDEO                   = 0x80,
     TSD_PMT_STREAM_TYPE_AUDIO_A53                    = 0x81,
     TSD_PMT_STREAM_TYPE_SCTE_STD_SUBTITLE            = 0x82,
@@ -382,8 +446,42 @@ typedef enum TSDPMTStreamType {
 typedef enum TSDRegType {
     TSD_REG_PES                     = 0x01,
     TSD_REG_ADAPTATION_FIELD        = 0x02,
+    TSD_REG_PCR                     = 0x04,
+    /// PES packets delivered as TSD_EVENT_PES_SLICES instead of TSD_EVENT_PES
+    TSD_REG_PES_SLICES              = 0x08,
+    /// PES packets streamed as TSD_EVENT_PES_START, TSD_EVENT_PES_DATA and
+    /// TSD_EVENT_PES_END as they arrive, nothing but the header is buffered
+    TSD_REG_PES_STREAM              = 0x10,
+    /// unbounded AVC and HEVC PES packets are delivered as soon as an access
+    /// unit is known to be complete, rather than at the next PES
+    TSD_REG_PES_AU_END              = 0x20,
 } TSDRegType;
 
+/**
+ * PES Stream State.
+ * Progress of the PES being streamed on a PID registered with
+ * TSD_REG_PES_STREAM.
+ */
+typedef enum TSDPESStreamState {
+    TSD_PES_STREAM_IDLE             = 0x00,
+    TSD_PES_STREAM_HEADER           = 0x01,
+    TSD_PES_STREAM_PAYLOAD          = 0x02,
+} TSDPESStreamState;
+
+/**
+ * PID Route Flags.
+ * The role(s) a PID plays during demux, as stored in the Context's PID map.
+ * @see TSDPIDRoute
+ */
+typedef enum TSDPIDRouteFlags {
+    TSD_ROUTE_PAT                   = 0x01,
+    TSD_ROUTE_CAT                   = 0x02,
+    TSD_ROUTE_TSDT                  = 0x04,
+    TSD_ROUTE_PMT                   = 0x08,
+    TSD_ROUTE_REGISTERED            = 0x10,
+    TSD_ROUTE_SECTIONS              = 0x20,
+} TSDPIDRouteFlags;
+
 /**
  * Video Stream Descriptor Flags.
  */
@@ -417,6 +515,44 @@ typedef struct TSDDataContext {
     uint32_t id;
 } TSDDataContext;
 
+/**
+ * Section Assembler.
+ * Collects the sections of one table, identified by the PID it is carried on
+ * and the table_id, table_id_extension and version_number in data.id. The
+ * first complete bytes of data hold the sections received so far, in the
+ * order they arrived, followed by the section being assembled. received has
+ * a bit set for each section_number held, the table is complete once every
+ * section up to last_section_number has arrived. skip counts the bytes left
+ * of a section already held, which are passed over without being copied.
+ * The assemblers in use on a PID are chained through pid_next, starting from
+ * the one in slot found in the PID map.
+ */
+typedef struct TSDSectionAssembler {
+    TSDDataContext data;
+    uint16_t pid;
+    uint16_t slot;
+    uint8_t last_section_number;
+    uint32_t received[8];
+    size_t complete;
+    size_t skip;
+    struct TSDSectionAssembler *next;
+    struct TSDSectionAssembler *prev;
+    struct TSDSectionAssembler *pid_next;
+} TSDSectionAssembler;
+
+/**
+ * Table Cache Entry.
+ * The version of a PSI table last delivered on a PID. crc folds together the
+ * CRC_32 of every section in the table.
+ */
+typedef struct TSDTableCacheEntry {
+    uint16_t pid;
+    uint8_t table_id;
+    uint16_t table_id_extension;
+    uint8_t version_number;
+    uint32_t crc;
+} TSDTableCacheEntry;
+
 /**
  * Adaptation Field Extension.
  */
@@ -467,8 +603,25 @@ typedef struct TSDPacket {
     TSDAdaptationField adaptation_field;
     const uint8_t *data_bytes;
     size_t data_bytes_length;
+    uint32_t arrival_time_stamp;    /// 30 bit M2TS arrival_time_stamp, 0 otherwise
 } TSDPacket;
 
+/**
+ * Packet Headers.
+ * Parallel arrays filled in by tsd_parse_packet_headers_batch, entry i of each
+ * array belongs to the i'th packet. The arrays are owned by the caller and
+ * must each have room for capacity entries.
+ */
+typedef struct TSDPacketHeaders {
+    uint16_t *pid;
+    uint8_t *flags;                     /// TSDPacketFlags
+    uint8_t *continuity_counter;
+    uint8_t *adaptation_field_control;  /// TSDAdaptionFieldControl
+    uint8_t *payload_offset;            /// from the sync byte, TSD_TSPACKET_SIZE when there is no payload
+    uint64_t *pcr;                      /// 27MHz PCR or 0 without TSD_PF_PCR, may be NULL
+    size_t capacity;
+} TSDPacketHeaders;
+
 /**
  * DSM Trick Mode.
  */
@@ -557,6 +710,44 @@ typedef struct TSDPESPacket {
 // re-typing the PESPacket for user callback consistency.
 typedef TSDPESPacket TSDPESData;
 
+/**
+ * Slice.
+ * A contiguous run of PES payload, laid out like struct iovec so an array of
+ * slices can be handed to writev as is.
+ */
+typedef struct TSDSlice {
+    const uint8_t *data;
+    size_t length;
+} TSDSlice;
+
+/**
+ * PES Slices.
+ * Data of TSD_EVENT_PES_SLICES. The payload of the PES packet is not copied,
+ * the slices point into the data passed to tsd_demux and are only valid
+ * until the callback returns. Only the part of a PES packet received in
+ * earlier calls to tsd_demux is copied, the first slice then points into the
+ * PID's Data Context.
+ */
+typedef struct TSDPESSlices {
+    /// the parsed PES header, data_bytes is NULL and data_bytes_length is
+    /// the size of the payload held by the slices
+    TSDPESPacket pes;
+    const TSDSlice *slices;
+    size_t slices_length;
+} TSDPESSlices;
+
+/**
+ * PES Chunk.
+ * Data of TSD_EVENT_PES_DATA, a piece of the payload of the PES being
+ * streamed, valid until the callback returns. TSD_EVENT_PES_END passes a
+ * chunk without data whose offset is the size of the whole payload.
+ */
+typedef struct TSDPESChunk {
+    const uint8_t *data;
+    size_t length;
+    size_t offset;      /// offset of data into the PES payload
+} TSDPESChunk;
+
 /**
  * TSDTable Section.
  * Represents any short or long form table section, both PSI and private.
@@ -604,6 +795,50 @@ typedef struct TSDDescriptor {
     size_t data_length;
 } TSDDescriptor;
 
+/**
+ * NAL Unit.
+ * A NAL unit found by a TSDNALSplitter. Offsets count the bytes passed to the
+ * splitter since it was initialised.
+ * @see tsd_nal_splitter_next
+ */
+typedef struct TSDNALUnit {
+    uint8_t type;                       /// nal_unit_type
+    size_t offset;                      /// offset of the NAL unit header
+    size_t length;                      /// length from the header on, without trailing zero bytes
+    size_t emulation_prevention_bytes;  /// emulation_prevention_three_bytes in the NAL unit
+} TSDNALUnit;
+
+/**
+ * NAL Splitter.
+ * Splits an Annex B byte stream of AVC or HEVC into NAL units. The stream may
+ * be passed in pieces of any size, such as the TSD_EVENT_PES_DATA chunks of a
+ * PID registered with TSD_REG_PES_STREAM, start codes split between two
+ * pieces are found as well.
+ * @see tsd_nal_splitter_init
+ */
+typedef struct TSDNALSplitter {
+    uint8_t stream_type;
+    const uint8_t *data;    /// the data being split
+    const uint8_t *ptr;     /// where the search carries on in data
+    size_t size;
+    size_t position;        /// offset of data into the stream
+    size_t zeros;           /// zero bytes the stream ended with before data
+    int boundary;           /// the start of data wasn't checked against the end of the previous data yet
+    int active;             /// a NAL unit is being received
+    int pending;            /// its header hasn't been received yet
+    TSDNALUnit unit;
+} TSDNALSplitter;
+
+/**
+ * Descriptor Iterator.
+ * Walks a descriptor loop in place, on the stack and without allocating.
+ * @see tsd_descriptor_iter_init
+ */
+typedef struct TSDDescriptorIter {
+    const uint8_t *ptr;
+    const uint8_t *end;
+} TSDDescriptorIter;
+
 /**
  * Program Element.
  * Description of a Program from the PMT.
@@ -639,6 +874,30 @@ typedef struct TSDDescriptorData {
     size_t descriptors_length;
 } TSDDescriptorData;
 
+/**
+ * Program.
+ * A program of the latest PAT, along with its latest PMT once one has been
+ * received. Kept by the context in its program directory.
+ */
+typedef struct TSDProgram {
+    uint16_t program_number;
+    uint16_t pmt_pid;
+    int has_pmt;            /// set once pmt holds the PMT of the program
+    TSDPMTData pmt;         /// descriptors point into data
+    uint8_t *data;          /// copy of the PMT table data
+    size_t data_length;
+} TSDProgram;
+
+/**
+ * Program Stream Reference.
+ * Entry of the program directory index of elementary streams, by PID.
+ */
+typedef struct TSDProgramStreamRef {
+    uint16_t pid;
+    uint16_t program;       /// index into the directory programs
+    uint16_t element;       /// index into the program elements of the PMT
+} TSDProgramStreamRef;
+
 typedef TSDDescriptorData TSDCATData;
 typedef TSDDescriptorData TSDTSDTData;
 
@@ -652,6 +911,23 @@ typedef struct TSDTableData {
     size_t size;    /// The number of bytes in data
 } TSDTableData;
 
+/**
+ * Section Filter.
+ * Selects the sections on pid whose table_id equals table_id in every bit
+ * set in mask. When extension_mask isn't 0 the table_id_extension of long
+ * form sections must also equal table_id_extension in every bit set in it,
+ * short form sections never match.
+ * @see tsd_register_section_filter
+ * @see tsd_register_section_filter_ext
+ */
+typedef struct TSDSectionFilter {
+    uint16_t pid;
+    uint8_t table_id;
+    uint8_t mask;
+    uint16_t table_id_extension;
+    uint16_t extension_mask;
+} TSDSectionFilter;
+
 /**
  * TS Demux Registration.
  * Lists what data of data the user wants to listen out for.
@@ -659,8 +935,49 @@ typedef struct TSDTableData {
 typedef struct TSDemuxRegistration {
     uint16_t pid;
     int data_types;
+    /// running max of the recent PES packet sizes, used to size the buffer
+    /// of unbounded PES packets before they arrive
+    size_t size_hint;
+    /// payload slices of the PES being received when registered with
+    /// TSD_REG_PES_SLICES. The first entry is kept for the copied prefix.
+    TSDSlice *slices;
+    size_t slices_length;
+    size_t slices_capacity;
+    size_t slices_bytes;
+    /// progress of the PES being streamed when registered with
+    /// TSD_REG_PES_STREAM, stream_length is 0 for unbounded PES packets
+    TSDPESStreamState stream_state;
+    size_t stream_offset;
+    size_t stream_length;
+    /// access unit tracking when registered with TSD_REG_PES_AU_END. The
+    /// stream_type comes from the PMT, au_scanned is the offset into the
+    /// buffer up to which start codes were searched.
+    uint8_t au_stream_type;
+    size_t au_scanned;
+    int au_vcl;             /// a VCL NAL unit of the current access unit was seen
+    int au_continued;       /// the buffer holds what followed a delivered access unit
 } TSDemuxRegistration;
 
+/**
+ * Sync Event.
+ * Data passed along with TSD_EVENT_SYNC_LOSS and TSD_EVENT_SYNC_ACQUIRED.
+ */
+typedef struct TSDSyncEvent {
+    size_t offset;          /// offset into the data passed to tsd_demux
+    size_t bytes_skipped;   /// bytes discarded before sync was acquired
+} TSDSyncEvent;
+
+/**
+ * PID Route.
+ * Entry in the PID map, describing how packets on a PID are dispatched.
+ * PIDs with no flags set are ignored.
+ */
+typedef struct TSDPIDRoute {
+    uint8_t flags;      /// TSDPIDRouteFlags
+    uint16_t index;     /// index into registered_pids when TSD_ROUTE_REGISTERED
+    uint16_t assembler; /// 1 + slot of the newest section assembler, 0 if none
+} TSDPIDRoute;
+
 /**
  * TS Demux Context.
  * The TSDEmuxContext is used to separate multiple demux tasks.
@@ -671,13 +988,73 @@ typedef struct TSDemuxContext {
     tsd_calloc calloc;
     tsd_free free;
 
+    /**
+     * Allocator.
+     * When set with tsd_set_allocator every allocation made for the context
+     * goes through it, instead of the functions above.
+     */
+    TSDAllocator allocator;
+
     /**
      * Registerd PIDs.
-     * The PIDs registered for demuxing.
+     * The PIDs registered for demuxing. Both arrays grow geometrically from
+     * TSD_PID_REGS_INITIAL_CAPACITY and are never shrunk, so PIDs can be
+     * added and removed repeatedly without further allocations.
      */
-    TSDemuxRegistration registered_pids[TSD_MAX_PID_REGS];
-    TSDDataContext *registered_pids_data[TSD_MAX_PID_REGS];
+    TSDemuxRegistration *registered_pids;
+    TSDDataContext **registered_pids_data;
     size_t registered_pids_length;
+    size_t registered_pids_capacity;
+
+    /**
+     * PID Map.
+     * TSD_PID_MAP_SIZE routing entries indexed by PID, kept up to date as the
+     * PAT changes and PIDs are (de)registered. Allocated on first use.
+     */
+    TSDPIDRoute *pid_map;
+
+    /**
+     * Sync State.
+     * Sync is only acquired when a sync byte is followed by confirm_packets
+     * more sync bytes at packet size intervals. Data still waiting to be
+     * confirmed is kept in the carry buffer across calls to tsd_demux, only
+     * tsd_demux_end accepts it on fewer. Defaults to TSD_SYNC_CONFIRM_PACKETS,
+     * at most as many as fit in TSD_PACKET_SIZE_DETECT_BYTES are used.
+     */
+    struct {
+        int locked;
+        size_t confirm_packets;
+        size_t bytes_skipped;
+        size_t packet_size;     /// detected packet size, 0 until detected
+    } sync;
+
+    /**
+     * Packet Size.
+     * TSD_TSPACKET_SIZE, TSD_M2TS_PACKET_SIZE or TSD_RS_PACKET_SIZE, or 0 to
+     * detect it from the start of the stream. Data is collected across calls
+     * to tsd_demux until a run of sync bytes long enough to confirm sync shows
+     * the packet size, or TSD_PACKET_SIZE_DETECT_BYTES have been collected.
+     * @see tsd_set_packet_size
+     */
+    size_t packet_size;
+
+    /**
+     * Carry.
+     * The end of the data passed to tsd_demux that didn't make a whole packet,
+     * completed with the start of the data in the next call. Holds the start
+     * of the stream while its packet size is being detected.
+     */
+    struct {
+        uint8_t data[TSD_PACKET_SIZE_DETECT_BYTES];
+        size_t length;
+    } carry;
+
+    /**
+     * Arrival Time Stamp.
+     * The M2TS arrival_time_stamp of the packet being demuxed, valid during
+     * event callbacks. Always 0 for other packet sizes.
+     */
+    uint32_t arrival_time_stamp;
 
     /**
      * On Event Callback.
@@ -693,16 +1070,94 @@ typedef struct TSDemuxContext {
         int valid;
     } pat;
 
+    /**
+     * Program Directory.
+     * The programs of the latest PAT sorted by program number, each with its
+     * latest PMT, kept until a PAT drops the program. PMTs of programs the
+     * PAT doesn't list are dropped. streams indexes the elementary streams
+     * of every PMT, sorted by PID. generation goes up every time the PAT or
+     * a PMT changes, consumers can compare it with the value they last saw
+     * instead of comparing tables.
+     * @see tsd_get_program
+     */
+    struct {
+        TSDProgram *programs;
+        size_t length;
+        size_t capacity;
+        TSDProgramStreamRef *streams;
+        size_t streams_length;
+        size_t streams_capacity;
+        uint32_t generation;
+    } directory;
+
     /**
      * Data Context Buffers.
-     * Tempoary pool of buffers used during demuxing.
+     * Pool of section assemblers kept across tsd_demux calls. Each table
+     * being assembled has its own assembler on the used list, most recent
+     * first, so tables on different PIDs, or different tables on the same
+     * PID, can be interleaved. Assemblers return to the free list once their
+     * table is complete.
+     * length counts every buffer in the pool, at most max_length are kept.
+     * slots holds every buffer at the index it was given when created, the
+     * PID map refers to them by it.
+     * pool_allocations counts the heap allocations made by this pool alone,
+     * it stays flat once the tables being assembled reach a steady state.
+     * Allocations made elsewhere, such as for the parsed tables passed to
+     * the event callback, aren't counted. Set an allocator to count those.
+     * @see tsd_set_section_buffer_limit
+     * @see tsd_set_allocator
      */
     struct {
-        TSDDataContext *active;
-        TSDDataContext *pool;
+        TSDSectionAssembler *used;
+        TSDSectionAssembler *free;
+        TSDSectionAssembler **slots;
+        size_t slots_capacity;
         size_t length;
+        size_t max_length;
+        size_t pool_allocations;
     } buffers;
 
+    /**
+     * Table Cache.
+     * PAT and PMT tables already delivered. A repeat of a table with the same
+     * version and CRCs is dropped before it is parsed and raises no event.
+     * @see tsd_set_table_cache
+     */
+    struct {
+        TSDTableCacheEntry *entries;
+        size_t length;
+        size_t capacity;
+        int enabled;
+    } table_cache;
+
+    /**
+     * Section Filters.
+     * The tables the user wants from PIDs other than the PAT, CAT, TSDT and
+     * PMTs, delivered with TSD_EVENT_TABLE. Every PID with a filter is routed
+     * with TSD_ROUTE_SECTIONS.
+     * @see tsd_register_section_filter
+     */
+    struct {
+        TSDSectionFilter *filters;
+        size_t length;
+        size_t capacity;
+    } section_filters;
+
+    /**
+     * Statistics.
+     * crc_errors counts the sections dropped because they failed their
+     * CRC_32 check. table_errors counts the packets of PSI that couldn't be
+     * parsed and were skipped by tsd_demux, last_table_error is the TSDCode
+     * of the latest one. section_evictions counts the partial tables dropped
+     * because every section buffer was in use.
+     */
+    struct {
+        size_t crc_errors;
+        size_t table_errors;
+        TSDCode last_table_error;
+        size_t section_evictions;
+    } stats;
+
 } TSDemuxContext;
 
 /**
@@ -978,6 +1433,65 @@ typedef struct TSDDescriptorMultiplexBuffer {
     uint32_t tb_leak_rate;
 } TSDDescriptorMultiplexBuffer;
 
+/**
+ * Descriptor List.
+ * Every descriptor tsd_decode_descriptor knows about, as
+ * X(id, tag, name, type). name is both the member of TSDDecodedDescriptor
+ * and the suffix of the tsd_parse_descriptor_ function decoding it, so a new
+ * descriptor only needs its struct, its parse function and a line here.
+ */
+#define TSD_DESCRIPTOR_LIST(X) \
+    X(TSD_DESCRIPTOR_VIDEO_STREAM,                  0x02, video_stream,                  TSDDescriptorVideoStream) \
+    X(TSD_DESCRIPTOR_AUDIO_STREAM,                  0x03, audio_stream,                  TSDDescriptorAudioStream) \
+    X(TSD_DESCRIPTOR_HIERARCHY,                     0x04, hierarchy,                     TSDDescriptorHierarchy) \
+    X(TSD_DESCRIPTOR_REGISTRATION,                  0x05, registration,                  TSDDescriptorRegistration) \
+    X(TSD_DESCRIPTOR_DATA_STREAM_ALIGNMENT,         0x06, data_stream_alignment,         TSDDescriptorDataStreamAlignment) \
+    X(TSD_DESCRIPTOR_TARGET_BACKGROUND_GRID,        0x07, target_background_grid,        TSDDescriptorTargetBackgroundGrid) \
+    X(TSD_DESCRIPTOR_VIDEO_WINDOW,                  0x08, video_window,                  TSDDescriptorVideoWindow) \
+    X(TSD_DESCRIPTOR_CONDITIONAL_ACCESS,            0x09, conditional_access,            TSDDescriptorConditionalAccess) \
+    X(TSD_DESCRIPTOR_ISO639_LANGUAGE,               0x0A, iso639_language,               TSDDescriptorISO639Language) \
+    X(TSD_DESCRIPTOR_SYSTEM_CLOCK,                  0x0B, system_clock,                  TSDDescriptorSystemClock) \
+    X(TSD_DESCRIPTOR_MULTIPLEX_BUFFER_UTILIZATION,  0x0C, multiplex_buffer_utilization,  TSDDescriptorMultiplexBufferUtilization) \
+    X(TSD_DESCRIPTOR_COPYRIGHT,                     0x0D, copyright,                     TSDDescriptorCopyright) \
+    X(TSD_DESCRIPTOR_MAX_BITRATE,                   0x0E, max_bitrate,                   TSDDescriptorMaxBitrate) \
+    X(TSD_DESCRIPTOR_PRIV_DATA_IND,                 0x0F, priv_data_ind,                 TSDDescriptorPrivDataInd) \
+    X(TSD_DESCRIPTOR_SMOOTHING_BUFFER,              0x10, smoothing_buffer,              TSDDescriptorSmoothingBuffer) \
+    X(TSD_DESCRIPTOR_SYS_TARGET_DECODER,            0x11, sys_target_decoder,            TSDDescriptorSysTargetDecoder) \
+    X(TSD_DESCRIPTOR_IBP,                           0x12, ibp,                           TSDDescriptorIBP) \
+    X(TSD_DESCRIPTOR_MPEG4_VIDEO,                   0x1B, mpeg4_video,                   TSDDescriptorMPEG4Video) \
+    X(TSD_DESCRIPTOR_MPEG4_AUDIO,                   0x1C, mpeg4_audio,                   TSDDescriptorMPEG4Audio) \
+    X(TSD_DESCRIPTOR_IOD,                           0x1D, iod,                           TSDDescriptorIOD) \
+    X(TSD_DESCRIPTOR_SL,                            0x1E, sl,                            TSDDescriptorSL) \
+    X(TSD_DESCRIPTOR_FMC,                           0x1F, fmc,                           TSDDescriptorFMC) \
+    X(TSD_DESCRIPTOR_EXTERNAL_ES_ID,                0x20, external_es_id,                TSDDescriptorExternalESID) \
+    X(TSD_DESCRIPTOR_MUX_CODE,                      0x21, mux_code,                      TSDDescriptorMuxCode) \
+    X(TSD_DESCRIPTOR_FMX_BUFFER_SIZE,               0x22, fmx_buffer_size,               TSDDescriptorFMXBufferSize) \
+    X(TSD_DESCRIPTOR_MULTIPLEX_BUFFER,              0x23, multiplex_buffer,              TSDDescriptorMultiplexBuffer)
+
+/**
+ * Descriptor Tags.
+ */
+typedef enum TSDDescriptorTag {
+#define TSD_DESCRIPTOR_TAG(id, tag, name, type) id = tag,
+    TSD_DESCRIPTOR_LIST(TSD_DESCRIPTOR_TAG)
+#undef TSD_DESCRIPTOR_TAG
+} TSDDescriptorTag;
+
+/**
+ * Decoded Descriptor.
+ * Holds any descriptor decoded by tsd_decode_descriptor. Every member starts
+ * with the tag and length, which can always be read through header.
+ */
+typedef union TSDDecodedDescriptor {
+    struct {
+        uint8_t tag;
+        uint8_t length;
+    } header;
+#define TSD_DESCRIPTOR_MEMBER(id, tag, name, type) type name;
+    TSD_DESCRIPTOR_LIST(TSD_DESCRIPTOR_MEMBER)
+#undef TSD_DESCRIPTOR_MEMBER
+} TSDDecodedDescriptor;
+
 /**
  * Get software version.
  * Gets the verison of the softare as a string.
@@ -1016,19 +1530,128 @@ TSDCode tsd_context_destroy(TSDemuxContext *ctx);
  */
 TSDCode tsd_set_event_callback(TSDemuxContext *ctx, tsd_on_event callback);
 
+/**
+ * Set the Packet Size.
+ * Packets may be plain 188 byte packets, 192 byte M2TS packets that start with
+ * a 4 byte arrival time stamp, or 204 byte packets that end with 16 bytes of
+ * Reed-Solomon parity. By default the packet size is detected, which holds
+ * back the first few packets of the stream until it is certain. Set it when
+ * it is known up front and the stream is fed a packet at a time.
+ * @param ctx The context being used to demux.
+ * @param packet_size TSD_TSPACKET_SIZE, TSD_M2TS_PACKET_SIZE,
+ *                    TSD_RS_PACKET_SIZE or 0 to detect the packet size.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT for any other size.
+ */
+TSDCode tsd_set_packet_size(TSDemuxContext *ctx, size_t packet_size);
+
+/**
+ * Set the Allocator.
+ * Makes every allocation of the context go through allocator, which is
+ * copied. Set the allocator straight after tsd_context_init, memory already
+ * allocated is released through the allocator that made it only if it is
+ * still set. Passing NULL goes back to the malloc, realloc, calloc and free
+ * members of the context.
+ * @param ctx The context being used to demux.
+ * @param allocator The allocator to use or NULL.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if one of the functions of
+ *         allocator is NULL.
+ */
+TSDCode tsd_set_allocator(TSDemuxContext *ctx, const TSDAllocator *allocator);
+
+/**
+ * Initialize an Arena.
+ * The arena hands out memory from buffer, aligned to TSD_ARENA_ALIGNMENT. It
+ * never allocates, once buffer is used up allocations fail until the arena
+ * is reset.
+ * @param arena The arena to initialize.
+ * @param buffer The region to allocate from, owned by the caller.
+ * @param size The number of bytes in buffer.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_arena_init(TSDArena *arena, void *buffer, size_t size);
+
+/**
+ * Reset an Arena.
+ * Makes the whole region available again, for example between streams.
+ * Nothing allocated from the arena may be used afterwards, destroy the
+ * contexts using it first.
+ * @param arena The arena to reset.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_arena_reset(TSDArena *arena);
+
+/**
+ * Arena Allocator.
+ * Fills allocator with functions allocating from arena, to be passed to
+ * tsd_set_allocator. The arena isn't thread safe, give each thread its own.
+ * @param arena The arena to allocate from.
+ * @param allocator The allocator to fill in.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_arena_allocator(TSDArena *arena, TSDAllocator *allocator);
+
+/**
+ * Set the Section Buffer Limit.
+ * Sets how many section assembly buffers the context keeps for reuse, by
+ * default TSD_SECTION_BUFFERS_MAX. When every buffer is in use the oldest
+ * partial table is dropped to make room for a new one, and counted in the
+ * context's stats.section_evictions. Raise the limit when that happens on
+ * streams carrying many tables at once.
+ * @param ctx The context being used to demux.
+ * @param max_length The maximum number of buffers, from 1 to 65535.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if max_length is out of
+ *         range.
+ */
+TSDCode tsd_set_section_buffer_limit(TSDemuxContext *ctx, size_t max_length);
+
+/**
+ * Enable or Disable the Table Cache.
+ * With the cache enabled, which is the default, TSD_EVENT_PAT and
+ * TSD_EVENT_PMT are only raised when a table changes. Repeats with the same
+ * version_number and CRC_32 are dropped without being parsed. Disable the
+ * cache to be notified of every repetition.
+ * @param ctx The context being used to demux.
+ * @param enabled 1 to enable the cache, 0 to disable it.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_set_table_cache(TSDemuxContext *ctx, int enabled);
+
 /**
  * Demux a Transport Stream.
+ * Data may be passed in chunks of any size, it doesn't need to start or end
+ * on a packet boundary. A partial packet at the end of data is carried over
+ * internally and completed by the next call. Until packet sync is acquired,
+ * data is searched for a run of sync bytes at packet intervals. Packets of
+ * PSI that can't be parsed are skipped and counted in the context's stats.
+ * PES packets on PIDs registered with TSD_REG_PES_SLICES are delivered as
+ * slices pointing into data, which must not change until tsd_demux returns.
  * @param ctx The contenxt being used to demux,
  * @param data The data to demux.
  * @param size The size of data.
- * @param parsedSize The total number of bytes parsed will be populated in parsedSize. This will be 0 if an error is returned.
+ * @param parsedSize The total number of bytes parsed will be populated in parsedSize. This is size on success and 0 if an error is returned.
  * @return Returns TSD_OK on success.
  */
 TSDCode tsd_demux(TSDemuxContext *ctx, void *data, size_t size, size_t *parsedSize);
 
+/**
+ * Demux a File.
+ * Demuxes a whole file, then ends the demux process with tsd_demux_end.
+ * Where mmap is available the file is mapped window_size bytes at a time, so
+ * PES packets that fit in a single TS packet point straight into the mapping
+ * and large files only take window_size bytes of address space. Otherwise the
+ * file is read into a window_size buffer.
+ * @param ctx The context being used to demux.
+ * @param path The path of the file to demux.
+ * @param window_size Bytes demuxed per tsd_demux call, 0 for
+ *                    TSD_FILE_WINDOW_SIZE.
+ * @return TSD_OK on success, TSD_FILE_ERROR if the file can't be read.
+ */
+TSDCode tsd_demux_file(TSDemuxContext *ctx, const char *path, size_t window_size);
+
 /**
  * Ends the Demuxxing process.
- * Flushing any pending PES packets in the buffers.
+ * Flushing any pending PES packets in the buffers, and any packet carried over
+ * from the last call to tsd_demux.
  * @param ctx The context being used to demux.
  * @return TSD_OK on success.
  */
@@ -1051,6 +1674,25 @@ TSDCode tsd_parse_packet_header(TSDemuxContext *ctx,
                                 size_t size,
                                 TSDPacket *hdr);
 
+/**
+ * Parse Packet Headers in Bulk.
+ * Decodes the headers of consecutive packets into the parallel arrays of
+ * headers, without demuxing them. The packet size set on the context is used,
+ * TSD_TSPACKET_SIZE when there is none.
+ * @param ctx The context being used to demux.
+ * @param data The TS data to parse, starting at a packet boundary.
+ * @param size The number of bytes to parse.
+ * @param headers The arrays to fill in.
+ * @param count Populated with the number of packets parsed.
+ * @return TSD_OK on success, TSD_INVALID_SYNC_BYTE when parsing stopped at a
+ *         packet without a sync byte.
+ */
+TSDCode tsd_parse_packet_headers_batch(TSDemuxContext *ctx,
+                                       const uint8_t *data,
+                                       size_t size,
+                                       TSDPacketHeaders *headers,
+                                       size_t *count);
+
 /**
  * Parse TS Packet Adaption Field.
  * Parses the Adaption Field found inside a TSDPacket.
@@ -1073,6 +1715,11 @@ TSDCode tsd_parse_adaptation_field(TSDemuxContext *ctx,
  * The data contained within the table to produce a PAT, PMT or CAT
  * needs to be parsed once the generic table has been parsed.
  * This function supports both short and long form tables.
+ * A long form table is complete once every section from 0 to its
+ * last_section_number has arrived, in any order. The sections of the
+ * returned table are sorted by section_number. Sections arriving again
+ * before the table completes are skipped.
+ * Only the first table completed by pkt is returned.
  * @param ctx The context being used to demux.
  * @param pkt The packet to parse.
  * @param table Where to store the table output.
@@ -1081,12 +1728,24 @@ TSDCode tsd_parse_adaptation_field(TSDemuxContext *ctx,
  *                not enough data to complete the table. tsd_parse_table
  *                will then need to be called with the next packets
  *                idenitfied with the sample table PID.
+ *                TSD_INVALID_CRC will be returned, and the section dropped,
+ *                when a long form section fails its CRC_32 check.
  */
 
 TSDCode tsd_parse_table(TSDemuxContext *ctx,
                         TSDPacket *pkt,
                         TSDTable *table);
 
+/**
+ * Calculates a CRC-32/MPEG-2.
+ * The CRC used by PSI sections. A section including its CRC_32 field is
+ * intact when the result is 0.
+ * @param data The data to calculate the CRC of.
+ * @param size The number of bytes in data.
+ * @return The CRC of data.
+ */
+uint32_t tsd_crc32(const uint8_t *data, size_t size);
+
 /**
  * Parses all the TSDTable Sections to form a TSDTable.
  * Takes complete TSDTable data, which is all the TSDTable Sections that
@@ -1123,6 +1782,8 @@ TSDCode tsd_parse_pat(TSDemuxContext *ctx,
  * Parses TSDDescriptor data from a TSDTable.
  * The table data is the data supplied by a TSDTable object once a
  * generic table has been processed using tsd_parse_table.
+ * The descriptors array is allocated with ctx->calloc and points into data,
+ * use a TSDDescriptorIter instead to walk the descriptors without allocating.
  * @param ctx The context being used to demux.
  * @param data The table data to parse into CAT values.
  * @param size The size of the table data.
@@ -1138,6 +1799,10 @@ TSDCode tsd_parse_descriptors(TSDemuxContext *ctx,
  * Parses PMT data from a TSDTable.
  * The table data is the data supploed by a TSDTable object once a
  * generic table has been processed using tsd_parse_table.
+ * The program elements and every descriptor are stored in a single block,
+ * allocated with ctx->calloc. It starts at program_elements, or at
+ * descriptors when there are no program elements, and is released with one
+ * call to ctx->free. The descriptors point into data.
  * @param ctx The context being used to demux.
  * @param data The table data to parse into a PMT.
  * @param size The size of the table data.
@@ -1199,6 +1864,95 @@ TSDCode tsd_descriptor_extract(TSDemuxContext *ctx,
                                TSDDescriptor **descriptors,
                                size_t *descriptors_length);
 
+/**
+ * Get a Program.
+ * Looks up a program of the program directory. The program, and the PMT in
+ * it, stay valid until the next call to tsd_demux.
+ * @param ctx The context being used to demux.
+ * @param program_number The program number from the PAT.
+ * @param program Where to store the program.
+ * @return TSD_OK on success, TSD_PROGRAM_NOT_FOUND if the PAT has no such
+ *         program.
+ */
+TSDCode tsd_get_program(TSDemuxContext *ctx,
+                        uint16_t program_number,
+                        const TSDProgram **program);
+
+/**
+ * Get a Program by Elementary PID.
+ * Looks up the program carrying an elementary stream.
+ * @param ctx The context being used to demux.
+ * @param pid The elementary PID.
+ * @param program Where to store the program.
+ * @param element Where to store the program element of the stream, may be
+ *        NULL.
+ * @return TSD_OK on success, TSD_PID_NOT_FOUND if no PMT has the PID.
+ */
+TSDCode tsd_get_program_by_pid(TSDemuxContext *ctx,
+                               uint16_t pid,
+                               const TSDProgram **program,
+                               const TSDProgramElement **element);
+
+/**
+ * Find Streams by Stream Type.
+ * Walks the elementary streams of the program directory with the given stream
+ * type, in PID order. Set cursor to 0 to start, each call moves it on.
+ * @param ctx The context being used to demux.
+ * @param stream_type The stream type to look for, see TSDPMTStreamType.
+ * @param cursor Position of the search.
+ * @param program Where to store the program.
+ * @param element Where to store the program element of the stream.
+ * @return TSD_OK when a stream was found, TSD_END_OF_DATA when there are no
+ *         more.
+ */
+TSDCode tsd_find_stream_type(TSDemuxContext *ctx,
+                             uint8_t stream_type,
+                             size_t *cursor,
+                             const TSDProgram **program,
+                             const TSDProgramElement **element);
+
+/**
+ * Initialize a Descriptor Iterator.
+ * Prepares iter to walk the descriptor loop in data, such as the program info
+ * or ES info of a PMT or the body of a CAT. Nothing is copied, data must
+ * outlive the iterator.
+ * @param iter The iterator to initialize.
+ * @param data The raw Descriptor data, may be NULL when size is 0.
+ * @param size The size of the Descriptor data.
+ * @return TSD_OK on success, TSD_INVALID_DATA if data is NULL but size isn't
+ *         0, in which case iter is left empty.
+ */
+TSDCode tsd_descriptor_iter_init(TSDDescriptorIter *iter,
+                                 const uint8_t *data,
+                                 size_t size);
+
+/**
+ * Next Descriptor.
+ * Fills desc with the next descriptor of the loop. desc->data points at the
+ * descriptor tag inside the loop and desc->data_length includes the tag and
+ * length bytes, as in the descriptors of TSDPMTData.
+ * @param iter The iterator.
+ * @param desc Where to store the descriptor.
+ * @return TSD_OK when desc was filled, TSD_END_OF_DATA once the loop is done
+ *         or TSD_INVALID_DATA_SIZE if the next descriptor runs past the end of
+ *         the loop, after which the iterator is done.
+ */
+TSDCode tsd_descriptor_iter_next(TSDDescriptorIter *iter, TSDDescriptor *desc);
+
+/**
+ * Find a Descriptor.
+ * Moves iter on to the next descriptor with the given tag, so that calling it
+ * again finds the following one.
+ * @param iter The iterator.
+ * @param tag The descriptor tag to look for.
+ * @param desc Where to store the descriptor.
+ * @return TSD_OK when found, TSD_END_OF_DATA if there are no more descriptors
+ *         with that tag or TSD_INVALID_DATA_SIZE if the loop is truncated.
+ */
+TSDCode tsd_descriptor_iter_find(TSDDescriptorIter *iter,
+                                 uint8_t tag,
+                                 TSDDescriptor *desc);
+
 /**
  * Destroys Table Data.
  * Detroys data used in a Table.
@@ -1236,7 +1990,7 @@ TSDCode tsd_data_context_destroy(TSDemuxContext *ctx, TSDDataContext *dataCtx);
 /**
  * Writes data to TSDDataContext.
  * The TSDDataContext will dynamically allocate more memory if there is not enough
- * space in the TSDDataContext buffer.
+ * space in the TSDDataContext buffer, at least doubling its size.
  * Supplying NULL data or a size of zero will cause tsd_data_context_write to return
  * an error.
  * @param ctx The context being used to demux.
@@ -1258,6 +2012,20 @@ TSDCode tsd_data_context_write(TSDemuxContext *ctx, TSDDataContext *dataCtx, con
  */
 TSDCode tsd_data_context_reset(TSDemuxContext *ctx, TSDDataContext *dataCtx);
 
+/**
+ * Data Context Reserve.
+ * Makes sure the Data Context can hold at least size bytes without growing,
+ * keeping the data already written. The buffer never shrinks.
+ * @param ctx The context being used to demux.
+ * @param dataCtx The Data Context to grow.
+ * @param size The number of bytes the Data Context should be able to hold.
+ * @return TSD_OK on success, TSD_OUT_OF_MEMORY if the memory couldn't be
+ *         allocated.
+ */
+TSDCode tsd_data_context_reserve(TSDemuxContext *ctx,
+                                 TSDDataContext *dataCtx,
+                                 size_t size);
+
 /**
  * Register a PID for demuxing.
  * When a PID is registered, the user supplied callback will be called with the
@@ -1265,20 +2033,99 @@ TSDCode tsd_data_context_reset(TSDemuxContext *ctx, TSDDataContext *dataCtx);
  * @param ctx The context being used to demux.
  * @param pid The PID being registered.
  * @param reg_data_type What type of data to register.
- * @return TSD_OK on success.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if the PID is out of range.
  * @see TSDRegType
  */
 TSDCode tsd_register_pid(TSDemuxContext *ctx, uint16_t pid, int reg_data_type);
 
 /**
  * Deregisters a PID for demuxing.
- * Removes a PID from the PID demuxing register.
+ * Removes a PID from the PID demuxing register and frees any data buffered
+ * for it. Unflushed PES data is discarded.
  * @param ctx The context being used to demux.
  * @param pid The PID being deregistered.
  * @return TSD_OK on success.
  */
 TSDCode tsd_deregister_pid(TSDemuxContext *ctx, uint16_t pid);
 
+/**
+ * Register a Section Filter.
+ * Tables carried on pid whose table_id matches table_id, in the bits set in
+ * mask, are assembled and passed to the user callback with TSD_EVENT_TABLE
+ * and a TSDTableData. Sections that don't match are skipped before they are
+ * copied. Several filters can be registered on the same PID, for example to
+ * receive SCTE-35 (0xFC) or all EIT tables (0x40 with mask 0xC0).
+ * Filters on the PAT, CAT, TSDT or PMT PIDs are ignored, those tables are
+ * parsed by the demux itself.
+ * The TSDTableData is only valid for the duration of the callback.
+ * @param ctx The context being used to demux.
+ * @param pid The PID carrying the tables.
+ * @param table_id The table_id to look for.
+ * @param mask The bits of table_id to compare, 0xFF for an exact match.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if the PID is out of range
+ *         and TSD_PID_ALREADY_REGISTERED if the filter already exists.
+ */
+TSDCode tsd_register_section_filter(TSDemuxContext *ctx,
+                                    uint16_t pid,
+                                    uint8_t table_id,
+                                    uint8_t mask);
+
+/**
+ * Deregisters a Section Filter.
+ * Removes a filter added with tsd_register_section_filter.
+ * @param ctx The context being used to demux.
+ * @param pid The PID of the filter.
+ * @param table_id The table_id of the filter.
+ * @param mask The mask of the filter.
+ * @return TSD_OK on success, TSD_PID_NOT_FOUND if there is no such filter.
+ */
+TSDCode tsd_deregister_section_filter(TSDemuxContext *ctx,
+                                      uint16_t pid,
+                                      uint8_t table_id,
+                                      uint8_t mask);
+
+/**
+ * Register a Section Filter on the table_id_extension.
+ * Like tsd_register_section_filter, but only the long form sections whose
+ * table_id_extension also matches table_id_extension, in the bits set in
+ * extension_mask, are assembled. For example the EIT of a single service
+ * (0x4E with the service_id) or the SDT of one transport stream. Sections
+ * that don't match are skipped before anything is allocated for them.
+ * @param ctx The context being used to demux.
+ * @param pid The PID carrying the tables.
+ * @param table_id The table_id to look for.
+ * @param mask The bits of table_id to compare, 0xFF for an exact match.
+ * @param table_id_extension The table_id_extension to look for.
+ * @param extension_mask The bits of table_id_extension to compare, 0 to
+ *                       accept any.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT if the PID is out of range
+ *         and TSD_PID_ALREADY_REGISTERED if the filter already exists.
+ */
+TSDCode tsd_register_section_filter_ext(TSDemuxContext *ctx,
+                                        uint16_t pid,
+                                        uint8_t table_id,
+                                        uint8_t mask,
+                                        uint16_t table_id_extension,
+                                        uint16_t extension_mask);
+
+/**
+ * Deregisters a Section Filter on the table_id_extension.
+ * Removes a filter added with tsd_register_section_filter_ext.
+ * @param ctx The context being used to demux.
+ * @param pid The PID of the filter.
+ * @param table_id The table_id of the filter.
+ * @param mask The mask of the filter.
+ * @param table_id_extension The table_id_extension of the filter.
+ * @param extension_mask The extension mask of the filter.
+ * @return TSD_OK on success, TSD_PID_NOT_FOUND if there is no such filter.
+ */
+TSDCode tsd_deregister_section_filter_ext(TSDemuxContext *ctx,
+                                          uint16_t pid,
+                                          uint8_t table_id,
+                                          uint8_t mask,
+                                          uint16_t table_id_extension,
+                                          uint16_t extension_mask);
+
 /**
  * Parses a Video Stream Descriptor.
  * @param data The data to parse.
@@ -1575,6 +2422,77 @@ TSDCode tsd_parse_descriptor_multiplex_buffer(const uint8_t *data,
         size_t size,
         TSDDescriptorMultiplexBuffer *desc);
 
+/**
+ * Decodes a Descriptor.
+ * Picks the decoder for the tag of desc from a table, instead of a switch
+ * over every tsd_parse_descriptor_ function, and decodes into the matching
+ * member of out, e.g. out->iso639_language for TSD_DESCRIPTOR_ISO639_LANGUAGE.
+ * @param desc The descriptor, as given by a TSDDescriptorIter or in
+ *        TSDPMTData.
+ * @param out The decoded descriptor.
+ * @return TSD_OK on success, TSD_UNKNOWN_DESCRIPTOR if the tag has no decoder
+ *         or the code returned by the decoder.
+ */
+TSDCode tsd_decode_descriptor(const TSDDescriptor *desc,
+                              TSDDecodedDescriptor *out);
+
+/**
+ * Find a Start Code.
+ * Searches data for the next Annex B start code (0x000001), using the widest
+ * SIMD instructions the CPU supports.
+ * @param data The data to search.
+ * @param size The size of data.
+ * @param offset Where to store the offset of the start code into data, or
+ *        size when there is none.
+ * @return TSD_OK when a start code was found, TSD_END_OF_DATA otherwise.
+ */
+TSDCode tsd_find_start_code(const uint8_t *data, size_t size, size_t *offset);
+
+/**
+ * Initialize a NAL Splitter.
+ * @param splitter The splitter to initialize.
+ * @param stream_type TSD_PMT_STREAM_TYPE_VIDEO_AVC or
+ *        TSD_PMT_STREAM_TYPE_VIDEO_HEVC, picks how nal_unit_type is read.
+ * @return TSD_OK on success, TSD_INVALID_ARGUMENT for other stream types.
+ */
+TSDCode tsd_nal_splitter_init(TSDNALSplitter *splitter, uint8_t stream_type);
+
+/**
+ * Feed a NAL Splitter.
+ * Passes the next piece of the stream to the splitter. Nothing is copied,
+ * data must stay valid until tsd_nal_splitter_next returned TSD_END_OF_DATA.
+ * @param splitter The splitter.
+ * @param data The next piece of the stream.
+ * @param size The size of data.
+ * @return TSD_OK on success.
+ */
+TSDCode tsd_nal_splitter_feed(TSDNALSplitter *splitter,
+                              const uint8_t *data,
+                              size_t size);
+
+/**
+ * Next NAL Unit.
+ * Finds the next NAL unit that ends in the data fed last. A NAL unit ends
+ * where the following start code begins, so the last one is only returned
+ * by tsd_nal_splitter_end.
+ * @param splitter The splitter.
+ * @param unit Where to store the NAL unit.
+ * @return TSD_OK when unit was filled, TSD_END_OF_DATA once the data needs to
+ *         be followed by more.
+ */
+TSDCode tsd_nal_splitter_next(TSDNALSplitter *splitter, TSDNALUnit *unit);
+
+/**
+ * End a NAL Splitter.
+ * Ends the stream, e.g. at the end of a PES packet when NAL units don't span
+ * PES packets, returning the NAL unit that was still being received.
+ * The splitter can carry on being fed afterwards.
+ * @param splitter The splitter.
+ * @param unit Where to store the NAL unit.
+ * @return TSD_OK when unit was filled, TSD_END_OF_DATA if there was none.
+ */
+TSDCode tsd_nal_splitter_end(TSDNALSplitter *splitter, TSDNALUnit *unit);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,64 @@
+#include "test.h"
+#include "stream.h"
+#include <tsdemux.h>
+#include <string.h>
+
+void test_crc32_check(void);
+void test_crc32_lengths(void);
+
+int main(int argc, char **argv)
+{
+    test_crc32_check();
+    test_crc32_lengths();
+    return 0;
+}
+
+void test_crc32_check(void)
+{
+    test_start("tsd_crc32 check value");
+
+    const char *check = "123456789";
+    test_assert(tsd_crc32((const uint8_t*)check, strlen(check)) == 0x0376E6E7,
+                "CRC-32/MPEG-2 check value");
+    test_assert(tsd_crc32((const uint8_t*)check, 0) == 0xFFFFFFFF, "empty data");
+    test_assert(tsd_crc32(NULL, 10) == 0xFFFFFFFF, "NULL data");
+
+    // a section with its CRC_32 appended comes out as 0
+    uint8_t section[1024];
+    uint16_t prog = 1, pid = 0x100;
+    size_t len = stream_pat(section, 1, 0, 1, &prog, &pid);
+    test_assert(tsd_crc32(section, len) == 0, "intact section");
+    section[9] ^= 0x01;
+    test_assert(tsd_crc32(section, len) != 0, "corrupt section");
+
+    test_end();
+}
+
+void test_crc32_lengths(void)
+{
+    test_start("tsd_crc32 lengths and alignments");
+
+    uint8_t data[4096 + 16];
+    size_t i;
+    uint32_t seed = 1;
+    for(i=0; i<sizeof(data); ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+
+    // every kernel path: the table tail, single blocks and 4 way folding
+    int all_ok = 1;
+    size_t offset, size;
+    for(offset=0; offset<4; ++offset) {
+        for(size=0; size<=600; ++size) {
+            if(tsd_crc32(&data[offset], size) != stream_crc32(&data[offset], size)) {
+                printf("      mismatch at offset %zu size %zu\n", offset, size);
+                all_ok = 0;
+            }
+        }
+    }
+    test_assert(all_ok, "matches the bitwise CRC");
+    test_assert(tsd_crc32(data, 4096) == stream_crc32(data, 4096), "4096 bytes");
+
+    test_end();
+}
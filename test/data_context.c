@@ -1,10 +1,13 @@
 #include "test.h"
 #include <tsdemux.h>
+#include <string.h>
 
 void test_init(void);
 void test_destroy(void);
 void test_write(void);
 void test_reset(void);
+void test_reserve(void);
+void test_growth(void);
 
 int main(int argc, char** argv)
 {
@@ -12,6 +15,8 @@ int main(int argc, char** argv)
     test_destroy();
     test_write();
     test_reset();
+    test_reserve();
+    test_growth();
     return 0;
 }
 
@@ -169,3 +174,84 @@ void test_reset(void)
 
     test_end();
 }
+
+void test_reserve(void)
+{
+    test_start("tsd_data_context_reserve");
+
+    TSDCode res;
+    TSDemuxContext ctx;
+    TSDDataContext dataCtx;
+    uint8_t data[100];
+    int i;
+
+    tsd_context_init(&ctx);
+    tsd_data_context_init(&ctx, &dataCtx);
+    for(i=0; i<100; ++i) {
+        data[i] = (uint8_t)i;
+    }
+
+    res = tsd_data_context_reserve(NULL, &dataCtx, 10);
+    test_assert_equal(TSD_INVALID_CONTEXT, res, "null context");
+    res = tsd_data_context_reserve(&ctx, NULL, 10);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "null data context");
+
+    res = tsd_data_context_reserve(&ctx, &dataCtx, 10);
+    test_assert_equal(TSD_OK, res, "already big enough");
+    test_assert_equal(TSD_MEM_PAGE_SIZE, dataCtx.size, "size unchanged");
+
+    tsd_data_context_write(&ctx, &dataCtx, data, sizeof(data));
+    res = tsd_data_context_reserve(&ctx, &dataCtx, 5000);
+    test_assert_equal(TSD_OK, res, "reserve");
+    test_assert_equal(5 * TSD_MEM_PAGE_SIZE, dataCtx.size, "rounded to pages");
+    test_assert_equal_ptr((size_t)&dataCtx.buffer[dataCtx.size], (size_t)dataCtx.end, "end position");
+    test_assert_equal(sizeof(data), dataCtx.write - dataCtx.buffer, "write position kept");
+    test_assert_equal(99, dataCtx.buffer[99], "data kept");
+
+    // resetting never shrinks the buffer
+    tsd_data_context_reset(&ctx, &dataCtx);
+    test_assert_equal(5 * TSD_MEM_PAGE_SIZE, dataCtx.size, "size kept after reset");
+    res = tsd_data_context_reserve(&ctx, &dataCtx, 1000);
+    test_assert_equal(5 * TSD_MEM_PAGE_SIZE, dataCtx.size, "no shrinking");
+
+    tsd_data_context_destroy(&ctx, &dataCtx);
+
+    test_end();
+}
+
+int realloc_count = 0;
+
+void *counting_realloc(void *ptr, size_t size)
+{
+    realloc_count++;
+    return realloc(ptr, size);
+}
+
+void test_growth(void)
+{
+    test_start("tsd_data_context_write growth");
+
+    TSDemuxContext ctx;
+    TSDDataContext dataCtx;
+    uint8_t data[188];
+    size_t total = 0;
+
+    memset(data, 0x42, sizeof(data));
+    tsd_context_init(&ctx);
+    ctx.realloc = counting_realloc;
+    tsd_data_context_init(&ctx, &dataCtx);
+
+    // 1.5 MB written a packet at a time
+    realloc_count = 0;
+    while(total < 1536 * 1024) {
+        tsd_data_context_write(&ctx, &dataCtx, data, sizeof(data));
+        total += sizeof(data);
+    }
+    test_assert(realloc_count <= 12, "grows geometrically");
+    test_assert(dataCtx.size >= total, "everything fits");
+    test_assert_equal(0x42, dataCtx.buffer[total - 1], "data written");
+
+    tsd_data_context_destroy(&ctx, &dataCtx);
+
+    test_end();
+}
@@ -0,0 +1,2002 @@
+#include "test.h"
+#include "stream.h"
+#include <tsdemux.h>
+#include <string.h>
+
+void test_demux_input(void);
+void test_demux_pes(void);
+void test_demux_many_programs(void);
+void test_demux_pat_update(void);
+void test_demux_deregister_in_callback(void);
+void test_demux_resync(void);
+void test_demux_packet_sizes(void);
+void test_demux_adaptation_field(void);
+void test_demux_chunks(void);
+void test_demux_file(void);
+void test_demux_section_buffers(void);
+void test_demux_table_cache(void);
+void test_demux_crc_error(void);
+void test_demux_table_error(void);
+void test_demux_interleaved_sections(void);
+void test_demux_shared_pmt_pid(void);
+void test_demux_section_filter(void);
+void test_demux_section_filter_extension(void);
+void test_demux_section_view(void);
+void test_demux_program_directory(void);
+void test_demux_pes_preallocation(void);
+void test_demux_pes_slices(void);
+void test_demux_pes_stream(void);
+void test_demux_pes_au_end(void);
+void test_demux_split_section_header(void);
+void test_demux_split_fake_sync(void);
+
+int main(int argc, char **argv)
+{
+    test_demux_input();
+    test_demux_pes();
+    test_demux_many_programs();
+    test_demux_pat_update();
+    test_demux_deregister_in_callback();
+    test_demux_resync();
+    test_demux_packet_sizes();
+    test_demux_adaptation_field();
+    test_demux_chunks();
+    test_demux_file();
+    test_demux_section_buffers();
+    test_demux_table_cache();
+    test_demux_crc_error();
+    test_demux_table_error();
+    test_demux_interleaved_sections();
+    test_demux_shared_pmt_pid();
+    test_demux_section_filter();
+    test_demux_section_filter_extension();
+    test_demux_section_view();
+    test_demux_program_directory();
+    test_demux_pes_preallocation();
+    test_demux_pes_slices();
+    test_demux_pes_stream();
+    test_demux_pes_au_end();
+    test_demux_split_section_header();
+    test_demux_split_fake_sync();
+    return 0;
+}
+
+// event counters filled in by the callback
+int pat_count;
+int pmt_count;
+int pes_count;
+uint16_t last_pmt_pid;
+uint16_t last_pes_pid;
+uint64_t last_pts;
+size_t last_pes_size;
+
+void reset_counters(void)
+{
+    pat_count = pmt_count = pes_count = 0;
+    last_pmt_pid = last_pes_pid = 0;
+    last_pts = 0;
+    last_pes_size = 0;
+}
+
+// feeds null packets until the context is in sync, the packets fed after it
+// are demuxed straight away however few there are.
+void lock_sync(TSDemuxContext *ctx)
+{
+    uint8_t stream[188 * (TSD_SYNC_CONFIRM_PACKETS + 1)];
+    uint8_t stuffing[184];
+    uint8_t cc = 0;
+    size_t len = 0;
+    size_t parsed = 0;
+    memset(stuffing, 0xFF, sizeof(stuffing));
+    while(len < sizeof(stream)) {
+        len += stream_packet(&stream[len], 0x1FFF, 0, &cc, stuffing, sizeof(stuffing), 0);
+    }
+    tsd_demux(ctx, stream, len, &parsed);
+}
+
+void event_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PAT) {
+        pat_count++;
+    } else if(id == TSD_EVENT_PMT) {
+        TSDPMTData *pmt = (TSDPMTData*)data;
+        pmt_count++;
+        last_pmt_pid = pid;
+        size_t i;
+        for(i=0; i<pmt->program_elements_length; ++i) {
+            tsd_register_pid(ctx, pmt->program_elements[i].elementary_pid, TSD_REG_PES);
+        }
+    } else if(id == TSD_EVENT_PES) {
+        TSDPESPacket *pes = (TSDPESPacket*)data;
+        pes_count++;
+        last_pes_pid = pid;
+        last_pts = pes->pts;
+        last_pes_size = pes->data_bytes_length;
+    }
+}
+
+void test_demux_input(void)
+{
+    test_start("tsd_demux input");
+
+    TSDemuxContext ctx;
+    TSDCode res;
+    size_t parsed = 10;
+    uint8_t data[188];
+
+    tsd_context_init(&ctx);
+
+    res = tsd_demux(NULL, data, sizeof(data), &parsed);
+    test_assert_equal(TSD_INVALID_CONTEXT, res, "invalid context");
+    test_assert_equal(0, parsed, "parsed size reset");
+    res = tsd_demux(&ctx, NULL, sizeof(data), &parsed);
+    test_assert_equal(TSD_INVALID_DATA, res, "invalid data");
+    res = tsd_demux(&ctx, data, 0, &parsed);
+    test_assert_equal(TSD_INVALID_DATA_SIZE, res, "invalid size");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_pes(void)
+{
+    test_start("tsd_demux PAT, PMT and PES");
+
+    uint8_t stream[188 * 16];
+    uint8_t section[1024];
+    uint8_t pes[512];
+    uint8_t payload[300];
+    size_t len = 0;
+    uint8_t cc_pat = 0, cc_pmt = 0, cc_es = 0;
+
+    uint16_t prog = 1;
+    uint16_t pmt_pid = 0x100;
+    uint8_t stream_type = TSD_PMT_STREAM_TYPE_VIDEO_AVC;
+    uint16_t es_pid = 0x101;
+
+    size_t sec_len = stream_pat(section, 1, 0, 1, &prog, &pmt_pid);
+    len += stream_packetize_section(&stream[len], 0, &cc_pat, section, sec_len);
+    sec_len = stream_pmt(section, prog, 0, es_pid, 1, &stream_type, &es_pid);
+    len += stream_packetize_section(&stream[len], pmt_pid, &cc_pmt, section, sec_len);
+
+    int i;
+    for(i=0; i<(int)sizeof(payload); ++i) {
+        payload[i] = (uint8_t)i;
+    }
+    size_t pes_len = stream_pes(pes, 0xE0, 0x123456789LL, payload, sizeof(payload), 1);
+    len += stream_packetize_pes(&stream[len], es_pid, &cc_es, pes, pes_len);
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    reset_counters();
+
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(len, parsed, "parsed everything");
+    test_assert_equal(1, pat_count, "PAT event");
+    test_assert_equal(1, pmt_count, "PMT event");
+    test_assert_equal(pmt_pid, last_pmt_pid, "PMT PID");
+    test_assert_equal(1, pes_count, "PES event");
+    test_assert_equal(es_pid, last_pes_pid, "PES PID");
+    test_assert_equal_uint64(0x123456789LL, last_pts, "PES PTS");
+    test_assert_equal(sizeof(payload), last_pes_size, "PES size");
+
+    test_assert(ctx.pid_map != NULL, "PID map created");
+    test_assert_equal(TSD_ROUTE_PAT, ctx.pid_map[TSD_PID_PAT].flags, "PAT route");
+    test_assert_equal(TSD_ROUTE_PMT, ctx.pid_map[pmt_pid].flags, "PMT route");
+    test_assert_equal(TSD_ROUTE_REGISTERED, ctx.pid_map[es_pid].flags, "registered route");
+    test_assert_equal(0, ctx.pid_map[0x102].flags, "ignored route");
+
+    tsd_deregister_pid(&ctx, es_pid);
+    test_assert_equal(0, ctx.pid_map[es_pid].flags, "deregistered route");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_many_programs(void)
+{
+    test_start("tsd_demux many programs");
+
+    const size_t programs = 200;
+    uint16_t prog_nums[200];
+    uint16_t pmt_pids[200];
+    uint8_t section[1024];
+    size_t len = 0;
+    uint8_t cc = 0;
+    uint8_t *stream = (uint8_t*)malloc(188 * (programs + 8));
+
+    size_t i;
+    for(i=0; i<programs; ++i) {
+        prog_nums[i] = (uint16_t)(i + 1);
+        pmt_pids[i] = (uint16_t)(0x1000 + i);
+    }
+
+    // the PAT spans several packets
+    size_t sec_len = stream_pat(section, 1, 0, programs, prog_nums, pmt_pids);
+    len += stream_packetize_section(&stream[len], 0, &cc, section, sec_len);
+    for(i=0; i<programs; ++i) {
+        uint8_t type = TSD_PMT_STREAM_TYPE_AUDIO_AAC;
+        uint16_t es_pid = (uint16_t)(0x100 + i);
+        uint8_t pmt_cc = 0;
+        sec_len = stream_pmt(section, prog_nums[i], 0, es_pid, 1, &type, &es_pid);
+        len += stream_packetize_section(&stream[len], pmt_pids[i], &pmt_cc, section, sec_len);
+    }
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    reset_counters();
+
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(1, pat_count, "PAT event");
+    test_assert_equal(programs, ctx.pat.value.length, "PAT length");
+    test_assert_equal(programs, pmt_count, "PMT events");
+    test_assert_equal(pmt_pids[programs - 1], last_pmt_pid, "last PMT PID");
+
+    int routed = 1;
+    for(i=0; i<programs; ++i) {
+        if(!(ctx.pid_map[pmt_pids[i]].flags & TSD_ROUTE_PMT)) {
+            routed = 0;
+        }
+    }
+    test_assert(routed, "all PMT PIDs routed");
+
+    tsd_context_destroy(&ctx);
+    free(stream);
+
+    test_end();
+}
+
+void test_demux_pat_update(void)
+{
+    test_start("tsd_demux PAT update");
+
+    uint8_t stream[188 * 4];
+    uint8_t section[1024];
+    size_t len = 0;
+    uint8_t cc = 0;
+
+    uint16_t progs[] = { 0, 1 };
+    uint16_t pids_v0[] = { 0x10, 0x200 };
+    uint16_t pids_v1[] = { 0x10, 0x300 };
+
+    size_t sec_len = stream_pat(section, 1, 0, 2, progs, pids_v0);
+    len += stream_packetize_section(&stream[len], 0, &cc, section, sec_len);
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    // a single packet is too short to detect the packet size or sync from
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    reset_counters();
+
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(1, pat_count, "first PAT");
+    test_assert_equal(0, ctx.pid_map[0x10].flags, "network PID is not a PMT");
+    test_assert_equal(TSD_ROUTE_PMT, ctx.pid_map[0x200].flags, "PMT route v0");
+
+    // register the old PMT PID, it should remain registered once the PMT goes
+    tsd_register_pid(&ctx, 0x200, TSD_REG_PES);
+
+    len = stream_pat(section, 1, 1, 2, progs, pids_v1);
+    len = stream_packetize_section(stream, 0, &cc, section, len);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(2, pat_count, "second PAT");
+    test_assert_equal(TSD_ROUTE_REGISTERED, ctx.pid_map[0x200].flags, "PMT route v0 removed");
+    test_assert_equal(TSD_ROUTE_PMT, ctx.pid_map[0x300].flags, "PMT route v1");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void deregister_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PES) {
+        pes_count++;
+        tsd_deregister_pid(ctx, pid);
+    }
+}
+
+void test_demux_deregister_in_callback(void)
+{
+    test_start("tsd_demux deregister in callback");
+
+    uint8_t stream[188 * 4];
+    uint8_t pes[256];
+    uint8_t payload[100];
+    size_t len = 0;
+    uint8_t cc = 0;
+
+    memset(payload, 0x11, sizeof(payload));
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    len += stream_packetize_pes(&stream[len], 0x101, &cc, pes, pes_len);
+    len += stream_packetize_pes(&stream[len], 0x101, &cc, pes, pes_len);
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, deregister_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    reset_counters();
+
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(1, pes_count, "single PES event");
+    test_assert_equal(0, ctx.registered_pids_length, "PID deregistered");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+int sync_loss_count;
+int sync_acquired_count;
+TSDSyncEvent last_sync_loss;
+TSDSyncEvent last_sync_acquired;
+
+void sync_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_SYNC_LOSS) {
+        sync_loss_count++;
+        last_sync_loss = *(TSDSyncEvent*)data;
+    } else if(id == TSD_EVENT_SYNC_ACQUIRED) {
+        sync_acquired_count++;
+        last_sync_acquired = *(TSDSyncEvent*)data;
+    } else if(id == TSD_EVENT_PES) {
+        pes_count++;
+    }
+}
+
+void test_demux_resync(void)
+{
+    test_start("tsd_demux resync");
+
+    uint8_t stream[188 * 16];
+    uint8_t pes[256];
+    uint8_t payload[100];
+    size_t len = 0;
+    uint8_t cc = 0;
+    const size_t junk = 500;
+    int i;
+
+    memset(payload, 0x11, sizeof(payload));
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    for(i=0; i<5; ++i) {
+        len += stream_packetize_pes(&stream[len], 0x101, &cc, pes, pes_len);
+    }
+    // garbage with a false sync that only repeats once
+    memset(&stream[len], 0x00, junk);
+    stream[len + 50] = TSD_SYNC_BYTE;
+    stream[len + 50 + 188] = TSD_SYNC_BYTE;
+    len += junk;
+    for(i=0; i<6; ++i) {
+        len += stream_packetize_pes(&stream[len], 0x101, &cc, pes, pes_len);
+    }
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, sync_cb);
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+    reset_counters();
+    sync_loss_count = sync_acquired_count = 0;
+
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(len, parsed, "parsed everything");
+    test_assert_equal(11, pes_count, "PES events");
+    test_assert_equal(1, sync_loss_count, "sync lost once");
+    test_assert_equal(188 * 5, last_sync_loss.offset, "sync loss offset");
+    test_assert_equal(2, sync_acquired_count, "sync acquired twice");
+    test_assert_equal(188 * 5 + junk, last_sync_acquired.offset, "sync acquired offset");
+    test_assert_equal(junk, last_sync_acquired.bytes_skipped, "bytes skipped");
+
+    // garbage at the end is handed back to the caller. The packet size is
+    // set, otherwise the garbage would be collected to detect it.
+    tsd_context_destroy(&ctx);
+    tsd_context_init(&ctx);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    tsd_set_event_callback(&ctx, sync_cb);
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+    reset_counters();
+    sync_loss_count = sync_acquired_count = 0;
+
+    res = tsd_demux(&ctx, &stream[188 * 5], junk + 188, &parsed);
+    test_assert_equal(TSD_OK, res, "demux garbage");
+    test_assert_equal(junk + 188, parsed, "parsed everything");
+    test_assert_equal(188, ctx.carry.length, "carried the candidate packet");
+    test_assert_equal(0, sync_acquired_count, "no sync in garbage");
+    res = tsd_demux(&ctx, &stream[188 * 6 + junk], len - 188 * 6 - junk, &parsed);
+    test_assert_equal(TSD_OK, res, "demux remainder");
+    test_assert_equal(1, sync_acquired_count, "sync acquired");
+    test_assert_equal(junk, last_sync_acquired.bytes_skipped, "bytes skipped over calls");
+    test_assert_equal(6, pes_count, "PES events");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+uint32_t last_ats;
+
+void ats_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PES) {
+        pes_count++;
+        last_ats = ctx->arrival_time_stamp;
+    }
+}
+
+// re-frames 188 byte packets as M2TS or 204 byte packets.
+size_t reframe(uint8_t *out, const uint8_t *in, size_t size, size_t packet_size)
+{
+    size_t written = 0;
+    size_t i;
+    for(i=0; i<size; i+=188) {
+        if(packet_size == TSD_M2TS_PACKET_SIZE) {
+            uint32_t ats = (uint32_t)(1000 * (i / 188 + 1));
+            out[written++] = (ats >> 24) & 0x3F;
+            out[written++] = (ats >> 16) & 0xFF;
+            out[written++] = (ats >> 8) & 0xFF;
+            out[written++] = ats & 0xFF;
+        }
+        memcpy(&out[written], &in[i], 188);
+        written += 188;
+        if(packet_size == TSD_RS_PACKET_SIZE) {
+            // parity bytes that look like sync bytes
+            memset(&out[written], TSD_SYNC_BYTE, 16);
+            written += 16;
+        }
+    }
+    return written;
+}
+
+void test_demux_packet_sizes(void)
+{
+    test_start("tsd_demux packet sizes");
+
+    uint8_t ts[188 * 8];
+    uint8_t stream[204 * 8];
+    uint8_t pes[256];
+    uint8_t payload[100];
+    size_t ts_len = 0;
+    uint8_t cc = 0;
+    size_t sizes[] = { TSD_TSPACKET_SIZE, TSD_M2TS_PACKET_SIZE, TSD_RS_PACKET_SIZE };
+    int i;
+
+    memset(payload, 0x22, sizeof(payload));
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    for(i=0; i<8; ++i) {
+        ts_len += stream_packetize_pes(&ts[ts_len], 0x101, &cc, pes, pes_len);
+    }
+
+    TSDemuxContext ctx;
+    TSDCode res;
+    size_t parsed;
+
+    for(i=0; i<3; ++i) {
+        size_t len = reframe(stream, ts, ts_len, sizes[i]);
+
+        tsd_context_init(&ctx);
+        tsd_set_event_callback(&ctx, ats_cb);
+        tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+        reset_counters();
+        last_ats = 0;
+
+        res = tsd_demux(&ctx, stream, len, &parsed);
+        test_assert_equal(TSD_OK, res, "demux");
+        test_assert_equal(len, parsed, "parsed everything");
+        test_assert_equal(sizes[i], ctx.sync.packet_size, "detected packet size");
+        test_assert_equal(8, pes_count, "PES events");
+        if(sizes[i] == TSD_M2TS_PACKET_SIZE) {
+            test_assert_equal(8000, last_ats, "arrival time stamp");
+        } else {
+            test_assert_equal(0, last_ats, "no arrival time stamp");
+        }
+        tsd_context_destroy(&ctx);
+    }
+
+    // a configured packet size skips detection
+    size_t len = reframe(stream, ts, ts_len, TSD_M2TS_PACKET_SIZE);
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, ats_cb);
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+    reset_counters();
+
+    res = tsd_set_packet_size(&ctx, 190);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "invalid packet size");
+    res = tsd_set_packet_size(&ctx, TSD_M2TS_PACKET_SIZE);
+    test_assert_equal(TSD_OK, res, "set packet size");
+    res = tsd_demux(&ctx, stream, TSD_M2TS_PACKET_SIZE, &parsed);
+    test_assert_equal(TSD_OK, res, "demux single packet");
+    test_assert_equal(TSD_M2TS_PACKET_SIZE, parsed, "parsed single packet");
+    test_assert_equal(0, pes_count, "single packet waits for sync");
+    tsd_demux_end(&ctx);
+    test_assert_equal(1, pes_count, "PES event");
+    test_assert_equal(1000, last_ats, "arrival time stamp");
+    tsd_context_destroy(&ctx);
+
+    // detection collects the start of the stream when it comes in chunks
+    // shorter than a packet
+    int detected = 1;
+    for(i=1; i<3; ++i) {
+        size_t offset;
+        len = reframe(stream, ts, ts_len, sizes[i]);
+        tsd_context_init(&ctx);
+        tsd_set_event_callback(&ctx, ats_cb);
+        tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+        reset_counters();
+        for(offset=0; offset<len; offset+=100) {
+            size_t chunk = len - offset < 100 ? len - offset : 100;
+            if(tsd_demux(&ctx, &stream[offset], chunk, &parsed) != TSD_OK || parsed != chunk) {
+                detected = 0;
+            }
+        }
+        tsd_demux_end(&ctx);
+        if(ctx.sync.packet_size != sizes[i] || pes_count != 8 ||
+           ctx.sync.bytes_skipped != 0) {
+            detected = 0;
+        }
+        tsd_context_destroy(&ctx);
+    }
+    test_assert(detected, "detected across chunks");
+
+    test_end();
+}
+
+int pcr_count;
+int af_count;
+uint64_t last_pcr_base;
+uint16_t last_pcr_ext;
+uint8_t last_private_byte;
+
+void af_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    TSDAdaptationField *af = (TSDAdaptationField*)data;
+    if(id == TSD_EVENT_PCR) {
+        pcr_count++;
+        last_pcr_base = af->program_clock_ref_base;
+        last_pcr_ext = af->program_clock_ref_ext;
+    } else if(id == TSD_EVENT_ADAP_FIELD_PRV_DATA) {
+        af_count++;
+        last_private_byte = af->private_data_bytes[0];
+    } else if(id == TSD_EVENT_PES) {
+        pes_count++;
+    }
+}
+
+// deregisters the PID from its PES event, before its adaptation field is
+// looked at.
+void af_deregister_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    af_cb(ctx, pid, id, data);
+    if(id == TSD_EVENT_PES) {
+        tsd_deregister_pid(ctx, pid);
+    }
+}
+
+// writes a packet with a PCR and 2 bytes of private data in the adaptation
+// field, followed by payload.
+size_t write_pcr_packet(uint8_t *out, uint16_t pid, uint8_t cc, uint64_t base,
+                        uint16_t ext, const uint8_t *payload, size_t size)
+{
+    out[0] = 0x47;
+    out[1] = (uint8_t)(0x40 | (pid >> 8));
+    out[2] = pid & 0xFF;
+    out[3] = 0x30 | (cc & 0x0F);
+    out[4] = (uint8_t)(183 - size);
+    out[5] = 0x12; // PCR and private data
+    out[6] = (uint8_t)(base >> 25);
+    out[7] = (uint8_t)(base >> 17);
+    out[8] = (uint8_t)(base >> 9);
+    out[9] = (uint8_t)(base >> 1);
+    out[10] = (uint8_t)(((base & 0x01) << 7) | 0x7E | ((ext >> 8) & 0x01));
+    out[11] = ext & 0xFF;
+    out[12] = 2;
+    out[13] = 0xAA;
+    out[14] = 0xBB;
+    memset(&out[15], 0xFF, 188 - 15 - size);
+    memcpy(&out[188 - size], payload, size);
+    return 188;
+}
+
+void test_demux_adaptation_field(void)
+{
+    test_start("tsd_demux adaptation field");
+
+    uint8_t stream[188 * 2];
+    uint8_t pes[128];
+    uint8_t payload[40];
+    size_t len = 0;
+    size_t parsed = 0;
+
+    memset(payload, 0x33, sizeof(payload));
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    len += write_pcr_packet(&stream[len], 0x101, 0, 0x1ABCDEF12LL, 0x123, pes, pes_len);
+    len += write_pcr_packet(&stream[len], 0x101, 1, 1000, 7, pes, pes_len);
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, af_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    reset_counters();
+    pcr_count = af_count = 0;
+
+    // PES only, the adaptation field isn't reported
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+    tsd_demux(&ctx, stream, 188, &parsed);
+    test_assert_equal(1, pes_count, "PES event");
+    test_assert_equal(0, pcr_count, "no PCR event");
+    test_assert_equal(0, af_count, "no private data event");
+
+    tsd_deregister_pid(&ctx, 0x101);
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES | TSD_REG_PCR | TSD_REG_ADAPTATION_FIELD);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(3, pes_count, "PES events");
+    test_assert_equal(2, pcr_count, "PCR events");
+    test_assert_equal_uint64(1000, last_pcr_base, "PCR base");
+    test_assert_equal(7, last_pcr_ext, "PCR extension");
+    test_assert_equal(2, af_count, "private data events");
+    test_assert_equal(0xAA, last_private_byte, "private data");
+
+    // the PID deregistered from its PES event has no adaptation field events
+    tsd_set_event_callback(&ctx, af_deregister_cb);
+    pes_count = pcr_count = af_count = 0;
+    tsd_demux(&ctx, stream, 188, &parsed);
+    test_assert_equal(1, pes_count, "PES event before deregistering");
+    test_assert_equal(0, pcr_count, "no PCR event once deregistered");
+    test_assert_equal(0, af_count, "no private data event once deregistered");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_chunks(void)
+{
+    test_start("tsd_demux arbitrary chunk sizes");
+
+    uint8_t stream[188 * 32];
+    uint8_t section[1024];
+    uint8_t pes[1024];
+    uint8_t payload[700];
+    size_t len = 0;
+    uint8_t cc_pat = 0, cc_pmt = 0, cc_es = 0;
+    uint16_t prog = 1;
+    uint16_t pmt_pid = 0x100;
+    uint8_t stream_type = TSD_PMT_STREAM_TYPE_VIDEO_AVC;
+    uint16_t es_pid = 0x101;
+    int i;
+
+    size_t sec_len = stream_pat(section, 1, 0, 1, &prog, &pmt_pid);
+    len += stream_packetize_section(&stream[len], 0, &cc_pat, section, sec_len);
+    sec_len = stream_pmt(section, prog, 0, es_pid, 1, &stream_type, &es_pid);
+    len += stream_packetize_section(&stream[len], pmt_pid, &cc_pmt, section, sec_len);
+    for(i=0; i<(int)sizeof(payload); ++i) {
+        payload[i] = (uint8_t)i;
+    }
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    for(i=0; i<5; ++i) {
+        len += stream_packetize_pes(&stream[len], es_pid, &cc_es, pes, pes_len);
+    }
+
+    size_t chunks[] = { 1, 7, 100, 187, 188, 189, 1000 };
+    int all_ok = 1;
+    size_t c;
+    for(c=0; c<sizeof(chunks) / sizeof(chunks[0]); ++c) {
+        TSDemuxContext ctx;
+        tsd_context_init(&ctx);
+        tsd_set_event_callback(&ctx, event_cb);
+        reset_counters();
+
+        size_t pos = 0;
+        while(pos < len) {
+            size_t size = len - pos < chunks[c] ? len - pos : chunks[c];
+            size_t parsed = 0;
+            if(tsd_demux(&ctx, &stream[pos], size, &parsed) != TSD_OK ||
+               parsed != size) {
+                all_ok = 0;
+            }
+            pos += size;
+        }
+        tsd_demux_end(&ctx);
+        if(pat_count != 1 || pmt_count != 1 || pes_count != 5 ||
+           last_pes_size != sizeof(payload) || ctx.carry.length != 0) {
+            printf("      chunk size %zu: PAT %d PMT %d PES %d\n",
+                   chunks[c], pat_count, pmt_count, pes_count);
+            all_ok = 0;
+        }
+        tsd_context_destroy(&ctx);
+    }
+    test_assert(all_ok, "same events for every chunk size");
+
+    test_end();
+}
+
+const uint8_t *last_pes_data;
+
+void zero_copy_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    event_cb(ctx, pid, id, data);
+    if(id == TSD_EVENT_PES) {
+        last_pes_data = ((TSDPESPacket*)data)->data_bytes;
+    }
+}
+
+void test_demux_file(void)
+{
+    test_start("tsd_demux_file");
+
+    const char *path = "demux_file_test.ts";
+    const size_t packets = 100;
+    uint8_t *stream = (uint8_t*)malloc(188 * (packets + 2));
+    uint8_t section[1024];
+    uint8_t pes[256];
+    uint8_t payload[150];
+    size_t len = 0;
+    uint8_t cc_pat = 0, cc_pmt = 0, cc_es = 0;
+    uint16_t prog = 1;
+    uint16_t pmt_pid = 0x100;
+    uint8_t stream_type = TSD_PMT_STREAM_TYPE_VIDEO_AVC;
+    uint16_t es_pid = 0x101;
+    size_t i;
+
+    size_t sec_len = stream_pat(section, 1, 0, 1, &prog, &pmt_pid);
+    len += stream_packetize_section(&stream[len], 0, &cc_pat, section, sec_len);
+    sec_len = stream_pmt(section, prog, 0, es_pid, 1, &stream_type, &es_pid);
+    len += stream_packetize_section(&stream[len], pmt_pid, &cc_pmt, section, sec_len);
+    memset(payload, 0x44, sizeof(payload));
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    for(i=0; i<packets; ++i) {
+        len += stream_packetize_pes(&stream[len], es_pid, &cc_es, pes, pes_len);
+    }
+
+    FILE *file = fopen(path, "wb");
+    test_assert(file != NULL, "create file");
+    fwrite(stream, 1, len, file);
+    fclose(file);
+
+    TSDemuxContext ctx;
+    TSDCode res;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+
+    res = tsd_demux_file(NULL, path, 0);
+    test_assert_equal(TSD_INVALID_CONTEXT, res, "invalid context");
+    res = tsd_demux_file(&ctx, NULL, 0);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "invalid path");
+    res = tsd_demux_file(&ctx, "does/not/exist.ts", 0);
+    test_assert_equal(TSD_FILE_ERROR, res, "missing file");
+
+    // the default window and windows that split packets
+    size_t windows[] = { 0, 1, 4096, 10000 };
+    int all_ok = 1;
+    for(i=0; i<sizeof(windows) / sizeof(windows[0]); ++i) {
+        tsd_context_destroy(&ctx);
+        tsd_context_init(&ctx);
+        tsd_set_event_callback(&ctx, event_cb);
+        reset_counters();
+        res = tsd_demux_file(&ctx, path, windows[i]);
+        if(res != TSD_OK || pat_count != 1 || pmt_count != 1 ||
+           pes_count != (int)packets || last_pes_size != sizeof(payload)) {
+            printf("      window %zu: res %d PES %d\n", windows[i], res, pes_count);
+            all_ok = 0;
+        }
+    }
+    test_assert(all_ok, "same events for every window size");
+    remove(path);
+
+    // a PES within a single packet points into the demuxed data
+    tsd_context_destroy(&ctx);
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, zero_copy_cb);
+    reset_counters();
+    last_pes_data = NULL;
+    size_t parsed = 0;
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(packets, pes_count, "PES events");
+    test_assert(last_pes_data > stream && last_pes_data < stream + len,
+                "PES data not copied");
+
+    tsd_context_destroy(&ctx);
+    free(stream);
+
+    test_end();
+}
+
+void test_demux_section_buffers(void)
+{
+    test_start("tsd_demux section buffer pool");
+
+    uint8_t stream[188 * 2];
+    uint8_t section[1024];
+    size_t len = 0;
+    uint8_t cc_pat = 0, cc_pmt = 0;
+    uint16_t prog = 1;
+    uint16_t pmt_pid = 0x100;
+    uint8_t stream_type = TSD_PMT_STREAM_TYPE_VIDEO_AVC;
+    uint16_t es_pid = 0x101;
+    int i;
+
+    size_t sec_len = stream_pat(section, 1, 0, 1, &prog, &pmt_pid);
+    len += stream_packetize_section(&stream[len], 0, &cc_pat, section, sec_len);
+    sec_len = stream_pmt(section, prog, 0, es_pid, 1, &stream_type, &es_pid);
+    len += stream_packetize_section(&stream[len], pmt_pid, &cc_pmt, section, sec_len);
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    // every repeat goes through the pool
+    tsd_set_table_cache(&ctx, 0);
+    reset_counters();
+
+    test_assert_equal(TSD_INVALID_CONTEXT, tsd_set_section_buffer_limit(NULL, 1),
+                      "invalid context");
+    test_assert_equal(TSD_INVALID_ARGUMENT, tsd_set_section_buffer_limit(&ctx, 0),
+                      "invalid limit");
+    test_assert_equal(TSD_INVALID_ARGUMENT, tsd_set_section_buffer_limit(&ctx, 0x10000),
+                      "limit beyond the PID map");
+
+    // the PSI repeats, one packet per call
+    tsd_demux(&ctx, stream, 188, &parsed);
+    tsd_demux(&ctx, &stream[188], 188, &parsed);
+    size_t allocations = ctx.buffers.pool_allocations;
+    test_assert(allocations > 0, "pool allocated");
+    for(i=0; i<50; ++i) {
+        tsd_demux(&ctx, stream, 188, &parsed);
+        tsd_demux(&ctx, &stream[188], 188, &parsed);
+    }
+    test_assert_equal(51, pat_count, "PAT events");
+    test_assert_equal(51, pmt_count, "PMT events");
+    test_assert_equal(allocations, ctx.buffers.pool_allocations, "no steady state pool allocations");
+    test_assert_equal(1, ctx.buffers.length, "single buffer");
+    test_assert(ctx.buffers.used == NULL, "no partial tables");
+    test_assert(ctx.buffers.free != NULL, "buffer kept for reuse");
+
+    // a partial table is dropped when the pool is full
+    tsd_set_section_buffer_limit(&ctx, 1);
+    uint8_t partial[188];
+    memcpy(partial, stream, 188);
+    partial[7] = 0xFF; // section_length far beyond the packet
+    tsd_demux(&ctx, partial, 188, &parsed);
+    test_assert(ctx.buffers.used != NULL, "partial table");
+    tsd_demux(&ctx, &stream[188], 188, &parsed);
+    test_assert_equal(52, pmt_count, "PMT event");
+    test_assert_equal(1, ctx.buffers.length, "pool limited");
+    test_assert_equal(1, ctx.stats.section_evictions, "eviction counted");
+    test_assert_equal(0, ctx.pid_map[0].assembler, "evicted from its PID");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+size_t alloc_count;
+
+void *counting_malloc(size_t size)
+{
+    alloc_count++;
+    return malloc(size);
+}
+
+void *counting_calloc(size_t num, size_t size)
+{
+    alloc_count++;
+    return calloc(num, size);
+}
+
+void *counting_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    return realloc(ptr, size);
+}
+
+// writes a PAT with one program followed by its PMT, returns the size.
+size_t write_psi(uint8_t *out, uint8_t pat_version, uint8_t pmt_version,
+                 uint8_t *cc_pat, uint8_t *cc_pmt)
+{
+    uint8_t section[1024];
+    uint16_t prog = 1;
+    uint16_t pmt_pid = 0x100;
+    uint8_t stream_type = TSD_PMT_STREAM_TYPE_VIDEO_AVC;
+    uint16_t es_pid = 0x101;
+    size_t len = 0;
+
+    size_t sec_len = stream_pat(section, 1, pat_version, 1, &prog, &pmt_pid);
+    len += stream_packetize_section(&out[len], 0, cc_pat, section, sec_len);
+    sec_len = stream_pmt(section, prog, pmt_version, es_pid, 1, &stream_type, &es_pid);
+    len += stream_packetize_section(&out[len], pmt_pid, cc_pmt, section, sec_len);
+    return len;
+}
+
+void test_demux_table_cache(void)
+{
+    test_start("tsd_demux table cache");
+
+    uint8_t stream[188 * 2];
+    uint8_t cc_pat = 0, cc_pmt = 0;
+    size_t parsed = 0;
+    int i;
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    ctx.malloc = counting_malloc;
+    ctx.calloc = counting_calloc;
+    ctx.realloc = counting_realloc;
+    tsd_set_event_callback(&ctx, event_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    reset_counters();
+
+    test_assert_equal(TSD_INVALID_CONTEXT, tsd_set_table_cache(NULL, 1), "invalid context");
+
+    size_t len = write_psi(stream, 0, 0, &cc_pat, &cc_pmt);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(1, pat_count, "PAT event");
+    test_assert_equal(1, pmt_count, "PMT event");
+
+    // repeats are dropped without allocating anything
+    alloc_count = 0;
+    for(i=0; i<20; ++i) {
+        len = write_psi(stream, 0, 0, &cc_pat, &cc_pmt);
+        tsd_demux(&ctx, stream, len, &parsed);
+    }
+    test_assert_equal(1, pat_count, "PAT repeats dropped");
+    test_assert_equal(1, pmt_count, "PMT repeats dropped");
+    test_assert_equal(0, alloc_count, "no allocations for repeats");
+
+    // a new PMT version is delivered
+    len = write_psi(stream, 0, 1, &cc_pat, &cc_pmt);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(1, pat_count, "PAT unchanged");
+    test_assert_equal(2, pmt_count, "PMT version change");
+
+    // a new PAT delivers the PMTs again
+    len = write_psi(stream, 1, 1, &cc_pat, &cc_pmt);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(2, pat_count, "PAT version change");
+    test_assert_equal(3, pmt_count, "PMT after PAT change");
+
+    // with the cache disabled every repeat is delivered
+    tsd_set_table_cache(&ctx, 0);
+    for(i=0; i<3; ++i) {
+        len = write_psi(stream, 1, 1, &cc_pat, &cc_pmt);
+        tsd_demux(&ctx, stream, len, &parsed);
+    }
+    test_assert_equal(5, pat_count, "PAT always notified");
+    test_assert_equal(6, pmt_count, "PMT always notified");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_crc_error(void)
+{
+    test_start("tsd_demux CRC errors");
+
+    uint8_t stream[188 * 2];
+    uint8_t cc_pat = 0, cc_pmt = 0;
+    size_t parsed = 0;
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    reset_counters();
+
+    // corrupt the PAT's program number
+    size_t len = write_psi(stream, 0, 0, &cc_pat, &cc_pmt);
+    stream[13] ^= 0x01;
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(0, pat_count, "no PAT event");
+    test_assert_equal(0, pmt_count, "PMT PID unknown");
+    test_assert_equal(1, ctx.stats.crc_errors, "CRC error counted");
+
+    len = write_psi(stream, 0, 0, &cc_pat, &cc_pmt);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(1, pat_count, "PAT event");
+    test_assert_equal(1, pmt_count, "PMT event");
+    test_assert_equal(1, ctx.stats.crc_errors, "no more CRC errors");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_table_error(void)
+{
+    test_start("tsd_demux table errors");
+
+    uint8_t stream[188 * 4];
+    uint8_t cc_pat = 0, cc_pmt = 0;
+    size_t parsed = 0;
+    size_t offset;
+    int demuxed = 1;
+
+    // a PMT with a pointer_field past the end of its packet, then the PSI
+    // again. Chunks end part way through packets so there's always a carry.
+    size_t len = write_psi(stream, 0, 0, &cc_pat, &cc_pmt);
+    stream[188 + 4] = 184;
+    len += write_psi(&stream[len], 0, 0, &cc_pat, &cc_pmt);
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    reset_counters();
+
+    for(offset=0; offset<len; offset+=100) {
+        size_t chunk = len - offset < 100 ? len - offset : 100;
+        if(tsd_demux(&ctx, &stream[offset], chunk, &parsed) != TSD_OK || parsed != chunk) {
+            demuxed = 0;
+        }
+    }
+    test_assert(demuxed, "demuxed every chunk");
+    test_assert_equal(1, pat_count, "PAT event");
+    test_assert_equal(1, pmt_count, "PMT event after the bad one");
+    test_assert_equal(1, ctx.stats.table_errors, "table error counted");
+    test_assert_equal(TSD_INVALID_POINTER_FIELD, ctx.stats.last_table_error, "table error");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_interleaved_sections(void)
+{
+    test_start("tsd_demux interleaved sections");
+
+    const size_t programs = 4;
+    const size_t streams = 60;
+    uint16_t prog_nums[4];
+    uint16_t pmt_pids[4];
+    uint8_t pmt_ts[4][188 * 4];
+    size_t pmt_len[4];
+    uint8_t stream[188 * 20];
+    uint8_t section[1024];
+    uint8_t types[60];
+    uint16_t es_pids[60];
+    size_t len = 0;
+    uint8_t cc = 0;
+    size_t i, j;
+
+    for(i=0; i<programs; ++i) {
+        prog_nums[i] = (uint16_t)(i + 1);
+        pmt_pids[i] = (uint16_t)(0x1000 + i);
+    }
+    size_t sec_len = stream_pat(section, 1, 0, programs, prog_nums, pmt_pids);
+    len += stream_packetize_section(&stream[len], 0, &cc, section, sec_len);
+
+    // every PMT spans 2 packets
+    for(i=0; i<programs; ++i) {
+        for(j=0; j<streams; ++j) {
+            types[j] = TSD_PMT_STREAM_TYPE_AUDIO_AAC;
+            es_pids[j] = (uint16_t)(0x100 + i * streams + j);
+        }
+        uint8_t pmt_cc = 0;
+        sec_len = stream_pmt(section, prog_nums[i], 0, es_pids[0], streams, types, es_pids);
+        pmt_len[i] = stream_packetize_section(pmt_ts[i], pmt_pids[i], &pmt_cc, section, sec_len);
+    }
+    test_assert_equal(188 * 2, pmt_len[0], "PMT spans 2 packets");
+
+    // the first packet of every PMT, then the second ones
+    for(j=0; j<2; ++j) {
+        for(i=0; i<programs; ++i) {
+            memcpy(&stream[len], &pmt_ts[i][188 * j], 188);
+            len += 188;
+        }
+    }
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    reset_counters();
+
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(1, pat_count, "PAT event");
+    test_assert_equal(programs, pmt_count, "every PMT in one repetition");
+    test_assert(ctx.buffers.used == NULL, "no partial tables");
+    test_assert_equal(programs, ctx.buffers.length, "one buffer per PID");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_shared_pmt_pid(void)
+{
+    test_start("tsd_demux PMTs sharing a PID");
+
+    uint16_t prog_nums[2] = { 1, 2 };
+    uint16_t pmt_pids[2] = { 0x100, 0x100 };
+    uint8_t stream[188 * 3];
+    uint8_t section[1024];
+    uint8_t pmt2[256];
+    uint8_t payload[184];
+    uint8_t types[33];
+    uint16_t es_pids[33];
+    size_t len = 0;
+    uint8_t cc = 0;
+    uint8_t pmt_cc = 0;
+    size_t i;
+
+    size_t sec_len = stream_pat(section, 1, 0, 2, prog_nums, pmt_pids);
+    len += stream_packetize_section(&stream[len], 0, &cc, section, sec_len);
+
+    for(i=0; i<33; ++i) {
+        types[i] = TSD_PMT_STREAM_TYPE_AUDIO_AAC;
+        es_pids[i] = (uint16_t)(0x200 + i);
+    }
+    sec_len = stream_pmt(section, 1, 0, es_pids[0], 33, types, es_pids);
+    uint16_t es_pid = 0x300;
+    size_t pmt2_len = stream_pmt(pmt2, 2, 0, es_pid, 1, types, &es_pid);
+
+    // the first PMT is followed by the first 2 bytes of the second, whose
+    // header only arrives with the next packet
+    test_assert_equal(181, sec_len, "first PMT size");
+    payload[0] = 0x00;
+    memcpy(&payload[1], section, sec_len);
+    memcpy(&payload[1 + sec_len], pmt2, 2);
+    len += stream_packet(&stream[len], 0x100, 1, &pmt_cc, payload, 184, 1);
+    len += stream_packet(&stream[len], 0x100, 0, &pmt_cc, &pmt2[2], pmt2_len - 2, 1);
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, event_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    reset_counters();
+
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(1, pat_count, "PAT event");
+    test_assert_equal(2, pmt_count, "both PMTs");
+    test_assert_equal(34, ctx.registered_pids_length, "streams of both PMTs");
+    test_assert(ctx.buffers.used == NULL, "no partial tables");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+int table_count;
+uint8_t last_table_id;
+size_t last_table_sections;
+size_t last_table_size;
+int last_table_copied;
+
+void table_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_TABLE) {
+        TSDTableData *table = (TSDTableData*)data;
+        table_count++;
+        last_table_id = table->table->sections[0].table_id;
+        last_table_sections = table->table->length;
+        last_table_size = table->size;
+        last_table_copied = table->data != table->table->sections[0].section_data;
+    }
+}
+
+void test_demux_section_filter(void)
+{
+    test_start("tsd_demux section filters");
+
+    uint8_t stream[188 * 4];
+    uint8_t payload[184];
+    uint8_t body[100];
+    uint8_t section[256];
+    size_t len = 0;
+    uint8_t cc = 0;
+    TSDCode res;
+
+    // a short form SCTE-35 style section followed by one nobody asked for
+    memset(payload, 0xFF, sizeof(payload));
+    payload[0] = 0x00;
+    payload[1] = 0xFC;
+    payload[2] = 0x30;
+    payload[3] = 20;
+    memset(&payload[4], 0xAA, 20);
+    payload[24] = 0xC0;
+    payload[25] = 0x30;
+    payload[26] = 10;
+    len += stream_packet(&stream[len], 0x500, 1, &cc, payload, sizeof(payload), 1);
+
+    // an EIT like table of 2 sections
+    memset(body, 0xBB, sizeof(body));
+    size_t sec_len = stream_section(section, 0x4F, 0x0001, 0, 0, 1, body, sizeof(body));
+    len += stream_packetize_section(&stream[len], 0x500, &cc, section, sec_len);
+    sec_len = stream_section(section, 0x4F, 0x0001, 0, 1, 1, body, sizeof(body));
+    len += stream_packetize_section(&stream[len], 0x500, &cc, section, sec_len);
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, table_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    table_count = 0;
+
+    res = tsd_register_section_filter(&ctx, 0x500, 0xFC, 0xFF);
+    test_assert_equal(TSD_OK, res, "register SCTE-35 filter");
+    res = tsd_register_section_filter(&ctx, 0x500, 0x4E, 0xFE);
+    test_assert_equal(TSD_OK, res, "register EIT filter");
+    res = tsd_register_section_filter(&ctx, 0x500, 0xFC, 0xFF);
+    test_assert_equal(TSD_PID_ALREADY_REGISTERED, res, "filter exists");
+    res = tsd_register_section_filter(&ctx, 0x2000, 0xFC, 0xFF);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "PID out of range");
+
+    res = tsd_demux(&ctx, stream, 188, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(1, table_count, "one table passed the filters");
+    test_assert_equal(0xFC, last_table_id, "SCTE-35 table");
+    test_assert_equal(20, last_table_size, "SCTE-35 size");
+
+    res = tsd_demux(&ctx, &stream[188], len - 188, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(2, table_count, "EIT table");
+    test_assert_equal(0x4F, last_table_id, "table id matched by the mask");
+    test_assert_equal(2, last_table_sections, "both sections");
+    test_assert_equal(200, last_table_size, "data of both sections");
+    test_assert(last_table_copied, "sections concatenated");
+    test_assert(ctx.buffers.used == NULL, "no partial tables");
+
+    res = tsd_deregister_section_filter(&ctx, 0x500, 0xFC, 0xFF);
+    test_assert_equal(TSD_OK, res, "deregister SCTE-35 filter");
+    res = tsd_deregister_section_filter(&ctx, 0x500, 0xFC, 0xFF);
+    test_assert_equal(TSD_PID_NOT_FOUND, res, "filter already removed");
+    res = tsd_demux(&ctx, stream, 188, &parsed);
+    test_assert_equal(2, table_count, "SCTE-35 no longer passes");
+    test_assert(ctx.buffers.used == NULL, "nothing assembled");
+
+    res = tsd_deregister_section_filter(&ctx, 0x500, 0x4E, 0xFE);
+    test_assert_equal(TSD_OK, res, "deregister EIT filter");
+    test_assert_equal(0, ctx.pid_map[0x500].flags & TSD_ROUTE_SECTIONS, "PID no longer routed");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_section_filter_extension(void)
+{
+    test_start("tsd_demux section filters on the table_id_extension");
+
+    uint8_t stream[188 * 4];
+    uint8_t body[250];
+    uint8_t section[512];
+    size_t len = 0;
+    uint8_t cc = 0;
+    TSDCode res;
+
+    // the EIT of two services, only the second is wanted
+    memset(body, 0xBB, sizeof(body));
+    size_t sec_len = stream_section(section, 0x4E, 0x0001, 0, 0, 0, body, sizeof(body));
+    len += stream_packetize_section(&stream[len], 0x500, &cc, section, sec_len);
+    sec_len = stream_section(section, 0x4E, 0x0002, 0, 0, 0, body, 50);
+    len += stream_packetize_section(&stream[len], 0x500, &cc, section, sec_len);
+
+    TSDemuxContext ctx;
+    size_t parsed = 0;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, table_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    table_count = 0;
+
+    res = tsd_register_section_filter_ext(&ctx, 0x500, 0x4E, 0xFF, 0x0002, 0xFFFF);
+    test_assert_equal(TSD_OK, res, "register filter");
+    res = tsd_register_section_filter_ext(&ctx, 0x500, 0x4E, 0xFF, 0x0002, 0xFFFF);
+    test_assert_equal(TSD_PID_ALREADY_REGISTERED, res, "filter exists");
+    res = tsd_register_section_filter(&ctx, 0x500, 0x4E, 0xFF);
+    test_assert_equal(TSD_OK, res, "filter without the extension is another one");
+    res = tsd_deregister_section_filter(&ctx, 0x500, 0x4E, 0xFF);
+    test_assert_equal(TSD_OK, res, "deregister filter without the extension");
+
+    // the first packet of the other service's section
+    res = tsd_demux(&ctx, stream, 188, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert(ctx.buffers.used == NULL, "other service not assembled");
+    test_assert_equal(0, ctx.buffers.length, "nothing allocated for it");
+
+    res = tsd_demux(&ctx, &stream[188], len - 188, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(1, table_count, "one table passed the filter");
+    test_assert_equal(0x4E, last_table_id, "EIT");
+    test_assert_equal(50, last_table_size, "second service");
+
+    // short form sections have no table_id_extension
+    uint8_t payload[184];
+    memset(payload, 0xFF, sizeof(payload));
+    payload[0] = 0x00;
+    payload[1] = 0x4E;
+    payload[2] = 0x30;
+    payload[3] = 20;
+    memset(&payload[4], 0x02, 20);
+    stream_packet(stream, 0x500, 1, &cc, payload, sizeof(payload), 1);
+    res = tsd_demux(&ctx, stream, 188, &parsed);
+    test_assert_equal(1, table_count, "short form section filtered out");
+
+    res = tsd_deregister_section_filter_ext(&ctx, 0x500, 0x4E, 0xFF, 0x0001, 0xFFFF);
+    test_assert_equal(TSD_PID_NOT_FOUND, res, "no such filter");
+    res = tsd_deregister_section_filter_ext(&ctx, 0x500, 0x4E, 0xFF, 0x0002, 0xFFFF);
+    test_assert_equal(TSD_OK, res, "deregister filter");
+    test_assert_equal(0, ctx.pid_map[0x500].flags & TSD_ROUTE_SECTIONS, "PID no longer routed");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_section_view(void)
+{
+    test_start("tsd_demux single section tables");
+
+    uint8_t stream[188];
+    uint8_t payload[184];
+    uint8_t cc = 0;
+    size_t parsed = 0;
+    int i;
+
+    memset(payload, 0xFF, sizeof(payload));
+    payload[0] = 0x00;
+    payload[1] = 0xFC;
+    payload[2] = 0x30;
+    payload[3] = 20;
+    memset(&payload[4], 0xAA, 20);
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    ctx.malloc = counting_malloc;
+    ctx.calloc = counting_calloc;
+    ctx.realloc = counting_realloc;
+    tsd_set_event_callback(&ctx, table_cb);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+    tsd_register_section_filter(&ctx, 0x500, 0xFC, 0xFF);
+    table_count = 0;
+
+    stream_packet(stream, 0x500, 1, &cc, payload, sizeof(payload), 1);
+    tsd_demux(&ctx, stream, sizeof(stream), &parsed);
+    test_assert_equal(1, table_count, "table event");
+    test_assert(!last_table_copied, "data left in the assembly buffer");
+
+    // once the assembler exists no further allocations are made
+    alloc_count = 0;
+    for(i=0; i<20; ++i) {
+        stream_packet(stream, 0x500, 1, &cc, payload, sizeof(payload), 1);
+        tsd_demux(&ctx, stream, sizeof(stream), &parsed);
+    }
+    test_assert_equal(21, table_count, "every repeat delivered");
+    test_assert_equal(20, last_table_size, "table size");
+    test_assert_equal(0, alloc_count, "no allocations per table");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_program_directory(void)
+{
+    test_start("tsd_demux program directory");
+
+    uint8_t stream[188 * 8];
+    uint8_t section[1024];
+    uint8_t cc_pat = 0, cc_pmt1 = 0, cc_pmt2 = 0;
+    size_t len = 0;
+    size_t parsed = 0;
+
+    uint16_t progs[] = { 0, 2, 1 };
+    uint16_t pmt_pids[] = { 0x10, 0x200, 0x100 };
+    uint8_t types1[] = { TSD_PMT_STREAM_TYPE_VIDEO_AVC, TSD_PMT_STREAM_TYPE_AUDIO_AAC };
+    uint16_t es1[] = { 0x101, 0x102 };
+    uint8_t types2[] = { TSD_PMT_STREAM_TYPE_VIDEO_AVC };
+    uint16_t es2[] = { 0x0F0 };
+
+    size_t sec_len = stream_pat(section, 1, 0, 3, progs, pmt_pids);
+    len += stream_packetize_section(&stream[len], 0, &cc_pat, section, sec_len);
+    sec_len = stream_pmt(section, 1, 0, 0x101, 2, types1, es1);
+    len += stream_packetize_section(&stream[len], 0x100, &cc_pmt1, section, sec_len);
+    sec_len = stream_pmt(section, 2, 0, 0x0F0, 1, types2, es2);
+    len += stream_packetize_section(&stream[len], 0x200, &cc_pmt2, section, sec_len);
+
+    TSDemuxContext ctx;
+    const TSDProgram *program = NULL;
+    const TSDProgramElement *element = NULL;
+    tsd_context_init(&ctx);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    lock_sync(&ctx);
+
+    TSDCode res = tsd_get_program(&ctx, 1, &program);
+    test_assert_equal(TSD_PROGRAM_NOT_FOUND, res, "empty directory");
+    res = tsd_get_program(NULL, 1, &program);
+    test_assert_equal(TSD_INVALID_CONTEXT, res, "invalid context");
+
+    tsd_demux(&ctx, stream, len, &parsed);
+    uint32_t generation = ctx.directory.generation;
+    test_assert(generation > 0, "generation moved on");
+    test_assert_equal(2, ctx.directory.length, "network PID left out");
+
+    // the PMTs outlive their events
+    res = tsd_get_program(&ctx, 1, &program);
+    test_assert_equal(TSD_OK, res, "program 1");
+    test_assert_equal(0x100, program->pmt_pid, "program 1 PMT PID");
+    test_assert(program->has_pmt, "program 1 PMT");
+    test_assert_equal(0x101, program->pmt.pcr_pid, "program 1 PCR PID");
+    test_assert_equal(2, program->pmt.program_elements_length, "program 1 streams");
+    res = tsd_get_program(&ctx, 2, &program);
+    test_assert_equal(TSD_OK, res, "program 2");
+    test_assert_equal(0x200, program->pmt_pid, "program 2 PMT PID");
+    test_assert_equal(1, program->pmt.program_elements_length, "program 2 streams");
+    res = tsd_get_program(&ctx, 3, &program);
+    test_assert_equal(TSD_PROGRAM_NOT_FOUND, res, "no program 3");
+
+    res = tsd_get_program_by_pid(&ctx, 0x102, &program, &element);
+    test_assert_equal(TSD_OK, res, "stream 0x102");
+    test_assert_equal(1, program->program_number, "stream 0x102 program");
+    test_assert_equal(TSD_PMT_STREAM_TYPE_AUDIO_AAC, element->stream_type, "stream 0x102 type");
+    res = tsd_get_program_by_pid(&ctx, 0x0F0, &program, NULL);
+    test_assert_equal(TSD_OK, res, "stream 0x0F0");
+    test_assert_equal(2, program->program_number, "stream 0x0F0 program");
+    res = tsd_get_program_by_pid(&ctx, 0x103, &program, &element);
+    test_assert_equal(TSD_PID_NOT_FOUND, res, "no stream 0x103");
+
+    // both AVC streams, in PID order
+    size_t cursor = 0;
+    res = tsd_find_stream_type(&ctx, TSD_PMT_STREAM_TYPE_VIDEO_AVC, &cursor, &program, &element);
+    test_assert_equal(TSD_OK, res, "first AVC stream");
+    test_assert_equal(0x0F0, element->elementary_pid, "first AVC PID");
+    res = tsd_find_stream_type(&ctx, TSD_PMT_STREAM_TYPE_VIDEO_AVC, &cursor, &program, &element);
+    test_assert_equal(TSD_OK, res, "second AVC stream");
+    test_assert_equal(0x101, element->elementary_pid, "second AVC PID");
+    test_assert_equal(1, program->program_number, "second AVC program");
+    res = tsd_find_stream_type(&ctx, TSD_PMT_STREAM_TYPE_VIDEO_AVC, &cursor, &program, &element);
+    test_assert_equal(TSD_END_OF_DATA, res, "no more AVC streams");
+
+    // repeats change nothing, even when they are parsed again
+    tsd_set_table_cache(&ctx, 0);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(generation, ctx.directory.generation, "repeats keep the generation");
+
+    // a new PAT drops program 2
+    uint16_t progs_v1[] = { 1 };
+    uint16_t pmt_pids_v1[] = { 0x100 };
+    sec_len = stream_pat(section, 1, 1, 1, progs_v1, pmt_pids_v1);
+    len = stream_packetize_section(stream, 0, &cc_pat, section, sec_len);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert(ctx.directory.generation != generation, "PAT change seen");
+    test_assert_equal(1, ctx.directory.length, "one program left");
+    res = tsd_get_program(&ctx, 2, &program);
+    test_assert_equal(TSD_PROGRAM_NOT_FOUND, res, "program 2 gone");
+    res = tsd_get_program_by_pid(&ctx, 0x0F0, &program, &element);
+    test_assert_equal(TSD_PID_NOT_FOUND, res, "stream 0x0F0 gone");
+    res = tsd_get_program(&ctx, 1, &program);
+    test_assert(res == TSD_OK && program->has_pmt, "program 1 keeps its PMT");
+
+    // a new PMT version replaces the old one
+    generation = ctx.directory.generation;
+    sec_len = stream_pmt(section, 1, 1, 0x101, 1, types1, es1);
+    len = stream_packetize_section(stream, 0x100, &cc_pmt1, section, sec_len);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert(ctx.directory.generation != generation, "PMT change seen");
+    tsd_get_program(&ctx, 1, &program);
+    test_assert_equal(1, program->pmt.program_elements_length, "new PMT");
+
+    // a PMT for a program the PAT doesn't list is dropped, the programs
+    // handed out stay where they are
+    generation = ctx.directory.generation;
+    sec_len = stream_pmt(section, 5, 0, 0x101, 1, types1, es1);
+    len = stream_packetize_section(stream, 0x100, &cc_pmt1, section, sec_len);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(generation, ctx.directory.generation, "stray PMT ignored");
+    test_assert_equal(1, ctx.directory.length, "no program added");
+    test_assert_equal(TSD_PROGRAM_NOT_FOUND, ctx.stats.last_table_error, "stray PMT reported");
+    const TSDProgram *same = NULL;
+    tsd_get_program(&ctx, 1, &same);
+    test_assert(same == program, "program 1 not moved");
+
+    // other tables on the PMT PID aren't PMTs, even with the program number
+    uint8_t body[] = { 0xE1, 0x01, 0xF0, 0x00 };
+    size_t table_errors = ctx.stats.table_errors;
+    sec_len = stream_section(section, 0xC0, 1, 0, 0, 0, body, sizeof(body));
+    len = stream_packetize_section(stream, 0x100, &cc_pmt1, section, sec_len);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(generation, ctx.directory.generation, "private table ignored");
+    test_assert_equal(table_errors, ctx.stats.table_errors, "private table not an error");
+    test_assert_equal(1, program->pmt.program_elements_length, "PMT kept");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_demux_pes_preallocation(void)
+{
+    test_start("tsd_demux PES preallocation");
+
+    uint8_t payload[20000];
+    uint8_t pes[20100];
+    uint8_t *stream = (uint8_t*) malloc(188 * 256);
+    uint8_t cc = 0;
+    size_t parsed = 0;
+
+    memset(payload, 0x33, sizeof(payload));
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    ctx.malloc = counting_malloc;
+    ctx.calloc = counting_calloc;
+    ctx.realloc = counting_realloc;
+    tsd_set_event_callback(&ctx, event_cb);
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+    reset_counters();
+
+    // PES_packet_length sizes the buffer in one go
+    alloc_count = 0;
+    size_t pes_len = stream_pes(pes, 0xE0, 1000, payload, 5000, 1);
+    size_t len = stream_packetize_pes(stream, 0x101, &cc, pes, pes_len);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(1, pes_count, "bounded PES delivered");
+    test_assert_equal(5000, last_pes_size, "bounded PES size");
+    test_assert_equal(1, alloc_count, "a single allocation");
+
+    // unbounded PES packets grow the buffer geometrically, which is then kept
+    alloc_count = 0;
+    pes_len = stream_pes(pes, 0xE0, 2000, payload, sizeof(payload), 0);
+    len = stream_packetize_pes(stream, 0x101, &cc, pes, pes_len);
+    len += stream_packetize_pes(&stream[len], 0x101, &cc, pes, pes_len);
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(2, pes_count, "unbounded PES delivered");
+    test_assert_equal(sizeof(payload), last_pes_size, "unbounded PES size");
+    test_assert(alloc_count <= 3, "few allocations");
+    alloc_count = 0;
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(4, pes_count, "more unbounded PES delivered");
+    test_assert_equal(0, alloc_count, "buffer reused");
+
+    tsd_context_destroy(&ctx);
+    free(stream);
+
+    test_end();
+}
+
+// the PES reassembled from the slices, and where the slices pointed
+uint8_t slices_payload[4096];
+size_t slices_payload_length;
+const uint8_t *slices_input;
+size_t slices_input_length;
+int slices_outside;
+
+void slices_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PES_SLICES) {
+        TSDPESSlices *pes = (TSDPESSlices*)data;
+        pes_count++;
+        last_pts = pes->pes.pts;
+        last_pes_size = pes->pes.data_bytes_length;
+        slices_payload_length = 0;
+        slices_outside = 0;
+        size_t i;
+        for(i=0; i<pes->slices_length; ++i) {
+            const TSDSlice *slice = &pes->slices[i];
+            if(slice->data < slices_input ||
+               slice->data + slice->length > slices_input + slices_input_length) {
+                slices_outside++;
+            }
+            memcpy(&slices_payload[slices_payload_length], slice->data, slice->length);
+            slices_payload_length += slice->length;
+        }
+    } else if(id == TSD_EVENT_PES) {
+        pes_count = -1;
+    }
+}
+
+void test_demux_pes_slices(void)
+{
+    test_start("tsd_demux PES slices");
+
+    uint8_t payload[2000];
+    uint8_t pes[2100];
+    uint8_t stream[188 * 32];
+    uint8_t cc = 0;
+    size_t parsed = 0;
+    size_t i;
+
+    for(i=0; i<sizeof(payload); ++i) {
+        payload[i] = (uint8_t)(i * 7);
+    }
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, slices_cb);
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES | TSD_REG_PES_SLICES);
+    reset_counters();
+
+    // a bounded PES with its header split over the first two packets
+    size_t pes_len = stream_pes(pes, 0xE0, 1234, payload, 1000, 1);
+    size_t len = stream_packet(stream, 0x101, 1, &cc, pes, 10, 0);
+    size_t offset;
+    for(offset=10; offset<pes_len; offset+=184) {
+        size_t chunk = pes_len - offset < 184 ? pes_len - offset : 184;
+        len += stream_packet(&stream[len], 0x101, 0, &cc, &pes[offset], chunk, 0);
+    }
+    slices_input = stream;
+    slices_input_length = len;
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(1, pes_count, "PES delivered as slices");
+    test_assert_equal_uint64(1234, last_pts, "header parsed across slices");
+    test_assert_equal(1000, last_pes_size, "payload size");
+    test_assert_equal(1000, slices_payload_length, "slices size");
+    test_assert_equal(0, memcmp(payload, slices_payload, 1000), "payload");
+    test_assert_equal(0, slices_outside, "slices point into the input");
+
+    // an unbounded PES split over two calls, the first part is copied
+    pes_len = stream_pes(pes, 0xE0, 5678, payload, sizeof(payload), 0);
+    len = stream_packetize_pes(stream, 0x101, &cc, pes, pes_len);
+    size_t half = (len / 188 / 2) * 188;
+    slices_input = &stream[half];
+    slices_input_length = len - half;
+    tsd_demux(&ctx, stream, half, &parsed);
+    test_assert_equal(1, pes_count, "nothing delivered yet");
+    tsd_demux(&ctx, &stream[half], len - half, &parsed);
+    test_assert_equal(1, pes_count, "still unbounded");
+    tsd_demux_end(&ctx);
+    test_assert_equal(2, pes_count, "delivered at the end");
+    test_assert_equal_uint64(5678, last_pts, "pts");
+    test_assert_equal(sizeof(payload), last_pes_size, "payload size");
+    test_assert_equal(sizeof(payload), slices_payload_length, "slices size");
+    test_assert_equal(0, memcmp(payload, slices_payload, sizeof(payload)), "payload");
+    test_assert_equal(1, slices_outside, "only the first part copied");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+// the payload streamed so far, and the order the events came in
+int stream_starts;
+int stream_ends;
+int stream_errors;
+size_t stream_end_offset;
+
+void stream_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PES_START) {
+        TSDPESPacket *pes = (TSDPESPacket*)data;
+        if(stream_starts != stream_ends) stream_errors++;
+        stream_starts++;
+        last_pts = pes->pts;
+        last_pes_size = pes->data_bytes_length;
+        slices_payload_length = 0;
+    } else if(id == TSD_EVENT_PES_DATA) {
+        TSDPESChunk *chunk = (TSDPESChunk*)data;
+        if(stream_starts != stream_ends + 1) stream_errors++;
+        if(chunk->offset != slices_payload_length) stream_errors++;
+        memcpy(&slices_payload[slices_payload_length], chunk->data, chunk->length);
+        slices_payload_length += chunk->length;
+    } else if(id == TSD_EVENT_PES_END) {
+        TSDPESChunk *chunk = (TSDPESChunk*)data;
+        if(stream_starts != stream_ends + 1) stream_errors++;
+        stream_ends++;
+        stream_end_offset = chunk->offset;
+    } else if(id == TSD_EVENT_PES || id == TSD_EVENT_PES_SLICES) {
+        stream_errors++;
+    }
+}
+
+void test_demux_pes_stream(void)
+{
+    test_start("tsd_demux PES streaming");
+
+    uint8_t payload[2000];
+    uint8_t pes[2100];
+    uint8_t stream[188 * 32];
+    uint8_t cc = 0;
+    size_t parsed = 0;
+    size_t i;
+
+    for(i=0; i<sizeof(payload); ++i) {
+        payload[i] = (uint8_t)(i * 13);
+    }
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, stream_cb);
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES | TSD_REG_PES_STREAM);
+    stream_starts = stream_ends = stream_errors = 0;
+
+    // a bounded PES with its header split over the first two packets
+    size_t pes_len = stream_pes(pes, 0xE0, 4321, payload, 1000, 1);
+    size_t len = stream_packet(stream, 0x101, 1, &cc, pes, 10, 0);
+    size_t offset;
+    for(offset=10; offset<pes_len; offset+=184) {
+        size_t chunk = pes_len - offset < 184 ? pes_len - offset : 184;
+        len += stream_packet(&stream[len], 0x101, 0, &cc, &pes[offset], chunk, 0);
+    }
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(1, stream_starts, "PES start");
+    test_assert_equal(1, stream_ends, "bounded PES ends without the next PUSI");
+    test_assert_equal_uint64(4321, last_pts, "header parsed across packets");
+    test_assert_equal(1000, last_pes_size, "expected payload size");
+    test_assert_equal(1000, stream_end_offset, "end offset");
+    test_assert_equal(1000, slices_payload_length, "payload size");
+    test_assert_equal(0, memcmp(payload, slices_payload, 1000), "payload");
+
+    // an unbounded PES, the start is sent before the rest has arrived
+    pes_len = stream_pes(pes, 0xE0, 8765, payload, sizeof(payload), 0);
+    len = stream_packetize_pes(stream, 0x101, &cc, pes, pes_len);
+    tsd_demux(&ctx, stream, 188, &parsed);
+    test_assert_equal(2, stream_starts, "started after one packet");
+    test_assert_equal(184 - 14, slices_payload_length, "first packet payload");
+    tsd_demux(&ctx, &stream[188], len - 188, &parsed);
+    test_assert_equal(1, stream_ends, "still unbounded");
+    tsd_demux_end(&ctx);
+    test_assert_equal(2, stream_ends, "ended at the end");
+    test_assert_equal_uint64(8765, last_pts, "pts");
+    test_assert_equal(0, last_pes_size, "unknown payload size");
+    test_assert_equal(sizeof(payload), stream_end_offset, "end offset");
+    test_assert_equal(0, memcmp(payload, slices_payload, sizeof(payload)), "payload");
+
+    test_assert_equal(0, stream_errors, "events in order");
+    test_assert(ctx.registered_pids_data[0]->size <= TSD_MEM_PAGE_SIZE, "only the header buffered");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+// the access units delivered as PES packets
+size_t au_sizes[4];
+uint64_t au_pts[4];
+int au_flags[4];
+
+void au_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PES) {
+        TSDPESPacket *pes = (TSDPESPacket*)data;
+        if(pes_count < 4) {
+            au_sizes[pes_count] = pes->data_bytes_length;
+            au_pts[pes_count] = pes->pts;
+            au_flags[pes_count] = pes->flags;
+            memcpy(&slices_payload[0], pes->data_bytes, pes->data_bytes_length);
+        }
+        pes_count++;
+    }
+}
+
+// writes a NAL unit with a 4 byte start code and size bytes of payload.
+size_t write_nal(uint8_t *out, uint8_t header, size_t size)
+{
+    out[0] = 0x00;
+    out[1] = 0x00;
+    out[2] = 0x00;
+    out[3] = 0x01;
+    out[4] = header;
+    memset(&out[5], 0x55, size);
+    return size + 5;
+}
+
+void test_demux_pes_au_end(void)
+{
+    test_start("tsd_demux early access unit end");
+
+    uint8_t section[256];
+    uint8_t es[2048];
+    uint8_t pes[2100];
+    uint8_t stream[188 * 32];
+    uint16_t prog = 1;
+    uint16_t pmt_pid = 0x100;
+    uint16_t es_pid = 0x101;
+    uint8_t type = TSD_PMT_STREAM_TYPE_VIDEO_AVC;
+    uint8_t cc_pat = 0, cc_pmt = 0, cc_es = 0;
+    size_t parsed = 0;
+
+    // two access units in one unbounded PES, the second ends the sequence
+    size_t first = 0;
+    first += write_nal(&es[first], 0x09, 1);        // AUD
+    first += write_nal(&es[first], 0x67, 20);       // SPS
+    first += write_nal(&es[first], 0x65, 500);      // IDR slice
+    size_t es_len = first;
+    es_len += write_nal(&es[es_len], 0x09, 1);      // AUD
+    es_len += write_nal(&es[es_len], 0x41, 300);    // non-IDR slice
+    es_len += write_nal(&es[es_len], 0x0A, 0);      // end of sequence
+
+    size_t len = 0;
+    size_t sec_len = stream_pat(section, 1, 0, 1, &prog, &pmt_pid);
+    len += stream_packetize_section(&stream[len], 0, &cc_pat, section, sec_len);
+    sec_len = stream_pmt(section, prog, 0, es_pid, 1, &type, &es_pid);
+    len += stream_packetize_section(&stream[len], pmt_pid, &cc_pmt, section, sec_len);
+    size_t pes_len = stream_pes(pes, 0xE0, 9000, es, es_len, 0);
+    len += stream_packetize_pes(&stream[len], es_pid, &cc_es, pes, pes_len);
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, au_cb);
+    tsd_register_pid(&ctx, es_pid, TSD_REG_PES | TSD_REG_PES_AU_END);
+    reset_counters();
+
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OK, res, "demux");
+    test_assert_equal(2, pes_count, "both access units delivered before the next PES");
+    test_assert_equal(first, au_sizes[0], "first access unit size");
+    test_assert_equal_uint64(9000, au_pts[0], "first access unit PTS");
+    test_assert_equal(es_len - first, au_sizes[1], "second access unit size");
+    test_assert_equal(0, au_flags[1] & TSD_PPF_PTS_FLAG, "no PTS on the second access unit");
+    test_assert_equal(0, memcmp(&es[first], slices_payload, es_len - first), "second access unit data");
+
+    tsd_demux_end(&ctx);
+    test_assert_equal(2, pes_count, "nothing left to flush");
+    tsd_context_destroy(&ctx);
+
+    // without the flag the PES waits for the end
+    tsd_context_init(&ctx);
+    tsd_set_event_callback(&ctx, au_cb);
+    tsd_register_pid(&ctx, es_pid, TSD_REG_PES);
+    reset_counters();
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(0, pes_count, "held back");
+    tsd_demux_end(&ctx);
+    test_assert_equal(1, pes_count, "flushed");
+    test_assert_equal(es_len, au_sizes[0], "whole PES");
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+// writes a PMT with a single stream, padded to size bytes with registration
+// descriptors in the program info.
+size_t write_padded_pmt(uint8_t *out, uint16_t program_number, uint16_t es_pid, size_t size)
+{
+    uint8_t body[1024];
+    size_t info_length = size - 12 - 4 - 5;
+    size_t len = 4;
+    body[0] = 0xE0 | (es_pid >> 8);
+    body[1] = es_pid & 0xFF;
+    body[2] = 0xF0 | (info_length >> 8);
+    body[3] = info_length & 0xFF;
+    while(len < 4 + info_length) {
+        size_t left = 4 + info_length - len;
+        size_t desc_length = left - 2 > 255 ? 255 : left - 2;
+        if(left - 2 - desc_length == 1) {
+            desc_length--;
+        }
+        body[len++] = 0x05;
+        body[len++] = (uint8_t)desc_length;
+        memset(&body[len], 0x41, desc_length);
+        len += desc_length;
+    }
+    body[len++] = TSD_PMT_STREAM_TYPE_AUDIO_AAC;
+    body[len++] = 0xE0 | (es_pid >> 8);
+    body[len++] = es_pid & 0xFF;
+    body[len++] = 0xF0;
+    body[len++] = 0x00;
+    return stream_section(out, 0x02, program_number, 0, 0, 0, body, len);
+}
+
+void test_demux_split_section_header(void)
+{
+    test_start("tsd_demux section header split between packets");
+
+    uint16_t prog_nums[2] = { 1, 2 };
+    uint16_t pmt_pids[2] = { 0x100, 0x100 };
+    uint16_t es_pid = 0x101;
+    uint8_t type = TSD_PMT_STREAM_TYPE_AUDIO_AAC;
+    uint8_t first[1024];
+    uint8_t second[256];
+    uint8_t payload[184];
+    uint8_t stream[188 * 4];
+    int all = 1;
+    size_t split;
+
+    // the second PMT starts in the last bytes of a packet whose pointer_field
+    // points past the tail of the first one, cutting the 8 byte header.
+    for(split=1; split<=8; ++split) {
+        uint8_t cc_pat = 0, cc_pmt = 0;
+        size_t len = 0;
+        size_t sec_len = stream_pat(second, 1, 0, 2, prog_nums, pmt_pids);
+        len += stream_packetize_section(&stream[len], 0, &cc_pat, second, sec_len);
+
+        size_t first_len = write_padded_pmt(first, 1, es_pid, 366 - split);
+        size_t second_len = stream_pmt(second, 2, 0, es_pid, 1, &type, &es_pid);
+
+        payload[0] = 0x00;
+        memcpy(&payload[1], first, 183);
+        len += stream_packet(&stream[len], 0x100, 1, &cc_pmt, payload, 184, 1);
+
+        payload[0] = (uint8_t)(first_len - 183);
+        memcpy(&payload[1], &first[183], first_len - 183);
+        memcpy(&payload[1 + first_len - 183], second, split);
+        len += stream_packet(&stream[len], 0x100, 1, &cc_pmt, payload, 184, 1);
+
+        memset(payload, 0xFF, sizeof(payload));
+        memcpy(payload, &second[split], second_len - split);
+        len += stream_packet(&stream[len], 0x100, 0, &cc_pmt, payload, 184, 1);
+
+        TSDemuxContext ctx;
+        size_t parsed = 0;
+        tsd_context_init(&ctx);
+        tsd_set_event_callback(&ctx, event_cb);
+        reset_counters();
+        TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+        if(res != TSD_OK || pmt_count != 2 || parsed != len) {
+            all = 0;
+        }
+        tsd_context_destroy(&ctx);
+    }
+    test_assert(all, "both PMTs whatever the split");
+
+    test_end();
+}
+
+void test_demux_split_fake_sync(void)
+{
+    test_start("tsd_demux fake sync split over calls");
+
+    uint8_t junk[300];
+    uint8_t stream[188 * 4];
+    uint8_t pes[256];
+    uint8_t payload[100];
+    size_t len = 0;
+    size_t parsed = 0;
+    uint8_t cc = 0;
+    int i;
+
+    // a pair of sync bytes a packet apart with nothing to confirm them
+    memset(junk, 0x00, sizeof(junk));
+    junk[20] = TSD_SYNC_BYTE;
+    junk[20 + 188] = TSD_SYNC_BYTE;
+
+    memset(payload, 0x11, sizeof(payload));
+    size_t pes_len = stream_pes(pes, 0xE0, 0, payload, sizeof(payload), 1);
+    for(i=0; i<4; ++i) {
+        len += stream_packetize_pes(&stream[len], 0x101, &cc, pes, pes_len);
+    }
+
+    TSDemuxContext ctx;
+    tsd_context_init(&ctx);
+    tsd_set_packet_size(&ctx, TSD_TSPACKET_SIZE);
+    tsd_set_event_callback(&ctx, sync_cb);
+    tsd_register_pid(&ctx, 0x101, TSD_REG_PES);
+    reset_counters();
+    sync_loss_count = sync_acquired_count = 0;
+
+    // the first call ends before the pair, the second before its confirmation
+    tsd_demux(&ctx, junk, 100, &parsed);
+    test_assert_equal(0, sync_acquired_count, "no sync on a lone sync byte");
+    tsd_demux(&ctx, &junk[100], sizeof(junk) - 100, &parsed);
+    test_assert_equal(0, sync_acquired_count, "no sync on an unconfirmed pair");
+    test_assert(ctx.carry.length > 0, "pair carried");
+
+    tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(1, sync_acquired_count, "sync acquired");
+    test_assert_equal(sizeof(junk), last_sync_acquired.bytes_skipped, "junk skipped");
+    test_assert_equal(4, pes_count, "PES events");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
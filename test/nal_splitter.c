@@ -0,0 +1,193 @@
+#include "test.h"
+#include <tsdemux.h>
+#include <string.h>
+
+void test_find_start_code(void);
+void test_nal_splitter(void);
+void test_nal_splitter_chunks(void);
+void test_nal_splitter_hevc(void);
+
+int main(int argc, char **argv)
+{
+    test_find_start_code();
+    test_nal_splitter();
+    test_nal_splitter_chunks();
+    test_nal_splitter_hevc();
+    return 0;
+}
+
+void test_find_start_code(void)
+{
+    test_start("tsd_find_start_code");
+
+    uint8_t data[256];
+    size_t offset = 0;
+    size_t pos;
+
+    test_assert_equal(TSD_INVALID_ARGUMENT, tsd_find_start_code(data, 10, NULL), "invalid offset");
+    test_assert_equal(TSD_INVALID_DATA, tsd_find_start_code(NULL, 10, &offset), "invalid data");
+    test_assert_equal(TSD_END_OF_DATA, tsd_find_start_code(NULL, 0, &offset), "empty data");
+
+    memset(data, 0x55, sizeof(data));
+    test_assert_equal(TSD_END_OF_DATA, tsd_find_start_code(data, sizeof(data), &offset), "no start code");
+    test_assert_equal(sizeof(data), offset, "offset is the size");
+
+    // every position, so each SIMD lane and the scalar tail are hit
+    int found = 1;
+    for(pos=0; pos + 3 <= sizeof(data); ++pos) {
+        memset(data, 0x55, sizeof(data));
+        data[pos] = 0x00;
+        data[pos + 1] = 0x00;
+        data[pos + 2] = 0x01;
+        if(tsd_find_start_code(data, sizeof(data), &offset) != TSD_OK || offset != pos) {
+            found = 0;
+        }
+    }
+    test_assert(found, "start code at every position");
+
+    // zeros and emulation prevention aren't start codes
+    memset(data, 0x55, sizeof(data));
+    data[10] = 0x00; data[11] = 0x00; data[12] = 0x03;
+    data[40] = 0x00; data[41] = 0x00; data[42] = 0x00;
+    data[43] = 0x00; data[44] = 0x01;
+    test_assert_equal(TSD_OK, tsd_find_start_code(data, sizeof(data), &offset), "found");
+    test_assert_equal(42, offset, "after the zero bytes");
+
+    // a start code cut off by the end of data
+    test_assert_equal(TSD_END_OF_DATA, tsd_find_start_code(data, 44, &offset), "cut off");
+
+    test_end();
+}
+
+// an AVC stream: AUD, SPS with an emulation prevention byte, a slice, and
+// trailing zero bytes before the 4 byte start code of the next AUD.
+size_t write_avc(uint8_t *out)
+{
+    size_t len = 0;
+    const uint8_t aud[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0 };
+    const uint8_t sps[] = { 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x00, 0x03, 0x01, 0x28 };
+    memcpy(&out[len], aud, sizeof(aud));
+    len += sizeof(aud);
+    memcpy(&out[len], sps, sizeof(sps));
+    len += sizeof(sps);
+    out[len++] = 0x00;
+    out[len++] = 0x00;
+    out[len++] = 0x01;
+    out[len++] = 0x65;
+    memset(&out[len], 0xA5, 300);
+    len += 300;
+    out[len++] = 0x00;
+    out[len++] = 0x00;
+    memcpy(&out[len], aud, sizeof(aud));
+    len += sizeof(aud);
+    return len;
+}
+
+// splits data fed in pieces of chunk bytes, returns the number of units.
+size_t split(uint8_t stream_type, const uint8_t *data, size_t size, size_t chunk, TSDNALUnit *units)
+{
+    TSDNALSplitter splitter;
+    size_t count = 0;
+    size_t offset;
+    tsd_nal_splitter_init(&splitter, stream_type);
+    for(offset=0; offset<size; offset+=chunk) {
+        size_t len = size - offset < chunk ? size - offset : chunk;
+        tsd_nal_splitter_feed(&splitter, &data[offset], len);
+        while(tsd_nal_splitter_next(&splitter, &units[count]) == TSD_OK) {
+            count++;
+        }
+    }
+    if(tsd_nal_splitter_end(&splitter, &units[count]) == TSD_OK) {
+        count++;
+    }
+    return count;
+}
+
+void test_nal_splitter(void)
+{
+    test_start("tsd_nal_splitter");
+
+    uint8_t data[512];
+    TSDNALUnit units[8];
+    TSDNALSplitter splitter;
+    size_t len = write_avc(data);
+
+    test_assert_equal(TSD_INVALID_ARGUMENT, tsd_nal_splitter_init(NULL, TSD_PMT_STREAM_TYPE_VIDEO_AVC), "invalid splitter");
+    test_assert_equal(TSD_INVALID_ARGUMENT, tsd_nal_splitter_init(&splitter, TSD_PMT_STREAM_TYPE_AUDIO_AAC), "invalid stream type");
+    test_assert_equal(TSD_OK, tsd_nal_splitter_init(&splitter, TSD_PMT_STREAM_TYPE_VIDEO_AVC), "init");
+    test_assert_equal(TSD_END_OF_DATA, tsd_nal_splitter_end(&splitter, &units[0]), "nothing fed");
+
+    size_t count = split(TSD_PMT_STREAM_TYPE_VIDEO_AVC, data, len, len, units);
+    test_assert_equal(4, count, "NAL units");
+    test_assert_equal(9, units[0].type, "AUD");
+    test_assert_equal(4, units[0].offset, "AUD offset");
+    test_assert_equal(2, units[0].length, "AUD length");
+    test_assert_equal(7, units[1].type, "SPS");
+    test_assert_equal(9, units[1].offset, "SPS offset");
+    test_assert_equal(7, units[1].length, "SPS length");
+    test_assert_equal(1, units[1].emulation_prevention_bytes, "SPS emulation prevention");
+    test_assert_equal(5, units[2].type, "IDR slice");
+    test_assert_equal(19, units[2].offset, "slice offset");
+    test_assert_equal(301, units[2].length, "trailing zeros left out");
+    test_assert_equal(0, units[2].emulation_prevention_bytes, "no emulation prevention");
+    test_assert_equal(9, units[3].type, "last AUD");
+    test_assert_equal(len - 2, units[3].offset, "last AUD offset");
+    test_assert_equal(2, units[3].length, "last AUD length");
+
+    test_end();
+}
+
+void test_nal_splitter_chunks(void)
+{
+    test_start("tsd_nal_splitter across chunks");
+
+    uint8_t data[512];
+    TSDNALUnit expected[8];
+    TSDNALUnit units[8];
+    size_t len = write_avc(data);
+    size_t count = split(TSD_PMT_STREAM_TYPE_VIDEO_AVC, data, len, len, expected);
+
+    // start codes and emulation prevention bytes split at every point
+    int same = 1;
+    size_t chunk;
+    for(chunk=1; chunk<=20; ++chunk) {
+        size_t n = split(TSD_PMT_STREAM_TYPE_VIDEO_AVC, data, len, chunk, units);
+        size_t i;
+        if(n != count) {
+            same = 0;
+            continue;
+        }
+        for(i=0; i<n; ++i) {
+            if(units[i].type != expected[i].type ||
+               units[i].offset != expected[i].offset ||
+               units[i].length != expected[i].length ||
+               units[i].emulation_prevention_bytes != expected[i].emulation_prevention_bytes) {
+                same = 0;
+            }
+        }
+    }
+    test_assert(same, "same NAL units whatever the chunk size");
+
+    test_end();
+}
+
+void test_nal_splitter_hevc(void)
+{
+    test_start("tsd_nal_splitter HEVC");
+
+    const uint8_t data[] = {
+        0x00, 0x00, 0x00, 0x01, 0x46, 0x01, 0x10,           // AUD
+        0x00, 0x00, 0x01, 0x40, 0x01, 0x0C, 0x01,           // VPS
+        0x00, 0x00, 0x01, 0x26, 0x01, 0xAF, 0x00, 0x00, 0x03, 0x00, 0x80, // IDR_W_RADL
+    };
+    TSDNALUnit units[4];
+    size_t count = split(TSD_PMT_STREAM_TYPE_VIDEO_HEVC, data, sizeof(data), sizeof(data), units);
+    test_assert_equal(3, count, "NAL units");
+    test_assert_equal(35, units[0].type, "AUD");
+    test_assert_equal(32, units[1].type, "VPS");
+    test_assert_equal(19, units[2].type, "IDR_W_RADL");
+    test_assert_equal(8, units[2].length, "IDR length");
+    test_assert_equal(1, units[2].emulation_prevention_bytes, "emulation prevention");
+
+    test_end();
+}
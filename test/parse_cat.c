@@ -63,6 +63,12 @@ void test_parse_cat_data(void)
     test_assert_equal(TSD_OK, res, "successful parse");
     test_assert_equal(2, cat.descriptors_length, "descriptor length");
     test_assert(cat.descriptors != NULL, "valid descriptors");
+    test_assert_equal(0xFE, cat.descriptors[0].tag, "descriptor tag 1");
+    test_assert_equal(0x03, cat.descriptors[0].length, "descriptor length 1");
+    test_assert_equal_ptr((size_t)&data[0], (size_t)cat.descriptors[0].data, "descriptor data 1");
+    test_assert_equal(0x98, cat.descriptors[1].tag, "descriptor tag 2");
+    test_assert_equal(0x04, cat.descriptors[1].length, "descriptor length 2");
+    test_assert_equal(6, cat.descriptors[1].data_length, "descriptor data length 2");
 
     test_end();
 }
@@ -28,6 +28,9 @@ void test_external_es_id(void);
 void test_mux_code(void);
 void test_fmx_buffer_size(void);
 void test_multiplex_buffer(void);
+void test_descriptor_iter(void);
+void test_descriptor_iter_find(void);
+void test_decode_descriptor(void);
 
 int main(int argc, char **argv)
 {
@@ -57,6 +60,9 @@ int main(int argc, char **argv)
     test_mux_code();
     test_fmx_buffer_size();
     test_multiplex_buffer();
+    test_descriptor_iter();
+    test_descriptor_iter_find();
+    test_decode_descriptor();
     return 0;
 }
 
@@ -849,3 +855,150 @@ void test_multiplex_buffer(void)
 
     test_end();
 }
+
+void test_descriptor_iter(void)
+{
+    test_start("descriptor iterator");
+
+    TSDDescriptorIter iter;
+    TSDDescriptor desc;
+    const uint8_t data[] = {
+        0x0A, 0x04, 'e', 'n', 'g', 0x00, // ISO 639 language
+        0x52, 0x00, // empty descriptor
+        0x09, 0x04, 0x0B, 0x00, 0xE1, 0x00, // conditional access
+        0x05, 0x08, 'H', 'D', // truncated
+    };
+
+    TSDCode res;
+    res = tsd_descriptor_iter_init(NULL, data, sizeof(data));
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "invalid iterator");
+    res = tsd_descriptor_iter_init(&iter, NULL, sizeof(data));
+    test_assert_equal(TSD_INVALID_DATA, res, "invalid data");
+    res = tsd_descriptor_iter_next(&iter, &desc);
+    test_assert_equal(TSD_END_OF_DATA, res, "invalid data leaves the loop empty");
+    res = tsd_descriptor_iter_init(&iter, NULL, 0);
+    test_assert_equal(TSD_OK, res, "empty loop");
+    res = tsd_descriptor_iter_next(&iter, &desc);
+    test_assert_equal(TSD_END_OF_DATA, res, "nothing in an empty loop");
+
+    res = tsd_descriptor_iter_init(&iter, data, sizeof(data));
+    test_assert_equal(TSD_OK, res, "init");
+    res = tsd_descriptor_iter_next(&iter, NULL);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "invalid descriptor");
+
+    res = tsd_descriptor_iter_next(&iter, &desc);
+    test_assert_equal(TSD_OK, res, "first descriptor");
+    test_assert_equal(0x0A, desc.tag, "first tag");
+    test_assert_equal(4, desc.length, "first length");
+    test_assert_equal_ptr((size_t)&data[0], (size_t)desc.data, "first data");
+    test_assert_equal(6, desc.data_length, "first data length");
+
+    res = tsd_descriptor_iter_next(&iter, &desc);
+    test_assert_equal(TSD_OK, res, "empty descriptor");
+    test_assert_equal(0x52, desc.tag, "empty tag");
+    test_assert_equal(0, desc.length, "empty length");
+    test_assert_equal(2, desc.data_length, "empty data length");
+
+    res = tsd_descriptor_iter_next(&iter, &desc);
+    test_assert_equal(TSD_OK, res, "third descriptor");
+    test_assert_equal(0x09, desc.tag, "third tag");
+    test_assert_equal_ptr((size_t)&data[8], (size_t)desc.data, "third data");
+
+    res = tsd_descriptor_iter_next(&iter, &desc);
+    test_assert_equal(TSD_INVALID_DATA_SIZE, res, "truncated descriptor");
+    res = tsd_descriptor_iter_next(&iter, &desc);
+    test_assert_equal(TSD_END_OF_DATA, res, "done after truncation");
+
+    // a lone tag byte is truncated as well
+    tsd_descriptor_iter_init(&iter, data, 1);
+    res = tsd_descriptor_iter_next(&iter, &desc);
+    test_assert_equal(TSD_INVALID_DATA_SIZE, res, "lone tag");
+
+    test_end();
+}
+
+void test_descriptor_iter_find(void)
+{
+    test_start("descriptor iterator find");
+
+    TSDDescriptorIter iter;
+    TSDDescriptor desc;
+    TSDDescriptorISO639Language lang;
+    const uint8_t data[] = {
+        0x09, 0x04, 0x0B, 0x00, 0xE1, 0x00, // conditional access
+        0x0A, 0x04, 'e', 'n', 'g', 0x00, // ISO 639 language
+        0x09, 0x04, 0x0D, 0x00, 0xE2, 0x00, // conditional access
+    };
+
+    TSDCode res;
+    tsd_descriptor_iter_init(&iter, data, sizeof(data));
+    res = tsd_descriptor_iter_find(&iter, 0x0A, &desc);
+    test_assert_equal(TSD_OK, res, "language found");
+    test_assert_equal_ptr((size_t)&data[6], (size_t)desc.data, "language data");
+    res = tsd_parse_descriptor_iso639_language(desc.data, desc.data_length, &lang);
+    test_assert_equal(TSD_OK, res, "language parsed");
+    test_assert_equal(1, lang.language_length, "one language");
+    res = tsd_descriptor_iter_find(&iter, 0x0A, &desc);
+    test_assert_equal(TSD_END_OF_DATA, res, "single language");
+
+    // every CA descriptor in turn
+    tsd_descriptor_iter_init(&iter, data, sizeof(data));
+    res = tsd_descriptor_iter_find(&iter, 0x09, &desc);
+    test_assert_equal(TSD_OK, res, "first CA");
+    test_assert_equal(0x0B, desc.data[2], "first CA system");
+    res = tsd_descriptor_iter_find(&iter, 0x09, &desc);
+    test_assert_equal(TSD_OK, res, "second CA");
+    test_assert_equal(0x0D, desc.data[2], "second CA system");
+    res = tsd_descriptor_iter_find(&iter, 0x09, &desc);
+    test_assert_equal(TSD_END_OF_DATA, res, "no more CA");
+
+    test_end();
+}
+
+void test_decode_descriptor(void)
+{
+    test_start("tsd_decode_descriptor");
+
+    TSDDescriptorIter iter;
+    TSDDescriptor desc;
+    TSDDecodedDescriptor out;
+    const uint8_t data[] = {
+        0x0A, 0x04, 'e', 'n', 'g', 0x03, // ISO 639 language
+        0x0E, 0x03, 0xC0, 0x12, 0x34, // maximum bitrate
+        0xE7, 0x01, 0x00, // user private
+        0x0A, 0x01, 0x00, // ISO 639 language that is too short
+    };
+
+    TSDCode res;
+    res = tsd_decode_descriptor(NULL, &out);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "invalid descriptor");
+
+    tsd_descriptor_iter_init(&iter, data, sizeof(data));
+    tsd_descriptor_iter_next(&iter, &desc);
+    res = tsd_decode_descriptor(&desc, NULL);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "invalid output");
+
+    res = tsd_decode_descriptor(&desc, &out);
+    test_assert_equal(TSD_OK, res, "language decoded");
+    test_assert_equal(TSD_DESCRIPTOR_ISO639_LANGUAGE, out.header.tag, "language tag");
+    test_assert_equal(4, out.header.length, "language length");
+    test_assert_equal(1, out.iso639_language.language_length, "one language");
+    test_assert_equal(0x656E67, out.iso639_language.iso_language_code[0], "language code");
+    test_assert_equal(0x03, out.iso639_language.audio_type[0], "audio type");
+
+    tsd_descriptor_iter_next(&iter, &desc);
+    res = tsd_decode_descriptor(&desc, &out);
+    test_assert_equal(TSD_OK, res, "bitrate decoded");
+    test_assert_equal(TSD_DESCRIPTOR_MAX_BITRATE, out.header.tag, "bitrate tag");
+    test_assert_equal(0x001234, out.max_bitrate.max_bitrate, "bitrate");
+
+    tsd_descriptor_iter_next(&iter, &desc);
+    res = tsd_decode_descriptor(&desc, &out);
+    test_assert_equal(TSD_UNKNOWN_DESCRIPTOR, res, "no decoder");
+
+    tsd_descriptor_iter_next(&iter, &desc);
+    res = tsd_decode_descriptor(&desc, &out);
+    test_assert_equal(TSD_INVALID_DATA_SIZE, res, "decoder error passed on");
+
+    test_end();
+}
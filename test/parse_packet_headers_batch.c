@@ -0,0 +1,225 @@
+#include "test.h"
+#include "stream.h"
+#include <tsdemux.h>
+#include <string.h>
+
+#define PACKETS (37)
+
+void test_input(void);
+void test_matches_single_parse(void);
+void test_m2ts(void);
+void test_sync_error(void);
+
+int main(int argc, char **argv)
+{
+    test_input();
+    test_matches_single_parse();
+    test_m2ts();
+    test_sync_error();
+    return 0;
+}
+
+uint16_t pids[PACKETS];
+uint8_t flags[PACKETS];
+uint8_t ccs[PACKETS];
+uint8_t afcs[PACKETS];
+uint8_t offsets[PACKETS];
+uint64_t pcrs[PACKETS];
+
+void init_headers(TSDPacketHeaders *headers)
+{
+    headers->pid = pids;
+    headers->flags = flags;
+    headers->continuity_counter = ccs;
+    headers->adaptation_field_control = afcs;
+    headers->payload_offset = offsets;
+    headers->pcr = pcrs;
+    headers->capacity = PACKETS;
+}
+
+// writes a mix of packets: PES with adaptation field stuffing, PCR only
+// packets, sections and packets with the error indicator set.
+size_t write_packets(uint8_t *out, size_t count)
+{
+    uint8_t payload[184];
+    uint8_t cc = 0;
+    size_t i;
+    for(i=0; i<count; ++i) {
+        uint8_t *pkt = &out[i * 188];
+        memset(payload, (int)i, sizeof(payload));
+        switch(i % 4) {
+        case 0:
+            stream_packet(pkt, (uint16_t)(0x100 + i), 1, &cc, payload, 100 + i, 0);
+            break;
+        case 1:
+            // adaptation field only, with a PCR of base i * 1000, ext i
+            pkt[0] = 0x47;
+            pkt[1] = 0x01;
+            pkt[2] = 0x00;
+            pkt[3] = 0x20 | (cc++ & 0x0F);
+            pkt[4] = 183;
+            pkt[5] = 0x10;
+            {
+                uint64_t base = (uint64_t)i * 1000;
+                uint16_t ext = (uint16_t)i;
+                pkt[6] = (uint8_t)(base >> 25);
+                pkt[7] = (uint8_t)(base >> 17);
+                pkt[8] = (uint8_t)(base >> 9);
+                pkt[9] = (uint8_t)(base >> 1);
+                pkt[10] = (uint8_t)(((base & 0x01) << 7) | 0x7E | ((ext >> 8) & 0x01));
+                pkt[11] = (uint8_t)(ext & 0xFF);
+            }
+            memset(&pkt[12], 0xFF, 188 - 12);
+            break;
+        case 2:
+            stream_packet(pkt, 0x1FFE, 0, &cc, payload, 184, 1);
+            break;
+        default:
+            stream_packet(pkt, 0x0011, 0, &cc, payload, 184, 1);
+            pkt[1] |= 0xA0; // error indicator and priority
+            break;
+        }
+    }
+    return count * 188;
+}
+
+void test_input(void)
+{
+    test_start("tsd_parse_packet_headers_batch input");
+
+    TSDemuxContext ctx;
+    TSDPacketHeaders headers;
+    uint8_t data[188];
+    size_t count = 10;
+    TSDCode res;
+
+    tsd_context_init(&ctx);
+    init_headers(&headers);
+    write_packets(data, 1);
+
+    res = tsd_parse_packet_headers_batch(NULL, data, sizeof(data), &headers, &count);
+    test_assert_equal(TSD_INVALID_CONTEXT, res, "invalid context");
+    test_assert_equal(0, count, "count reset");
+    res = tsd_parse_packet_headers_batch(&ctx, NULL, sizeof(data), &headers, &count);
+    test_assert_equal(TSD_INVALID_DATA, res, "invalid data");
+    res = tsd_parse_packet_headers_batch(&ctx, data, sizeof(data), NULL, &count);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "invalid headers");
+    res = tsd_parse_packet_headers_batch(&ctx, data, 187, &headers, &count);
+    test_assert_equal(TSD_INVALID_DATA_SIZE, res, "invalid size");
+    headers.pcr = NULL;
+    res = tsd_parse_packet_headers_batch(&ctx, data, sizeof(data), &headers, &count);
+    test_assert_equal(TSD_OK, res, "optional PCR");
+    test_assert_equal(1, count, "single packet");
+
+    tsd_context_destroy(&ctx);
+    test_end();
+}
+
+void test_matches_single_parse(void)
+{
+    test_start("tsd_parse_packet_headers_batch matches tsd_parse_packet_header");
+
+    TSDemuxContext ctx;
+    TSDPacketHeaders headers;
+    uint8_t data[188 * PACKETS];
+    size_t count = 0;
+
+    tsd_context_init(&ctx);
+    init_headers(&headers);
+    size_t len = write_packets(data, PACKETS);
+
+    TSDCode res = tsd_parse_packet_headers_batch(&ctx, data, len, &headers, &count);
+    test_assert_equal(TSD_OK, res, "parse");
+    test_assert_equal(PACKETS, count, "count");
+
+    int pid_ok = 1, flags_ok = 1, cc_ok = 1, afc_ok = 1, offset_ok = 1, pcr_ok = 1;
+    size_t i;
+    for(i=0; i<PACKETS; ++i) {
+        TSDPacket hdr;
+        tsd_parse_packet_header(&ctx, &data[i * 188], 188, &hdr);
+        if(pids[i] != hdr.pid) pid_ok = 0;
+        if((flags[i] & ~TSD_PF_PCR) != hdr.flags) flags_ok = 0;
+        if(ccs[i] != hdr.continuity_counter) cc_ok = 0;
+        if(afcs[i] != hdr.adaptation_field_control) afc_ok = 0;
+        if(hdr.data_bytes &&
+           offsets[i] != (size_t)(hdr.data_bytes - &data[i * 188])) offset_ok = 0;
+        if(i % 4 == 1) {
+            uint64_t pcr = hdr.adaptation_field.program_clock_ref_base * 300 +
+                           hdr.adaptation_field.program_clock_ref_ext;
+            if(!(flags[i] & TSD_PF_PCR) || pcrs[i] != pcr ||
+               offsets[i] != 188) pcr_ok = 0;
+        } else if(flags[i] & TSD_PF_PCR || pcrs[i] != 0) {
+            pcr_ok = 0;
+        }
+    }
+    test_assert(pid_ok, "pid");
+    test_assert(flags_ok, "flags");
+    test_assert(cc_ok, "continuity counter");
+    test_assert(afc_ok, "adaptation field control");
+    test_assert(offset_ok, "payload offset");
+    test_assert(pcr_ok, "PCR");
+    test_assert_equal_uint64(5 * 1000 * 300 + 5, pcrs[5], "PCR value");
+
+    // capacity limits the number of packets parsed
+    headers.capacity = 9;
+    res = tsd_parse_packet_headers_batch(&ctx, data, len, &headers, &count);
+    test_assert_equal(TSD_OK, res, "parse with small capacity");
+    test_assert_equal(9, count, "count limited by capacity");
+
+    tsd_context_destroy(&ctx);
+    test_end();
+}
+
+void test_m2ts(void)
+{
+    test_start("tsd_parse_packet_headers_batch M2TS");
+
+    TSDemuxContext ctx;
+    TSDPacketHeaders headers;
+    uint8_t ts[188 * PACKETS];
+    uint8_t data[192 * PACKETS];
+    size_t count = 0;
+    size_t i;
+
+    tsd_context_init(&ctx);
+    tsd_set_packet_size(&ctx, TSD_M2TS_PACKET_SIZE);
+    init_headers(&headers);
+    write_packets(ts, PACKETS);
+    for(i=0; i<PACKETS; ++i) {
+        memset(&data[i * 192], 0x47, 4);
+        memcpy(&data[i * 192 + 4], &ts[i * 188], 188);
+    }
+
+    TSDCode res = tsd_parse_packet_headers_batch(&ctx, data, sizeof(data), &headers, &count);
+    test_assert_equal(TSD_OK, res, "parse");
+    test_assert_equal(PACKETS, count, "count");
+    test_assert_equal(0x100 + 32, pids[32], "pid");
+    test_assert_equal(4, offsets[2], "payload offset");
+    test_assert_equal_uint64(33 * 1000 * 300 + 33, pcrs[33], "PCR value");
+
+    tsd_context_destroy(&ctx);
+    test_end();
+}
+
+void test_sync_error(void)
+{
+    test_start("tsd_parse_packet_headers_batch sync error");
+
+    TSDemuxContext ctx;
+    TSDPacketHeaders headers;
+    uint8_t data[188 * PACKETS];
+    size_t count = 0;
+
+    tsd_context_init(&ctx);
+    init_headers(&headers);
+    size_t len = write_packets(data, PACKETS);
+    data[20 * 188] = 0x00;
+
+    TSDCode res = tsd_parse_packet_headers_batch(&ctx, data, len, &headers, &count);
+    test_assert_equal(TSD_INVALID_SYNC_BYTE, res, "invalid sync byte");
+    test_assert_equal(20, count, "stopped at the bad packet");
+    test_assert_equal(0x100 + 16, pids[16], "packets before are parsed");
+
+    tsd_context_destroy(&ctx);
+    test_end();
+}
@@ -1,16 +1,19 @@
 #include "test.h"
 #include <tsdemux.h>
+#include <stdlib.h>
 #include <string.h>
 
 void parse_pmt_input(void);
 void parse_pmt_data(void);
 void parse_pmt_empty_data(void);
+void parse_pmt_single_allocation(void);
 
 int main(int argc, char **argv)
 {
     parse_pmt_input();
     parse_pmt_data();
     parse_pmt_empty_data();
+    parse_pmt_single_allocation();
     return 0;
 }
 
@@ -150,3 +153,66 @@ void parse_pmt_empty_data(void)
 
     test_end();
 }
+
+int alloc_count;
+int free_count;
+
+void *counting_calloc(size_t num, size_t size)
+{
+    alloc_count++;
+    return calloc(num, size);
+}
+
+void counting_free(void *ptr)
+{
+    free_count++;
+    free(ptr);
+}
+
+void parse_pmt_single_allocation(void)
+{
+    test_start("parse pmt single allocation");
+
+    TSDemuxContext ctx;
+    TSDPMTData pmt;
+    TSDCode res;
+
+    tsd_context_init(&ctx);
+    ctx.calloc = counting_calloc;
+    ctx.free = counting_free;
+    memset(&pmt, 0, sizeof(pmt));
+
+    uint8_t data[] = {
+        0xE0, 0x99, // PCR PID = 0x99
+        0xF0, 0x04, // program info length = 4
+        0x8B, 0x02, 0xBB, 0xCC, // program descriptor
+        0x1B, 0xE1, 0x00, 0xF0, 0x05, // AVC, ES Info Length = 5
+        0x28, 0x03, 0x64, 0x00, 0x28, // descriptor
+        0x0F, 0xE1, 0x01, 0xF0, 0x00, // AAC, no descriptors
+        0x06, 0xE1, 0x02, 0xF0, 0x06, // private, ES Info Length = 6
+        0x0A, 0x04, 0x65, 0x6E, 0x67, 0x00, // descriptor
+        0xCC, 0xCC, 0xEE, 0x54, // CRC32
+    };
+
+    alloc_count = 0;
+    res = tsd_parse_pmt(&ctx, data, sizeof(data), &pmt);
+    test_assert_equal(TSD_OK, res, "parse valid data");
+    test_assert_equal(1, alloc_count, "one allocation");
+    test_assert_equal(3, pmt.program_elements_length, "program elements length");
+    test_assert_equal(1, pmt.descriptors_length, "descriptors length");
+    test_assert_equal(0x8B, pmt.descriptors[0].tag, "program descriptor");
+    test_assert(pmt.descriptors == (TSDDescriptor*)&pmt.program_elements[3], "descriptors follow the program elements");
+    test_assert(pmt.program_elements[0].descriptors == &pmt.descriptors[1], "inner descriptors follow");
+    test_assert_equal(0x28, pmt.program_elements[0].descriptors[0].tag, "AVC descriptor");
+    test_assert_equal(0, pmt.program_elements[1].descriptors_length, "no AAC descriptors");
+    test_assert(pmt.program_elements[1].descriptors == NULL, "no AAC descriptors");
+    test_assert(pmt.program_elements[2].descriptors == &pmt.descriptors[2], "private descriptors");
+    test_assert_equal(0x0A, pmt.program_elements[2].descriptors[0].tag, "language descriptor");
+    test_assert_equal(0xCCCCEE54, pmt.crc_32, "crc32");
+
+    free_count = 0;
+    ctx.free(pmt.program_elements);
+    test_assert_equal(1, free_count, "released with one free");
+
+    test_end();
+}
@@ -1,4 +1,5 @@
 #include "test.h"
+#include "stream.h"
 #include <tsdemux.h>
 #include <stdio.h>
 #include <string.h>
@@ -7,6 +8,8 @@ void test_input(void);
 void test_parse_longform_table(void);
 void test_parse_shortform_table(void);
 void test_parse_multi_packet_table(void);
+void test_parse_table_crc(void);
+void test_parse_table_section_order(void);
 
 int main(int argc, char **argv)
 {
@@ -14,6 +17,8 @@ int main(int argc, char **argv)
     test_parse_longform_table();
     test_parse_shortform_table();
     test_parse_multi_packet_table();
+    test_parse_table_crc();
+    test_parse_table_section_order();
     return 0;
 }
 
@@ -68,7 +73,8 @@ void test_parse_longform_table(void)
         0b11011101, // reserved, version number, current next indicator
         0x00, // section number
         0x00, // last section number
-        0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, // random bytes
+        0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, // random bytes
+        0x3A, 0xB8, 0x03, 0x78, // CRC_32
         0xFF, // end of table
         // 21 bytes
         0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
@@ -218,23 +224,25 @@ void test_parse_multi_packet_table(void)
         0b10000100, // reserved, version number, current next indicator
         0x00, // section number
         0x02, // last section number
-        0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, // random bytes
+        0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, // random bytes
+        0xCD, 0xD6, 0x69, 0x40, // CRC_32
         // 29 bytes
-        0xD3, // table id
+        0xC2, // table id
         0b10110000, // section syntax indicator, 4 bits of section length (0000)
         0x10, // rest of the section length (16)
-        0x45, // transport stream id
-        0xAB, // transport stream id cont.
+        0x34, // transport stream id
+        0x9A, // transport stream id cont.
         0b10000100, // reserved, version number, current next indicator
         0x01, // section number
         0x02, // last section number
-        0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0D, 0x0F, 0x10, 0x11, 0x12, // random bytes
+        0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0D, // random bytes
+        0xE7, 0x3A, 0x2A, 0x2A, // CRC_32
         // +19 bytes
-        0xE4, // table id
+        0xC2, // table id
         0b10110000, // section syntax indicator, 4 bits of section length (0000)
         0x9E, // rest of the section length (158 bytes)
-        0x56, // transport stream id
-        0xBC, // transport stream id cont.
+        0x34, // transport stream id
+        0x9A, // transport stream id cont.
         0b10000100, // reserved, version number, current next indicator
         0x02, // section number
         0x02, // last section number
@@ -264,12 +272,12 @@ void test_parse_multi_packet_table(void)
     uint8_t tableData2[] = {
         0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
         0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+        0xFF, 0xFF, 0xFF, 0xFF, 0x0D, 0x85, 0xEC, 0xBA, // CRC_32
         0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // stuffing
         0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
         0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
         0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
         0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
         // +64 bytes
         0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
         0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
@@ -338,8 +346,8 @@ void test_parse_multi_packet_table(void)
     TSDTableSection *sec3 = &table.sections[2];
 
     test_assert_equal(sec1->table_id, 0xC2, "table id 1");
-    test_assert_equal(sec2->table_id, 0xD3, "table id 2");
-    test_assert_equal(sec3->table_id, 0xE4, "table id 3");
+    test_assert_equal(sec2->table_id, 0xC2, "table id 2");
+    test_assert_equal(sec3->table_id, 0xC2, "table id 3");
     test_assert_equal(sec1->flags & TSD_TBL_SECTION_SYNTAX_INDICATOR, TSD_TBL_SECTION_SYNTAX_INDICATOR, "section syntax indicator 1");
     test_assert_equal(sec2->flags & TSD_TBL_SECTION_SYNTAX_INDICATOR, TSD_TBL_SECTION_SYNTAX_INDICATOR, "section syntax indicator 2");
     test_assert_equal(sec3->flags & TSD_TBL_SECTION_SYNTAX_INDICATOR, TSD_TBL_SECTION_SYNTAX_INDICATOR, "section syntax indicator 3");
@@ -350,8 +358,8 @@ void test_parse_multi_packet_table(void)
     test_assert_equal(sec2->section_length, 0x10, "section length 2");
     test_assert_equal(sec3->section_length, 0x9E, "section length 3");
     test_assert_equal(sec1->table_id_extension, 0x349A, "transport stream id 1");
-    test_assert_equal(sec2->table_id_extension, 0x45AB, "transport stream id 2");
-    test_assert_equal(sec3->table_id_extension, 0x56BC, "transport stream id 3");
+    test_assert_equal(sec2->table_id_extension, 0x349A, "transport stream id 2");
+    test_assert_equal(sec3->table_id_extension, 0x349A, "transport stream id 3");
     test_assert_equal(sec1->version_number, 0b00000010, "version 1");
     test_assert_equal(sec2->version_number, 0b00000010, "version 2");
     test_assert_equal(sec3->version_number, 0b00000010, "version 3");
@@ -364,3 +372,133 @@ void test_parse_multi_packet_table(void)
 
     test_end();
 }
+
+void test_parse_table_crc(void)
+{
+    test_start("tsd_parse_table CRC check");
+
+    TSDemuxContext ctx;
+    TSDPacket pkt;
+    TSDTable table;
+    TSDCode res;
+
+    uint8_t tableData[188];
+    memset(tableData, 0xFF, sizeof(tableData));
+    uint8_t section[] = {
+        0x00, // pointer field
+        0x01, // table id
+        0b10110000, // section syntax indicator, 4 bits of section length (0000)
+        0x10, // rest of the section length (16)
+        0xFA, // transport stream id
+        0xEB, // transport stream id cont.
+        0b11011101, // reserved, version number, current next indicator
+        0x00, // section number
+        0x00, // last section number
+        0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, // random bytes
+        0x3A, 0xB8, 0x03, 0x78, // CRC_32
+    };
+    memcpy(tableData, section, sizeof(section));
+
+    pkt.sync_byte = 'G';
+    pkt.flags = TSD_PF_PAYLOAD_UNIT_START_IND;
+    pkt.pid = 0x00;
+    pkt.transport_scrambling_control = TSD_SC_NO_SCRAMBLING;
+    pkt.adaptation_field_control = TSD_AFC_NO_FIELD_PRESENT;
+    pkt.continuity_counter = 0;
+    pkt.data_bytes = tableData;
+    pkt.data_bytes_length = sizeof(tableData);
+
+    tsd_context_init(&ctx);
+
+    // a corrupt byte
+    tableData[12] ^= 0x40;
+    res = tsd_parse_table(&ctx, &pkt, &table);
+    test_assert_equal(TSD_INVALID_CRC, res, "corrupt section");
+    test_assert_equal(1, ctx.stats.crc_errors, "CRC error counted");
+    test_assert(ctx.buffers.used == NULL, "table dropped");
+
+    tableData[12] ^= 0x40;
+    res = tsd_parse_table(&ctx, &pkt, &table);
+    test_assert_equal(TSD_OK, res, "intact section");
+    test_assert_equal(1, ctx.stats.crc_errors, "no more CRC errors");
+    tsd_table_data_destroy(&ctx, &table);
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_parse_table_section_order(void)
+{
+    test_start("tsd_parse_table section order and repeats");
+
+    TSDemuxContext ctx;
+    TSDPacket pkt;
+    TSDTable table;
+    TSDCode res;
+
+    uint8_t body[40];
+    uint8_t sections[3][64];
+    size_t section_size = 0;
+    size_t i;
+    for(i=0; i<3; ++i) {
+        memset(body, (int)i, sizeof(body));
+        section_size = stream_section(sections[i], 0x42, 0x1234, 1, (uint8_t)i, 2,
+                                      body, sizeof(body));
+    }
+
+    uint8_t data1[184];
+    uint8_t data2[184];
+    memset(data1, 0xFF, sizeof(data1));
+    memset(data2, 0xFF, sizeof(data2));
+    // sections 2 and 0, then 0 again followed by 1
+    data1[0] = 0x00;
+    memcpy(&data1[1], sections[2], section_size);
+    memcpy(&data1[1 + section_size], sections[0], section_size);
+    data2[0] = 0x00;
+    memcpy(&data2[1], sections[0], section_size);
+    memcpy(&data2[1 + section_size], sections[1], section_size);
+
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.sync_byte = 'G';
+    pkt.flags = TSD_PF_PAYLOAD_UNIT_START_IND;
+    pkt.pid = 0x12;
+    pkt.data_bytes = data1;
+    pkt.data_bytes_length = sizeof(data1);
+
+    tsd_context_init(&ctx);
+
+    res = tsd_parse_table(&ctx, &pkt, &table);
+    test_assert_equal(res, TSD_INCOMPLETE_TABLE, "section 1 missing");
+
+    pkt.data_bytes = data2;
+    res = tsd_parse_table(&ctx, &pkt, &table);
+    test_assert_equal(res, TSD_OK, "complete table");
+    test_assert_equal(3, table.length, "repeat dropped");
+    for(i=0; i<table.length && i<3; ++i) {
+        test_assert_equal(i, table.sections[i].section_number, "sorted by section number");
+        test_assert_equal(i, table.sections[i].section_data[0], "section data");
+    }
+    test_assert(ctx.buffers.used == NULL, "assembler released");
+    tsd_table_data_destroy(&ctx, &table);
+
+    // a new version starts over
+    section_size = stream_section(sections[0], 0x42, 0x1234, 2, 0, 1, body, sizeof(body));
+    memset(data1, 0xFF, sizeof(data1));
+    data1[0] = 0x00;
+    memcpy(&data1[1], sections[0], section_size);
+    pkt.data_bytes = data1;
+    res = tsd_parse_table(&ctx, &pkt, &table);
+    test_assert_equal(res, TSD_INCOMPLETE_TABLE, "new version incomplete");
+    section_size = stream_section(sections[1], 0x42, 0x1234, 3, 0, 0, body, sizeof(body));
+    memcpy(&data1[1], sections[1], section_size);
+    res = tsd_parse_table(&ctx, &pkt, &table);
+    test_assert_equal(res, TSD_OK, "newer version complete");
+    test_assert_equal(3, table.sections[0].version_number, "newer version");
+    test_assert(ctx.buffers.used == NULL, "older version dropped");
+    tsd_table_data_destroy(&ctx, &table);
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
@@ -29,14 +29,21 @@ void test_register(void)
     res = tsd_register_pid(&ctx, 0x100, TSD_REG_PES);
     test_assert_equal(res, TSD_PID_ALREADY_REGISTERED, "PID already registered");
 
+    res = tsd_register_pid(&ctx, 0x2000, TSD_REG_PES);
+    test_assert_equal(res, TSD_INVALID_ARGUMENT, "PID out of range");
+
     int i;
-    for(i=1; i< TSD_MAX_PID_REGS; ++i) {
+    int all_ok = 1;
+    for(i=1; i<128; ++i) {
         res = tsd_register_pid(&ctx, 0x400 + i, TSD_REG_PES);
-        test_assert_equal(res, TSD_OK, "valid PID registration");
+        if(res != TSD_OK) all_ok = 0;
     }
+    test_assert(all_ok, "register more PIDs than the initial capacity");
+    test_assert_equal(128, ctx.registered_pids_length, "registration count");
+    test_assert_equal(0x100, ctx.registered_pids[0].pid, "first PID");
+    test_assert_equal(0x47F, ctx.registered_pids[127].pid, "last PID");
 
-    res = tsd_register_pid(&ctx, 0xFFFF, TSD_REG_PES);
-    test_assert_equal(res, TSD_TSD_MAX_PID_REGS_REACHED, "max PID registration");
+    tsd_context_destroy(&ctx);
 
     test_end();
 }
@@ -61,6 +68,32 @@ void test_deregister(void)
     test_assert_equal(res, TSD_OK, "register same PID");
     res = tsd_deregister_pid(&ctx, 0x200);
     test_assert_equal(res, TSD_OK, "remove same PID again");
+    res = tsd_deregister_pid(&ctx, 0x200);
+    test_assert_equal(res, TSD_PID_NOT_FOUND, "PID already removed");
+
+    // removing from the middle moves the last registration into its place
+    tsd_register_pid(&ctx, 0x300, TSD_REG_PES);
+    tsd_register_pid(&ctx, 0x301, TSD_REG_PES);
+    tsd_register_pid(&ctx, 0x302, TSD_REG_PES);
+    res = tsd_deregister_pid(&ctx, 0x300);
+    test_assert_equal(res, TSD_OK, "remove first PID");
+    test_assert_equal(2, ctx.registered_pids_length, "registration count");
+    test_assert_equal(0x302, ctx.registered_pids[0].pid, "last PID moved");
+    test_assert_equal(0, ctx.pid_map[0x302].index, "moved PID route");
+    res = tsd_register_pid(&ctx, 0x300, TSD_REG_PES);
+    test_assert_equal(res, TSD_OK, "register removed PID");
+
+    // repeated registration doesn't grow the store
+    size_t capacity = ctx.registered_pids_capacity;
+    int i;
+    for(i=0; i<1000; ++i) {
+        tsd_register_pid(&ctx, 0x500 + (i % 8), TSD_REG_PES);
+        tsd_deregister_pid(&ctx, 0x500 + (i % 8));
+    }
+    test_assert_equal(capacity, ctx.registered_pids_capacity, "capacity unchanged");
+    test_assert_equal(3, ctx.registered_pids_length, "registration count");
+
+    tsd_context_destroy(&ctx);
 
     test_end();
 }
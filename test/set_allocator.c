@@ -0,0 +1,278 @@
+#include "test.h"
+#include "stream.h"
+#include <tsdemux.h>
+#include <stdlib.h>
+
+void test_set_allocator(void);
+void test_allocator_user(void);
+void test_arena(void);
+void test_arena_demux(void);
+
+int main(int argc, char **argv)
+{
+    test_set_allocator();
+    test_allocator_user();
+    test_arena();
+    test_arena_demux();
+    return 0;
+}
+
+// allocations counted per user context
+typedef struct Counter {
+    size_t allocs;
+    size_t frees;
+} Counter;
+
+void *counter_malloc(void *user, size_t size)
+{
+    ((Counter*)user)->allocs++;
+    return malloc(size);
+}
+
+void *counter_calloc(void *user, size_t num, size_t size)
+{
+    ((Counter*)user)->allocs++;
+    return calloc(num, size);
+}
+
+void *counter_realloc(void *user, void *ptr, size_t size)
+{
+    if(!ptr) ((Counter*)user)->allocs++;
+    return realloc(ptr, size);
+}
+
+void counter_free(void *user, void *mem)
+{
+    if(mem) ((Counter*)user)->frees++;
+    free(mem);
+}
+
+int pmt_count;
+int pes_count;
+
+void event_cb(TSDemuxContext *ctx, uint16_t pid, TSDEventId id, void *data)
+{
+    if(id == TSD_EVENT_PMT) {
+        TSDPMTData *pmt = (TSDPMTData*)data;
+        pmt_count++;
+        size_t i;
+        for(i=0; i<pmt->program_elements_length; ++i) {
+            tsd_register_pid(ctx, pmt->program_elements[i].elementary_pid, TSD_REG_PES);
+        }
+    } else if(id == TSD_EVENT_PES) {
+        pes_count++;
+    }
+}
+
+// a PAT, a PMT and a few PES packets on PID 0x101, returns the size.
+size_t write_stream(uint8_t *out)
+{
+    uint8_t section[256];
+    uint8_t pes[512];
+    uint8_t payload[300];
+    uint16_t prog = 1;
+    uint16_t pmt_pid = 0x100;
+    uint8_t type = TSD_PMT_STREAM_TYPE_VIDEO_AVC;
+    uint16_t es_pid = 0x101;
+    uint8_t cc_pat = 0, cc_pmt = 0, cc_es = 0;
+    size_t len = 0;
+    int i;
+
+    memset(payload, 0x11, sizeof(payload));
+    size_t sec_len = stream_pat(section, 1, 0, 1, &prog, &pmt_pid);
+    len += stream_packetize_section(&out[len], 0, &cc_pat, section, sec_len);
+    sec_len = stream_pmt(section, prog, 0, es_pid, 1, &type, &es_pid);
+    len += stream_packetize_section(&out[len], pmt_pid, &cc_pmt, section, sec_len);
+    for(i=0; i<4; ++i) {
+        size_t pes_len = stream_pes(pes, 0xE0, i * 3000, payload, sizeof(payload), 1);
+        len += stream_packetize_pes(&out[len], es_pid, &cc_es, pes, pes_len);
+    }
+    return len;
+}
+
+void test_set_allocator(void)
+{
+    test_start("tsd_set_allocator");
+
+    TSDemuxContext ctx;
+    TSDAllocator allocator;
+    Counter counter = {0, 0};
+    tsd_context_init(&ctx);
+
+    allocator.malloc = counter_malloc;
+    allocator.calloc = counter_calloc;
+    allocator.realloc = counter_realloc;
+    allocator.free = NULL;
+    allocator.user = &counter;
+
+    TSDCode res = tsd_set_allocator(NULL, &allocator);
+    test_assert_equal(TSD_INVALID_CONTEXT, res, "invalid context");
+    res = tsd_set_allocator(&ctx, &allocator);
+    test_assert_equal(TSD_INVALID_ARGUMENT, res, "missing free function");
+    test_assert_equal_ptr((size_t)NULL, (size_t)ctx.allocator.malloc, "allocator not set");
+
+    allocator.free = counter_free;
+    res = tsd_set_allocator(&ctx, &allocator);
+    test_assert_equal(TSD_OK, res, "set allocator");
+    test_assert_equal_ptr((size_t)&counter, (size_t)ctx.allocator.user, "user is set");
+
+    res = tsd_set_allocator(&ctx, NULL);
+    test_assert_equal(TSD_OK, res, "NULL allocator");
+    test_assert_equal_ptr((size_t)NULL, (size_t)ctx.allocator.malloc, "allocator cleared");
+
+    tsd_context_destroy(&ctx);
+
+    test_end();
+}
+
+void test_allocator_user(void)
+{
+    test_start("allocator user context");
+
+    uint8_t stream[188 * 16];
+    size_t len = write_stream(stream);
+    size_t parsed = 0;
+
+    // two contexts, each with its own counter
+    Counter counters[2] = {{0, 0}, {0, 0}};
+    TSDemuxContext ctx[2];
+    int i;
+    for(i=0; i<2; ++i) {
+        TSDAllocator allocator;
+        allocator.malloc = counter_malloc;
+        allocator.calloc = counter_calloc;
+        allocator.realloc = counter_realloc;
+        allocator.free = counter_free;
+        allocator.user = &counters[i];
+        tsd_context_init(&ctx[i]);
+        tsd_set_allocator(&ctx[i], &allocator);
+        tsd_set_event_callback(&ctx[i], event_cb);
+    }
+
+    pes_count = 0;
+    tsd_demux(&ctx[0], stream, len, &parsed);
+    test_assert(pes_count > 0, "PES delivered");
+    test_assert(counters[0].allocs > 0, "first context allocated");
+    test_assert_equal(0, counters[1].allocs, "second context untouched");
+
+    tsd_context_destroy(&ctx[0]);
+    tsd_context_destroy(&ctx[1]);
+    test_assert_equal(counters[0].allocs, counters[0].frees, "everything freed");
+
+    test_end();
+}
+
+void test_arena(void)
+{
+    test_start("tsd_arena");
+
+    uint8_t region[256 + TSD_ARENA_ALIGNMENT];
+    TSDArena arena;
+    TSDAllocator allocator;
+
+    test_assert_equal(TSD_INVALID_ARGUMENT, tsd_arena_init(NULL, region, 10), "invalid arena");
+    test_assert_equal(TSD_INVALID_ARGUMENT, tsd_arena_init(&arena, NULL, 10), "invalid buffer");
+    test_assert_equal(TSD_INVALID_ARGUMENT, tsd_arena_allocator(&arena, NULL), "invalid allocator");
+
+    // start off misaligned, the arena aligns itself
+    TSDCode res = tsd_arena_init(&arena, &region[1], 256);
+    test_assert_equal(TSD_OK, res, "init");
+    res = tsd_arena_allocator(&arena, &allocator);
+    test_assert_equal(TSD_OK, res, "allocator");
+    test_assert_equal_ptr((size_t)&arena, (size_t)allocator.user, "user is the arena");
+
+    uint8_t *a = (uint8_t*) allocator.malloc(allocator.user, 10);
+    uint8_t *b = (uint8_t*) allocator.calloc(allocator.user, 4, 5);
+    test_assert(a != NULL && b != NULL, "allocated");
+    test_assert_equal(0, (size_t)a % TSD_ARENA_ALIGNMENT, "a aligned");
+    test_assert_equal(0, (size_t)b % TSD_ARENA_ALIGNMENT, "b aligned");
+    test_assert(b > a + 10, "no overlap");
+    test_assert_equal(0, b[19], "calloc zeroes");
+
+    // the last block grows in place
+    memset(b, 0x5A, 20);
+    uint8_t *c = (uint8_t*) allocator.realloc(allocator.user, b, 40);
+    test_assert_equal_ptr((size_t)b, (size_t)c, "grown in place");
+    test_assert_equal(0x5A, c[19], "data kept");
+
+    // an older block is copied
+    memset(a, 0x3C, 10);
+    uint8_t *d = (uint8_t*) allocator.realloc(allocator.user, a, 20);
+    test_assert(d != NULL && d != a, "moved");
+    test_assert_equal(0x3C, d[9], "data copied");
+
+    // freeing the last block gives its memory back
+    size_t used = arena.used;
+    allocator.free(allocator.user, d);
+    test_assert(arena.used < used, "last block freed");
+    used = arena.used;
+    allocator.free(allocator.user, a);
+    test_assert_equal(used, arena.used, "older blocks stay");
+
+    // running out of memory
+    test_assert_equal_ptr((size_t)NULL, (size_t)allocator.malloc(allocator.user, 1024), "exhausted");
+    test_assert_equal_ptr((size_t)NULL, (size_t)allocator.calloc(allocator.user, (size_t)-1, 2), "overflow");
+
+    res = tsd_arena_reset(&arena);
+    test_assert_equal(TSD_OK, res, "reset");
+    test_assert_equal(0, arena.used, "nothing used");
+    test_assert_equal_ptr((size_t)a, (size_t)allocator.malloc(allocator.user, 10), "memory reused");
+
+    test_end();
+}
+
+void test_arena_demux(void)
+{
+    test_start("tsd_demux with an arena");
+
+    uint8_t stream[188 * 16];
+    size_t len = write_stream(stream);
+    size_t parsed = 0;
+    int round;
+
+    size_t region_size = 256 * 1024;
+    uint8_t *region = (uint8_t*) malloc(region_size);
+    TSDArena arena;
+    TSDAllocator allocator;
+    tsd_arena_init(&arena, region, region_size);
+    tsd_arena_allocator(&arena, &allocator);
+
+    // a context per stream, the arena is reset in between
+    size_t first_used = 0;
+    for(round=0; round<3; ++round) {
+        TSDemuxContext ctx;
+        tsd_context_init(&ctx);
+        tsd_set_allocator(&ctx, &allocator);
+        tsd_set_event_callback(&ctx, event_cb);
+
+        pmt_count = 0;
+        pes_count = 0;
+        TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+        test_assert_equal(TSD_OK, res, "demux");
+        test_assert_equal(1, pmt_count, "PMT");
+        test_assert_equal(4, pes_count, "PES packets");
+        test_assert(arena.used > 0, "allocated from the arena");
+        if(round == 0) {
+            first_used = arena.used;
+        } else {
+            test_assert_equal(first_used, arena.used, "same usage each stream");
+        }
+
+        tsd_context_destroy(&ctx);
+        tsd_arena_reset(&arena);
+    }
+
+    // a region too small for the context fails cleanly
+    TSDemuxContext ctx;
+    tsd_arena_init(&arena, region, 64);
+    tsd_context_init(&ctx);
+    tsd_set_allocator(&ctx, &allocator);
+    tsd_set_event_callback(&ctx, event_cb);
+    TSDCode res = tsd_demux(&ctx, stream, len, &parsed);
+    test_assert_equal(TSD_OUT_OF_MEMORY, res, "out of memory");
+    tsd_context_destroy(&ctx);
+
+    free(region);
+
+    test_end();
+}
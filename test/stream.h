@@ -0,0 +1,201 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+// Helpers used to build small Transport Streams in memory.
+
+#include <stdint.h>
+#include <string.h>
+
+uint32_t stream_crc32(const uint8_t *data, size_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    size_t i;
+    for(i=0; i<size; ++i) {
+        crc ^= ((uint32_t)data[i]) << 24;
+        int j;
+        for(j=0; j<8; ++j) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+// writes a long form section around body, returns the section size.
+size_t stream_section(uint8_t *out,
+                      uint8_t table_id,
+                      uint16_t table_ext,
+                      uint8_t version,
+                      uint8_t section_number,
+                      uint8_t last_section_number,
+                      const uint8_t *body,
+                      size_t body_size)
+{
+    size_t section_length = body_size + 9;
+    out[0] = table_id;
+    out[1] = 0xB0 | ((section_length >> 8) & 0x0F);
+    out[2] = section_length & 0xFF;
+    out[3] = table_ext >> 8;
+    out[4] = table_ext & 0xFF;
+    out[5] = 0xC1 | ((version & 0x1F) << 1);
+    out[6] = section_number;
+    out[7] = last_section_number;
+    memcpy(&out[8], body, body_size);
+    uint32_t crc = stream_crc32(out, body_size + 8);
+    out[body_size + 8] = crc >> 24;
+    out[body_size + 9] = crc >> 16;
+    out[body_size + 10] = crc >> 8;
+    out[body_size + 11] = crc;
+    return body_size + 12;
+}
+
+size_t stream_pat(uint8_t *out,
+                  uint16_t ts_id,
+                  uint8_t version,
+                  size_t count,
+                  const uint16_t *program_numbers,
+                  const uint16_t *pids)
+{
+    uint8_t body[1024];
+    size_t i;
+    for(i=0; i<count; ++i) {
+        body[i*4] = program_numbers[i] >> 8;
+        body[i*4+1] = program_numbers[i] & 0xFF;
+        body[i*4+2] = 0xE0 | (pids[i] >> 8);
+        body[i*4+3] = pids[i] & 0xFF;
+    }
+    return stream_section(out, 0x00, ts_id, version, 0, 0, body, count * 4);
+}
+
+size_t stream_pmt(uint8_t *out,
+                  uint16_t program_number,
+                  uint8_t version,
+                  uint16_t pcr_pid,
+                  size_t count,
+                  const uint8_t *stream_types,
+                  const uint16_t *pids)
+{
+    uint8_t body[1024];
+    body[0] = 0xE0 | (pcr_pid >> 8);
+    body[1] = pcr_pid & 0xFF;
+    body[2] = 0xF0;
+    body[3] = 0x00;
+    size_t len = 4;
+    size_t i;
+    for(i=0; i<count; ++i) {
+        body[len++] = stream_types[i];
+        body[len++] = 0xE0 | (pids[i] >> 8);
+        body[len++] = pids[i] & 0xFF;
+        body[len++] = 0xF0;
+        body[len++] = 0x00;
+    }
+    return stream_section(out, 0x02, program_number, version, 0, 0, body, len);
+}
+
+// writes a single 188 byte packet. Payloads shorter than 184 bytes are either
+// padded with 0xFF (sections) or adaptation field stuffing (PES).
+size_t stream_packet(uint8_t *out,
+                     uint16_t pid,
+                     int pusi,
+                     uint8_t *cc,
+                     const uint8_t *payload,
+                     size_t size,
+                     int stuff_payload)
+{
+    out[0] = 0x47;
+    out[1] = (pusi ? 0x40 : 0x00) | ((pid >> 8) & 0x1F);
+    out[2] = pid & 0xFF;
+    size_t header = 4;
+    if(size < 184 && !stuff_payload) {
+        size_t af_len = 183 - size;
+        out[3] = 0x30 | (*cc & 0x0F);
+        out[4] = (uint8_t)af_len;
+        if(af_len > 0) {
+            out[5] = 0x00;
+            memset(&out[6], 0xFF, af_len - 1);
+        }
+        header = 5 + af_len;
+    } else {
+        out[3] = 0x10 | (*cc & 0x0F);
+    }
+    memcpy(&out[header], payload, size);
+    if(header + size < 188) {
+        memset(&out[header + size], 0xFF, 188 - header - size);
+    }
+    *cc = (*cc + 1) & 0x0F;
+    return 188;
+}
+
+// splits a section over as many packets as are needed.
+size_t stream_packetize_section(uint8_t *out,
+                                uint16_t pid,
+                                uint8_t *cc,
+                                const uint8_t *section,
+                                size_t size)
+{
+    uint8_t payload[184];
+    size_t written = 0;
+    size_t offset = 0;
+    int first = 1;
+    while(offset < size) {
+        size_t len = 0;
+        if(first) {
+            payload[len++] = 0x00; // pointer field
+        }
+        size_t chunk = size - offset;
+        if(chunk > 184 - len) chunk = 184 - len;
+        memcpy(&payload[len], &section[offset], chunk);
+        len += chunk;
+        offset += chunk;
+        written += stream_packet(&out[written], pid, first, cc, payload, len, 1);
+        first = 0;
+    }
+    return written;
+}
+
+// writes a PES packet header (with PTS) followed by the payload.
+size_t stream_pes(uint8_t *out,
+                  uint8_t stream_id,
+                  uint64_t pts,
+                  const uint8_t *payload,
+                  size_t size,
+                  int bounded)
+{
+    size_t pes_len = size + 8;
+    out[0] = 0x00;
+    out[1] = 0x00;
+    out[2] = 0x01;
+    out[3] = stream_id;
+    out[4] = (bounded && pes_len <= 0xFFFF) ? (pes_len >> 8) : 0;
+    out[5] = (bounded && pes_len <= 0xFFFF) ? (pes_len & 0xFF) : 0;
+    out[6] = 0x80;
+    out[7] = 0x80; // PTS only
+    out[8] = 0x05;
+    out[9] = 0x21 | ((pts >> 29) & 0x0E);
+    out[10] = (pts >> 22) & 0xFF;
+    out[11] = 0x01 | ((pts >> 14) & 0xFE);
+    out[12] = (pts >> 7) & 0xFF;
+    out[13] = 0x01 | ((pts << 1) & 0xFE);
+    memcpy(&out[14], payload, size);
+    return size + 14;
+}
+
+// splits a PES packet over as many packets as are needed.
+size_t stream_packetize_pes(uint8_t *out,
+                            uint16_t pid,
+                            uint8_t *cc,
+                            const uint8_t *pes,
+                            size_t size)
+{
+    size_t written = 0;
+    size_t offset = 0;
+    while(offset < size) {
+        size_t chunk = size - offset;
+        if(chunk > 184) chunk = 184;
+        written += stream_packet(&out[written], pid, offset == 0, cc,
+                                 &pes[offset], chunk, 0);
+        offset += chunk;
+    }
+    return written;
+}
+
+#endif // STREAM_H